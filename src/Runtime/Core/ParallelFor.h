@@ -0,0 +1,38 @@
+#pragma once
+#include <Core/ThreadPool.h>
+#include <algorithm>
+#include <future>
+#include <vector>
+
+namespace GU
+{
+	// Split [0, count) into at most maxChunks contiguous ranges and run
+	// func(chunk, begin, end) for each of them on the pool. Chunk 0 runs on the
+	// calling thread, so the chunk index can be used to pick per-worker scratch data.
+	// Must not be called from a task that is itself running on the same pool.
+	template<typename F>
+	void parallelFor(ThreadPool* pool, int count, int maxChunks, F&& func)
+	{
+		if (count <= 0) return;
+		int nchunks = std::max(1, std::min(maxChunks, count));
+		if (pool == nullptr || nchunks == 1)
+		{
+			func(0, 0, count);
+			return;
+		}
+
+		const int chunkSize = (count + nchunks - 1) / nchunks;
+		std::vector<std::future<void> > futures;
+		futures.reserve(nchunks);
+		for (int chunk = 1; chunk < nchunks; chunk++)
+		{
+			const int begin = chunk * chunkSize;
+			const int end = std::min(begin + chunkSize, count);
+			if (begin >= end) break;
+			futures.emplace_back(pool->enqueue([&func, chunk, begin, end]() { func(chunk, begin, end); }));
+		}
+		func(0, 0, std::min(chunkSize, count));
+		for (auto& future : futures)
+			future.get();
+	}
+}
@@ -20,4 +20,9 @@ namespace GU {
 	{
 	}
 
+	void UUID::setSeed(uint64_t seed)
+	{
+		s_Engine.seed(seed ? seed : s_RandomDevice());
+	}
+
 }
\ No newline at end of file
@@ -9,6 +9,9 @@ namespace GU
 		UUID(uint64_t uuid);
 		UUID(const UUID&) = default;
 
+		// reproducible ids for lockstep runs, 0 goes back to the random device
+		static void setSeed(uint64_t seed);
+
 		operator uint64_t() const { return m_UUID; }
 	private:
 		uint64_t m_UUID;
@@ -78,7 +78,7 @@ inline int longestAxis(float x, float y)
 
 static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int trisPerChunk,
 					  int& curNode, rcChunkyTriMeshNode* nodes, const int maxNodes,
-					  int& curTri, int* outTris, const int* inTris)
+					  int& curTri, int* outTris, int* outTriIds, const int* inTris)
 {
 	int inum = imax - imin;
 	int icur = curNode;
@@ -101,6 +101,7 @@ static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int tri
 		{
 			const int* src = &inTris[items[i].i*3];
 			int* dst = &outTris[curTri*3];
+			outTriIds[curTri] = items[i].i;
 			curTri++;
 			dst[0] = src[0];
 			dst[1] = src[1];
@@ -129,9 +130,9 @@ static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int tri
 		int isplit = imin+inum/2;
 		
 		// Left
-		subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+		subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, outTriIds, inTris);
 		// Right
-		subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+		subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, outTriIds, inTris);
 		
 		int iescape = curNode - icur;
 		// Negative index means escape.
@@ -151,6 +152,10 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
 	cm->tris = new int[ntris*3];
 	if (!cm->tris)
 		return false;
+
+	cm->triIds = new int[ntris];
+	if (!cm->triIds)
+		return false;
 		
 	cm->ntris = ntris;
 
@@ -180,7 +185,7 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
 
 	int curTri = 0;
 	int curNode = 0;
-	subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris);
+	subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, cm->triIds, tris);
 	
 	delete [] items;
 	
@@ -313,3 +318,8 @@ int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm,
 	
 	return n;
 }
+
+bool rcCheckChunkOverlapSegment(const rcChunkyTriMeshNode& node, const float p[2], const float q[2])
+{
+	return checkOverlapSegment(p, q, node.bmin, node.bmax);
+}
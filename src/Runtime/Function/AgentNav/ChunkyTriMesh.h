@@ -29,12 +29,13 @@ struct rcChunkyTriMeshNode
 
 struct rcChunkyTriMesh
 {
-	inline rcChunkyTriMesh() : nodes(0), nnodes(0), tris(0), ntris(0), maxTrisPerChunk(0) {}
-	inline ~rcChunkyTriMesh() { delete [] nodes; delete [] tris; }
+	inline rcChunkyTriMesh() : nodes(0), nnodes(0), tris(0), triIds(0), ntris(0), maxTrisPerChunk(0) {}
+	inline ~rcChunkyTriMesh() { delete [] nodes; delete [] tris; delete [] triIds; }
 
 	rcChunkyTriMeshNode* nodes;
 	int nnodes;
 	int* tris;
+	int* triIds;	// Index of each chunk triangle in the source triangle array.
 	int ntris;
 	int maxTrisPerChunk;
 
@@ -55,5 +56,8 @@ int rcGetChunksOverlappingRect(const rcChunkyTriMesh* cm, float bmin[2], float b
 /// Returns the chunk indices which overlap the input segment.
 int rcGetChunksOverlappingSegment(const rcChunkyTriMesh* cm, float p[2], float q[2], int* ids, const int maxIds);
 
+/// Returns true if the input segment overlaps the bounds of the chunk.
+bool rcCheckChunkOverlapSegment(const rcChunkyTriMeshNode& node, const float p[2], const float q[2]);
+
 
 #endif // CHUNKYTRIMESH_H
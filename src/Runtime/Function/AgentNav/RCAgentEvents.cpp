@@ -0,0 +1,156 @@
+#include "RCAgentEvents.h"
+#include <Function/AgentNav/RCScheduler.h>
+#include <DetourCommon.h>
+#include <algorithm>
+
+namespace GU
+{
+	void RCAgentEvents::init(int maxAgents)
+	{
+		// room for every agent arriving in the same tick twice over
+		size_t capacity = 64;
+		while (capacity < (size_t)maxAgents * 2) capacity <<= 1;
+		m_ring.assign(capacity, RCAgentEvent());
+		m_mask = capacity - 1;
+		m_slowTime.assign(maxAgents, 0.0f);
+		m_flags.assign(maxAgents, 0);
+		clear();
+	}
+
+	void RCAgentEvents::reset(int idx)
+	{
+		if (idx < 0 || idx >= (int)m_flags.size()) return;
+		m_slowTime[idx] = 0.0f;
+		m_flags[idx] = 0;
+	}
+
+	void RCAgentEvents::clear()
+	{
+		m_head.store(0, std::memory_order_relaxed);
+		m_tail.store(0, std::memory_order_relaxed);
+		m_overflow.clear();
+	}
+
+	bool RCAgentEvents::tryPush(const RCAgentEvent& event)
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head - m_tail.load(std::memory_order_acquire) > m_mask) return false;
+		m_ring[head & m_mask] = event;
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	void RCAgentEvents::push(const RCAgentEvent& event)
+	{
+		// keep the order, nothing passes the overflow list
+		if (m_overflow.empty() && tryPush(event)) return;
+		m_overflow.push_back(event);
+	}
+
+	void RCAgentEvents::post(uint64_t tick, int idx, RCAgentEventType type, const float* pos)
+	{
+		RCAgentEvent event;
+		event.tick = tick;
+		event.idx = idx;
+		event.type = type;
+		dtVcopy(event.pos, pos);
+		push(event);
+	}
+
+	void RCAgentEvents::flushOverflow()
+	{
+		size_t flushed = 0;
+		while (flushed < m_overflow.size() && tryPush(m_overflow[flushed])) flushed++;
+		m_overflow.erase(m_overflow.begin(), m_overflow.begin() + flushed);
+	}
+
+	int RCAgentEvents::pop(std::vector<RCAgentEvent>& events)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		const size_t head = m_head.load(std::memory_order_acquire);
+		for (size_t i = tail; i != head; i++)
+			events.push_back(m_ring[i & m_mask]);
+		m_tail.store(head, std::memory_order_release);
+		return (int)(head - tail);
+	}
+
+	void RCAgentEvents::detect(RCScheduler* scheduler, uint64_t tick, float dt)
+	{
+		if (m_ring.empty()) return;
+		flushOverflow();
+
+		const float arriveSqr = m_arriveRadius * m_arriveRadius;
+		const float stuckSqr = m_stuckSpeed * m_stuckSpeed;
+		const int n = std::min(scheduler->getMaxAgents(), (int)m_flags.size());
+		for (int i = 0; i < n; i++)
+		{
+			const dtCrowdAgent* ag = scheduler->getCrowdAgent(i);
+			if (!ag->active)
+			{
+				reset(i);
+				continue;
+			}
+			unsigned char& flags = m_flags[i];
+
+			const bool offMesh = ag->state == DT_CROWDAGENT_STATE_INVALID;
+			if (offMesh != ((flags & FLAG_OFF_MESH) != 0))
+			{
+				flags ^= FLAG_OFF_MESH;
+				if (offMesh) post(tick, i, RC_AGENT_EVENT_OFF_MESH, ag->npos);
+			}
+			const bool failed = ag->targetState == DT_CROWDAGENT_TARGET_FAILED;
+			if (failed != ((flags & FLAG_FAILED) != 0))
+			{
+				flags ^= FLAG_FAILED;
+				if (failed) post(tick, i, RC_AGENT_EVENT_TARGET_FAILED, ag->npos);
+			}
+
+			const bool follower = scheduler->getAgentLeader(i) != -1;
+			const bool atTarget = ag->targetState == DT_CROWDAGENT_TARGET_VALID && dtVdistSqr(ag->npos, ag->targetPos) < arriveSqr;
+			if (atTarget && !follower)
+			{
+				post(tick, i, RC_AGENT_EVENT_ARRIVED, ag->npos);
+				if (scheduler->getAgentFollowerCount(i) > 0)
+				{
+					flags |= FLAG_LEADER_ARRIVED;
+					m_arrivedLeaders.push_back(i);
+					continue;
+				}
+				scheduler->removeCrowdAgent(i);
+				reset(i);
+				continue;
+			}
+
+			// on the way to a target but barely moving, followers standing in their slot wait for the leader
+			const bool heading = ag->state == DT_CROWDAGENT_STATE_WALKING &&
+				ag->targetState != DT_CROWDAGENT_TARGET_NONE &&
+				ag->targetState != DT_CROWDAGENT_TARGET_VELOCITY && !failed && !(follower && atTarget);
+			if (heading && dtVlenSqr(ag->vel) < stuckSqr) m_slowTime[i] += dt;
+			else m_slowTime[i] = 0.0f;
+			const bool stuck = m_slowTime[i] >= m_stuckTime;
+			if (stuck != ((flags & FLAG_STUCK) != 0))
+			{
+				flags ^= FLAG_STUCK;
+				post(tick, i, stuck ? RC_AGENT_EVENT_STUCK : RC_AGENT_EVENT_UNSTUCK, ag->npos);
+			}
+		}
+		if (m_arrivedLeaders.empty()) return;
+
+		// followers arrive with their leader, before it leaves so the group is not handed on
+		for (int i = 0; i < n; i++)
+		{
+			const dtCrowdAgent* ag = scheduler->getCrowdAgent(i);
+			const int leader = ag->active ? scheduler->getAgentLeader(i) : -1;
+			if (leader == -1 || !(m_flags[leader] & FLAG_LEADER_ARRIVED)) continue;
+			post(tick, i, RC_AGENT_EVENT_ARRIVED, ag->npos);
+			scheduler->removeCrowdAgent(i);
+			reset(i);
+		}
+		for (int leader : m_arrivedLeaders)
+		{
+			scheduler->removeCrowdAgent(leader);
+			reset(leader);
+		}
+		m_arrivedLeaders.clear();
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <Function/AgentNav/RCParams.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GU
+{
+	class RCScheduler;
+
+	enum RCAgentEventType : unsigned char
+	{
+		RC_AGENT_EVENT_ARRIVED,			// reached its target, already removed from the crowd
+		RC_AGENT_EVENT_STUCK,			// slower than AGENT_STUCK_SPEED for AGENT_STUCK_TIME on the way to its target
+		RC_AGENT_EVENT_UNSTUCK,			// moving again after RC_AGENT_EVENT_STUCK
+		RC_AGENT_EVENT_TARGET_FAILED,	// no path to the move target
+		RC_AGENT_EVENT_OFF_MESH,		// lost the navmesh
+		RC_AGENT_EVENT_DENSITY_PEAK,	// idx is a density grid cell that reached the peak density, pos the agent that filled it
+	};
+
+	struct RCAgentEvent
+	{
+		uint64_t tick = 0;
+		int idx = -1;
+		RCAgentEventType type = RC_AGENT_EVENT_ARRIVED;
+		float pos[3] = {};
+	};
+
+	// Agent state transitions found at the end of every crowd tick. The tick walks the
+	// agents in slot order, removes arrivals from the crowd and pushes events into a
+	// bounded single producer, single consumer ring that the scene drains once per frame
+	// without taking the crowd mutex. Events that do not fit wait in an overflow list
+	// on the producer side and go first on the next tick.
+	// Group followers have no target of their own, they arrive with their leader.
+	class RCAgentEvents
+	{
+	public:
+		RCAgentEvents() = default;
+		~RCAgentEvents() = default;
+		RCAgentEvents(const RCAgentEvents&) = delete;
+		RCAgentEvents& operator=(const RCAgentEvents&) = delete;
+
+		void init(int maxAgents);
+		// a new agent took the slot
+		void reset(int idx);
+		// producer, called by the crowd tick under the crowd mutex
+		void detect(RCScheduler* scheduler, uint64_t tick, float dt);
+		// producer, for events found by other passes of the crowd tick
+		void post(uint64_t tick, int idx, RCAgentEventType type, const float* pos);
+		// producer, moves waiting events into the ring as far as they fit, detect does it first
+		void flushOverflow();
+		// consumer, appends the pending events to events and returns how many
+		int pop(std::vector<RCAgentEvent>& events);
+		// drops every event, neither side may run
+		void clear();
+
+		float m_arriveRadius = AGENT_ARRIVE_RADIUS;
+		float m_stuckSpeed = AGENT_STUCK_SPEED;
+		float m_stuckTime = AGENT_STUCK_TIME;
+	private:
+		enum Flags : unsigned char
+		{
+			FLAG_STUCK = 1,
+			FLAG_FAILED = 2,
+			FLAG_OFF_MESH = 4,
+			FLAG_LEADER_ARRIVED = 8,
+		};
+
+		void push(const RCAgentEvent& event);
+		bool tryPush(const RCAgentEvent& event);
+
+		std::vector<RCAgentEvent> m_ring;
+		size_t m_mask = 0;
+		alignas(64) std::atomic<size_t> m_head{ 0 };	// next write, producer
+		alignas(64) std::atomic<size_t> m_tail{ 0 };	// next read, consumer
+		std::vector<RCAgentEvent> m_overflow;
+
+		// producer only
+		std::vector<float> m_slowTime;
+		std::vector<unsigned char> m_flags;
+		std::vector<int> m_arrivedLeaders;	// removed after their followers
+	};
+}
@@ -0,0 +1,69 @@
+#include "RCCheckpoint.h"
+#include <fstream>
+
+namespace GU
+{
+	static const int CHECKPOINT_MAGIC = 'R' << 24 | 'C' << 16 | 'C' << 8 | 'P';
+	static const int CHECKPOINT_VERSION = 1;
+
+	struct CheckpointHeader
+	{
+		int magic;
+		int version;
+		uint64_t tick;
+		double time;
+		uint64_t crowdSize;
+		uint64_t entityCount;
+		uint32_t entitySize;
+	};
+
+	void RCCrowdCheckpoint::clear()
+	{
+		tick = 0;
+		time = 0.0;
+		crowd.clear();
+		entities.clear();
+	}
+
+	bool RCCrowdCheckpoint::save(const std::filesystem::path& filepath) const
+	{
+		std::ofstream fout(filepath, std::ios::binary);
+		if (!fout.is_open()) return false;
+		CheckpointHeader header{ CHECKPOINT_MAGIC, CHECKPOINT_VERSION, tick, time,
+			crowd.size(), entities.size(), sizeof(RCCheckpointEntity) };
+		fout.write((const char*)&header, sizeof(header));
+		fout.write((const char*)crowd.data(), crowd.size());
+		fout.write((const char*)entities.data(), entities.size() * sizeof(RCCheckpointEntity));
+		return fout.good();
+	}
+
+	bool RCCrowdCheckpoint::load(const std::filesystem::path& filepath)
+	{
+		std::ifstream fin(filepath, std::ios::binary);
+		if (!fin.is_open()) return false;
+		CheckpointHeader header;
+		if (!fin.read((char*)&header, sizeof(header))) return false;
+		if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION ||
+			header.entitySize != sizeof(RCCheckpointEntity))
+			return false;
+		// sizes from a damaged header must not allocate more than the file holds
+		std::error_code ec;
+		const uint64_t fileSize = std::filesystem::file_size(filepath, ec);
+		if (ec || fileSize < sizeof(header)) return false;
+		const uint64_t left = fileSize - sizeof(header);
+		if (header.crowdSize > left || header.entityCount > (left - header.crowdSize) / sizeof(RCCheckpointEntity))
+			return false;
+		tick = header.tick;
+		time = header.time;
+		crowd.resize(header.crowdSize);
+		entities.resize(header.entityCount);
+		fin.read((char*)crowd.data(), crowd.size());
+		fin.read((char*)entities.data(), entities.size() * sizeof(RCCheckpointEntity));
+		if (!fin)
+		{
+			clear();
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace GU
+{
+	// scene entity of a crowd agent
+	struct RCCheckpointEntity
+	{
+		uint64_t uuid = 0;
+		int idx = -1;
+		float startPos[3] = {};
+		float targetPos[3] = {};
+		float translation[3] = {};
+		float rotation[3] = {};
+	};
+
+	// Crowd and agent entity state of one tick, see RCScheduler::saveCheckpoint. Kept in
+	// memory it is a branch point, every restore runs a variant from the same tick.
+	struct RCCrowdCheckpoint
+	{
+		uint64_t tick = 0;
+		double time = 0.0;
+		std::vector<uint8_t> crowd;		// RCCrowd::saveState
+		std::vector<RCCheckpointEntity> entities;
+
+		void clear();
+		bool save(const std::filesystem::path& filepath) const;
+		bool load(const std::filesystem::path& filepath);
+	};
+}
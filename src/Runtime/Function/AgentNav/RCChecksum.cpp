@@ -0,0 +1,27 @@
+#include "RCChecksum.h"
+#include <DetourCrowd.h>
+#include <cstring>
+
+namespace GU
+{
+	static inline uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t hashCrowdAgent(uint64_t hash, int idx, const dtCrowdAgent* ag)
+	{
+		if (!ag->active) return hash;
+		hash = fnv1a(hash, &idx, sizeof(idx));
+		hash = fnv1a(hash, &ag->state, sizeof(ag->state));
+		hash = fnv1a(hash, ag->npos, sizeof(float) * 3);
+		hash = fnv1a(hash, ag->vel, sizeof(float) * 3);
+		return hash;
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+struct dtCrowdAgent;
+
+namespace GU
+{
+	const uint64_t CROWD_CHECKSUM_SEED = 14695981039346656037ull;
+
+	// FNV-1a over the raw bits of an active agent's slot, state, position and velocity.
+	// Hash agents in slot order, any floating point difference changes the result.
+	uint64_t hashCrowdAgent(uint64_t hash, int idx, const dtCrowdAgent* ag);
+}
@@ -0,0 +1,2209 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+// Altered: dtCrowd::update split into per agent phases that run on the thread pool.
+//
+#include "RCCrowd.h"
+#include <Function/AgentNav/RCLandmarks.h>
+#include <Function/AgentNav/RCQueryLog.h>
+#include <Function/AgentNav/RCQueryFilters.h>
+#include <Function/AgentNav/RCDensityGrid.h>
+#include <Core/ParallelFor.h>
+#include <DetourCommon.h>
+#include <DetourAlloc.h>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cstring>
+#include <new>
+
+namespace GU
+{
+	static const int MAX_ITERS_PER_UPDATE = 100;
+	static const int MAX_PATHQUEUE_NODES = 4096;
+	static const int MAX_COMMON_NODES = 512;
+	// below this many agents per worker a phase is not worth a task
+	static const int MIN_AGENTS_PER_WORKER = 32;
+
+	const char* getCrowdPhaseName(int phase)
+	{
+		static const char* names[RC_CROWD_PHASE_COUNT] = {
+			"pathValidity", "moveRequest", "topology", "neighbours", "corners",
+			"steering", "avoidance", "integrate", "collision", "move",
+		};
+		return phase >= 0 && phase < RC_CROWD_PHASE_COUNT ? names[phase] : "";
+	}
+
+	void getGroupFormationOffset(int follower, float spacing, float* offset)
+	{
+		const int row = follower / 2 + 1;
+		const float side = (follower % 2) ? 1.0f : -1.0f;
+		offset[0] = side * row * spacing * 0.5f;
+		offset[1] = 0.0f;
+		offset[2] = -row * spacing;
+	}
+
+	inline float tween(const float t, const float t0, const float t1)
+	{
+		return dtClamp((t - t0) / (t1 - t0), 0.0f, 1.0f);
+	}
+
+	static void integrate(dtCrowdAgent* ag, const float dt)
+	{
+		// Fake dynamic constraint.
+		const float maxDelta = ag->params.maxAcceleration * dt;
+		float dv[3];
+		dtVsub(dv, ag->nvel, ag->vel);
+		float ds = dtVlen(dv);
+		if (ds > maxDelta)
+			dtVscale(dv, dv, maxDelta / ds);
+		dtVadd(ag->vel, ag->vel, dv);
+
+		// Integrate
+		if (dtVlen(ag->vel) > 0.0001f)
+			dtVmad(ag->npos, ag->npos, ag->vel, dt);
+		else
+			dtVset(ag->vel, 0, 0, 0);
+	}
+
+	static bool overOffmeshConnection(const dtCrowdAgent* ag, const float radius)
+	{
+		if (!ag->ncorners)
+			return false;
+
+		const bool offMeshConnection = (ag->cornerFlags[ag->ncorners - 1] & DT_STRAIGHTPATH_OFFMESH_CONNECTION) ? true : false;
+		if (offMeshConnection)
+		{
+			const float distSq = dtVdist2DSqr(ag->npos, &ag->cornerVerts[(ag->ncorners - 1) * 3]);
+			if (distSq < radius * radius)
+				return true;
+		}
+
+		return false;
+	}
+
+	static float getDistanceToGoal(const dtCrowdAgent* ag, const float range)
+	{
+		if (!ag->ncorners)
+			return range;
+
+		const bool endOfPath = (ag->cornerFlags[ag->ncorners - 1] & DT_STRAIGHTPATH_END) ? true : false;
+		if (endOfPath)
+			return dtMin(dtVdist2D(ag->npos, &ag->cornerVerts[(ag->ncorners - 1) * 3]), range);
+
+		return range;
+	}
+
+	static void calcSmoothSteerDirection(const dtCrowdAgent* ag, float* dir)
+	{
+		if (!ag->ncorners)
+		{
+			dtVset(dir, 0, 0, 0);
+			return;
+		}
+
+		const int ip0 = 0;
+		const int ip1 = dtMin(1, ag->ncorners - 1);
+		const float* p0 = &ag->cornerVerts[ip0 * 3];
+		const float* p1 = &ag->cornerVerts[ip1 * 3];
+
+		float dir0[3], dir1[3];
+		dtVsub(dir0, p0, ag->npos);
+		dtVsub(dir1, p1, ag->npos);
+		dir0[1] = 0;
+		dir1[1] = 0;
+
+		float len0 = dtVlen(dir0);
+		float len1 = dtVlen(dir1);
+		if (len1 > 0.001f)
+			dtVscale(dir1, dir1, 1.0f / len1);
+
+		dir[0] = dir0[0] - dir1[0] * len0 * 0.5f;
+		dir[1] = 0;
+		dir[2] = dir0[2] - dir1[2] * len0 * 0.5f;
+
+		dtVnormalize(dir);
+	}
+
+	static void calcStraightSteerDirection(const dtCrowdAgent* ag, float* dir)
+	{
+		if (!ag->ncorners)
+		{
+			dtVset(dir, 0, 0, 0);
+			return;
+		}
+		dtVsub(dir, &ag->cornerVerts[0], ag->npos);
+		dir[1] = 0;
+		dtVnormalize(dir);
+	}
+
+	// xz direction the agent is heading in, false when it neither moves nor has a corner
+	static bool getHeadingDirection(const dtCrowdAgent* ag, float* dir)
+	{
+		static const float MIN_HEADING_SPEED = 0.1f;
+		if (dtVlenSqr(ag->vel) > dtSqr(MIN_HEADING_SPEED))
+			dtVcopy(dir, ag->vel);
+		else if (ag->ncorners)
+			dtVsub(dir, &ag->cornerVerts[0], ag->npos);
+		else
+			return false;
+		dir[1] = 0;
+		if (dtVlenSqr(dir) < 0.0001f)
+			return false;
+		dtVnormalize(dir);
+		return true;
+	}
+
+	static int addNeighbour(const int idx, const float dist, dtCrowdNeighbour* neis, const int nneis, const int maxNeis)
+	{
+		// Insert neighbour based on the distance.
+		dtCrowdNeighbour* nei = 0;
+		if (!nneis)
+		{
+			nei = &neis[nneis];
+		}
+		else if (dist >= neis[nneis - 1].dist)
+		{
+			if (nneis >= maxNeis)
+				return nneis;
+			nei = &neis[nneis];
+		}
+		else
+		{
+			int i;
+			for (i = 0; i < nneis; ++i)
+				if (dist <= neis[i].dist)
+					break;
+
+			const int tgt = i + 1;
+			const int n = dtMin(nneis - i, maxNeis - tgt);
+			if (n > 0)
+				memmove(&neis[tgt], &neis[i], sizeof(dtCrowdNeighbour) * n);
+			nei = &neis[i];
+		}
+
+		memset(nei, 0, sizeof(dtCrowdNeighbour));
+		nei->idx = idx;
+		nei->dist = dist;
+
+		return dtMin(nneis + 1, maxNeis);
+	}
+
+	RCCrowdProxy RCCrowd::getNeighbour(const int idx) const
+	{
+		if (idx >= m_maxAgents) return m_proxies[idx - m_maxAgents];
+		const dtCrowdAgent* ag = &m_agents[idx];
+		RCCrowdProxy nei;
+		dtVcopy(nei.npos, ag->npos);
+		dtVcopy(nei.vel, ag->vel);
+		dtVcopy(nei.dvel, ag->dvel);
+		nei.radius = ag->params.radius;
+		nei.height = ag->params.height;
+		return nei;
+	}
+
+	int RCCrowd::getNeighbours(const float* pos, const float height, const float range,
+		const dtCrowdAgent* skip, dtCrowdNeighbour* result, const int maxResult) const
+	{
+		int n = 0;
+
+		static const int MAX_NEIS = 32;
+		unsigned short ids[MAX_NEIS];
+		int nids = m_grid->queryItems(pos[0] - range, pos[2] - range,
+			pos[0] + range, pos[2] + range,
+			ids, MAX_NEIS);
+
+		for (int i = 0; i < nids; ++i)
+		{
+			if (skip && ids[i] == getAgentIndex(skip)) continue;
+			const RCCrowdProxy ag = getNeighbour(ids[i]);
+
+			// Check for overlap.
+			float diff[3];
+			dtVsub(diff, pos, ag.npos);
+			if (dtMathFabsf(diff[1]) >= (height + ag.height) / 2.0f)
+				continue;
+			diff[1] = 0;
+			const float distSqr = dtVlenSqr(diff);
+			if (distSqr > dtSqr(range))
+				continue;
+
+			n = addNeighbour(ids[i], distSqr, result, n, maxResult);
+		}
+		return n;
+	}
+
+	static int addToOptQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int nagents, const int maxAgents)
+	{
+		// Insert neighbour based on greatest time.
+		int slot = 0;
+		if (!nagents)
+		{
+			slot = nagents;
+		}
+		else if (newag->topologyOptTime <= agents[nagents - 1]->topologyOptTime)
+		{
+			if (nagents >= maxAgents)
+				return nagents;
+			slot = nagents;
+		}
+		else
+		{
+			int i;
+			for (i = 0; i < nagents; ++i)
+				if (newag->topologyOptTime >= agents[i]->topologyOptTime)
+					break;
+
+			const int tgt = i + 1;
+			const int n = dtMin(nagents - i, maxAgents - tgt);
+			if (n > 0)
+				memmove(&agents[tgt], &agents[i], sizeof(dtCrowdAgent*) * n);
+			slot = i;
+		}
+
+		agents[slot] = newag;
+
+		return dtMin(nagents + 1, maxAgents);
+	}
+
+	static int addToPathQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int nagents, const int maxAgents)
+	{
+		// Insert neighbour based on greatest time.
+		int slot = 0;
+		if (!nagents)
+		{
+			slot = nagents;
+		}
+		else if (newag->targetReplanTime <= agents[nagents - 1]->targetReplanTime)
+		{
+			if (nagents >= maxAgents)
+				return nagents;
+			slot = nagents;
+		}
+		else
+		{
+			int i;
+			for (i = 0; i < nagents; ++i)
+				if (newag->targetReplanTime >= agents[i]->targetReplanTime)
+					break;
+
+			const int tgt = i + 1;
+			const int n = dtMin(nagents - i, maxAgents - tgt);
+			if (n > 0)
+				memmove(&agents[tgt], &agents[i], sizeof(dtCrowdAgent*) * n);
+			slot = i;
+		}
+
+		agents[slot] = newag;
+
+		return dtMin(nagents + 1, maxAgents);
+	}
+
+	static const int CROWD_STATE_MAGIC = 'R' << 24 | 'C' << 16 | 'C' << 8 | 'S';
+	static const int CROWD_STATE_VERSION = 3;
+
+	struct CrowdStateHeader
+	{
+		int magic;
+		int version;
+		int maxAgents;
+		int agentCount;
+		uint32_t recordSize;
+		uint32_t animSize;
+		double time;
+	};
+
+	// fixed part of a saved agent, followed by the off-mesh animation when animActive
+	// is set and npath corridor polygons
+	struct CrowdAgentRecord
+	{
+		int32_t idx;
+		unsigned char state;
+		unsigned char partial;
+		unsigned char targetState;
+		unsigned char targetReplan;
+		unsigned char animActive;
+		float npos[3];
+		float disp[3];
+		float dvel[3];
+		float nvel[3];
+		float vel[3];
+		float desiredSpeed;
+		float topologyOptTime;
+		float targetReplanTime;
+		float targetPos[3];
+		float corridorPos[3];
+		float corridorTarget[3];
+		dtPolyRef targetRef;
+		int32_t npath;
+		// the boundary is found again from these, 0 when it has to be updated
+		dtPolyRef boundaryRef;
+		float boundaryCenter[3];
+		float boundaryRange;
+		double replanStart;
+		int32_t groupLeader;
+		int32_t groupFollowers;
+		float groupOffset[3];
+		float groupHeading[3];
+		float groupLag;
+		dtCrowdAgentParams params;
+	};
+
+	static inline void putBytes(std::vector<uint8_t>& out, const void* src, size_t size)
+	{
+		const uint8_t* p = (const uint8_t*)src;
+		out.insert(out.end(), p, p + size);
+	}
+
+	static inline bool getBytes(const uint8_t*& data, const uint8_t* end, void* dst, size_t size)
+	{
+		if ((size_t)(end - data) < size) return false;
+		memcpy(dst, data, size);
+		data += size;
+		return true;
+	}
+
+	RCCrowd::~RCCrowd()
+	{
+		purge();
+	}
+
+	void RCCrowd::purge()
+	{
+		if (m_agents)
+		{
+			for (int i = 0; i < m_maxAgents; ++i)
+				m_agents[i].~dtCrowdAgent();
+			dtFree(m_agents);
+		}
+		m_agents = nullptr;
+		m_maxAgents = 0;
+
+		dtFree(m_activeAgents);
+		m_activeAgents = nullptr;
+
+		dtFree(m_agentAnims);
+		m_agentAnims = nullptr;
+
+		dtFree(m_pathResult);
+		m_pathResult = nullptr;
+
+		dtFree(m_replanStart);
+		m_replanStart = nullptr;
+		m_groups.clear();
+		m_followerCount = 0;
+		m_boundaryQueries.clear();
+		m_hierarchyCorridors.clear();
+
+		dtFreeProximityGrid(m_grid);
+		m_grid = nullptr;
+
+		for (Worker& worker : m_workers)
+		{
+			dtFreeNavMeshQuery(worker.navQuery);
+			dtFreeObstacleAvoidanceQuery(worker.obstacleQuery);
+			worker = Worker();
+		}
+	}
+
+	bool RCCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* nav, const int maxProxies)
+	{
+		purge();
+
+		m_maxAgents = maxAgents;
+		m_maxAgentRadius = maxAgentRadius;
+		m_navMesh = nav;
+		m_maxProxies = maxProxies;
+		m_proxies.clear();
+		m_proxies.reserve(maxProxies);
+
+		dtVset(m_ext, m_maxAgentRadius * 2.0f, m_maxAgentRadius * 1.5f, m_maxAgentRadius * 2.0f);
+
+		m_grid = dtAllocProximityGrid();
+		if (!m_grid)
+			return false;
+		if (!m_grid->init((m_maxAgents + m_maxProxies) * 4, maxAgentRadius * 3))
+			return false;
+
+		// Init obstacle query params.
+		memset(m_obstacleQueryParams, 0, sizeof(m_obstacleQueryParams));
+		for (int i = 0; i < DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS; ++i)
+		{
+			dtObstacleAvoidanceParams* params = &m_obstacleQueryParams[i];
+			params->velBias = 0.4f;
+			params->weightDesVel = 2.0f;
+			params->weightCurVel = 0.75f;
+			params->weightSide = 0.75f;
+			params->weightToi = 2.5f;
+			params->horizTime = 2.5f;
+			params->gridSize = 33;
+			params->adaptiveDivs = 7;
+			params->adaptiveRings = 2;
+			params->adaptiveDepth = 5;
+		}
+
+		// Allocate temp buffer for merging paths.
+		m_maxPathResult = 256;
+		m_pathResult = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef) * m_maxPathResult, DT_ALLOC_PERM);
+		if (!m_pathResult)
+			return false;
+
+		if (!m_pathq.init(m_maxPathResult, MAX_PATHQUEUE_NODES, nav))
+			return false;
+		if (!m_pathSearch.init(nav, MAX_PATHQUEUE_NODES))
+			return false;
+
+		m_agents = (dtCrowdAgent*)dtAlloc(sizeof(dtCrowdAgent) * m_maxAgents, DT_ALLOC_PERM);
+		if (!m_agents)
+			return false;
+
+		m_activeAgents = (dtCrowdAgent**)dtAlloc(sizeof(dtCrowdAgent*) * m_maxAgents, DT_ALLOC_PERM);
+		if (!m_activeAgents)
+			return false;
+
+		m_agentAnims = (dtCrowdAgentAnimation*)dtAlloc(sizeof(dtCrowdAgentAnimation) * m_maxAgents, DT_ALLOC_PERM);
+		if (!m_agentAnims)
+			return false;
+
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			new(&m_agents[i]) dtCrowdAgent();
+			m_agents[i].active = false;
+			if (!m_agents[i].corridor.init(m_maxPathResult))
+				return false;
+		}
+
+		for (int i = 0; i < m_maxAgents; ++i)
+			m_agentAnims[i].active = false;
+
+		m_replanStart = (double*)dtAlloc(sizeof(double) * m_maxAgents, DT_ALLOC_PERM);
+		if (!m_replanStart)
+			return false;
+		for (int i = 0; i < m_maxAgents; ++i)
+			m_replanStart[i] = -1.0;
+		m_replanHeap.reserve(m_maxAgents);
+		m_time = 0.0;
+		resetReplanStats();
+		m_groups.assign(m_maxAgents, GroupMember());
+		m_followerCount = 0;
+		m_boundaryQueries.assign(m_maxAgents, BoundaryQuery());
+		m_hierarchyCorridors.assign(m_maxAgents, HierarchyCorridor());
+		m_agentCells.assign(m_maxAgents, -1);
+		m_cellChanges.clear();
+
+		// The navquery is mostly used for local searches, no need for large node pool.
+		// Every worker gets its own, together with its obstacle avoidance query.
+		for (Worker& worker : m_workers)
+		{
+			worker.navQuery = dtAllocNavMeshQuery();
+			if (!worker.navQuery || dtStatusFailed(worker.navQuery->init(nav, MAX_COMMON_NODES)))
+				return false;
+			worker.obstacleQuery = dtAllocObstacleAvoidanceQuery();
+			if (!worker.obstacleQuery || !worker.obstacleQuery->init(6, 8))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool RCCrowd::resize(const int maxAgents, const int maxProxies)
+	{
+		if (!m_navMesh || maxAgents < m_maxAgents)
+			return false;
+		std::vector<uint8_t> state;
+		saveState(state);
+		// init resets these, the filters and public settings are left alone
+		dtObstacleAvoidanceParams params[DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS];
+		memcpy(params, m_obstacleQueryParams, sizeof(params));
+		const RCReplanStats stats = m_replanStats;
+
+		if (!init(maxAgents, m_maxAgentRadius, m_navMesh, maxProxies))
+			return false;
+		memcpy(m_obstacleQueryParams, params, sizeof(params));
+		m_replanStats = stats;
+		return loadState(state.data(), state.size());
+	}
+
+	void RCCrowd::setObstacleAvoidanceParams(const int idx, const dtObstacleAvoidanceParams* params)
+	{
+		if (idx >= 0 && idx < DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS)
+			memcpy(&m_obstacleQueryParams[idx], params, sizeof(dtObstacleAvoidanceParams));
+	}
+
+	void RCCrowd::initAvoidanceQualities()
+	{
+		// Use mostly default settings, copy from dtCrowd.
+		dtObstacleAvoidanceParams params;
+		memcpy(&params, getObstacleAvoidanceParams(0), sizeof(dtObstacleAvoidanceParams));
+
+		// Low (11)
+		params.velBias = 0.5f;
+		params.adaptiveDivs = 5;
+		params.adaptiveRings = 2;
+		params.adaptiveDepth = 1;
+		setObstacleAvoidanceParams(0, &params);
+
+		// Medium (22)
+		params.velBias = 0.5f;
+		params.adaptiveDivs = 5;
+		params.adaptiveRings = 2;
+		params.adaptiveDepth = 2;
+		setObstacleAvoidanceParams(1, &params);
+
+		// Good (45)
+		params.velBias = 0.5f;
+		params.adaptiveDivs = 7;
+		params.adaptiveRings = 2;
+		params.adaptiveDepth = 3;
+		setObstacleAvoidanceParams(2, &params);
+
+		// High (66)
+		params.velBias = 0.5f;
+		params.adaptiveDivs = 7;
+		params.adaptiveRings = 3;
+		params.adaptiveDepth = 3;
+		setObstacleAvoidanceParams(3, &params);
+	}
+
+	void RCCrowd::resetPhaseTimes()
+	{
+		for (double& t : m_phaseTime)
+			t = 0.0;
+	}
+
+	void RCCrowd::resetReplanStats()
+	{
+		m_replanStats = RCReplanStats();
+	}
+
+	void RCCrowd::saveState(std::vector<uint8_t>& out) const
+	{
+		CrowdStateHeader header;
+		header.magic = CROWD_STATE_MAGIC;
+		header.version = CROWD_STATE_VERSION;
+		header.maxAgents = m_maxAgents;
+		header.agentCount = 0;
+		header.recordSize = sizeof(CrowdAgentRecord);
+		header.animSize = sizeof(dtCrowdAgentAnimation);
+		header.time = m_time;
+		const size_t headerOffset = out.size();
+		putBytes(out, &header, sizeof(header));
+
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			const dtCrowdAgent* ag = &m_agents[i];
+			if (!ag->active)
+				continue;
+
+			CrowdAgentRecord record;
+			memset(&record, 0, sizeof(record));
+			record.idx = i;
+			record.state = ag->state;
+			record.partial = ag->partial;
+			record.targetState = ag->targetState;
+			// The path queue is not saved, its requests are made again.
+			if (record.targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_PATH)
+				record.targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE;
+			record.targetReplan = ag->targetReplan;
+			record.animActive = m_agentAnims[i].active;
+			dtVcopy(record.npos, ag->npos);
+			dtVcopy(record.disp, ag->disp);
+			dtVcopy(record.dvel, ag->dvel);
+			dtVcopy(record.nvel, ag->nvel);
+			dtVcopy(record.vel, ag->vel);
+			record.desiredSpeed = ag->desiredSpeed;
+			record.topologyOptTime = ag->topologyOptTime;
+			record.targetReplanTime = ag->targetReplanTime;
+			dtVcopy(record.targetPos, ag->targetPos);
+			dtVcopy(record.corridorPos, ag->corridor.getPos());
+			dtVcopy(record.corridorTarget, ag->corridor.getTarget());
+			record.targetRef = ag->targetRef;
+			record.npath = ag->corridor.getPathCount();
+			// a reset boundary has its center at FLT_MAX
+			if (ag->boundary.getCenter()[0] != FLT_MAX)
+			{
+				record.boundaryRef = m_boundaryQueries[i].ref;
+				dtVcopy(record.boundaryCenter, ag->boundary.getCenter());
+				record.boundaryRange = m_boundaryQueries[i].range;
+			}
+			record.replanStart = m_replanStart[i];
+			const GroupMember& member = m_groups[i];
+			record.groupLeader = member.leader;
+			record.groupFollowers = member.followers;
+			dtVcopy(record.groupOffset, member.offset);
+			dtVcopy(record.groupHeading, member.heading);
+			record.groupLag = member.lag;
+			record.params = ag->params;
+			record.params.userData = nullptr;
+			putBytes(out, &record, sizeof(record));
+
+			if (record.animActive)
+				putBytes(out, &m_agentAnims[i], sizeof(dtCrowdAgentAnimation));
+			putBytes(out, ag->corridor.getPath(), sizeof(dtPolyRef) * record.npath);
+			header.agentCount++;
+		}
+		memcpy(out.data() + headerOffset, &header, sizeof(header));
+	}
+
+	bool RCCrowd::loadState(const uint8_t* data, size_t size)
+	{
+		const uint8_t* end = data + size;
+		CrowdStateHeader header;
+		if (!getBytes(data, end, &header, sizeof(header)))
+			return false;
+		if (header.magic != CROWD_STATE_MAGIC || header.version != CROWD_STATE_VERSION ||
+			header.maxAgents > m_maxAgents || header.recordSize != sizeof(CrowdAgentRecord) ||
+			header.animSize != sizeof(dtCrowdAgentAnimation))
+			return false;
+
+		auto clear = [this]()
+		{
+			for (int i = 0; i < m_maxAgents; ++i)
+			{
+				m_agents[i].active = false;
+				m_agentAnims[i].active = false;
+				m_replanStart[i] = -1.0;
+				m_groups[i] = GroupMember();
+				m_boundaryQueries[i] = BoundaryQuery();
+				m_hierarchyCorridors[i].path.waypoints.clear();
+				m_agentCells[i] = -1;
+			}
+			m_followerCount = 0;
+		};
+		clear();
+
+		for (int n = 0; n < header.agentCount; ++n)
+		{
+			CrowdAgentRecord record;
+			bool valid = getBytes(data, end, &record, sizeof(record)) &&
+				record.idx >= 0 && record.idx < m_maxAgents &&
+				record.npath > 0 && record.npath <= m_maxPathResult;
+			dtCrowdAgent* ag = valid ? &m_agents[record.idx] : nullptr;
+			if (valid && record.animActive)
+				valid = getBytes(data, end, &m_agentAnims[record.idx], sizeof(dtCrowdAgentAnimation));
+			const size_t pathSize = sizeof(dtPolyRef) * (valid ? record.npath : 0);
+			if (!valid || (size_t)(end - data) < pathSize)
+			{
+				// a truncated state or a corridor that does not fit leaves the crowd empty
+				clear();
+				return false;
+			}
+			memcpy(m_pathResult, data, pathSize);
+			data += pathSize;
+
+			ag->corridor.reset(m_pathResult[0], record.corridorPos);
+			ag->corridor.setCorridor(record.corridorTarget, m_pathResult, record.npath);
+
+			ag->params = record.params;
+			ag->state = record.state;
+			ag->partial = record.partial != 0;
+			ag->targetState = record.targetState;
+			ag->targetReplan = record.targetReplan != 0;
+			ag->targetRef = record.targetRef;
+			ag->targetPathqRef = DT_PATHQ_INVALID;
+			dtVcopy(ag->targetPos, record.targetPos);
+			dtVcopy(ag->npos, record.npos);
+			dtVcopy(ag->disp, record.disp);
+			dtVcopy(ag->dvel, record.dvel);
+			dtVcopy(ag->nvel, record.nvel);
+			dtVcopy(ag->vel, record.vel);
+			ag->desiredSpeed = record.desiredSpeed;
+			ag->topologyOptTime = record.topologyOptTime;
+			ag->targetReplanTime = record.targetReplanTime;
+			// same query as the saved boundary came from, so same segments
+			BoundaryQuery& boundary = m_boundaryQueries[record.idx];
+			boundary.ref = record.boundaryRef;
+			boundary.range = record.boundaryRange;
+			if (record.boundaryRef)
+				ag->boundary.update(record.boundaryRef, record.boundaryCenter, record.boundaryRange,
+					m_workers[0].navQuery, &m_filters[ag->params.queryFilterType]);
+			else
+				ag->boundary.reset();
+			// neighbours and corners are found again before they are used
+			ag->nneis = 0;
+			ag->ncorners = 0;
+			m_agentAnims[record.idx].active = record.animActive != 0;
+			m_replanStart[record.idx] = record.replanStart;
+			GroupMember& member = m_groups[record.idx];
+			member.leader = dtClamp((int)record.groupLeader, -1, m_maxAgents - 1);
+			member.followers = record.groupFollowers;
+			dtVcopy(member.offset, record.groupOffset);
+			dtVcopy(member.heading, record.groupHeading);
+			member.lag = record.groupLag;
+			if (member.leader != -1)
+				m_followerCount++;
+			ag->active = true;
+		}
+
+		m_time = header.time;
+		return true;
+	}
+
+	const dtObstacleAvoidanceParams* RCCrowd::getObstacleAvoidanceParams(const int idx) const
+	{
+		if (idx >= 0 && idx < DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS)
+			return &m_obstacleQueryParams[idx];
+		return 0;
+	}
+
+	const dtCrowdAgent* RCCrowd::getAgent(const int idx)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return 0;
+		return &m_agents[idx];
+	}
+
+	dtCrowdAgent* RCCrowd::getEditableAgent(const int idx)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return 0;
+		return &m_agents[idx];
+	}
+
+	void RCCrowd::updateAgentParameters(const int idx, const dtCrowdAgentParams* params)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return;
+		memcpy(&m_agents[idx].params, params, sizeof(dtCrowdAgentParams));
+	}
+
+	int RCCrowd::addAgent(const float* pos, const dtCrowdAgentParams* params)
+	{
+		// Find empty slot.
+		int idx = -1;
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			if (!m_agents[i].active)
+			{
+				idx = i;
+				break;
+			}
+		}
+		if (idx == -1)
+			return -1;
+
+		dtCrowdAgent* ag = &m_agents[idx];
+
+		updateAgentParameters(idx, params);
+
+		// Find nearest position on navmesh and place the agent there.
+		float nearest[3];
+		dtPolyRef ref = 0;
+		dtVcopy(nearest, pos);
+		dtStatus status = m_workers[0].navQuery->findNearestPoly(pos, m_ext, &m_filters[ag->params.queryFilterType], &ref, nearest);
+		if (dtStatusFailed(status))
+		{
+			dtVcopy(nearest, pos);
+			ref = 0;
+		}
+
+		ag->corridor.reset(ref, nearest);
+		ag->boundary.reset();
+		ag->partial = false;
+
+		ag->topologyOptTime = 0;
+		ag->targetReplanTime = 0;
+		ag->nneis = 0;
+
+		dtVset(ag->dvel, 0, 0, 0);
+		dtVset(ag->nvel, 0, 0, 0);
+		dtVset(ag->vel, 0, 0, 0);
+		dtVcopy(ag->npos, nearest);
+
+		ag->desiredSpeed = 0;
+
+		if (ref)
+			ag->state = DT_CROWDAGENT_STATE_WALKING;
+		else
+			ag->state = DT_CROWDAGENT_STATE_INVALID;
+
+		ag->targetState = DT_CROWDAGENT_TARGET_NONE;
+		m_replanStart[idx] = -1.0;
+		m_groups[idx] = GroupMember();
+		m_hierarchyCorridors[idx].path.waypoints.clear();
+		m_agentCells[idx] = -1;
+
+		ag->active = true;
+
+		return idx;
+	}
+
+	void RCCrowd::removeAgent(const int idx)
+	{
+		if (idx >= 0 && idx < m_maxAgents)
+		{
+			if (m_groups[idx].followers > 0)
+				promoteFollower(idx);
+			clearAgentGroup(idx);
+			m_agents[idx].active = false;
+			m_agentAnims[idx].active = false;
+			m_replanStart[idx] = -1.0;
+		}
+	}
+
+	bool RCCrowd::requestMoveTargetReplan(const int idx, dtPolyRef ref, const float* pos)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return false;
+
+		dtCrowdAgent* ag = &m_agents[idx];
+
+		// Initialize request.
+		ag->targetRef = ref;
+		dtVcopy(ag->targetPos, pos);
+		ag->targetPathqRef = DT_PATHQ_INVALID;
+		ag->targetReplan = true;
+		if (ag->targetRef)
+			ag->targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+		else
+			ag->targetState = DT_CROWDAGENT_TARGET_FAILED;
+
+		return true;
+	}
+
+	bool RCCrowd::requestMoveTarget(const int idx, dtPolyRef ref, const float* pos)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return false;
+		if (!ref)
+			return false;
+		clearAgentGroup(idx);
+
+		dtCrowdAgent* ag = &m_agents[idx];
+
+		// Initialize request.
+		ag->targetRef = ref;
+		dtVcopy(ag->targetPos, pos);
+		ag->targetPathqRef = DT_PATHQ_INVALID;
+		ag->targetReplan = false;
+		if (ag->targetRef)
+			ag->targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+		else
+			ag->targetState = DT_CROWDAGENT_TARGET_FAILED;
+
+		return true;
+	}
+
+	bool RCCrowd::requestMoveVelocity(const int idx, const float* vel)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return false;
+		clearAgentGroup(idx);
+
+		dtCrowdAgent* ag = &m_agents[idx];
+
+		// Initialize request.
+		ag->targetRef = 0;
+		dtVcopy(ag->targetPos, vel);
+		ag->targetPathqRef = DT_PATHQ_INVALID;
+		ag->targetReplan = false;
+		ag->targetState = DT_CROWDAGENT_TARGET_VELOCITY;
+
+		return true;
+	}
+
+	bool RCCrowd::resetMoveTarget(const int idx)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return false;
+		clearAgentGroup(idx);
+
+		dtCrowdAgent* ag = &m_agents[idx];
+
+		// Initialize request.
+		ag->targetRef = 0;
+		dtVset(ag->targetPos, 0, 0, 0);
+		dtVset(ag->dvel, 0, 0, 0);
+		ag->targetPathqRef = DT_PATHQ_INVALID;
+		ag->targetReplan = false;
+		ag->targetState = DT_CROWDAGENT_TARGET_NONE;
+
+		return true;
+	}
+
+	int RCCrowd::getActiveAgents(dtCrowdAgent** agents, const int maxAgents)
+	{
+		int n = 0;
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			if (!m_agents[i].active) continue;
+			if (n < maxAgents)
+				agents[n++] = &m_agents[i];
+		}
+		return n;
+	}
+
+	void RCCrowd::setNeighbourProxies(const RCCrowdProxy* proxies, const int n)
+	{
+		m_proxies.assign(proxies, proxies + dtClamp(n, 0, m_maxProxies));
+	}
+
+	bool RCCrowd::setAgentGroup(const int idx, const int leader, const float* offset)
+	{
+		if (idx < 0 || idx >= m_maxAgents || leader < 0 || leader >= m_maxAgents || idx == leader)
+			return false;
+		if (!m_agents[idx].active || !m_agents[leader].active)
+			return false;
+		if (m_groups[leader].leader != -1 || m_groups[idx].followers > 0)
+			return false;
+		clearAgentGroup(idx);
+
+		GroupMember& member = m_groups[idx];
+		member.leader = leader;
+		dtVcopy(member.offset, offset);
+		m_followerCount++;
+		GroupMember& leaderMember = m_groups[leader];
+		if (leaderMember.followers++ == 0)
+		{
+			float dir[3];
+			if (getHeadingDirection(&m_agents[leader], dir))
+				dtVcopy(leaderMember.heading, dir);
+			leaderMember.lag = 0.0f;
+		}
+
+		// The corridor starts where the follower stands, the slot pulls its end along.
+		dtCrowdAgent* ag = &m_agents[idx];
+		ag->corridor.reset(ag->corridor.getFirstPoly(), ag->npos);
+		ag->partial = false;
+		ag->targetRef = ag->corridor.getFirstPoly();
+		dtVcopy(ag->targetPos, ag->npos);
+		ag->targetPathqRef = DT_PATHQ_INVALID;
+		ag->targetReplan = false;
+		ag->targetReplanTime = 0;
+		ag->targetState = DT_CROWDAGENT_TARGET_VALID;
+		m_replanStart[idx] = -1.0;
+		return true;
+	}
+
+	void RCCrowd::clearAgentGroup(const int idx)
+	{
+		if (idx < 0 || idx >= m_maxAgents)
+			return;
+		GroupMember& member = m_groups[idx];
+		if (member.leader == -1)
+			return;
+		m_groups[member.leader].followers--;
+		member.leader = -1;
+		m_followerCount--;
+	}
+
+	void RCCrowd::promoteFollower(const int leader)
+	{
+		int newLeader = -1;
+		for (int i = 0; i < m_maxAgents && newLeader == -1; ++i)
+		{
+			if (m_groups[i].leader == leader)
+				newLeader = i;
+		}
+		if (newLeader == -1)
+			return;
+
+		// the others keep their place in the formation around the new leader
+		float base[3];
+		dtVcopy(base, m_groups[newLeader].offset);
+		clearAgentGroup(newLeader);
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			GroupMember& member = m_groups[i];
+			if (member.leader != leader)
+				continue;
+			member.leader = newLeader;
+			dtVsub(member.offset, member.offset, base);
+			m_groups[leader].followers--;
+			m_groups[newLeader].followers++;
+		}
+		dtVcopy(m_groups[newLeader].heading, m_groups[leader].heading);
+
+		const dtCrowdAgent* ag = &m_agents[leader];
+		if (ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			requestMoveVelocity(newLeader, ag->targetPos);
+		else if (ag->targetState != DT_CROWDAGENT_TARGET_NONE && ag->targetState != DT_CROWDAGENT_TARGET_FAILED)
+			requestMoveTarget(newLeader, ag->targetRef, ag->targetPos);
+		else
+			resetMoveTarget(newLeader);
+	}
+
+	void RCCrowd::updateGroupLeaders(dtCrowdAgent** agents, const int nagents, const float dt)
+	{
+		// seconds for the formation to turn most of the way to a new heading
+		static const float HEADING_TURN_TIME = 0.5f;
+
+		for (int i = 0; i < nagents; ++i)
+		{
+			const dtCrowdAgent* ag = agents[i];
+			GroupMember& member = m_groups[getAgentIndex(ag)];
+			if (member.followers == 0)
+				continue;
+			member.lag = 0.0f;
+			float dir[3];
+			if (!getHeadingDirection(ag, dir))
+				continue;
+			dtVlerp(member.heading, member.heading, dir, dtMin(1.0f, dt / HEADING_TURN_TIME));
+			member.heading[1] = 0;
+			if (dtVlenSqr(member.heading) > 0.0001f)
+				dtVnormalize(member.heading);
+			else
+				dtVcopy(member.heading, dir);
+		}
+
+		for (int i = 0; i < nagents; ++i)
+		{
+			const dtCrowdAgent* ag = agents[i];
+			const int leader = m_groups[getAgentIndex(ag)].leader;
+			if (leader == -1 || ag->targetState != DT_CROWDAGENT_TARGET_VALID)
+				continue;
+			float& lag = m_groups[leader].lag;
+			lag = dtMax(lag, dtVdist2D(ag->npos, ag->targetPos));
+		}
+	}
+
+	void RCCrowd::updateFollowerTarget(dtCrowdAgent* ag, dtNavMeshQuery* navQuery)
+	{
+		static const int MAX_VISITED = 16;
+		static const float REJOIN_DELAY = 1.0f; // seconds
+
+		const int idx = getAgentIndex(ag);
+		const GroupMember& member = m_groups[idx];
+		if (member.leader == -1 || ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+		const dtCrowdAgent* leader = &m_agents[member.leader];
+		if (leader->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+		// a follower on its way back to the group keeps that path until it is found
+		if (ag->targetState == DT_CROWDAGENT_TARGET_REQUESTING ||
+			ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE ||
+			ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_PATH)
+			return;
+
+		const float* heading = m_groups[member.leader].heading;
+		const float* offset = member.offset;
+		float desired[3];
+		desired[0] = leader->npos[0] + heading[2] * offset[0] + heading[0] * offset[2];
+		desired[1] = leader->npos[1];
+		desired[2] = leader->npos[2] - heading[0] * offset[0] + heading[2] * offset[2];
+
+		// The slot is moved out from the leader, so it is never behind a wall from it.
+		const dtQueryFilter* filter = &m_filters[ag->params.queryFilterType];
+		dtPolyRef visited[MAX_VISITED];
+		int nvisited = 0;
+		float slot[3];
+		dtStatus status = navQuery->moveAlongSurface(leader->corridor.getFirstPoly(), leader->npos, desired, filter,
+			slot, visited, &nvisited, MAX_VISITED);
+		if (dtStatusFailed(status) || !nvisited)
+			return;
+
+		bool lost = true;
+		if (ag->targetState == DT_CROWDAGENT_TARGET_VALID && ag->corridor.moveTargetPosition(slot, navQuery, filter))
+		{
+			ag->targetRef = ag->corridor.getLastPoly();
+			dtVcopy(ag->targetPos, ag->corridor.getTarget());
+			lost = dtVdist2DSqr(ag->targetPos, slot) > dtSqr(GROUP_REJOIN_DIST);
+		}
+		if (lost && ag->targetReplanTime > REJOIN_DELAY)
+		{
+			requestMoveTargetReplan(idx, visited[nvisited - 1], slot);
+			ag->targetReplanTime = 0;
+		}
+	}
+
+	float RCCrowd::getReplanPriority(const dtCrowdAgent* ag) const
+	{
+		// agents on an invalid corridor or without one have nothing to follow
+		static const float INVALID_PRIORITY = 1e6f;
+		// meters a request gains per second of waiting, so near targets do not starve
+		static const float WAIT_WEIGHT = 10.0f;
+
+		const float waited = (float)(m_time - m_replanStart[getAgentIndex(ag)]);
+		float priority = dtVdist(ag->corridor.getTarget(), ag->targetPos) + waited * WAIT_WEIGHT;
+		if (ag->targetReplan || ag->corridor.getPathCount() <= 1)
+			priority += INVALID_PRIORITY;
+		return priority;
+	}
+
+	int RCCrowd::planMoveRequest(dtCrowdAgent* ag, dtNavMeshQuery* navQuery)
+	{
+		// the corridor is planned again from here
+		m_hierarchyCorridors[getAgentIndex(ag)].path.waypoints.clear();
+
+		const dtPolyRef* path = ag->corridor.getPath();
+		const int npath = ag->corridor.getPathCount();
+
+		static const int MAX_RES = 32;
+		float reqPos[3];
+		dtPolyRef reqPath[MAX_RES];	// The path to the request location
+		int reqPathCount = 0;
+
+		// Quick search towards the goal.
+		static const int MAX_ITER = 20;
+		if (queryRecorder)
+			queryRecorder->recordFindPath(path[0], ag->targetRef, ag->npos, ag->targetPos, &m_filters[ag->params.queryFilterType]);
+		navQuery->initSlicedFindPath(path[0], ag->targetRef, ag->npos, ag->targetPos, &m_filters[ag->params.queryFilterType]);
+		int iters = 0;
+		navQuery->updateSlicedFindPath(MAX_ITER, &iters);
+		dtStatus status = 0;
+		if (ag->targetReplan)
+		{
+			// Try to use existing steady path during replan if possible.
+			status = navQuery->finalizeSlicedFindPathPartial(path, npath, reqPath, &reqPathCount, MAX_RES);
+		}
+		else
+		{
+			// Try to move towards target when goal changes.
+			status = navQuery->finalizeSlicedFindPath(reqPath, &reqPathCount, MAX_RES);
+		}
+
+		if (!dtStatusFailed(status) && reqPathCount > 0)
+		{
+			// In progress or succeed.
+			if (reqPath[reqPathCount - 1] != ag->targetRef)
+			{
+				// Partial path, constrain target position inside the last polygon.
+				status = navQuery->closestPointOnPoly(reqPath[reqPathCount - 1], ag->targetPos, reqPos, 0);
+				if (dtStatusFailed(status))
+					reqPathCount = 0;
+			}
+			else
+			{
+				dtVcopy(reqPos, ag->targetPos);
+			}
+		}
+		else
+		{
+			reqPathCount = 0;
+		}
+
+		if (!reqPathCount)
+		{
+			// Could not find path, start the request from current location.
+			dtVcopy(reqPos, ag->npos);
+			reqPath[0] = path[0];
+			reqPathCount = 1;
+		}
+
+		ag->corridor.setCorridor(reqPos, reqPath, reqPathCount);
+		ag->boundary.reset();
+		ag->partial = false;
+
+		if (reqPath[reqPathCount - 1] == ag->targetRef)
+		{
+			ag->targetState = DT_CROWDAGENT_TARGET_VALID;
+			ag->targetReplanTime = 0.0;
+		}
+		else
+		{
+			// The path is longer or potentially unreachable, full plan.
+			ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE;
+		}
+
+		return iters;
+	}
+
+	bool RCCrowd::isSearchingPaths() const
+	{
+		return (landmarks && landmarks->getLandmarkCount() > 0) || (hierarchy && hierarchy->getClusterCount() > 0) ||
+			(polyDensity && densityGraph);
+	}
+
+	template<typename Filter>
+	dtStatus RCCrowd::findRequestPath(const dtCrowdAgent* ag, const Filter* filter, int* nres)
+	{
+		const dtPolyRef startRef = ag->corridor.getLastPoly();
+		const float* startPos = ag->corridor.getTarget();
+		if (landmarks && landmarks->getLandmarkCount() > 0)
+		{
+			// density only adds to the costs, the bound still holds
+			const RCLandmarkHeuristic heuristic{ landmarks, landmarks->getGraph()->indexOf(ag->targetRef), ag->targetPos };
+			return m_pathSearch.findPath(startRef, ag->targetRef, startPos, ag->targetPos, filter, heuristic, m_pathResult, nres, m_maxPathResult);
+		}
+		return m_pathSearch.findPath(startRef, ag->targetRef, startPos, ag->targetPos, filter, m_pathResult, nres, m_maxPathResult);
+	}
+
+	int RCCrowd::searchPathRequest(dtCrowdAgent* ag, dtNavMeshQuery* navQuery)
+	{
+		// Same start as a path queue request, the merge expects the corridor end.
+		const dtPolyRef startRef = ag->corridor.getLastPoly();
+		const float* startPos = ag->corridor.getTarget();
+		const dtQueryFilter* filter = &m_filters[ag->params.queryFilterType];
+		int nres = 0;
+		int expanded = 0;
+		dtStatus status;
+		HierarchyCorridor& hc = m_hierarchyCorridors[getAgentIndex(ag)];
+		if (hierarchy && hierarchy->getCluster(startRef) != hierarchy->getCluster(ag->targetRef) &&
+			hierarchy->findAbstractPath(startRef, ag->targetRef, hc.path))
+		{
+			const int nsegments = (int)hc.path.waypoints.size() - 1;
+			hc.nextSegment = dtMin(HIERARCHY_REFINE_SEGMENTS, nsegments);
+			status = hierarchy->refinePath(m_pathSearch, filter, hc.path, 0, hc.nextSegment, startPos, ag->targetPos,
+				m_pathResult, &nres, m_maxPathResult, &expanded);
+			if (hc.nextSegment == nsegments || dtStatusFailed(status))
+				hc.path.waypoints.clear();
+		}
+		else if (polyDensity && densityGraph)
+		{
+			// agent filter flags and area costs, density on top
+			RCCrowdCostFilter costFilter(*filter);
+			costFilter.graph = densityGraph;
+			costFilter.density = polyDensity;
+			costFilter.densityWeight = densityWeight;
+			status = findRequestPath(ag, &costFilter, &nres);
+			expanded = m_pathSearch.getLastExpandedNodes();
+		}
+		else
+		{
+			const RCAreaFilter areaFilter(*filter);
+			status = findRequestPath(ag, &areaFilter, &nres);
+			expanded = m_pathSearch.getLastExpandedNodes();
+		}
+		ag->targetPathqRef = DT_PATHQ_INVALID;
+		if (dtStatusFailed(status))
+		{
+			// Retry if the target location is still valid, as for a failed queue request.
+			ag->targetState = ag->targetRef ? DT_CROWDAGENT_TARGET_REQUESTING : DT_CROWDAGENT_TARGET_FAILED;
+			ag->targetReplanTime = 0.0;
+		}
+		else
+		{
+			applyPathResult(ag, status, nres, navQuery);
+		}
+		return expanded;
+	}
+
+	int RCCrowd::extendHierarchyCorridor(dtCrowdAgent* ag, dtNavMeshQuery* navQuery)
+	{
+		HierarchyCorridor& hc = m_hierarchyCorridors[getAgentIndex(ag)];
+		const int nsegments = (int)hc.path.waypoints.size() - 1;
+		// The corridor ends on the waypoint the next segment leaves from, the merge
+		// appends the segment and clamps the end to the target or the next waypoint.
+		int nres = 0;
+		int expanded = 0;
+		const dtStatus status = hierarchy->refinePath(m_pathSearch, &m_filters[ag->params.queryFilterType], hc.path,
+			hc.nextSegment, 1, ag->corridor.getTarget(), ag->targetPos, m_pathResult, &nres, m_maxPathResult, &expanded);
+		if (dtStatusFailed(status) || !nres || m_pathResult[0] != ag->corridor.getLastPoly())
+		{
+			// Lost the waypoint, plan again from the agent.
+			hc.path.waypoints.clear();
+			requestMoveTargetReplan(getAgentIndex(ag), ag->targetRef, ag->targetPos);
+			return expanded;
+		}
+		hc.nextSegment++;
+		if (hc.nextSegment == nsegments || dtStatusDetail(status, DT_PARTIAL_RESULT))
+			hc.path.waypoints.clear();
+		applyPathResult(ag, status, nres, navQuery);
+		return expanded;
+	}
+
+	void RCCrowd::applyPathResult(dtCrowdAgent* ag, dtStatus status, int nres, dtNavMeshQuery* navQuery)
+	{
+		const dtPolyRef* path = ag->corridor.getPath();
+		const int npath = ag->corridor.getPathCount();
+
+		// Apply results.
+		float targetPos[3];
+		dtVcopy(targetPos, ag->targetPos);
+
+		dtPolyRef* res = m_pathResult;
+		bool valid = true;
+		if (dtStatusFailed(status) || !nres)
+			valid = false;
+
+		if (dtStatusDetail(status, DT_PARTIAL_RESULT))
+			ag->partial = true;
+		else
+			ag->partial = false;
+
+		// Merge result and existing path.
+		// The agent might have moved whilst the request is
+		// being processed, so the path may have changed.
+		// We assume that the end of the path is at the same location
+		// where the request was issued.
+
+		// The last ref in the old path should be the same as
+		// the location where the request was issued..
+		if (valid && path[npath - 1] != res[0])
+			valid = false;
+
+		if (valid)
+		{
+			// Put the old path infront of the old path.
+			if (npath > 1)
+			{
+				// Make space for the old path.
+				if ((npath - 1) + nres > m_maxPathResult)
+					nres = m_maxPathResult - (npath - 1);
+
+				memmove(res + npath - 1, res, sizeof(dtPolyRef) * nres);
+				// Copy old path in the beginning.
+				memcpy(res, path, sizeof(dtPolyRef) * (npath - 1));
+				nres += npath - 1;
+
+				// Remove trackbacks
+				for (int j = 0; j < nres; ++j)
+				{
+					if (j - 1 >= 0 && j + 1 < nres)
+					{
+						if (res[j - 1] == res[j + 1])
+						{
+							memmove(res + (j - 1), res + (j + 1), sizeof(dtPolyRef) * (nres - (j + 1)));
+							nres -= 2;
+							j -= 2;
+						}
+					}
+				}
+			}
+
+			// Check for partial path.
+			if (res[nres - 1] != ag->targetRef)
+			{
+				// Partial path, constrain target position inside the last polygon.
+				float nearest[3];
+				status = navQuery->closestPointOnPoly(res[nres - 1], targetPos, nearest, 0);
+				if (dtStatusSucceed(status))
+					dtVcopy(targetPos, nearest);
+				else
+					valid = false;
+			}
+		}
+
+		if (valid)
+		{
+			// Set current corridor.
+			ag->corridor.setCorridor(targetPos, res, nres);
+			// Force to update boundary.
+			ag->boundary.reset();
+			ag->targetState = DT_CROWDAGENT_TARGET_VALID;
+		}
+		else
+		{
+			// Something went wrong.
+			ag->targetState = DT_CROWDAGENT_TARGET_FAILED;
+		}
+
+		ag->targetReplanTime = 0.0;
+	}
+
+	void RCCrowd::updateMoveRequest(const float /*dt*/)
+	{
+		using clock = std::chrono::steady_clock;
+		const auto start = clock::now();
+		dtNavMeshQuery* navQuery = m_workers[0].navQuery;
+
+		const int PATH_MAX_AGENTS = 8;
+		dtCrowdAgent* queue[PATH_MAX_AGENTS];
+		int nqueue = 0;
+
+		// Collect new requests, the budget decides how many are planned this tick.
+		m_replanHeap.clear();
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			dtCrowdAgent* ag = &m_agents[i];
+			if (!ag->active)
+				continue;
+			if (ag->state == DT_CROWDAGENT_STATE_INVALID)
+				continue;
+
+			if (ag->targetState == DT_CROWDAGENT_TARGET_REQUESTING)
+			{
+				if (m_replanStart[i] < 0.0)
+					m_replanStart[i] = m_time;
+				m_replanHeap.push_back({ getReplanPriority(ag), i });
+			}
+			else if (ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE)
+			{
+				nqueue = addToPathQueue(ag, queue, nqueue, PATH_MAX_AGENTS);
+			}
+		}
+
+		// A quarter of the node budget is kept for the path queue.
+		const bool nodeLimit = replanBudgetNodes > 0;
+		const int quickBudget = replanBudgetNodes - replanBudgetNodes / 4;
+		int nodes = 0;
+		int planned = 0;
+		auto overBudget = [&](int nodeBudget)
+		{
+			if (nodeLimit && nodes >= nodeBudget)
+				return true;
+			return replanBudgetMs > 0.0f && std::chrono::duration<float, std::milli>(clock::now() - start).count() >= replanBudgetMs;
+		};
+
+		// Walking agents near the end of a hierarchical corridor go first, at least one
+		// per tick.
+		int extended = 0;
+		for (int i = 0; hierarchy && i < m_maxAgents; ++i)
+		{
+			dtCrowdAgent* ag = &m_agents[i];
+			if (!ag->active || ag->targetState != DT_CROWDAGENT_TARGET_VALID || m_hierarchyCorridors[i].path.waypoints.empty())
+				continue;
+			if (ag->corridor.getPathCount() > HIERARCHY_EXTEND_POLYS)
+				continue;
+			if (extended > 0 && overBudget(quickBudget))
+				break;
+			nodes += extendHierarchyCorridor(ag, navQuery);
+			extended++;
+		}
+
+		std::make_heap(m_replanHeap.begin(), m_replanHeap.end());
+		while (!m_replanHeap.empty())
+		{
+			// At least one request per tick, so the queue always drains.
+			if (planned > 0 && overBudget(quickBudget))
+				break;
+			std::pop_heap(m_replanHeap.begin(), m_replanHeap.end());
+			dtCrowdAgent* ag = &m_agents[m_replanHeap.back().idx];
+			m_replanHeap.pop_back();
+
+			nodes += planMoveRequest(ag, navQuery);
+			planned++;
+
+			if (ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE)
+				nqueue = addToPathQueue(ag, queue, nqueue, PATH_MAX_AGENTS);
+		}
+
+		// Full searches run here while the budget lasts, the rest wait for the next tick.
+		const bool searching = isSearchingPaths();
+		int searched = 0;
+		for (int i = 0; i < nqueue; ++i)
+		{
+			dtCrowdAgent* ag = queue[i];
+			if (searching)
+			{
+				if (searched > 0 && overBudget(replanBudgetNodes))
+					break;
+				if (queryRecorder)
+					queryRecorder->recordFindPath(ag->corridor.getLastPoly(), ag->targetRef, ag->corridor.getTarget(), ag->targetPos,
+						&m_filters[ag->params.queryFilterType]);
+				nodes += searchPathRequest(ag, navQuery);
+				searched++;
+				continue;
+			}
+			ag->targetPathqRef = m_pathq.request(ag->corridor.getLastPoly(), ag->targetRef,
+				ag->corridor.getTarget(), ag->targetPos, &m_filters[ag->params.queryFilterType]);
+			if (ag->targetPathqRef != DT_PATHQ_INVALID)
+			{
+				ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
+				if (queryRecorder)
+					queryRecorder->recordFindPath(ag->corridor.getLastPoly(), ag->targetRef, ag->corridor.getTarget(), ag->targetPos,
+						&m_filters[ag->params.queryFilterType]);
+			}
+		}
+
+		// Update requests with what is left of the node budget. With searches on only
+		// requests queued before they were switched on are left.
+		m_pathq.update(nodeLimit ? dtMax(replanBudgetNodes - nodes, replanBudgetNodes / 4) : MAX_ITERS_PER_UPDATE);
+
+		dtStatus status;
+
+		// Process path results.
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			dtCrowdAgent* ag = &m_agents[i];
+			if (!ag->active)
+				continue;
+			if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+				continue;
+
+			if (ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_PATH)
+			{
+				// Poll path queue.
+				status = m_pathq.getRequestStatus(ag->targetPathqRef);
+				if (dtStatusFailed(status))
+				{
+					// Path find failed, retry if the target location is still valid.
+					ag->targetPathqRef = DT_PATHQ_INVALID;
+					if (ag->targetRef)
+						ag->targetState = DT_CROWDAGENT_TARGET_REQUESTING;
+					else
+						ag->targetState = DT_CROWDAGENT_TARGET_FAILED;
+					ag->targetReplanTime = 0.0;
+				}
+				else if (dtStatusSucceed(status))
+				{
+					int nres = 0;
+					status = m_pathq.getPathResult(ag->targetPathqRef, m_pathResult, &nres, m_maxPathResult);
+					applyPathResult(ag, status, nres, navQuery);
+				}
+			}
+		}
+
+		// Latency of the resolved requests and what is left for the next ticks.
+		int depth = 0;
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			const dtCrowdAgent* ag = &m_agents[i];
+			if (!ag->active || m_replanStart[i] < 0.0)
+				continue;
+			if (ag->targetState == DT_CROWDAGENT_TARGET_REQUESTING ||
+				ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE ||
+				ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_PATH)
+			{
+				depth++;
+				continue;
+			}
+			if (ag->targetState == DT_CROWDAGENT_TARGET_VALID || ag->targetState == DT_CROWDAGENT_TARGET_FAILED)
+			{
+				const double latency = m_time - m_replanStart[i];
+				m_replanStats.completed++;
+				m_replanStats.totalLatency += latency;
+				m_replanStats.maxLatency = dtMax(m_replanStats.maxLatency, latency);
+			}
+			m_replanStart[i] = -1.0;
+		}
+		m_replanStats.queueDepth = depth;
+		m_replanStats.planned = planned;
+		m_replanStats.nodes = nodes;
+		m_replanStats.ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+	}
+
+	void RCCrowd::updateTopologyOptimization(dtCrowdAgent** agents, const int nagents, const float dt)
+	{
+		if (!nagents)
+			return;
+
+		const float OPT_TIME_THR = 0.5f; // seconds
+		const int OPT_MAX_AGENTS = 1;
+		dtCrowdAgent* queue[OPT_MAX_AGENTS];
+		int nqueue = 0;
+
+		for (int i = 0; i < nagents; ++i)
+		{
+			dtCrowdAgent* ag = agents[i];
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+				continue;
+			if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+				continue;
+			if ((ag->params.updateFlags & DT_CROWD_OPTIMIZE_TOPO) == 0)
+				continue;
+			ag->topologyOptTime += dt;
+			if (ag->topologyOptTime >= OPT_TIME_THR)
+				nqueue = addToOptQueue(ag, queue, nqueue, OPT_MAX_AGENTS);
+		}
+
+		for (int i = 0; i < nqueue; ++i)
+		{
+			dtCrowdAgent* ag = queue[i];
+			// the local search optimizePathTopology runs on corridors of 3 polygons or more
+			if (queryRecorder && ag->corridor.getPathCount() >= 3)
+				queryRecorder->recordFindPath(ag->corridor.getFirstPoly(), ag->corridor.getLastPoly(), ag->corridor.getPos(), ag->corridor.getTarget(),
+					&m_filters[ag->params.queryFilterType]);
+			ag->corridor.optimizePathTopology(m_workers[0].navQuery, &m_filters[ag->params.queryFilterType]);
+			ag->topologyOptTime = 0;
+		}
+	}
+
+	void RCCrowd::checkPathValidity(dtCrowdAgent* ag, dtNavMeshQuery* navQuery, const float dt)
+	{
+		static const int CHECK_LOOKAHEAD = 10;
+		static const float TARGET_REPLAN_DELAY = 1.0; // seconds
+
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+
+		ag->targetReplanTime += dt;
+
+		bool replan = false;
+
+		// First check that the current location is valid.
+		const int idx = getAgentIndex(ag);
+		float agentPos[3];
+		dtPolyRef agentRef = ag->corridor.getFirstPoly();
+		dtVcopy(agentPos, ag->npos);
+		if (!navQuery->isValidPolyRef(agentRef, &m_filters[ag->params.queryFilterType]))
+		{
+			// Current location is not valid, try to reposition.
+			float nearest[3];
+			dtVcopy(nearest, agentPos);
+			agentRef = 0;
+			navQuery->findNearestPoly(ag->npos, m_ext, &m_filters[ag->params.queryFilterType], &agentRef, nearest);
+			dtVcopy(agentPos, nearest);
+
+			if (!agentRef)
+			{
+				// Could not find location in navmesh, set state to invalid.
+				ag->corridor.reset(0, agentPos);
+				ag->partial = false;
+				ag->boundary.reset();
+				ag->state = DT_CROWDAGENT_STATE_INVALID;
+				return;
+			}
+
+			// Make sure the first polygon is valid, but leave other valid
+			// polygons in the path so that replanner can adjust the path better.
+			ag->corridor.fixPathStart(agentRef, agentPos);
+			ag->boundary.reset();
+			dtVcopy(ag->npos, agentPos);
+
+			replan = true;
+		}
+
+		// If the agent does not have move target or is controlled by velocity, no need to recover the target nor replan.
+		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			return;
+
+		// Try to recover move request position.
+		if (ag->targetState != DT_CROWDAGENT_TARGET_NONE && ag->targetState != DT_CROWDAGENT_TARGET_FAILED)
+		{
+			if (!navQuery->isValidPolyRef(ag->targetRef, &m_filters[ag->params.queryFilterType]))
+			{
+				// Current target is not valid, try to reposition.
+				float nearest[3];
+				dtVcopy(nearest, ag->targetPos);
+				ag->targetRef = 0;
+				navQuery->findNearestPoly(ag->targetPos, m_ext, &m_filters[ag->params.queryFilterType], &ag->targetRef, nearest);
+				dtVcopy(ag->targetPos, nearest);
+				replan = true;
+			}
+			if (!ag->targetRef)
+			{
+				// Failed to reposition target, fail moverequest.
+				ag->corridor.reset(agentRef, agentPos);
+				ag->partial = false;
+				ag->targetState = DT_CROWDAGENT_TARGET_NONE;
+			}
+		}
+
+		// If nearby corridor is not valid, replan.
+		if (!ag->corridor.isValid(CHECK_LOOKAHEAD, navQuery, &m_filters[ag->params.queryFilterType]))
+		{
+			replan = true;
+		}
+
+		// If the end of the path is near and it is not the requested location, replan.
+		if (ag->targetState == DT_CROWDAGENT_TARGET_VALID)
+		{
+			if (ag->targetReplanTime > TARGET_REPLAN_DELAY &&
+				ag->corridor.getPathCount() < CHECK_LOOKAHEAD &&
+				ag->corridor.getLastPoly() != ag->targetRef &&
+				(!hierarchy || m_hierarchyCorridors[idx].path.waypoints.empty()))
+				replan = true;
+		}
+
+		// Try to replan path to goal.
+		if (replan)
+		{
+			if (ag->targetState != DT_CROWDAGENT_TARGET_NONE)
+			{
+				requestMoveTargetReplan(idx, ag->targetRef, ag->targetPos);
+			}
+		}
+	}
+
+	void RCCrowd::updateBoundaryAndNeighbours(dtCrowdAgent* ag, dtNavMeshQuery* navQuery)
+	{
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+
+		// Update the collision boundary after certain distance has been passed or
+		// if it has become invalid.
+		const float updateThr = ag->params.collisionQueryRange * 0.25f;
+		if (dtVdist2DSqr(ag->npos, ag->boundary.getCenter()) > dtSqr(updateThr) ||
+			!ag->boundary.isValid(navQuery, &m_filters[ag->params.queryFilterType]))
+		{
+			BoundaryQuery& boundary = m_boundaryQueries[getAgentIndex(ag)];
+			boundary.ref = ag->corridor.getFirstPoly();
+			boundary.range = ag->params.collisionQueryRange;
+			ag->boundary.update(boundary.ref, ag->npos, boundary.range,
+				navQuery, &m_filters[ag->params.queryFilterType]);
+		}
+		// Query neighbour agents, the grid holds agent indices
+		ag->nneis = getNeighbours(ag->npos, ag->params.height, ag->params.collisionQueryRange,
+			ag, ag->neis, DT_CROWDAGENT_MAX_NEIGHBOURS);
+	}
+
+	void RCCrowd::recordVisibilityRay(const dtCrowdAgent* ag, const float* next)
+	{
+		// Same clamp as dtPathCorridor::optimizePathVisibility.
+		const float* pos = ag->corridor.getPos();
+		float dist = dtVdist2D(pos, next);
+		if (dist < 0.01f)
+			return;
+		dist = dtMin(dist + 0.01f, ag->params.pathOptimizationRange);
+		float delta[3], goal[3];
+		dtVsub(delta, next, pos);
+		dtVmad(goal, pos, delta, ag->params.pathOptimizationRange / dist);
+		queryRecorder->recordRaycast(ag->corridor.getFirstPoly(), pos, goal, &m_filters[ag->params.queryFilterType]);
+	}
+
+	void RCCrowd::updateCorners(dtCrowdAgent* ag, int i, dtNavMeshQuery* navQuery, dtCrowdAgentDebugInfo* debug)
+	{
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			return;
+
+		const int debugIdx = debug ? debug->idx : -1;
+
+		// Find corners for steering
+		ag->ncorners = ag->corridor.findCorners(ag->cornerVerts, ag->cornerFlags, ag->cornerPolys,
+			DT_CROWDAGENT_MAX_CORNERS, navQuery, &m_filters[ag->params.queryFilterType]);
+
+		// Check to see if the corner after the next corner is directly visible,
+		// and short cut to there.
+		if ((ag->params.updateFlags & DT_CROWD_OPTIMIZE_VIS) && ag->ncorners > 0)
+		{
+			const float* target = &ag->cornerVerts[dtMin(1, ag->ncorners - 1) * 3];
+			if (queryRecorder)
+				recordVisibilityRay(ag, target);
+			ag->corridor.optimizePathVisibility(target, ag->params.pathOptimizationRange, navQuery, &m_filters[ag->params.queryFilterType]);
+
+			// Copy data for debug purposes.
+			if (debugIdx == i)
+			{
+				dtVcopy(debug->optStart, ag->corridor.getPos());
+				dtVcopy(debug->optEnd, target);
+			}
+		}
+		else
+		{
+			// Copy data for debug purposes.
+			if (debugIdx == i)
+			{
+				dtVset(debug->optStart, 0, 0, 0);
+				dtVset(debug->optEnd, 0, 0, 0);
+			}
+		}
+	}
+
+	void RCCrowd::triggerOffMeshConnection(dtCrowdAgent* ag, dtNavMeshQuery* navQuery)
+	{
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+			return;
+
+		// Check
+		const float triggerRadius = ag->params.radius * 2.25f;
+		if (overOffmeshConnection(ag, triggerRadius))
+		{
+			// Prepare to off-mesh connection.
+			const int idx = getAgentIndex(ag);
+			dtCrowdAgentAnimation* anim = &m_agentAnims[idx];
+
+			// Adjust the path over the off-mesh connection.
+			dtPolyRef refs[2];
+			if (ag->corridor.moveOverOffmeshConnection(ag->cornerPolys[ag->ncorners - 1], refs,
+				anim->startPos, anim->endPos, navQuery))
+			{
+				dtVcopy(anim->initPos, ag->npos);
+				anim->polyRef = refs[1];
+				anim->active = true;
+				anim->t = 0.0f;
+				anim->tmax = (dtVdist2D(anim->startPos, anim->endPos) / ag->params.maxSpeed) * 0.5f;
+
+				ag->state = DT_CROWDAGENT_STATE_OFFMESH;
+				ag->ncorners = 0;
+				ag->nneis = 0;
+			}
+			// Otherwise path validity check will ensure that bad/blocked connections will be replanned.
+		}
+	}
+
+	void RCCrowd::updateSteering(dtCrowdAgent* ag)
+	{
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE)
+			return;
+
+		float dvel[3] = { 0,0,0 };
+
+		if (ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+		{
+			dtVcopy(dvel, ag->targetPos);
+			ag->desiredSpeed = dtVlen(ag->targetPos);
+		}
+		else
+		{
+			// Calculate steering direction.
+			if (ag->params.updateFlags & DT_CROWD_ANTICIPATE_TURNS)
+				calcSmoothSteerDirection(ag, dvel);
+			else
+				calcStraightSteerDirection(ag, dvel);
+
+			const GroupMember& member = m_groups[getAgentIndex(ag)];
+			if (member.leader != -1)
+			{
+				// Followers close the gap to their slot on top of the leader's speed.
+				const float range = ag->params.maxSpeed * GROUP_CATCHUP_TIME;
+				const float gap = getDistanceToGoal(ag, range);
+				ag->desiredSpeed = dtMin(ag->params.maxSpeed, dtVlen(m_agents[member.leader].vel) + gap / GROUP_CATCHUP_TIME);
+				dtVscale(dvel, dvel, ag->desiredSpeed);
+			}
+			else
+			{
+				// Calculate speed scale, which tells the agent to slowdown at the end of the path.
+				const float slowDownRadius = ag->params.radius * 2;
+				const float speedScale = getDistanceToGoal(ag, slowDownRadius) / slowDownRadius;
+
+				ag->desiredSpeed = ag->params.maxSpeed;
+				// leaders leave their followers room to catch up and wait for stragglers
+				if (member.followers > 0)
+					ag->desiredSpeed *= GROUP_LEADER_SPEED * (1.0f - 0.75f * tween(member.lag, GROUP_MAX_LAG, GROUP_MAX_LAG * 2));
+				dtVscale(dvel, dvel, ag->desiredSpeed * speedScale);
+			}
+		}
+
+		// Separation
+		if (ag->params.updateFlags & DT_CROWD_SEPARATION)
+		{
+			const float separationDist = ag->params.collisionQueryRange;
+			const float invSeparationDist = 1.0f / separationDist;
+			const float separationWeight = ag->params.separationWeight;
+
+			float w = 0;
+			float disp[3] = { 0,0,0 };
+
+			for (int j = 0; j < ag->nneis; ++j)
+			{
+				const RCCrowdProxy nei = getNeighbour(ag->neis[j].idx);
+
+				float diff[3];
+				dtVsub(diff, ag->npos, nei.npos);
+				diff[1] = 0;
+
+				const float distSqr = dtVlenSqr(diff);
+				if (distSqr < 0.00001f)
+					continue;
+				if (distSqr > dtSqr(separationDist))
+					continue;
+				const float dist = dtMathSqrtf(distSqr);
+				const float weight = separationWeight * (1.0f - dtSqr(dist * invSeparationDist));
+
+				dtVmad(disp, disp, diff, weight / dist);
+				w += 1.0f;
+			}
+
+			if (w > 0.0001f)
+			{
+				// Adjust desired velocity.
+				dtVmad(dvel, dvel, disp, 1.0f / w);
+				// Clamp desired velocity to desired speed.
+				const float speedSqr = dtVlenSqr(dvel);
+				const float desiredSqr = dtSqr(ag->desiredSpeed);
+				if (speedSqr > desiredSqr)
+					dtVscale(dvel, dvel, desiredSqr / speedSqr);
+			}
+		}
+
+		// Set the desired velocity.
+		dtVcopy(ag->dvel, dvel);
+	}
+
+	int RCCrowd::updateVelocity(dtCrowdAgent* ag, int i, dtObstacleAvoidanceQuery* obstacleQuery, dtCrowdAgentDebugInfo* debug)
+	{
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return 0;
+
+		if (ag->params.updateFlags & DT_CROWD_OBSTACLE_AVOIDANCE)
+		{
+			obstacleQuery->reset();
+
+			// Add neighbours as obstacles.
+			for (int j = 0; j < ag->nneis; ++j)
+			{
+				const RCCrowdProxy nei = getNeighbour(ag->neis[j].idx);
+				obstacleQuery->addCircle(nei.npos, nei.radius, nei.vel, nei.dvel);
+			}
+
+			// Append neighbour segments as obstacles.
+			for (int j = 0; j < ag->boundary.getSegmentCount(); ++j)
+			{
+				const float* s = ag->boundary.getSegment(j);
+				if (dtTriArea2D(ag->npos, s, s + 3) < 0.0f)
+					continue;
+				obstacleQuery->addSegment(s, s + 3);
+			}
+
+			dtObstacleAvoidanceDebugData* vod = 0;
+			if (debug && debug->idx == i)
+				vod = debug->vod;
+
+			// Sample new safe velocity.
+			const dtObstacleAvoidanceParams* params = &m_obstacleQueryParams[ag->params.obstacleAvoidanceType];
+			return obstacleQuery->sampleVelocityAdaptive(ag->npos, ag->params.radius, ag->desiredSpeed,
+				ag->vel, ag->dvel, ag->nvel, params, vod);
+		}
+
+		// If not using velocity planning, new velocity is directly the desired velocity.
+		dtVcopy(ag->nvel, ag->dvel);
+		return 0;
+	}
+
+	void RCCrowd::updateCollisionDisp(dtCrowdAgent* ag)
+	{
+		static const float COLLISION_RESOLVE_FACTOR = 0.7f;
+
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+
+		const int idx0 = getAgentIndex(ag);
+		dtVset(ag->disp, 0, 0, 0);
+
+		float w = 0;
+
+		for (int j = 0; j < ag->nneis; ++j)
+		{
+			const RCCrowdProxy nei = getNeighbour(ag->neis[j].idx);
+			const int idx1 = ag->neis[j].idx;
+
+			float diff[3];
+			dtVsub(diff, ag->npos, nei.npos);
+			diff[1] = 0;
+
+			float dist = dtVlenSqr(diff);
+			if (dist > dtSqr(ag->params.radius + nei.radius))
+				continue;
+			dist = dtMathSqrtf(dist);
+			float pen = (ag->params.radius + nei.radius) - dist;
+			if (dist < 0.0001f)
+			{
+				// Agents on top of each other, try to choose diverging separation directions.
+				if (idx0 > idx1)
+					dtVset(diff, -ag->dvel[2], 0, ag->dvel[0]);
+				else
+					dtVset(diff, ag->dvel[2], 0, -ag->dvel[0]);
+				pen = 0.01f;
+			}
+			else
+			{
+				pen = (1.0f / dist) * (pen * 0.5f) * COLLISION_RESOLVE_FACTOR;
+			}
+
+			dtVmad(ag->disp, ag->disp, diff, pen);
+
+			w += 1.0f;
+		}
+
+		if (w > 0.0001f)
+		{
+			const float iw = 1.0f / w;
+			dtVscale(ag->disp, ag->disp, iw);
+		}
+	}
+
+	void RCCrowd::updateCorridorPosition(dtCrowdAgent* ag, dtNavMeshQuery* navQuery)
+	{
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			return;
+
+		// Move along navmesh.
+		ag->corridor.movePosition(ag->npos, navQuery, &m_filters[ag->params.queryFilterType]);
+		// Get valid constrained position back.
+		dtVcopy(ag->npos, ag->corridor.getPos());
+
+		// If not using path, truncate the corridor to just one poly.
+		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+		{
+			ag->corridor.reset(ag->corridor.getFirstPoly(), ag->npos);
+			ag->partial = false;
+		}
+	}
+
+	void RCCrowd::updateOffMeshAnimations(const float dt)
+	{
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			dtCrowdAgentAnimation* anim = &m_agentAnims[i];
+			if (!anim->active)
+				continue;
+			dtCrowdAgent* ag = &m_agents[i];
+
+			anim->t += dt;
+			if (anim->t > anim->tmax)
+			{
+				// Reset animation
+				anim->active = false;
+				// Prepare agent for walking.
+				ag->state = DT_CROWDAGENT_STATE_WALKING;
+				continue;
+			}
+
+			// Update position
+			const float ta = anim->tmax * 0.15f;
+			const float tb = anim->tmax;
+			if (anim->t < ta)
+			{
+				const float u = tween(anim->t, 0.0, ta);
+				dtVlerp(ag->npos, anim->initPos, anim->startPos, u);
+			}
+			else
+			{
+				const float u = tween(anim->t, ta, tb);
+				dtVlerp(ag->npos, anim->startPos, anim->endPos, u);
+			}
+
+			// Update velocity.
+			dtVset(ag->vel, 0, 0, 0);
+			dtVset(ag->dvel, 0, 0, 0);
+		}
+	}
+
+	template<typename F>
+	void RCCrowd::forEachAgent(ThreadPool* pool, int nagents, F&& func)
+	{
+		const int nworkers = pool ? dtClamp(nagents / MIN_AGENTS_PER_WORKER, 1, MAX_WORKERS) : 1;
+		parallelFor(pool, nagents, nworkers, [&](int worker, int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				func(worker, i, m_activeAgents[i]);
+		});
+	}
+
+	void RCCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug, ThreadPool* pool)
+	{
+		using clock = std::chrono::steady_clock;
+		auto phaseStart = clock::now();
+		auto endPhase = [&](int phase)
+		{
+			if (!isTimingPhases) return;
+			const auto now = clock::now();
+			m_phaseTime[phase] += std::chrono::duration<double, std::milli>(now - phaseStart).count();
+			phaseStart = now;
+		};
+
+		m_velocitySampleCount = 0;
+		m_time += dt;
+
+		dtCrowdAgent** agents = m_activeAgents;
+		int nagents = getActiveAgents(agents, m_maxAgents);
+
+		// Check that all agents still have valid paths.
+		forEachAgent(pool, nagents, [&](int worker, int, dtCrowdAgent* ag)
+		{
+			checkPathValidity(ag, m_workers[worker].navQuery, dt);
+		});
+		endPhase(RC_CROWD_PHASE_PATH_VALIDITY);
+
+		// Update async move request and path finder.
+		updateMoveRequest(dt);
+
+		// Move the followers' corridor ends to their formation slots.
+		if (m_followerCount > 0)
+		{
+			updateGroupLeaders(agents, nagents, dt);
+			forEachAgent(pool, nagents, [&](int worker, int, dtCrowdAgent* ag)
+			{
+				updateFollowerTarget(ag, m_workers[worker].navQuery);
+			});
+		}
+		endPhase(RC_CROWD_PHASE_MOVE_REQUEST);
+
+		// Optimize path topology.
+		updateTopologyOptimization(agents, nagents, dt);
+		endPhase(RC_CROWD_PHASE_TOPOLOGY);
+
+		// Register agents to proximity grid.
+		m_grid->clear();
+		for (int i = 0; i < nagents; ++i)
+		{
+			dtCrowdAgent* ag = agents[i];
+			const float* p = ag->npos;
+			const float r = ag->params.radius;
+			m_grid->addItem((unsigned short)getAgentIndex(ag), p[0] - r, p[2] - r, p[0] + r, p[2] + r);
+		}
+		for (int i = 0; i < (int)m_proxies.size(); ++i)
+		{
+			const float* p = m_proxies[i].npos;
+			const float r = m_proxies[i].radius;
+			m_grid->addItem((unsigned short)(m_maxAgents + i), p[0] - r, p[2] - r, p[0] + r, p[2] + r);
+		}
+
+		// Get nearby navmesh segments and agents to collide with.
+		forEachAgent(pool, nagents, [&](int worker, int, dtCrowdAgent* ag)
+		{
+			updateBoundaryAndNeighbours(ag, m_workers[worker].navQuery);
+		});
+		endPhase(RC_CROWD_PHASE_NEIGHBOURS);
+
+		// Find next corner to steer to.
+		forEachAgent(pool, nagents, [&](int worker, int i, dtCrowdAgent* ag)
+		{
+			updateCorners(ag, i, m_workers[worker].navQuery, debug);
+		});
+
+		// Trigger off-mesh connections (depends on corners).
+		forEachAgent(pool, nagents, [&](int worker, int, dtCrowdAgent* ag)
+		{
+			triggerOffMeshConnection(ag, m_workers[worker].navQuery);
+		});
+		endPhase(RC_CROWD_PHASE_CORNERS);
+
+		// Calculate steering.
+		forEachAgent(pool, nagents, [&](int, int, dtCrowdAgent* ag)
+		{
+			updateSteering(ag);
+		});
+		endPhase(RC_CROWD_PHASE_STEERING);
+
+		// Velocity planning.
+		for (Worker& worker : m_workers)
+			worker.velocitySamples = 0;
+		forEachAgent(pool, nagents, [&](int worker, int i, dtCrowdAgent* ag)
+		{
+			m_workers[worker].velocitySamples += updateVelocity(ag, i, m_workers[worker].obstacleQuery, debug);
+		});
+		for (const Worker& worker : m_workers)
+			m_velocitySampleCount += worker.velocitySamples;
+		endPhase(RC_CROWD_PHASE_AVOIDANCE);
+
+		// Integrate.
+		forEachAgent(pool, nagents, [&](int, int, dtCrowdAgent* ag)
+		{
+			if (ag->state == DT_CROWDAGENT_STATE_WALKING)
+				integrate(ag, dt);
+		});
+		endPhase(RC_CROWD_PHASE_INTEGRATE);
+
+		// Handle collisions.
+		for (int iter = 0; iter < 4; ++iter)
+		{
+			forEachAgent(pool, nagents, [&](int, int, dtCrowdAgent* ag)
+			{
+				updateCollisionDisp(ag);
+			});
+			forEachAgent(pool, nagents, [&](int, int, dtCrowdAgent* ag)
+			{
+				if (ag->state == DT_CROWDAGENT_STATE_WALKING)
+					dtVadd(ag->npos, ag->npos, ag->disp);
+			});
+		}
+		endPhase(RC_CROWD_PHASE_COLLISION);
+
+		forEachAgent(pool, nagents, [&](int worker, int, dtCrowdAgent* ag)
+		{
+			updateCorridorPosition(ag, m_workers[worker].navQuery);
+			if (!cellGrid)
+				return;
+			// Links move the agent after this pass, list it again once it is off.
+			const int idx = getAgentIndex(ag);
+			const int cell = cellGrid->getCellAt(ag->npos);
+			if (cell != m_agentCells[idx] || cellGrid->isGateCell(cell) || ag->state == DT_CROWDAGENT_STATE_OFFMESH)
+			{
+				m_agentCells[idx] = ag->state == DT_CROWDAGENT_STATE_OFFMESH ? -1 : cell;
+				m_workers[worker].cellChanges.push_back(idx);
+			}
+		});
+		m_cellChanges.clear();
+		for (Worker& worker : m_workers)
+		{
+			m_cellChanges.insert(m_cellChanges.end(), worker.cellChanges.begin(), worker.cellChanges.end());
+			worker.cellChanges.clear();
+		}
+
+		// Update agents using off-mesh connection.
+		updateOffMeshAnimations(dt);
+		endPhase(RC_CROWD_PHASE_MOVE);
+	}
+}
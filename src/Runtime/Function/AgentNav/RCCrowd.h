@@ -0,0 +1,312 @@
+#pragma once
+#include <DetourCrowd.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Function/AgentNav/RCPathSearch.h>
+#include <Function/AgentNav/RCPathHierarchy.h>
+#include <cstdint>
+#include <vector>
+class ThreadPool;
+
+namespace GU
+{
+	class RCLandmarks;
+	class RCQueryRecorder;
+	class RCNavGraph;
+	class RCDensityGrid;
+
+	// update phases timed by RCCrowd when isTimingPhases is set
+	enum RCCrowdPhase
+	{
+		RC_CROWD_PHASE_PATH_VALIDITY,
+		RC_CROWD_PHASE_MOVE_REQUEST,
+		RC_CROWD_PHASE_TOPOLOGY,
+		RC_CROWD_PHASE_NEIGHBOURS,
+		RC_CROWD_PHASE_CORNERS,
+		RC_CROWD_PHASE_STEERING,
+		RC_CROWD_PHASE_AVOIDANCE,
+		RC_CROWD_PHASE_INTEGRATE,
+		RC_CROWD_PHASE_COLLISION,
+		RC_CROWD_PHASE_MOVE,
+		RC_CROWD_PHASE_COUNT
+	};
+	const char* getCrowdPhaseName(int phase);
+	// wedge behind the leader, followers 0 and 1 form the first row
+	void getGroupFormationOffset(int follower, float spacing, float* offset);
+
+	// replanning scheduler counters, the per tick values are from the last update
+	struct RCReplanStats
+	{
+		int queueDepth = 0;		// agents still waiting for a path
+		int planned = 0;		// quick searches run
+		int nodes = 0;			// search iterations spent
+		float ms = 0.0f;
+		uint64_t completed = 0;	// requests resolved since the last reset
+		double totalLatency = 0.0;	// crowd seconds from request to resolve
+		double maxLatency = 0.0;
+
+		double getAvgLatency() const { return completed ? totalLatency / completed : 0.0; }
+	};
+
+	// agent of another crowd seen by separation, avoidance and collision, e.g. a
+	// border agent of a neighbouring shard
+	struct RCCrowdProxy
+	{
+		float npos[3];
+		float vel[3];
+		float dvel[3];
+		float radius;
+		float height;
+	};
+
+	// dtCrowd with the same public interface whose update can run its per agent
+	// phases (path validity, boundary and neighbours, corners, steering, velocity
+	// sampling, integration, collisions, corridor move) as parallel-for passes on
+	// the thread pool with a barrier between them. Each pass only writes the agent
+	// it visits and only reads other agents' fields that are not written in that
+	// pass, so the result is identical to the serial update.
+	// Path requests and topology optimization share the path queue and stay serial.
+	// Path requests run under a per tick budget: agents with an invalid corridor go
+	// first, then the ones whose corridor ends farthest from their target, and the
+	// rest wait for the next ticks, so many agents getting a target at once do not
+	// land in one frame.
+	// Agents in a group share the leader's path: followers do not search, their
+	// corridor end slides along a formation slot next to the leader every tick.
+	//
+	// Port of dtCrowd from recastnavigation (zlib license, Copyright (c) 2009-2010
+	// Mikko Mononen memon@inside.org).
+	class RCCrowd
+	{
+	public:
+		RCCrowd() = default;
+		~RCCrowd();
+		RCCrowd(const RCCrowd&) = delete;
+		RCCrowd& operator=(const RCCrowd&) = delete;
+
+		// maxProxies neighbour proxies fit next to the agents, maxAgents + maxProxies
+		// is limited by the 16 bit proximity grid ids
+		bool init(const int maxAgents, const float maxAgentRadius, dtNavMesh* nav, const int maxProxies = 0);
+		// Grows the agent and proxy slots, agents keep their index and state, filters and
+		// avoidance params stay. Path queue requests start again, as after loadState.
+		bool resize(const int maxAgents, const int maxProxies);
+
+		void setObstacleAvoidanceParams(const int idx, const dtObstacleAvoidanceParams* params);
+		// low, medium, good and high quality adaptive sampling in slots 0-3, as in the Recast demo
+		void initAvoidanceQualities();
+		const dtObstacleAvoidanceParams* getObstacleAvoidanceParams(const int idx) const;
+
+		const dtCrowdAgent* getAgent(const int idx);
+		dtCrowdAgent* getEditableAgent(const int idx);
+		int getAgentCount() const { return m_maxAgents; }
+		inline int getAgentIndex(const dtCrowdAgent* agent) const { return (int)(agent - m_agents); }
+
+		// Read-only neighbours for the next updates, at most maxProxies. They are not
+		// simulated and keep the given state for the whole update, pushing against one
+		// moves only the agent of this crowd. Neighbour ids past getAgentCount() are proxies.
+		void setNeighbourProxies(const RCCrowdProxy* proxies, const int n);
+		int getNeighbourProxyCount() const { return (int)m_proxies.size(); }
+		int getMaxNeighbourProxies() const { return m_maxProxies; }
+
+		int addAgent(const float* pos, const dtCrowdAgentParams* params);
+		void updateAgentParameters(const int idx, const dtCrowdAgentParams* params);
+		void removeAgent(const int idx);
+
+		// a move request of its own takes a follower out of its group
+		bool requestMoveTarget(const int idx, dtPolyRef ref, const float* pos);
+		bool requestMoveVelocity(const int idx, const float* vel);
+		bool resetMoveTarget(const int idx);
+
+		// Makes idx follow leader at offset, offset[0] across and offset[2] along the
+		// leader's heading. The follower's corridor starts at its position and its end
+		// is moved to the slot with local surface moves only, so the group costs one
+		// path search. It plans a path of its own only to get back to a slot it lost
+		// behind a wall. Groups are one level deep, returns false when the leader
+		// follows someone or idx has followers. Removing a leader hands its target
+		// and followers to its first follower.
+		bool setAgentGroup(const int idx, const int leader, const float* offset);
+		// the agent leaves its group and stops at its last slot
+		void clearAgentGroup(const int idx);
+		int getAgentLeader(const int idx) const { return (idx >= 0 && idx < m_maxAgents) ? m_groups[idx].leader : -1; }
+		int getFollowerCount(const int idx) const { return (idx >= 0 && idx < m_maxAgents) ? m_groups[idx].followers : 0; }
+
+		int getActiveAgents(dtCrowdAgent** agents, const int maxAgents);
+
+		// pool == nullptr runs every phase on the calling thread.
+		void update(const float dt, dtCrowdAgentDebugInfo* debug, ThreadPool* pool = nullptr);
+
+		const dtQueryFilter* getFilter(const int i) const { return (i >= 0 && i < DT_CROWD_MAX_QUERY_FILTER_TYPE) ? &m_filters[i] : 0; }
+		dtQueryFilter* getEditableFilter(const int i) { return (i >= 0 && i < DT_CROWD_MAX_QUERY_FILTER_TYPE) ? &m_filters[i] : 0; }
+		const float* getQueryHalfExtents() const { return m_ext; }
+		const float* getQueryExtents() const { return m_ext; }
+		int getVelocitySampleCount() const { return m_velocitySampleCount; }
+
+		// Grid the caller keeps the agents in. Every update lists the agents that changed
+		// cell, walk in a gate cell or are on an off-mesh link, the others need no grid
+		// update. Owned by the caller.
+		const RCDensityGrid* cellGrid = nullptr;
+		const std::vector<int>& getCellChanges() const { return m_cellChanges; }
+		const dtProximityGrid* getGrid() const { return m_grid; }
+		const dtPathQueue* getPathQueue() const { return &m_pathq; }
+		const dtNavMeshQuery* getNavMeshQuery() const { return m_workers[0].navQuery; }
+
+		// accumulated milliseconds per RCCrowdPhase since the last reset
+		bool isTimingPhases = false;
+		double getPhaseTime(int phase) const { return m_phaseTime[phase]; }
+		void resetPhaseTimes();
+
+		// per tick replanning budget, a limit <= 0 is off. The time limit makes the
+		// result depend on the machine and is off by default, lockstep runs only use
+		// the node limit.
+		float replanBudgetMs = REPLAN_BUDGET_MS;
+		int replanBudgetNodes = REPLAN_BUDGET_NODES;
+		const RCReplanStats& getReplanStats() const { return m_replanStats; }
+		void resetReplanStats();
+
+		// Full path requests run as RCPathSearch searches instead of the sliced path
+		// queue while landmarks is set, with the ALT bound as heuristic. Each search
+		// runs to its end inside updateMoveRequest and counts against replanBudgetNodes.
+		// The tables belong to the caller and must be built on the crowd's navmesh.
+		const RCLandmarks* landmarks = nullptr;
+		// With a hierarchy, requests between two clusters search the portal graph and
+		// refine only the first HIERARCHY_REFINE_SEGMENTS segments, the corridor grows
+		// by one segment whenever the agent is near its end. Corridors stay short
+		// whatever the distance to the target.
+		const RCPathHierarchy* hierarchy = nullptr;
+		// With a density, the full searches run with RCCrowdCostFilter: the agent's
+		// filter flags and area costs, and every polygon penalised by the agents on it.
+		// polyDensity is indexed by densityGraph polygon index and read during update.
+		// Otherwise they run with RCAreaFilter, both inline into the search.
+		const RCNavGraph* densityGraph = nullptr;
+		const float* polyDensity = nullptr;
+		float densityWeight = 0.5f;
+
+		// Captures the quick and full path searches and the visibility and topology
+		// queries of the corridors, as they are issued. Owned by the caller.
+		RCQueryRecorder* queryRecorder = nullptr;
+
+		// Appends the agent, corridor, target, avoidance and off-mesh state of every
+		// active agent. Requests waiting in the path queue are not kept, those agents
+		// queue again after loadState. Neither are the segments of a hierarchical path
+		// not refined yet, those agents replan near the end of their corridor.
+		void saveState(std::vector<uint8_t>& out) const;
+		// False when data is not from a crowd of the same build and at most this size, the
+		// crowd is left empty when it is truncated or holds a corridor longer than this crowd's.
+		bool loadState(const uint8_t* data, size_t size);
+	private:
+		struct Worker
+		{
+			dtNavMeshQuery* navQuery = nullptr;
+			dtObstacleAvoidanceQuery* obstacleQuery = nullptr;
+			int velocitySamples = 0;
+			std::vector<int> cellChanges;
+		};
+
+		void purge();
+		// agent or proxy behind a neighbour id
+		RCCrowdProxy getNeighbour(const int idx) const;
+		int getNeighbours(const float* pos, const float height, const float range,
+			const dtCrowdAgent* skip, dtCrowdNeighbour* result, const int maxResult) const;
+		bool requestMoveTargetReplan(const int idx, dtPolyRef ref, const float* pos);
+
+		void checkPathValidity(dtCrowdAgent* ag, dtNavMeshQuery* navQuery, const float dt);
+		void updateMoveRequest(const float dt);
+		// quick search towards the target, returns the search iterations used
+		int planMoveRequest(dtCrowdAgent* ag, dtNavMeshQuery* navQuery);
+		float getReplanPriority(const dtCrowdAgent* ag) const;
+		bool isSearchingPaths() const;
+		// full path request of a queued agent, returns the nodes expanded
+		int searchPathRequest(dtCrowdAgent* ag, dtNavMeshQuery* navQuery);
+		// flat search from the corridor end to the target, with the landmark bound when set
+		template<typename Filter>
+		dtStatus findRequestPath(const dtCrowdAgent* ag, const Filter* filter, int* nres);
+		// merges the nres polygons of a finished request in m_pathResult into the corridor
+		void applyPathResult(dtCrowdAgent* ag, dtStatus status, int nres, dtNavMeshQuery* navQuery);
+		// appends the next segment of the agent's abstract path, returns the nodes expanded
+		int extendHierarchyCorridor(dtCrowdAgent* ag, dtNavMeshQuery* navQuery);
+		void updateTopologyOptimization(dtCrowdAgent** agents, const int nagents, const float dt);
+		void updateBoundaryAndNeighbours(dtCrowdAgent* ag, dtNavMeshQuery* navQuery);
+		void updateCorners(dtCrowdAgent* ag, int i, dtNavMeshQuery* navQuery, dtCrowdAgentDebugInfo* debug);
+		// the raycast optimizePathVisibility casts towards next
+		void recordVisibilityRay(const dtCrowdAgent* ag, const float* next);
+		void triggerOffMeshConnection(dtCrowdAgent* ag, dtNavMeshQuery* navQuery);
+		void updateSteering(dtCrowdAgent* ag);
+		int updateVelocity(dtCrowdAgent* ag, int i, dtObstacleAvoidanceQuery* obstacleQuery, dtCrowdAgentDebugInfo* debug);
+		void updateCollisionDisp(dtCrowdAgent* ag);
+		void updateCorridorPosition(dtCrowdAgent* ag, dtNavMeshQuery* navQuery);
+		void updateOffMeshAnimations(const float dt);
+		void updateGroupLeaders(dtCrowdAgent** agents, const int nagents, const float dt);
+		void updateFollowerTarget(dtCrowdAgent* ag, dtNavMeshQuery* navQuery);
+		void promoteFollower(const int leader);
+
+		// Runs func(worker, agentListIndex, agent) over the active agents.
+		template<typename F>
+		void forEachAgent(ThreadPool* pool, int nagents, F&& func);
+
+		int m_maxAgents = 0;
+		dtCrowdAgent* m_agents = nullptr;
+		dtCrowdAgent** m_activeAgents = nullptr;
+		dtCrowdAgentAnimation* m_agentAnims = nullptr;
+
+		dtPathQueue m_pathq;
+		RCPathSearch m_pathSearch;
+		dtObstacleAvoidanceParams m_obstacleQueryParams[DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS];
+		dtProximityGrid* m_grid = nullptr;
+		std::vector<RCCrowdProxy> m_proxies;
+		int m_maxProxies = 0;
+
+		dtPolyRef* m_pathResult = nullptr;
+		int m_maxPathResult = 0;
+
+		float m_ext[3] = {};
+		dtQueryFilter m_filters[DT_CROWD_MAX_QUERY_FILTER_TYPE];
+		float m_maxAgentRadius = 0.0f;
+		dtNavMesh* m_navMesh = nullptr;
+		int m_velocitySampleCount = 0;
+
+		// worker 0 is also the query used by the serial phases
+		Worker m_workers[MAX_WORKERS];
+		double m_phaseTime[RC_CROWD_PHASE_COUNT] = {};
+
+		struct ReplanEntry
+		{
+			float priority;
+			int idx;
+			bool operator<(const ReplanEntry& other) const { return priority < other.priority; }
+		};
+		std::vector<ReplanEntry> m_replanHeap;
+		double* m_replanStart = nullptr;	// crowd time the request was seen, < 0 when none
+		double m_time = 0.0;
+		RCReplanStats m_replanStats;
+
+		struct GroupMember
+		{
+			int leader = -1;
+			int followers = 0;
+			float offset[3] = {};
+			float heading[3] = { 0.0f, 0.0f, 1.0f };	// leaders only, xz unit vector
+			float lag = 0.0f;	// leaders only, largest follower distance to its slot
+		};
+		std::vector<GroupMember> m_groups;
+		int m_followerCount = 0;
+
+		// poly and range the boundary was last found from, saveState keeps these and
+		// loadState finds the same segments again
+		struct BoundaryQuery
+		{
+			dtPolyRef ref = 0;
+			float range = 0.0f;
+		};
+		std::vector<BoundaryQuery> m_boundaryQueries;
+
+		// abstract path of a hierarchical request, empty once the corridor reaches the target
+		struct HierarchyCorridor
+		{
+			RCAbstractPath path;
+			int nextSegment = 0;
+		};
+		std::vector<HierarchyCorridor> m_hierarchyCorridors;
+
+		// cellGrid cell of the last update, -1 forces the agent into the next list
+		std::vector<int> m_agentCells;
+		std::vector<int> m_cellChanges;
+	};
+}
@@ -0,0 +1,176 @@
+#include "RCDensityGrid.h"
+#include <algorithm>
+#include <cmath>
+
+namespace GU
+{
+	// signed area of (b - a) x (p - a) on the xz plane
+	static inline float orient2D(const float* a, const float* b, const float* p)
+	{
+		return (b[0] - a[0]) * (p[1] - a[1]) - (b[1] - a[1]) * (p[0] - a[0]);
+	}
+
+	void RCDensityGrid::init(const float* bmin, const float* bmax, float cellSize, int maxAgents)
+	{
+		m_cellSize = std::max(0.01f, cellSize);
+		m_invCellArea = 1.0f / (m_cellSize * m_cellSize);
+		m_origin[0] = bmin[0];
+		m_origin[1] = bmin[2];
+		m_width = std::max(1, (int)ceilf((bmax[0] - bmin[0]) / m_cellSize));
+		m_height = std::max(1, (int)ceilf((bmax[2] - bmin[2]) / m_cellSize));
+		m_counts.assign((size_t)m_width * m_height, 0);
+		m_alerted.assign((size_t)m_width * m_height, 0);
+		m_gateCells.assign((size_t)m_width * m_height, 0);
+		m_agentCells.assign(maxAgents, -1);
+		m_agentPos.assign((size_t)maxAgents * 2, 0.0f);
+		m_alerts.clear();
+		m_gates.clear();
+	}
+
+	void RCDensityGrid::clear()
+	{
+		std::fill(m_counts.begin(), m_counts.end(), 0);
+		std::fill(m_alerted.begin(), m_alerted.end(), 0);
+		std::fill(m_agentCells.begin(), m_agentCells.end(), -1);
+		m_alerts.clear();
+	}
+
+	int RCDensityGrid::getCellAt(const float* pos) const
+	{
+		const int x = (int)floorf((pos[0] - m_origin[0]) / m_cellSize);
+		const int z = (int)floorf((pos[2] - m_origin[1]) / m_cellSize);
+		if (x < 0 || z < 0 || x >= m_width || z >= m_height) return -1;
+		return x + z * m_width;
+	}
+
+	void RCDensityGrid::updateAgent(int idx, const float* pos, bool active)
+	{
+		if (idx < 0) return;
+		if (idx >= (int)m_agentCells.size())
+		{
+			m_agentCells.resize(idx + 1, -1);
+			m_agentPos.resize((size_t)(idx + 1) * 2, 0.0f);
+		}
+		const int cell = m_agentCells[idx];
+		const int newCell = active ? getCellAt(pos) : -1;
+		float* last = &m_agentPos[idx * 2];
+		const float xz[2] = { pos[0], pos[2] };
+		if (newCell != cell)
+		{
+			if (cell != -1) removeFromCell(cell);
+			if (newCell != -1) addToCell(newCell, pos);
+		}
+		// gate cells are grown by one, a tick step never skips over them
+		if (cell != -1 && newCell != -1 && (m_gateCells[cell] || m_gateCells[newCell]))
+			testGates(last, xz);
+		m_agentCells[idx] = newCell;
+		last[0] = xz[0];
+		last[1] = xz[1];
+	}
+
+	void RCDensityGrid::removeAgent(int idx)
+	{
+		if (idx < 0 || idx >= (int)m_agentCells.size() || m_agentCells[idx] == -1) return;
+		removeFromCell(m_agentCells[idx]);
+		m_agentCells[idx] = -1;
+	}
+
+	void RCDensityGrid::addToCell(int cell, const float* pos)
+	{
+		const int count = ++m_counts[cell];
+		const float density = count * m_invCellArea;
+		if (!m_alerted[cell] && density >= m_peakDensity)
+		{
+			m_alerted[cell] = 1;
+			RCDensityAlert alert;
+			alert.cell = cell;
+			alert.count = count;
+			alert.density = density;
+			alert.time = m_time;
+			alert.pos[0] = pos[0];
+			alert.pos[1] = pos[1];
+			alert.pos[2] = pos[2];
+			m_alerts.push_back(alert);
+		}
+	}
+
+	void RCDensityGrid::removeFromCell(int cell)
+	{
+		const int count = --m_counts[cell];
+		if (m_alerted[cell] && count * m_invCellArea < m_peakDensity * 0.75f)
+			m_alerted[cell] = 0;
+	}
+
+	int RCDensityGrid::getPeakCount(int* cell) const
+	{
+		int peak = 0;
+		int peakCell = -1;
+		for (int i = 0; i < (int)m_counts.size(); i++)
+		{
+			if (m_counts[i] <= peak) continue;
+			peak = m_counts[i];
+			peakCell = i;
+		}
+		if (cell) *cell = peakCell;
+		return peak;
+	}
+
+	int RCDensityGrid::popAlerts(std::vector<RCDensityAlert>& alerts)
+	{
+		const int n = (int)m_alerts.size();
+		alerts.insert(alerts.end(), m_alerts.begin(), m_alerts.end());
+		m_alerts.clear();
+		return n;
+	}
+
+	int RCDensityGrid::addGate(const float* a, const float* b)
+	{
+		Gate gate;
+		gate.a[0] = a[0];
+		gate.a[1] = a[2];
+		gate.b[0] = b[0];
+		gate.b[1] = b[2];
+		m_gates.push_back(gate);
+
+		const int x0 = std::max(0, (int)floorf((std::min(a[0], b[0]) - m_origin[0]) / m_cellSize) - 1);
+		const int x1 = std::min(m_width - 1, (int)floorf((std::max(a[0], b[0]) - m_origin[0]) / m_cellSize) + 1);
+		const int z0 = std::max(0, (int)floorf((std::min(a[2], b[2]) - m_origin[1]) / m_cellSize) - 1);
+		const int z1 = std::min(m_height - 1, (int)floorf((std::max(a[2], b[2]) - m_origin[1]) / m_cellSize) + 1);
+		for (int z = z0; z <= z1; z++)
+			for (int x = x0; x <= x1; x++)
+				m_gateCells[x + z * m_width] = 1;
+		return (int)m_gates.size() - 1;
+	}
+
+	void RCDensityGrid::clearGates()
+	{
+		m_gates.clear();
+		std::fill(m_gateCells.begin(), m_gateCells.end(), 0);
+	}
+
+	void RCDensityGrid::testGates(const float* from, const float* to)
+	{
+		for (Gate& gate : m_gates)
+		{
+			// half open so an agent standing on the line is counted once
+			const float s0 = orient2D(gate.a, gate.b, from);
+			const float s1 = orient2D(gate.a, gate.b, to);
+			if ((s0 > 0.0f) == (s1 > 0.0f)) continue;
+			const float t0 = orient2D(from, to, gate.a);
+			const float t1 = orient2D(from, to, gate.b);
+			if ((t0 > 0.0f && t1 > 0.0f) || (t0 < 0.0f && t1 < 0.0f)) continue;
+			gate.crossings[s1 > 0.0f ? 0 : 1]++;
+			gate.recent.push_back(m_time);
+			while (gate.recent.front() < m_time - m_flowWindow)
+				gate.recent.pop_front();
+		}
+	}
+
+	float RCDensityGrid::getGateFlowRate(int gate)
+	{
+		Gate& g = m_gates[gate];
+		while (!g.recent.empty() && g.recent.front() < m_time - m_flowWindow)
+			g.recent.pop_front();
+		return m_flowWindow > 0.0f ? g.recent.size() / m_flowWindow : 0.0f;
+	}
+}
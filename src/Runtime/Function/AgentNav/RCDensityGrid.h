@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace GU
+{
+	// a cell reaching the peak density, reported once until it drops below 3/4 of it
+	struct RCDensityAlert
+	{
+		int cell = -1;
+		int count = 0;
+		float density = 0.0f;	// agents per square meter
+		double time = 0.0;
+		float pos[3] = {};	// agent that filled the cell
+	};
+
+	// Uniform xz grid of agent counts over the navmesh bounds. Agents are kept in
+	// their cell and only touch the counts, alerts and gate tests when they change
+	// cell or walk near a gate, so a tick costs work for those agents only. RCCrowd
+	// lists them with cellGrid set, removed agents are dropped by removeAgent.
+	class RCDensityGrid
+	{
+	public:
+		RCDensityGrid() = default;
+		~RCDensityGrid() = default;
+
+		void init(const float* bmin, const float* bmax, float cellSize, int maxAgents);
+		// drops every agent, gates and their counts are kept
+		void clear();
+
+		// sim time used for alerts and flow rates, set before the agents of a tick
+		void setTime(double time) { m_time = time; }
+		void updateAgent(int idx, const float* pos, bool active = true);
+		void removeAgent(int idx);
+
+		int getWidth() const { return m_width; }
+		int getHeight() const { return m_height; }
+		float getCellSize() const { return m_cellSize; }
+		int getCellAt(const float* pos) const;
+		// agents in these cells have to be updated every tick for the gate tests
+		bool isGateCell(int cell) const { return cell != -1 && m_gateCells[cell]; }
+		int getCount(int cell) const { return m_counts[cell]; }
+		const std::vector<int>& getCounts() const { return m_counts; }
+		float getDensity(int cell) const { return m_counts[cell] * m_invCellArea; }
+		// highest count over all cells, O(cells)
+		int getPeakCount(int* cell = nullptr) const;
+
+		// agents per square meter that raise an alert
+		void setPeakDensity(float density) { m_peakDensity = density; }
+		float getPeakDensity() const { return m_peakDensity; }
+		// moves the alerts raised since the last call into alerts, returns how many
+		int popAlerts(std::vector<RCDensityAlert>& alerts);
+
+		// Counting line between a and b on the xz plane (3 floats each, y ignored).
+		// Returns the gate id.
+		int addGate(const float* a, const float* b);
+		void clearGates();
+		int getGateCount() const { return (int)m_gates.size(); }
+		// dir 0 counts crossings to the left of a->b, dir 1 to the right
+		uint64_t getGateCrossings(int gate, int dir) const { return m_gates[gate].crossings[dir]; }
+		// agents per second through the gate in both directions over the flow window
+		float getGateFlowRate(int gate);
+		void setFlowWindow(float seconds) { m_flowWindow = seconds; }
+	private:
+		struct Gate
+		{
+			float a[2];
+			float b[2];
+			uint64_t crossings[2] = {};
+			std::deque<double> recent;	// crossing times inside the flow window
+		};
+
+		void addToCell(int cell, const float* pos);
+		void removeFromCell(int cell);
+		void testGates(const float* from, const float* to);
+
+		float m_origin[2] = {};
+		float m_cellSize = 0.0f;
+		float m_invCellArea = 0.0f;
+		int m_width = 0;
+		int m_height = 0;
+		std::vector<int> m_counts;
+		std::vector<unsigned char> m_alerted;
+		std::vector<unsigned char> m_gateCells;	// cells a gate passes, grown by one cell
+
+		std::vector<int> m_agentCells;		// -1 when not in the grid
+		std::vector<float> m_agentPos;		// xz of the last update
+
+		float m_peakDensity = 4.0f;
+		std::vector<RCDensityAlert> m_alerts;
+		std::vector<Gate> m_gates;
+		float m_flowWindow = 10.0f;
+		double m_time = 0.0;
+	};
+}
@@ -0,0 +1,171 @@
+#include "RCLandmarks.h"
+#include <cfloat>
+#include <cmath>
+#include <queue>
+#include <functional>
+
+namespace GU
+{
+	void RCLandmarks::build(const RCNavGraph& graph, int nlandmarks)
+	{
+		clear();
+		m_graph = &graph;
+		const dtNavMesh* navMesh = graph.getNavMesh();
+		const int npolys = graph.getPolyCount();
+		if (navMesh == nullptr || npolys == 0 || nlandmarks <= 0) return;
+		nlandmarks = dtMin(nlandmarks, npolys);
+
+		// Portal graph, polygons are visited in index order.
+		m_portalOffsets.assign(npolys + 1, 0);
+		for (int i = 0; i < navMesh->getMaxTiles(); i++)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (!tile || !tile->header) continue;
+			const dtPolyRef base = navMesh->getPolyRefBase(tile);
+			for (int j = 0; j < tile->header->polyCount; j++)
+			{
+				const dtPolyRef ref = base | (dtPolyRef)j;
+				const dtPoly* poly = &tile->polys[j];
+				const int idx = graph.indexOf(ref);
+				for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+				{
+					const dtLink* link = &tile->links[k];
+					const int nei = graph.indexOf(link->ref);
+					if (nei < 0) continue;
+					const dtMeshTile* neiTile = 0;
+					const dtPoly* neiPoly = 0;
+					navMesh->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly);
+					float mid[3];
+					RCPathSearch::getEdgeMidPoint(ref, poly, tile, link, neiPoly, neiTile, mid);
+					m_portalTo.push_back(nei);
+					m_portalPos.insert(m_portalPos.end(), mid, mid + 3);
+				}
+				m_portalOffsets[idx + 1] = (int)m_portalTo.size();
+			}
+		}
+
+		// Farthest point selection. Unreachable polygons count as infinitely far,
+		// so every island gets a landmark before an island gets a second one.
+		std::vector<std::vector<float> > nearDists, farDists;
+		std::vector<float> minDist(npolys, FLT_MAX);
+		std::vector<float> dist, nearDist, farDist;
+		dijkstra(0, dist);
+		reduce(0, dist, nearDist, farDist);
+		int next = 0;
+		for (int i = 0; i < npolys; i++)
+		{
+			if (nearDist[i] != FLT_MAX && nearDist[i] > nearDist[next]) next = i;
+		}
+
+		float maxDist = 0.0f;
+		for (int k = 0; k < nlandmarks; k++)
+		{
+			m_landmarks.push_back(next);
+			dijkstra(next, dist);
+			reduce(next, dist, nearDist, farDist);
+			for (int i = 0; i < npolys; i++)
+			{
+				minDist[i] = dtMin(minDist[i], nearDist[i]);
+				if (farDist[i] != FLT_MAX) maxDist = dtMax(maxDist, farDist[i]);
+			}
+			nearDists.push_back(nearDist);
+			farDists.push_back(farDist);
+
+			next = -1;
+			for (int i = 0; i < npolys; i++)
+			{
+				if (minDist[i] > 0.0f && (next == -1 || minDist[i] > minDist[next])) next = i;
+			}
+			if (next == -1) break;
+		}
+
+		m_nlandmarks = (int)m_landmarks.size();
+		m_quantStep = dtMax(maxDist / (float)(UNREACHABLE - 2), 1e-4f);
+		m_dist.resize((size_t)npolys * m_nlandmarks * 2);
+		for (int i = 0; i < npolys; i++)
+		{
+			for (int k = 0; k < m_nlandmarks; k++)
+			{
+				unsigned short* d = &m_dist[((size_t)i * m_nlandmarks + k) * 2];
+				if (nearDists[k][i] == FLT_MAX)
+				{
+					d[0] = d[1] = UNREACHABLE;
+					continue;
+				}
+				d[0] = (unsigned short)dtMin((int)floorf(nearDists[k][i] / m_quantStep), (int)UNREACHABLE - 1);
+				d[1] = (unsigned short)dtMin((int)ceilf(farDists[k][i] / m_quantStep), (int)UNREACHABLE - 1);
+			}
+		}
+	}
+
+	void RCLandmarks::clear()
+	{
+		m_graph = nullptr;
+		m_nlandmarks = 0;
+		m_landmarks.clear();
+		m_portalOffsets.clear();
+		m_portalTo.clear();
+		m_portalPos.clear();
+		m_dist.clear();
+	}
+
+	float RCLandmarks::lowerBound(int from, int to) const
+	{
+		const unsigned short* a = &m_dist[(size_t)from * m_nlandmarks * 2];
+		const unsigned short* b = &m_dist[(size_t)to * m_nlandmarks * 2];
+		int best = 0;
+		for (int k = 0; k < m_nlandmarks; k++, a += 2, b += 2)
+		{
+			if (a[0] == UNREACHABLE || b[0] == UNREACHABLE) continue;
+			// d(L, to) - d(L, from) and d(L, from) - d(L, to) for the worst portals of both
+			best = dtMax(best, dtMax((int)b[0] - (int)a[1], (int)a[0] - (int)b[1]));
+		}
+		return best * m_quantStep;
+	}
+
+	void RCLandmarks::dijkstra(int source, std::vector<float>& dist) const
+	{
+		dist.assign(m_portalTo.size(), FLT_MAX);
+		typedef std::pair<float, int> Entry;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+		for (int p = m_portalOffsets[source]; p < m_portalOffsets[source + 1]; p++)
+		{
+			dist[p] = 0.0f;
+			open.push({ 0.0f, p });
+		}
+		while (!open.empty())
+		{
+			const Entry cur = open.top();
+			open.pop();
+			const int p = cur.second;
+			if (cur.first > dist[p]) continue;
+			const int poly = m_portalTo[p];
+			for (int q = m_portalOffsets[poly]; q < m_portalOffsets[poly + 1]; q++)
+			{
+				const float d = cur.first + dtVdist(&m_portalPos[p * 3], &m_portalPos[q * 3]);
+				if (d < dist[q])
+				{
+					dist[q] = d;
+					open.push({ d, q });
+				}
+			}
+		}
+	}
+
+	void RCLandmarks::reduce(int source, const std::vector<float>& dist, std::vector<float>& nearDist, std::vector<float>& farDist) const
+	{
+		const int npolys = (int)m_portalOffsets.size() - 1;
+		nearDist.assign(npolys, FLT_MAX);
+		farDist.assign(npolys, FLT_MAX);
+		for (int p = 0; p < (int)m_portalTo.size(); p++)
+		{
+			if (dist[p] == FLT_MAX) continue;
+			const int poly = m_portalTo[p];
+			nearDist[poly] = dtMin(nearDist[poly], dist[p]);
+			farDist[poly] = farDist[poly] == FLT_MAX ? dist[p] : dtMax(farDist[poly], dist[p]);
+		}
+		// a search starting on the source is there already, also without a portal into it
+		nearDist[source] = 0.0f;
+		if (farDist[source] == FLT_MAX) farDist[source] = 0.0f;
+	}
+}
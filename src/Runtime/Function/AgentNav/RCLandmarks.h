@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <Function/AgentNav/RCPathSearch.h>
+#include <Function/AgentNav/RCNavGraph.h>
+
+namespace GU
+{
+	// ALT (A*, landmarks, triangle inequality) distance tables. After a build a few
+	// landmarks are picked by farthest point selection and the graph distance from
+	// every landmark to every polygon is stored as a 16 bit quantized value.
+	// Distances are measured like the search measures them: along the portal edge
+	// midpoints a node is placed on (RCPathSearch::getEdgeMidPoint). A polygon can be
+	// entered through any of its portals, so it keeps the nearest and the farthest of
+	// them, and the bound takes the worst case of both ends. The quantization rounds
+	// near values down and far values up, the bound never needs a scale. Detour keeps
+	// the portal a node was first reached through when it gets a cheaper parent, the
+	// step after that is the only one that can be shorter than the portal graph.
+	class RCLandmarks
+	{
+	public:
+		RCLandmarks() = default;
+		~RCLandmarks() = default;
+
+		void build(const RCNavGraph& graph, int nlandmarks);
+		void clear();
+
+		int getLandmarkCount() const { return m_nlandmarks; }
+		int getLandmarkPoly(int i) const { return m_landmarks[i]; }
+		const RCNavGraph* getGraph() const { return m_graph; }
+		size_t getMemorySize() const { return m_dist.size() * sizeof(unsigned short); }
+
+		// Lower bound of the search cost from a node on polygon index from to a node on to.
+		float lowerBound(int from, int to) const;
+	private:
+		static const unsigned short UNREACHABLE = 0xffff;
+		// portal to portal distances from every portal of the source polygon
+		void dijkstra(int source, std::vector<float>& dist) const;
+		// nearest and farthest portal of every polygon, FLT_MAX without a reachable one
+		void reduce(int source, const std::vector<float>& dist, std::vector<float>& nearDist, std::vector<float>& farDist) const;
+
+		const RCNavGraph* m_graph = nullptr;
+		int m_nlandmarks = 0;
+		std::vector<int> m_landmarks;
+		// Portals are the links between polygons, grouped by the polygon they leave,
+		// so the portals reachable from portal p are [m_portalOffsets[to], m_portalOffsets[to + 1])
+		// with to = m_portalTo[p].
+		std::vector<int> m_portalOffsets;
+		std::vector<int> m_portalTo;
+		std::vector<float> m_portalPos;
+		// poly major, [(poly * m_nlandmarks + landmark) * 2] near and + 1 far, one cache line per lookup
+		std::vector<unsigned short> m_dist;
+		float m_quantStep = 1.0f;
+	};
+
+	struct RCLandmarkHeuristic
+	{
+		const RCLandmarks* landmarks;
+		int goalIdx;
+		const float* endPos;
+
+		float operator()(dtPolyRef ref, const float* pos) const
+		{
+			const float euclid = dtVdist(pos, endPos) * RC_H_SCALE;
+			const int idx = landmarks->getGraph()->indexOf(ref);
+			if (idx < 0 || goalIdx < 0) return euclid;
+			return dtMax(euclid, landmarks->lowerBound(idx, goalIdx));
+		}
+	};
+}
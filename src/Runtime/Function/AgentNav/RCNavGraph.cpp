@@ -0,0 +1,90 @@
+#include "RCNavGraph.h"
+#include <DetourCommon.h>
+
+namespace GU
+{
+	bool RCNavGraph::build(const dtNavMesh* navMesh)
+	{
+		clear();
+		if (navMesh == nullptr) return false;
+		m_navMesh = navMesh;
+
+		const int maxTiles = navMesh->getMaxTiles();
+		m_tileBase.assign(maxTiles, -1);
+		int npolys = 0;
+		for (int i = 0; i < maxTiles; i++)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (!tile || !tile->header) continue;
+			m_tileBase[i] = npolys;
+			npolys += tile->header->polyCount;
+		}
+
+		m_refs.resize(npolys);
+		m_centers.resize(npolys * 3);
+		m_adjOffsets.assign(npolys + 1, 0);
+
+		for (int i = 0; i < maxTiles; i++)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (!tile || !tile->header) continue;
+			const dtPolyRef base = navMesh->getPolyRefBase(tile);
+			for (int j = 0; j < tile->header->polyCount; j++)
+			{
+				const dtPoly* poly = &tile->polys[j];
+				const int idx = m_tileBase[i] + j;
+				m_refs[idx] = base | (dtPolyRef)j;
+
+				float* center = &m_centers[idx * 3];
+				dtVset(center, 0, 0, 0);
+				for (int k = 0; k < (int)poly->vertCount; k++)
+					dtVadd(center, center, &tile->verts[poly->verts[k] * 3]);
+				if (poly->vertCount)
+					dtVscale(center, center, 1.0f / (float)poly->vertCount);
+			}
+		}
+
+		// Polygons are visited in index order, so the offsets can be filled as we go.
+		for (int i = 0; i < maxTiles; i++)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (!tile || !tile->header) continue;
+			for (int j = 0; j < tile->header->polyCount; j++)
+			{
+				const dtPoly* poly = &tile->polys[j];
+				const int idx = m_tileBase[i] + j;
+				for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+				{
+					const int nei = indexOf(tile->links[k].ref);
+					if (nei < 0) continue;
+					m_adj.push_back(nei);
+					m_adjCost.push_back(dtVdist(centerAt(idx), centerAt(nei)));
+				}
+				m_adjOffsets[idx + 1] = (int)m_adj.size();
+			}
+		}
+		return true;
+	}
+
+	void RCNavGraph::clear()
+	{
+		m_navMesh = nullptr;
+		m_tileBase.clear();
+		m_refs.clear();
+		m_centers.clear();
+		m_adjOffsets.clear();
+		m_adj.clear();
+		m_adjCost.clear();
+	}
+
+	int RCNavGraph::indexOf(dtPolyRef ref) const
+	{
+		if (m_navMesh == nullptr || !ref) return -1;
+		unsigned int salt, it, ip;
+		m_navMesh->decodePolyId(ref, salt, it, ip);
+		if (it >= (unsigned int)m_tileBase.size() || m_tileBase[it] < 0) return -1;
+		const dtMeshTile* tile = m_navMesh->getTile((int)it);
+		if (tile->salt != salt || ip >= (unsigned int)tile->header->polyCount) return -1;
+		return m_tileBase[it] + (int)ip;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <DetourNavMesh.h>
+
+namespace GU
+{
+	// Flat view of the Detour polygon graph, rebuilt after every navmesh build.
+	// Every polygon gets a dense index, so per polygon data can live in plain arrays.
+	class RCNavGraph
+	{
+	public:
+		RCNavGraph() = default;
+		~RCNavGraph() = default;
+
+		bool build(const dtNavMesh* navMesh);
+		void clear();
+
+		int getPolyCount() const { return (int)m_refs.size(); }
+		// Dense index of the polygon, -1 for invalid or stale refs.
+		int indexOf(dtPolyRef ref) const;
+		// No salt or range checks, for refs taken from navmesh links inside a search.
+		int indexOfUnsafe(dtPolyRef ref) const
+		{
+			return m_tileBase[m_navMesh->decodePolyIdTile(ref)] + (int)m_navMesh->decodePolyIdPoly(ref);
+		}
+		dtPolyRef refAt(int idx) const { return m_refs[idx]; }
+		const float* centerAt(int idx) const { return &m_centers[idx * 3]; }
+
+		// Neighbours of idx are neighbourAt(k) for k in [neighbourBegin(idx), neighbourEnd(idx)).
+		int neighbourBegin(int idx) const { return m_adjOffsets[idx]; }
+		int neighbourEnd(int idx) const { return m_adjOffsets[idx + 1]; }
+		int neighbourAt(int k) const { return m_adj[k]; }
+		// Distance between the two polygon centers.
+		float edgeCostAt(int k) const { return m_adjCost[k]; }
+
+		const dtNavMesh* getNavMesh() const { return m_navMesh; }
+	private:
+		const dtNavMesh* m_navMesh = nullptr;
+		std::vector<int> m_tileBase;
+		std::vector<dtPolyRef> m_refs;
+		std::vector<float> m_centers;
+		std::vector<int> m_adjOffsets;
+		std::vector<int> m_adj;
+		std::vector<float> m_adjCost;
+	};
+}
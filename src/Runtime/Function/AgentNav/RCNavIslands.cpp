@@ -0,0 +1,134 @@
+#include "RCNavIslands.h"
+#include <Function/AgentNav/RCNavGraph.h>
+#include <DetourCommon.h>
+#include <cfloat>
+
+namespace GU
+{
+	void RCNavIslands::build(const RCNavGraph& graph, const dtQueryFilter* const* filters, int nfilters)
+	{
+		clear();
+		m_graph = &graph;
+		const dtNavMesh* navMesh = graph.getNavMesh();
+		const int npolys = graph.getPolyCount();
+
+		std::vector<int> stack;
+		stack.reserve(npolys);
+		for (int f = 0; f < nfilters; f++)
+		{
+			const dtQueryFilter* filter = filters[f];
+			m_filters.push_back(filter);
+			std::vector<int> labels(npolys, -1);
+
+			// Polygons rejected by the filter keep label -1 and split islands.
+			std::vector<char> passable(npolys, 0);
+			for (int i = 0; i < npolys; i++)
+			{
+				const dtMeshTile* tile = 0;
+				const dtPoly* poly = 0;
+				navMesh->getTileAndPolyByRefUnsafe(graph.refAt(i), &tile, &poly);
+				passable[i] = filter->passFilter(graph.refAt(i), tile, poly) ? 1 : 0;
+			}
+
+			// Links of ground polygons are symmetric, so the graph is labelled as undirected.
+			int nislands = 0;
+			for (int seed = 0; seed < npolys; seed++)
+			{
+				if (!passable[seed] || labels[seed] != -1) continue;
+				labels[seed] = nislands;
+				stack.push_back(seed);
+				while (!stack.empty())
+				{
+					const int cur = stack.back();
+					stack.pop_back();
+					for (int k = graph.neighbourBegin(cur); k < graph.neighbourEnd(cur); k++)
+					{
+						const int nei = graph.neighbourAt(k);
+						if (!passable[nei] || labels[nei] != -1) continue;
+						labels[nei] = nislands;
+						stack.push_back(nei);
+					}
+				}
+				nislands++;
+			}
+
+			m_labels.push_back(std::move(labels));
+			m_islandCounts.push_back(nislands);
+		}
+	}
+
+	void RCNavIslands::clear()
+	{
+		m_graph = nullptr;
+		m_filters.clear();
+		m_labels.clear();
+		m_islandCounts.clear();
+	}
+
+	int RCNavIslands::getIsland(dtPolyRef ref, int filterIdx) const
+	{
+		if (m_graph == nullptr || filterIdx < 0 || filterIdx >= (int)m_labels.size()) return -1;
+		const int idx = m_graph->indexOf(ref);
+		if (idx < 0) return -1;
+		return m_labels[filterIdx][idx];
+	}
+
+	bool RCNavIslands::isReachable(dtPolyRef from, dtPolyRef to, int filterIdx) const
+	{
+		// Without labels nothing can be rejected.
+		if (m_graph == nullptr || filterIdx < 0 || filterIdx >= (int)m_labels.size()) return true;
+		const int a = getIsland(from, filterIdx);
+		const int b = getIsland(to, filterIdx);
+		return a != -1 && a == b;
+	}
+
+	bool RCNavIslands::findNearestOnIsland(const dtNavMeshQuery* navQuery, const float* pos, const float* halfExtents,
+		int island, int filterIdx, dtPolyRef* nearestRef, float* nearestPt) const
+	{
+		*nearestRef = 0;
+		if (m_graph == nullptr || island < 0 || filterIdx < 0 || filterIdx >= (int)m_labels.size()) return false;
+		const std::vector<int>& labels = m_labels[filterIdx];
+		const dtQueryFilter* filter = m_filters[filterIdx];
+
+		float bestDist = FLT_MAX;
+		auto consider = [&](dtPolyRef ref)
+		{
+			float closest[3];
+			if (dtStatusFailed(navQuery->closestPointOnPoly(ref, pos, closest, 0))) return;
+			const float d = dtVdistSqr(closest, pos);
+			if (d < bestDist)
+			{
+				bestDist = d;
+				*nearestRef = ref;
+				dtVcopy(nearestPt, closest);
+			}
+		};
+
+		static const int MAX_QUERY_POLYS = 128;
+		static const int MAX_GROW_STEPS = 6;
+		dtPolyRef polys[MAX_QUERY_POLYS];
+		float ext[3];
+		dtVcopy(ext, halfExtents);
+		for (int step = 0; step < MAX_GROW_STEPS && !*nearestRef; step++)
+		{
+			int npolys = 0;
+			navQuery->queryPolygons(pos, ext, filter, polys, &npolys, MAX_QUERY_POLYS);
+			for (int i = 0; i < npolys; i++)
+			{
+				const int idx = m_graph->indexOf(polys[i]);
+				if (idx >= 0 && labels[idx] == island)
+					consider(polys[i]);
+			}
+			ext[0] *= 2.0f;
+			ext[2] *= 2.0f;
+		}
+		if (*nearestRef) return true;
+
+		for (int i = 0; i < m_graph->getPolyCount(); i++)
+		{
+			if (labels[i] == island)
+				consider(m_graph->refAt(i));
+		}
+		return *nearestRef != 0;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+namespace GU
+{
+	class RCNavGraph;
+
+	// Connected component ("island") labels over the polygon graph, one label set
+	// per query filter. Lets path requests between islands be rejected in O(1)
+	// instead of exhausting the A* node pool.
+	class RCNavIslands
+	{
+	public:
+		RCNavIslands() = default;
+		~RCNavIslands() = default;
+
+		// The filters are kept by pointer for findNearestOnIsland and must outlive the labels.
+		void build(const RCNavGraph& graph, const dtQueryFilter* const* filters, int nfilters);
+		void clear();
+
+		int getFilterCount() const { return (int)m_filters.size(); }
+		int getIslandCount(int filterIdx) const { return m_islandCounts[filterIdx]; }
+		// Island of the polygon, -1 if it is invalid or rejected by the filter.
+		int getIsland(dtPolyRef ref, int filterIdx) const;
+		bool isReachable(dtPolyRef from, dtPolyRef to, int filterIdx) const;
+
+		// Nearest point to pos that lies on the given island. The search box grows from
+		// halfExtents until a polygon of the island is found, then falls back to a full scan.
+		bool findNearestOnIsland(const dtNavMeshQuery* navQuery, const float* pos, const float* halfExtents,
+			int island, int filterIdx, dtPolyRef* nearestRef, float* nearestPt) const;
+	private:
+		const RCNavGraph* m_graph = nullptr;
+		std::vector<const dtQueryFilter*> m_filters;
+		std::vector<std::vector<int> > m_labels;
+		std::vector<int> m_islandCounts;
+	};
+}
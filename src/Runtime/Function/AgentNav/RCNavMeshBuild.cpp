@@ -0,0 +1,201 @@
+#include "RCNavMeshBuild.h"
+#include <Function/AgentNav/RCScheduler.h>
+#include <Recast.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshBuilder.h>
+#include <DetourAlloc.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace GU
+{
+	RCBuildData::~RCBuildData()
+	{
+		rcFreeHeightField(solid);
+		rcFreeCompactHeightfield(chf);
+		rcFreeContourSet(cset);
+		rcFreePolyMesh(pmesh);
+		rcFreePolyMeshDetail(dmesh);
+	}
+
+	dtNavMesh* buildNavMesh(rcContext* ctx, const RCParams& rcparams,
+		const float* verts, int nverts, const int* tris, int ntris,
+		RCBuildData* data, const std::function<void()>& onStep)
+	{
+		if (ctx == nullptr || verts == nullptr || tris == nullptr || ntris <= 0) return nullptr;
+		RCBuildData localData;
+		RCBuildData& d = data ? *data : localData;
+		auto step = [&]() { if (onStep) onStep(); };
+
+		float bmin[3];
+		float bmax[3];
+		rcCalcBounds(verts, nverts, bmin, bmax);
+
+		rcConfig& cfg = d.cfg;
+		memset(&cfg, 0, sizeof(cfg));
+		cfg.cs = rcparams.m_cellSize;
+		cfg.ch = rcparams.m_cellHeight;
+		cfg.walkableSlopeAngle = rcparams.m_agentMaxSlope;
+		cfg.walkableHeight = (int)ceilf(rcparams.m_agentHeight / cfg.ch);
+		cfg.walkableClimb = (int)floorf(rcparams.m_agentMaxClimb / cfg.ch);
+		cfg.walkableRadius = (int)ceilf(rcparams.m_agentRadius / cfg.cs);
+		cfg.maxEdgeLen = (int)(rcparams.m_edgeMaxLen / rcparams.m_cellSize);
+		cfg.maxSimplificationError = rcparams.m_edgeMaxError;
+		cfg.minRegionArea = (int)rcSqr(rcparams.m_regionMinSize);
+		cfg.mergeRegionArea = (int)rcSqr(rcparams.m_regionMergeSize);
+		cfg.maxVertsPerPoly = (int)rcparams.m_vertsPerPoly;
+		cfg.detailSampleDist = rcparams.m_detailSampleDist < 0.9f ? 0 : rcparams.m_cellSize * rcparams.m_detailSampleDist;
+		cfg.detailSampleMaxError = rcparams.m_cellHeight * rcparams.m_detailSampleMaxError;
+		rcVcopy(cfg.bmin, bmin);
+		rcVcopy(cfg.bmax, bmax);
+		rcCalcGridSize(cfg.bmin, cfg.bmax, cfg.cs, &cfg.width, &cfg.height);
+		if (cfg.maxVertsPerPoly > DT_VERTS_PER_POLYGON)
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Too many verts per poly %d.", cfg.maxVertsPerPoly);
+			return nullptr;
+		}
+		ctx->log(RC_LOG_PROGRESS, "Building navigation:");
+		ctx->log(RC_LOG_PROGRESS, " - %d x %d cells", cfg.width, cfg.height);
+		ctx->log(RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts / 1000.0f, ntris / 1000.0f);
+		step();
+
+		// rasterize
+		d.solid = rcAllocHeightfield();
+		if (!d.solid || !rcCreateHeightfield(ctx, *d.solid, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not create solid heightfield.");
+			return nullptr;
+		}
+		std::vector<unsigned char> triareas(ntris, 0);
+		rcMarkWalkableTriangles(ctx, cfg.walkableSlopeAngle, verts, nverts, tris, ntris, triareas.data());
+		if (!rcRasterizeTriangles(ctx, verts, nverts, tris, triareas.data(), ntris, *d.solid, cfg.walkableClimb))
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not rasterize triangles.");
+			return nullptr;
+		}
+		step();
+
+		// filter walkable surfaces
+		if (rcparams.m_filterLowHangingObstacles)
+			rcFilterLowHangingWalkableObstacles(ctx, cfg.walkableClimb, *d.solid);
+		if (rcparams.m_filterLedgeSpans)
+			rcFilterLedgeSpans(ctx, cfg.walkableHeight, cfg.walkableClimb, *d.solid);
+		if (rcparams.m_filterWalkableLowHeightSpans)
+			rcFilterWalkableLowHeightSpans(ctx, cfg.walkableHeight, *d.solid);
+		step();
+
+		// regions
+		d.chf = rcAllocCompactHeightfield();
+		if (!d.chf || !rcBuildCompactHeightfield(ctx, cfg.walkableHeight, cfg.walkableClimb, *d.solid, *d.chf))
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not build compact data.");
+			return nullptr;
+		}
+		if (!rcErodeWalkableArea(ctx, cfg.walkableRadius, *d.chf))
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not erode.");
+			return nullptr;
+		}
+		bool regions = false;
+		if (rcparams.m_partitionType == RCScheduler::SAMPLE_PARTITION_WATERSHED)
+			regions = rcBuildDistanceField(ctx, *d.chf) && rcBuildRegions(ctx, *d.chf, 0, cfg.minRegionArea, cfg.mergeRegionArea);
+		else if (rcparams.m_partitionType == RCScheduler::SAMPLE_PARTITION_MONOTONE)
+			regions = rcBuildRegionsMonotone(ctx, *d.chf, 0, cfg.minRegionArea, cfg.mergeRegionArea);
+		else
+			regions = rcBuildLayerRegions(ctx, *d.chf, 0, cfg.minRegionArea);
+		if (!regions)
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not build regions.");
+			return nullptr;
+		}
+		step();
+
+		// contours and polygons
+		d.cset = rcAllocContourSet();
+		if (!d.cset || !rcBuildContours(ctx, *d.chf, cfg.maxSimplificationError, cfg.maxEdgeLen, *d.cset))
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not create contours.");
+			return nullptr;
+		}
+		step();
+		d.pmesh = rcAllocPolyMesh();
+		if (!d.pmesh || !rcBuildPolyMesh(ctx, *d.cset, cfg.maxVertsPerPoly, *d.pmesh))
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not triangulate contours.");
+			return nullptr;
+		}
+		step();
+		d.dmesh = rcAllocPolyMeshDetail();
+		if (!d.dmesh || !rcBuildPolyMeshDetail(ctx, *d.pmesh, *d.chf, cfg.detailSampleDist, cfg.detailSampleMaxError, *d.dmesh))
+		{
+			ctx->log(RC_LOG_ERROR, "buildNavMesh: Could not build detail mesh.");
+			return nullptr;
+		}
+
+		// areas to the flags of the default query filters
+		rcPolyMesh* pmesh = d.pmesh;
+		for (int i = 0; i < pmesh->npolys; ++i)
+		{
+			if (pmesh->areas[i] == RC_WALKABLE_AREA)
+				pmesh->areas[i] = RCScheduler::SAMPLE_POLYAREA_GROUND;
+
+			if (pmesh->areas[i] == RCScheduler::SAMPLE_POLYAREA_GROUND ||
+				pmesh->areas[i] == RCScheduler::SAMPLE_POLYAREA_GRASS ||
+				pmesh->areas[i] == RCScheduler::SAMPLE_POLYAREA_ROAD)
+				pmesh->flags[i] = RCScheduler::SAMPLE_POLYFLAGS_WALK;
+			else if (pmesh->areas[i] == RCScheduler::SAMPLE_POLYAREA_WATER)
+				pmesh->flags[i] = RCScheduler::SAMPLE_POLYFLAGS_SWIM;
+			else if (pmesh->areas[i] == RCScheduler::SAMPLE_POLYAREA_DOOR)
+				pmesh->flags[i] = RCScheduler::SAMPLE_POLYFLAGS_WALK | RCScheduler::SAMPLE_POLYFLAGS_DOOR;
+		}
+
+		dtNavMeshCreateParams params;
+		memset(&params, 0, sizeof(params));
+		params.verts = pmesh->verts;
+		params.vertCount = pmesh->nverts;
+		params.polys = pmesh->polys;
+		params.polyAreas = pmesh->areas;
+		params.polyFlags = pmesh->flags;
+		params.polyCount = pmesh->npolys;
+		params.nvp = pmesh->nvp;
+		params.detailMeshes = d.dmesh->meshes;
+		params.detailVerts = d.dmesh->verts;
+		params.detailVertsCount = d.dmesh->nverts;
+		params.detailTris = d.dmesh->tris;
+		params.detailTriCount = d.dmesh->ntris;
+		params.walkableHeight = rcparams.m_agentHeight;
+		params.walkableRadius = rcparams.m_agentRadius;
+		params.walkableClimb = rcparams.m_agentMaxClimb;
+		rcVcopy(params.bmin, pmesh->bmin);
+		rcVcopy(params.bmax, pmesh->bmax);
+		params.cs = cfg.cs;
+		params.ch = cfg.ch;
+		params.buildBvTree = true;
+
+		unsigned char* navData = 0;
+		int navDataSize = 0;
+		if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
+		{
+			ctx->log(RC_LOG_ERROR, "Could not build Detour navmesh.");
+			return nullptr;
+		}
+
+		dtNavMesh* navMesh = dtAllocNavMesh();
+		if (!navMesh)
+		{
+			dtFree(navData);
+			ctx->log(RC_LOG_ERROR, "Could not create Detour navmesh");
+			return nullptr;
+		}
+		if (dtStatusFailed(navMesh->init(navData, navDataSize, DT_TILE_FREE_DATA)))
+		{
+			dtFree(navData);
+			dtFreeNavMesh(navMesh);
+			ctx->log(RC_LOG_ERROR, "Could not init Detour navmesh");
+			return nullptr;
+		}
+		step();
+		return navMesh;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <functional>
+#include <Recast.h>
+#include <Function/AgentNav/RCParams.h>
+class dtNavMesh;
+
+namespace GU
+{
+	// Intermediate Recast results of a build, freed with the struct unless released.
+	struct RCBuildData
+	{
+		rcConfig cfg;
+		rcHeightfield* solid = nullptr;
+		rcCompactHeightfield* chf = nullptr;
+		rcContourSet* cset = nullptr;
+		rcPolyMesh* pmesh = nullptr;
+		rcPolyMeshDetail* dmesh = nullptr;
+
+		RCBuildData() = default;
+		~RCBuildData();
+		RCBuildData(const RCBuildData&) = delete;
+		RCBuildData& operator=(const RCBuildData&) = delete;
+	};
+	const int NAVMESH_BUILD_STEPS = 7;
+
+	// Single tile navmesh build of the editor and the tools. data, when given, receives
+	// the intermediate results, and onStep runs after each of the NAVMESH_BUILD_STEPS
+	// steps. Returns nullptr on failure, free with dtFreeNavMesh.
+	dtNavMesh* buildNavMesh(rcContext* ctx, const RCParams& rcparams,
+		const float* verts, int nverts, const int* tris, int ntris,
+		RCBuildData* data = nullptr, const std::function<void()>& onStep = nullptr);
+}
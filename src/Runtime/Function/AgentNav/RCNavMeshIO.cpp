@@ -0,0 +1,89 @@
+#include "RCNavMeshIO.h"
+#include <DetourNavMesh.h>
+#include <DetourAlloc.h>
+#include <fstream>
+
+namespace GU
+{
+	static const int NAVMESHSET_MAGIC = 'M' << 24 | 'S' << 16 | 'E' << 8 | 'T';
+	static const int NAVMESHSET_VERSION = 1;
+
+	struct NavMeshSetHeader
+	{
+		int magic;
+		int version;
+		int numTiles;
+		dtNavMeshParams params;
+	};
+
+	struct NavMeshTileHeader
+	{
+		dtTileRef tileRef;
+		int dataSize;
+	};
+
+	bool saveNavMesh(const std::filesystem::path& filepath, const dtNavMesh* navMesh)
+	{
+		if (navMesh == nullptr) return false;
+		std::ofstream fout(filepath, std::ios::binary);
+		if (!fout.is_open()) return false;
+
+		NavMeshSetHeader header;
+		header.magic = NAVMESHSET_MAGIC;
+		header.version = NAVMESHSET_VERSION;
+		header.numTiles = 0;
+		for (int i = 0; i < navMesh->getMaxTiles(); i++)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (tile && tile->header && tile->dataSize) header.numTiles++;
+		}
+		header.params = *navMesh->getParams();
+		fout.write((const char*)&header, sizeof(header));
+
+		for (int i = 0; i < navMesh->getMaxTiles(); i++)
+		{
+			const dtMeshTile* tile = navMesh->getTile(i);
+			if (!tile || !tile->header || !tile->dataSize) continue;
+			NavMeshTileHeader tileHeader;
+			tileHeader.tileRef = navMesh->getTileRef(tile);
+			tileHeader.dataSize = tile->dataSize;
+			fout.write((const char*)&tileHeader, sizeof(tileHeader));
+			fout.write((const char*)tile->data, tile->dataSize);
+		}
+		return fout.good();
+	}
+
+	dtNavMesh* loadNavMesh(const std::filesystem::path& filepath)
+	{
+		std::ifstream fin(filepath, std::ios::binary);
+		if (!fin.is_open()) return nullptr;
+
+		NavMeshSetHeader header;
+		if (!fin.read((char*)&header, sizeof(header))) return nullptr;
+		if (header.magic != NAVMESHSET_MAGIC || header.version != NAVMESHSET_VERSION) return nullptr;
+
+		dtNavMesh* navMesh = dtAllocNavMesh();
+		if (navMesh == nullptr) return nullptr;
+		if (dtStatusFailed(navMesh->init(&header.params)))
+		{
+			dtFreeNavMesh(navMesh);
+			return nullptr;
+		}
+
+		for (int i = 0; i < header.numTiles; i++)
+		{
+			NavMeshTileHeader tileHeader;
+			if (!fin.read((char*)&tileHeader, sizeof(tileHeader)) || tileHeader.dataSize <= 0)
+				break;
+			unsigned char* data = (unsigned char*)dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM);
+			if (data == nullptr) break;
+			if (!fin.read((char*)data, tileHeader.dataSize))
+			{
+				dtFree(data);
+				break;
+			}
+			navMesh->addTile(data, tileHeader.dataSize, DT_TILE_FREE_DATA, tileHeader.tileRef, 0);
+		}
+		return navMesh;
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <filesystem>
+class dtNavMesh;
+
+namespace GU
+{
+	// Binary navmesh file, same layout as the Recast demo "MSET" files:
+	// header with dtNavMeshParams, then every tile's data blob.
+	bool saveNavMesh(const std::filesystem::path& filepath, const dtNavMesh* navMesh);
+	// Returns a new navmesh owning its tile data, nullptr on failure. Free with dtFreeNavMesh.
+	dtNavMesh* loadNavMesh(const std::filesystem::path& filepath);
+}
@@ -0,0 +1,221 @@
+#include "RCNavSampler.h"
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Core/ParallelFor.h>
+#include <DetourCommon.h>
+#include <algorithm>
+#include <cmath>
+
+namespace GU
+{
+	static const int MAX_SAMPLE_ATTEMPTS = 32;
+
+	static inline uint64_t splitMix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	static inline float randFloat(uint64_t& state)
+	{
+		return (float)(splitMix64(state) >> 40) * (1.0f / 16777216.0f);
+	}
+
+	static void getPolyVerts(const dtNavMesh* navMesh, dtPolyRef ref, const dtPoly** poly, const float** verts)
+	{
+		const dtMeshTile* tile = 0;
+		navMesh->getTileAndPolyByRefUnsafe(ref, &tile, poly);
+		*verts = tile->verts;
+	}
+
+	void RCNavSampler::build(const RCNavGraph& graph, const dtNavMeshQuery* navQuery, const dtQueryFilter* filter)
+	{
+		clear();
+		m_graph = &graph;
+		m_navQuery = navQuery;
+		const dtNavMesh* navMesh = graph.getNavMesh();
+		const int npolys = graph.getPolyCount();
+		m_cdf.resize(npolys);
+		m_areaTypes.resize(npolys);
+
+		float total = 0.0f;
+		for (int i = 0; i < npolys; i++)
+		{
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			navMesh->getTileAndPolyByRefUnsafe(graph.refAt(i), &tile, &poly);
+			m_areaTypes[i] = poly->getArea();
+			if (poly->getType() == DT_POLYTYPE_GROUND && filter->passFilter(graph.refAt(i), tile, poly))
+			{
+				const float* va = &tile->verts[poly->verts[0] * 3];
+				for (int j = 2; j < poly->vertCount; j++)
+				{
+					const float* vb = &tile->verts[poly->verts[j - 1] * 3];
+					const float* vc = &tile->verts[poly->verts[j] * 3];
+					total += dtAbs(dtTriArea2D(va, vb, vc));
+				}
+			}
+			m_cdf[i] = total;
+		}
+	}
+
+	void RCNavSampler::clear()
+	{
+		m_graph = nullptr;
+		m_navQuery = nullptr;
+		m_cdf.clear();
+		m_areaTypes.clear();
+	}
+
+	bool RCNavSampler::isInside(const RCNavSampleQuery& query, const float* pos) const
+	{
+		if (query.hasRegion)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				if (pos[k] < query.regionMin[k] || pos[k] > query.regionMax[k]) return false;
+			}
+		}
+		if (query.radius > 0.0f && dtVdist2DSqr(pos, query.center) > dtSqr(query.radius))
+			return false;
+		return true;
+	}
+
+	bool RCNavSampler::overlaps(const RCNavSampleQuery& query, int idx) const
+	{
+		if (!(query.areaMask & (1ull << m_areaTypes[idx]))) return false;
+		if (!query.hasRegion && query.radius <= 0.0f) return true;
+
+		const dtPoly* poly = 0;
+		const float* verts = 0;
+		getPolyVerts(m_graph->getNavMesh(), m_graph->refAt(idx), &poly, &verts);
+		float bmin[3], bmax[3];
+		dtVcopy(bmin, &verts[poly->verts[0] * 3]);
+		dtVcopy(bmax, bmin);
+		for (int j = 1; j < poly->vertCount; j++)
+		{
+			dtVmin(bmin, &verts[poly->verts[j] * 3]);
+			dtVmax(bmax, &verts[poly->verts[j] * 3]);
+		}
+		if (query.hasRegion && !dtOverlapBounds(bmin, bmax, query.regionMin, query.regionMax))
+			return false;
+		if (query.radius > 0.0f)
+		{
+			const float dx = dtMax(bmin[0] - query.center[0], dtMax(0.0f, query.center[0] - bmax[0]));
+			const float dz = dtMax(bmin[2] - query.center[2], dtMax(0.0f, query.center[2] - bmax[2]));
+			if (dx * dx + dz * dz > dtSqr(query.radius)) return false;
+		}
+		return true;
+	}
+
+	void RCNavSampler::samplePoly(int idx, uint64_t& state, float* pos) const
+	{
+		const dtPolyRef ref = m_graph->refAt(idx);
+		const dtPoly* poly = 0;
+		const float* verts = 0;
+		getPolyVerts(m_graph->getNavMesh(), ref, &poly, &verts);
+
+		// pick a fan triangle by area, then a uniform point inside it
+		float areas[DT_VERTS_PER_POLYGON];
+		float areaSum = 0.0f;
+		const float* va = &verts[poly->verts[0] * 3];
+		for (int j = 2; j < poly->vertCount; j++)
+		{
+			areas[j] = dtAbs(dtTriArea2D(va, &verts[poly->verts[j - 1] * 3], &verts[poly->verts[j] * 3]));
+			areaSum += areas[j];
+		}
+		const float thr = randFloat(state) * areaSum;
+		int tri = poly->vertCount - 1;
+		float acc = 0.0f;
+		for (int j = 2; j < poly->vertCount; j++)
+		{
+			acc += areas[j];
+			if (thr < acc)
+			{
+				tri = j;
+				break;
+			}
+		}
+		const float* vb = &verts[poly->verts[tri - 1] * 3];
+		const float* vc = &verts[poly->verts[tri] * 3];
+		const float s = sqrtf(randFloat(state));
+		const float t = randFloat(state);
+		const float a = 1.0f - s;
+		const float b = (1.0f - t) * s;
+		const float c = t * s;
+		for (int k = 0; k < 3; k++)
+			pos[k] = a * va[k] + b * vb[k] + c * vc[k];
+
+		// the polygon is flat, the detail mesh has the real surface height
+		float h = 0.0f;
+		if (m_navQuery && dtStatusSucceed(m_navQuery->getPolyHeight(ref, pos, &h)))
+			pos[1] = h;
+	}
+
+	int RCNavSampler::sample(const RCNavSampleQuery& query, int count, uint64_t seed,
+		float* outPos, dtPolyRef* outRefs, ThreadPool* pool) const
+	{
+		if (m_graph == nullptr || count <= 0 || getTotalArea() <= 0.0f) return 0;
+
+		// restricted queries get their own CDF over the polygons that can satisfy them
+		const bool isRestricted = query.areaMask != ~0ull || query.hasRegion || query.radius > 0.0f;
+		std::vector<int> candidates;
+		std::vector<float> localCdf;
+		const std::vector<float>* cdf = &m_cdf;
+		if (isRestricted)
+		{
+			float total = 0.0f;
+			for (int i = 0; i < (int)m_cdf.size(); i++)
+			{
+				const float area = m_cdf[i] - (i ? m_cdf[i - 1] : 0.0f);
+				if (area <= 0.0f || !overlaps(query, i)) continue;
+				total += area;
+				candidates.push_back(i);
+				localCdf.push_back(total);
+			}
+			cdf = &localCdf;
+		}
+		if (cdf->empty() || cdf->back() <= 0.0f) return 0;
+
+		const int attempts = isRestricted ? MAX_SAMPLE_ATTEMPTS : 1;
+		std::vector<char> found(count, 0);
+		parallelFor(pool, count, MAX_WORKERS, [&](int, int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				uint64_t state = seed + (uint64_t)i * 0xd1b54a32d192ed03ull;
+				float* pos = &outPos[i * 3];
+				for (int attempt = 0; attempt < attempts; attempt++)
+				{
+					const float r = randFloat(state) * cdf->back();
+					int k = (int)(std::upper_bound(cdf->begin(), cdf->end(), r) - cdf->begin());
+					k = std::min(k, (int)cdf->size() - 1);
+					const int idx = isRestricted ? candidates[k] : k;
+					samplePoly(idx, state, pos);
+					if (!isRestricted || isInside(query, pos))
+					{
+						outRefs[i] = m_graph->refAt(idx);
+						found[i] = 1;
+						break;
+					}
+				}
+			}
+		});
+
+		// keep the points in index order so the output only depends on the seed
+		int n = 0;
+		for (int i = 0; i < count; i++)
+		{
+			if (!found[i]) continue;
+			if (n != i)
+			{
+				dtVcopy(&outPos[n * 3], &outPos[i * 3]);
+				outRefs[n] = outRefs[i];
+			}
+			n++;
+		}
+		return n;
+	}
+}
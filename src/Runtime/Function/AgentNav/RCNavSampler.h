@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+class ThreadPool;
+
+namespace GU
+{
+	class RCNavGraph;
+
+	// Optional restrictions for RCNavSampler::sample.
+	struct RCNavSampleQuery
+	{
+		// bit i allows polygons with area type i
+		uint64_t areaMask = ~0ull;
+		// axis aligned region
+		bool hasRegion = false;
+		float regionMin[3] = {};
+		float regionMax[3] = {};
+		// circle on the xz plane, ignored when radius <= 0
+		float center[3] = {};
+		float radius = 0.0f;
+	};
+
+	// Uniformly distributed random points on the navmesh. Polygons are picked through
+	// an area-weighted CDF built once per navmesh build. Every point draws from its own
+	// stream derived from (seed, index), so results do not depend on the thread count.
+	class RCNavSampler
+	{
+	public:
+		RCNavSampler() = default;
+		~RCNavSampler() = default;
+
+		// navQuery is only used for getPolyHeight, which is safe to call concurrently.
+		void build(const RCNavGraph& graph, const dtNavMeshQuery* navQuery, const dtQueryFilter* filter);
+		void clear();
+		float getTotalArea() const { return m_cdf.empty() ? 0.0f : m_cdf.back(); }
+
+		// Writes up to count points (3 floats each) and their polygons, returns how many
+		// were found. Restricted queries may return fewer when the region is mostly off mesh.
+		int sample(const RCNavSampleQuery& query, int count, uint64_t seed,
+			float* outPos, dtPolyRef* outRefs, ThreadPool* pool = nullptr) const;
+	private:
+		bool isInside(const RCNavSampleQuery& query, const float* pos) const;
+		bool overlaps(const RCNavSampleQuery& query, int idx) const;
+		void samplePoly(int idx, uint64_t& state, float* pos) const;
+
+		const RCNavGraph* m_graph = nullptr;
+		const dtNavMeshQuery* m_navQuery = nullptr;
+		std::vector<float> m_cdf;
+		std::vector<unsigned char> m_areaTypes;
+	};
+}
@@ -0,0 +1,194 @@
+#include "RCNavSnapGrid.h"
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Core/ParallelFor.h>
+#include <DetourCommon.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace GU
+{
+	// keeps the grid bounded on very large, sparse meshes
+	static const int MAX_GRID_CELLS = 1 << 20;
+
+	void RCNavSnapGrid::build(const RCNavGraph& graph, const dtNavMeshQuery* navQuery, float cellSize)
+	{
+		clear();
+		m_graph = &graph;
+		m_navQuery = navQuery;
+		const dtNavMesh* navMesh = graph.getNavMesh();
+		const int npolys = graph.getPolyCount();
+		if (npolys == 0) return;
+
+		float bmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float bmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float extentSum = 0.0f;
+		m_bounds.resize(npolys * 6);
+		for (int i = 0; i < npolys; i++)
+		{
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			navMesh->getTileAndPolyByRefUnsafe(graph.refAt(i), &tile, &poly);
+			float* pmin = &m_bounds[i * 6];
+			float* pmax = &m_bounds[i * 6 + 3];
+			dtVcopy(pmin, &tile->verts[poly->verts[0] * 3]);
+			dtVcopy(pmax, pmin);
+			for (int j = 1; j < poly->vertCount; j++)
+			{
+				dtVmin(pmin, &tile->verts[poly->verts[j] * 3]);
+				dtVmax(pmax, &tile->verts[poly->verts[j] * 3]);
+			}
+			dtVmin(bmin, pmin);
+			dtVmax(bmax, pmax);
+			extentSum += dtMax(pmax[0] - pmin[0], pmax[2] - pmin[2]);
+		}
+
+		if (cellSize <= 0.0f)
+			cellSize = dtMax(2.0f * extentSum / (float)npolys, 0.01f);
+		const float sizeX = bmax[0] - bmin[0];
+		const float sizeZ = bmax[2] - bmin[2];
+		while ((sizeX / cellSize + 1.0f) * (sizeZ / cellSize + 1.0f) > (float)MAX_GRID_CELLS)
+			cellSize *= 2.0f;
+
+		m_cellSize = cellSize;
+		m_origin[0] = bmin[0];
+		m_origin[1] = bmin[2];
+		m_width = (int)(sizeX / cellSize) + 1;
+		m_height = (int)(sizeZ / cellSize) + 1;
+
+		// two passes, count then fill
+		auto cellRange = [&](int i, int& x0, int& z0, int& x1, int& z1)
+		{
+			const float* pmin = &m_bounds[i * 6];
+			const float* pmax = &m_bounds[i * 6 + 3];
+			x0 = dtClamp((int)((pmin[0] - m_origin[0]) / m_cellSize), 0, m_width - 1);
+			z0 = dtClamp((int)((pmin[2] - m_origin[1]) / m_cellSize), 0, m_height - 1);
+			x1 = dtClamp((int)((pmax[0] - m_origin[0]) / m_cellSize), 0, m_width - 1);
+			z1 = dtClamp((int)((pmax[2] - m_origin[1]) / m_cellSize), 0, m_height - 1);
+		};
+		auto isGround = [&](int i)
+		{
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			navMesh->getTileAndPolyByRefUnsafe(graph.refAt(i), &tile, &poly);
+			return poly->getType() == DT_POLYTYPE_GROUND;
+		};
+
+		m_cellOffsets.assign(m_width * m_height + 1, 0);
+		for (int i = 0; i < npolys; i++)
+		{
+			if (!isGround(i)) continue;
+			int x0, z0, x1, z1;
+			cellRange(i, x0, z0, x1, z1);
+			for (int z = z0; z <= z1; z++)
+				for (int x = x0; x <= x1; x++)
+					m_cellOffsets[z * m_width + x + 1]++;
+		}
+		for (int c = 0; c < m_width * m_height; c++)
+			m_cellOffsets[c + 1] += m_cellOffsets[c];
+		m_cellPolys.resize(m_cellOffsets.back());
+		std::vector<int> fill(m_cellOffsets.begin(), m_cellOffsets.end() - 1);
+		for (int i = 0; i < npolys; i++)
+		{
+			if (!isGround(i)) continue;
+			int x0, z0, x1, z1;
+			cellRange(i, x0, z0, x1, z1);
+			for (int z = z0; z <= z1; z++)
+				for (int x = x0; x <= x1; x++)
+					m_cellPolys[fill[z * m_width + x]++] = i;
+		}
+	}
+
+	void RCNavSnapGrid::clear()
+	{
+		m_graph = nullptr;
+		m_navQuery = nullptr;
+		m_cellSize = 0.0f;
+		m_width = m_height = 0;
+		m_bounds.clear();
+		m_cellOffsets.clear();
+		m_cellPolys.clear();
+	}
+
+	bool RCNavSnapGrid::findNearestPoly(const float* center, const float* halfExtents, const dtQueryFilter* filter,
+		dtPolyRef* nearestRef, float* nearestPt) const
+	{
+		*nearestRef = 0;
+		if (m_graph == nullptr || m_width == 0) return false;
+
+		float qmin[3], qmax[3];
+		dtVsub(qmin, center, halfExtents);
+		dtVadd(qmax, center, halfExtents);
+		const int x0 = (int)floorf((qmin[0] - m_origin[0]) / m_cellSize);
+		const int z0 = (int)floorf((qmin[2] - m_origin[1]) / m_cellSize);
+		const int x1 = (int)floorf((qmax[0] - m_origin[0]) / m_cellSize);
+		const int z1 = (int)floorf((qmax[2] - m_origin[1]) / m_cellSize);
+		if (x1 < 0 || z1 < 0 || x0 >= m_width || z0 >= m_height) return false;
+
+		const dtNavMesh* navMesh = m_graph->getNavMesh();
+		float nearestDistSqr = FLT_MAX;
+		for (int z = dtMax(z0, 0); z <= dtMin(z1, m_height - 1); z++)
+		{
+			for (int x = dtMax(x0, 0); x <= dtMin(x1, m_width - 1); x++)
+			{
+				const int cell = z * m_width + x;
+				for (int k = m_cellOffsets[cell]; k < m_cellOffsets[cell + 1]; k++)
+				{
+					const int idx = m_cellPolys[k];
+					if (!dtOverlapBounds(qmin, qmax, &m_bounds[idx * 6], &m_bounds[idx * 6 + 3]))
+						continue;
+					const dtPolyRef ref = m_graph->refAt(idx);
+					const dtMeshTile* tile = 0;
+					const dtPoly* poly = 0;
+					navMesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+					if (!filter->passFilter(ref, tile, poly))
+						continue;
+
+					float closest[3];
+					bool posOverPoly = false;
+					m_navQuery->closestPointOnPoly(ref, center, closest, &posOverPoly);
+
+					// Same rule as findNearestPoly: a polygon right below within climb height wins.
+					float diff[3];
+					dtVsub(diff, center, closest);
+					float d;
+					if (posOverPoly)
+					{
+						d = dtAbs(diff[1]) - tile->header->walkableClimb;
+						d = d > 0 ? d * d : 0;
+					}
+					else
+					{
+						d = dtVlenSqr(diff);
+					}
+					if (d < nearestDistSqr)
+					{
+						nearestDistSqr = d;
+						*nearestRef = ref;
+						if (nearestPt) dtVcopy(nearestPt, closest);
+					}
+				}
+			}
+		}
+		return *nearestRef != 0;
+	}
+
+	int RCNavSnapGrid::findNearestPolyBatch(const float* centers, int n, const float* halfExtents, const dtQueryFilter* filter,
+		dtPolyRef* nearestRefs, float* nearestPts, ThreadPool* pool) const
+	{
+		int hits[MAX_WORKERS] = {};
+		parallelFor(pool, n, MAX_WORKERS, [&](int chunk, int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				if (findNearestPoly(&centers[i * 3], halfExtents, filter, &nearestRefs[i], nearestPts ? &nearestPts[i * 3] : nullptr))
+					hits[chunk]++;
+			}
+		});
+		int total = 0;
+		for (int i = 0; i < MAX_WORKERS; i++)
+			total += hits[i];
+		return total;
+	}
+}
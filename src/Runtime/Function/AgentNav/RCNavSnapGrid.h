@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+class ThreadPool;
+
+namespace GU
+{
+	class RCNavGraph;
+
+	// Coarse xz grid mapping cells to the polygons overlapping them. Replaces the BV
+	// tree walk of dtNavMeshQuery::findNearestPoly with a lookup of a few cells, and
+	// picks the nearest polygon with the same rules as Detour. Read only after build,
+	// so queries can run on any number of threads.
+	class RCNavSnapGrid
+	{
+	public:
+		RCNavSnapGrid() = default;
+		~RCNavSnapGrid() = default;
+
+		// cellSize <= 0 picks about two average polygon widths
+		void build(const RCNavGraph& graph, const dtNavMeshQuery* navQuery, float cellSize = 0.0f);
+		void clear();
+		int getCellCount() const { return m_width * m_height; }
+		float getCellSize() const { return m_cellSize; }
+
+		bool findNearestPoly(const float* center, const float* halfExtents, const dtQueryFilter* filter,
+			dtPolyRef* nearestRef, float* nearestPt) const;
+		// n queries, 3 floats per position. nearestPts may be null. Misses get ref 0,
+		// returns the number of hits.
+		int findNearestPolyBatch(const float* centers, int n, const float* halfExtents, const dtQueryFilter* filter,
+			dtPolyRef* nearestRefs, float* nearestPts, ThreadPool* pool = nullptr) const;
+	private:
+		const RCNavGraph* m_graph = nullptr;
+		const dtNavMeshQuery* m_navQuery = nullptr;
+		float m_origin[2] = {};
+		float m_cellSize = 0.0f;
+		int m_width = 0;
+		int m_height = 0;
+		std::vector<float> m_bounds;		// bmin, bmax per polygon
+		std::vector<int> m_cellOffsets;
+		std::vector<int> m_cellPolys;
+	};
+}
@@ -24,6 +24,45 @@ namespace GU
 		bool m_keepInterResults;
 	};
 	const int MAX_AGENTS = 650;
+	// sharded crowd
+	const int MAX_CROWD_AGENTS = 50000;
+	const int CROWD_SHARDS_X = 4;
+	const int CROWD_SHARDS_Z = 4;
+	// fixed timestep simulation thread
+	const float SIM_TICK_RATE = 60.0f;
+	const int SIM_MAX_CATCHUP_STEPS = 4;
+	// wall milliseconds of ticking per frame or simulation thread wake up above real time
+	const float SIM_CPU_BUDGET_MS = 12.0f;
+	const float SIM_MAX_TIME_SCALE = 1000.0f;
 	const int MAX_SMOOTH = 2048;
 	const int MAX_POLYS = 256;
+	const int MAX_WORKERS = 8;
+	const int NUM_LANDMARKS = 8;
+	const int HIERARCHY_CLUSTER_SIZE = 64;
+	// crowd requests refine this many abstract segments up front and the next one once
+	// fewer than HIERARCHY_EXTEND_POLYS polygons of the corridor are left
+	const int HIERARCHY_REFINE_SEGMENTS = 2;
+	const int HIERARCHY_EXTEND_POLYS = 16;
+	const int RAY_PACKET_SIZE = 16;
+	// agents closer than this to their target are removed
+	const float AGENT_ARRIVE_RADIUS = 1.5f;
+	// agents heading for a target below this speed for this many seconds are stuck
+	const float AGENT_STUCK_SPEED = 0.1f;
+	const float AGENT_STUCK_TIME = 5.0f;
+	// density grid, cell size in meters and alert threshold in agents per square meter
+	const float DENSITY_CELL_SIZE = 2.0f;
+	const float DENSITY_PEAK = 4.0f;
+	// crowd path requests per tick, 0 turns a limit off. The node limit keeps runs
+	// reproducible, the wall time limit depends on the machine and is opt-in.
+	const float REPLAN_BUDGET_MS = 0.0f;
+	const int REPLAN_BUDGET_NODES = 2000;
+	// agent groups: followers stand GROUP_SPACING apart and close a gap to their slot in
+	// GROUP_CATCHUP_TIME seconds. The leader walks at GROUP_LEADER_SPEED of its max speed
+	// and slows down further while a follower lags more than GROUP_MAX_LAG meters. A
+	// follower whose slot moved GROUP_REJOIN_DIST away from its corridor plans a path back.
+	const float GROUP_SPACING = 1.5f;
+	const float GROUP_CATCHUP_TIME = 1.0f;
+	const float GROUP_LEADER_SPEED = 0.8f;
+	const float GROUP_MAX_LAG = 3.0f;
+	const float GROUP_REJOIN_DIST = 2.0f;
 }
\ No newline at end of file
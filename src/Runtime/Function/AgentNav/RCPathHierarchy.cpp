@@ -0,0 +1,312 @@
+#include "RCPathHierarchy.h"
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCPathSearch.h>
+#include <DetourCommon.h>
+#include <cfloat>
+#include <queue>
+#include <functional>
+#include <unordered_map>
+
+namespace GU
+{
+	static void groupByKey(const std::vector<int>& keys, int nkeys, std::vector<int>& offsets, std::vector<int>& items)
+	{
+		offsets.assign(nkeys + 1, 0);
+		for (int key : keys)
+		{
+			if (key >= 0) offsets[key + 1]++;
+		}
+		for (int i = 0; i < nkeys; i++)
+			offsets[i + 1] += offsets[i];
+		items.resize(offsets[nkeys]);
+		std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < (int)keys.size(); i++)
+		{
+			if (keys[i] >= 0) items[fill[keys[i]]++] = i;
+		}
+	}
+
+	void RCPathHierarchy::build(const RCNavGraph& graph, const dtQueryFilter* filter, int clusterSize)
+	{
+		clear();
+		m_graph = &graph;
+		const dtNavMesh* navMesh = graph.getNavMesh();
+		const int npolys = graph.getPolyCount();
+
+		std::vector<char> passable(npolys, 0);
+		for (int i = 0; i < npolys; i++)
+		{
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			navMesh->getTileAndPolyByRefUnsafe(graph.refAt(i), &tile, &poly);
+			passable[i] = filter->passFilter(graph.refAt(i), tile, poly) ? 1 : 0;
+		}
+
+		// Grow clusters breadth first, which keeps them compact.
+		m_cluster.assign(npolys, -1);
+		std::vector<int> queue;
+		for (int seed = 0; seed < npolys; seed++)
+		{
+			if (!passable[seed] || m_cluster[seed] != -1) continue;
+			const int id = m_nclusters++;
+			queue.clear();
+			queue.push_back(seed);
+			m_cluster[seed] = id;
+			for (size_t head = 0; head < queue.size() && (int)queue.size() < clusterSize; head++)
+			{
+				const int cur = queue[head];
+				for (int k = graph.neighbourBegin(cur); k < graph.neighbourEnd(cur) && (int)queue.size() < clusterSize; k++)
+				{
+					const int nei = graph.neighbourAt(k);
+					if (!passable[nei] || m_cluster[nei] != -1) continue;
+					m_cluster[nei] = id;
+					queue.push_back(nei);
+				}
+			}
+		}
+		groupByKey(m_cluster, m_nclusters, m_clusterOffsets, m_clusterPolys);
+
+		// Polygons touching another cluster are the portals.
+		m_portalOf.assign(npolys, -1);
+		std::vector<int> portalCluster;
+		for (int i = 0; i < npolys; i++)
+		{
+			if (m_cluster[i] < 0) continue;
+			for (int k = graph.neighbourBegin(i); k < graph.neighbourEnd(i); k++)
+			{
+				const int nei = graph.neighbourAt(k);
+				if (m_cluster[nei] >= 0 && m_cluster[nei] != m_cluster[i])
+				{
+					m_portalOf[i] = (int)m_portalPoly.size();
+					m_portalPoly.push_back(i);
+					portalCluster.push_back(m_cluster[i]);
+					break;
+				}
+			}
+		}
+		groupByKey(portalCluster, m_nclusters, m_clusterPortalOffsets, m_clusterPortals);
+
+		const int nportals = (int)m_portalPoly.size();
+		m_edgeOffsets.assign(nportals + 1, 0);
+		std::vector<std::pair<int, float> > reached;
+		for (int i = 0; i < nportals; i++)
+		{
+			const int poly = m_portalPoly[i];
+			const int cluster = m_cluster[poly];
+
+			// Crossing into the neighbour cluster.
+			for (int k = graph.neighbourBegin(poly); k < graph.neighbourEnd(poly); k++)
+			{
+				const int nei = graph.neighbourAt(k);
+				if (m_cluster[nei] >= 0 && m_cluster[nei] != cluster && m_portalOf[nei] >= 0)
+				{
+					m_edgeTo.push_back(m_portalOf[nei]);
+					m_edgeCost.push_back(graph.edgeCostAt(k));
+				}
+			}
+
+			// Travelling through the own cluster to its other portals.
+			clusterDijkstra(poly, reached);
+			for (const auto& r : reached)
+			{
+				const int portal = m_portalOf[r.first];
+				if (portal < 0 || portal == i) continue;
+				m_edgeTo.push_back(portal);
+				m_edgeCost.push_back(r.second);
+			}
+			m_edgeOffsets[i + 1] = (int)m_edgeTo.size();
+		}
+	}
+
+	void RCPathHierarchy::clear()
+	{
+		m_graph = nullptr;
+		m_nclusters = 0;
+		m_cluster.clear();
+		m_clusterPolys.clear();
+		m_clusterOffsets.clear();
+		m_portalOf.clear();
+		m_portalPoly.clear();
+		m_clusterPortalOffsets.clear();
+		m_clusterPortals.clear();
+		m_edgeOffsets.clear();
+		m_edgeTo.clear();
+		m_edgeCost.clear();
+	}
+
+	int RCPathHierarchy::getCluster(dtPolyRef ref) const
+	{
+		if (m_graph == nullptr) return -1;
+		const int idx = m_graph->indexOf(ref);
+		return idx < 0 ? -1 : m_cluster[idx];
+	}
+
+	void RCPathHierarchy::clusterDijkstra(int source, std::vector<std::pair<int, float> >& result) const
+	{
+		result.clear();
+		const int cluster = m_cluster[source];
+		std::unordered_map<int, float> dist;
+		typedef std::pair<float, int> Entry;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+		dist[source] = 0.0f;
+		open.push({ 0.0f, source });
+		while (!open.empty())
+		{
+			const Entry cur = open.top();
+			open.pop();
+			if (cur.first > dist[cur.second]) continue;
+			result.push_back({ cur.second, cur.first });
+			for (int k = m_graph->neighbourBegin(cur.second); k < m_graph->neighbourEnd(cur.second); k++)
+			{
+				const int nei = m_graph->neighbourAt(k);
+				if (m_cluster[nei] != cluster) continue;
+				const float d = cur.first + m_graph->edgeCostAt(k);
+				auto it = dist.find(nei);
+				if (it == dist.end() || d < it->second)
+				{
+					dist[nei] = d;
+					open.push({ d, nei });
+				}
+			}
+		}
+	}
+
+	bool RCPathHierarchy::findAbstractPath(dtPolyRef startRef, dtPolyRef endRef, RCAbstractPath& result) const
+	{
+		result.waypoints.clear();
+		result.cost = 0.0f;
+		if (m_graph == nullptr) return false;
+		const int s = m_graph->indexOf(startRef);
+		const int g = m_graph->indexOf(endRef);
+		if (s < 0 || g < 0 || m_cluster[s] < 0 || m_cluster[g] < 0) return false;
+
+		std::vector<std::pair<int, float> > startReach, goalReach;
+		clusterDijkstra(s, startReach);
+		if (m_cluster[s] == m_cluster[g])
+		{
+			for (const auto& r : startReach)
+			{
+				if (r.first != g) continue;
+				result.waypoints = { s, g };
+				result.cost = r.second;
+				return true;
+			}
+		}
+		clusterDijkstra(g, goalReach);
+
+		// Portal graph plus a virtual start and goal node.
+		const int nportals = (int)m_portalPoly.size();
+		const int START = nportals;
+		const int GOAL = nportals + 1;
+		std::vector<float> cost(nportals + 2, FLT_MAX);
+		std::vector<int> parent(nportals + 2, -1);
+		std::vector<float> goalCost(nportals, FLT_MAX);
+		for (const auto& r : goalReach)
+		{
+			if (m_portalOf[r.first] >= 0) goalCost[m_portalOf[r.first]] = r.second;
+		}
+
+		const float* goalCenter = m_graph->centerAt(g);
+		auto heuristic = [&](int node)
+		{
+			if (node >= nportals) return 0.0f;
+			return dtVdist(m_graph->centerAt(m_portalPoly[node]), goalCenter);
+		};
+
+		typedef std::pair<float, int> Entry;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+		auto relax = [&](int from, int to, float c)
+		{
+			const float d = cost[from] + c;
+			if (d >= cost[to]) return;
+			cost[to] = d;
+			parent[to] = from;
+			open.push({ d + heuristic(to), to });
+		};
+
+		cost[START] = 0.0f;
+		open.push({ 0.0f, START });
+		while (!open.empty())
+		{
+			const Entry cur = open.top();
+			open.pop();
+			const int u = cur.second;
+			if (u == GOAL) break;
+			if (cur.first > cost[u] + heuristic(u)) continue;
+
+			if (u == START)
+			{
+				for (const auto& r : startReach)
+				{
+					if (m_portalOf[r.first] >= 0) relax(START, m_portalOf[r.first], r.second);
+				}
+				continue;
+			}
+			for (int k = m_edgeOffsets[u]; k < m_edgeOffsets[u + 1]; k++)
+				relax(u, m_edgeTo[k], m_edgeCost[k]);
+			if (goalCost[u] != FLT_MAX)
+				relax(u, GOAL, goalCost[u]);
+		}
+		if (parent[GOAL] == -1) return false;
+
+		std::vector<int> reversed;
+		for (int node = parent[GOAL]; node != START; node = parent[node])
+			reversed.push_back(m_portalPoly[node]);
+
+		result.cost = cost[GOAL];
+		result.waypoints.push_back(s);
+		for (auto it = reversed.rbegin(); it != reversed.rend(); ++it)
+		{
+			if (*it != result.waypoints.back()) result.waypoints.push_back(*it);
+		}
+		if (g != result.waypoints.back()) result.waypoints.push_back(g);
+		return true;
+	}
+
+	dtStatus RCPathHierarchy::refinePath(RCPathSearch& search, const dtQueryFilter* filter, const RCAbstractPath& apath,
+		int firstSegment, int nsegments, const float* startPos, const float* endPos,
+		dtPolyRef* path, int* pathCount, int maxPath, int* expandedNodes) const
+	{
+		*pathCount = 0;
+		if (expandedNodes) *expandedNodes = 0;
+		const int nwaypoints = (int)apath.waypoints.size();
+		if (m_graph == nullptr || nwaypoints == 0 || firstSegment < 0 || maxPath <= 0)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		if (nwaypoints == 1)
+		{
+			path[0] = m_graph->refAt(apath.waypoints[0]);
+			*pathCount = 1;
+			return DT_SUCCESS;
+		}
+
+		static const int MAX_SEGMENT_POLYS = 256;
+		dtPolyRef segment[MAX_SEGMENT_POLYS];
+		const int lastSegment = dtMin(firstSegment + nsegments, nwaypoints - 1);
+		for (int seg = firstSegment; seg < lastSegment; seg++)
+		{
+			const int a = apath.waypoints[seg];
+			const int b = apath.waypoints[seg + 1];
+			const float* spos = seg == firstSegment ? startPos : m_graph->centerAt(a);
+			const float* epos = seg + 1 == nwaypoints - 1 ? endPos : m_graph->centerAt(b);
+
+			int nsegment = 0;
+			const dtStatus status = search.findPath(m_graph->refAt(a), m_graph->refAt(b), spos, epos, filter,
+				segment, &nsegment, MAX_SEGMENT_POLYS);
+			if (expandedNodes) *expandedNodes += search.getLastExpandedNodes();
+			if (dtStatusFailed(status) || nsegment == 0)
+				return *pathCount ? (DT_SUCCESS | DT_PARTIAL_RESULT) : status;
+
+			// The joint polygon is already the last one of the corridor.
+			const int begin = (*pathCount > 0 && path[*pathCount - 1] == segment[0]) ? 1 : 0;
+			for (int i = begin; i < nsegment; i++)
+			{
+				if (*pathCount >= maxPath)
+					return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+				path[(*pathCount)++] = segment[i];
+			}
+			if (segment[nsegment - 1] != m_graph->refAt(b))
+				return DT_SUCCESS | DT_PARTIAL_RESULT;
+		}
+		return DT_SUCCESS;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+
+namespace GU
+{
+	class RCNavGraph;
+	class RCPathSearch;
+
+	struct RCAbstractPath
+	{
+		// polygon indices in RCNavGraph, start polygon, portal polygons, end polygon
+		std::vector<int> waypoints;
+		float cost = 0.0f;
+	};
+
+	// Two level path search. Polygons are grown into clusters of about clusterSize
+	// polygons, polygons with a neighbour in another cluster become portals, and the
+	// portal to portal costs inside every cluster are precomputed. Long queries search
+	// the portal graph first, then refine the corridor one waypoint segment at a time,
+	// each segment a short search between neighbouring portals.
+	class RCPathHierarchy
+	{
+	public:
+		RCPathHierarchy() = default;
+		~RCPathHierarchy() = default;
+
+		void build(const RCNavGraph& graph, const dtQueryFilter* filter, int clusterSize);
+		void clear();
+
+		int getClusterCount() const { return m_nclusters; }
+		int getPortalCount() const { return (int)m_portalPoly.size(); }
+		int getCluster(dtPolyRef ref) const;
+
+		// Search the portal graph. Fails when start and end are not connected.
+		bool findAbstractPath(dtPolyRef startRef, dtPolyRef endRef, RCAbstractPath& result) const;
+
+		// Detailed corridor for the waypoint segments [firstSegment, firstSegment + nsegments),
+		// waypoints.size() - 1 segments from 0 for the whole path. startPos is the position
+		// on the first waypoint, endPos the final goal. expandedNodes adds up the nodes
+		// the segment searches expanded.
+		dtStatus refinePath(RCPathSearch& search, const dtQueryFilter* filter, const RCAbstractPath& apath,
+			int firstSegment, int nsegments, const float* startPos, const float* endPos,
+			dtPolyRef* path, int* pathCount, int maxPath, int* expandedNodes = nullptr) const;
+	private:
+		// costs from source to every polygon of its cluster
+		void clusterDijkstra(int source, std::vector<std::pair<int, float> >& result) const;
+
+		const RCNavGraph* m_graph = nullptr;
+		int m_nclusters = 0;
+		std::vector<int> m_cluster;			// per polygon, -1 if rejected by the filter
+		std::vector<int> m_clusterPolys;	// polygons grouped by cluster
+		std::vector<int> m_clusterOffsets;
+		std::vector<int> m_portalOf;		// per polygon, portal index or -1
+		std::vector<int> m_portalPoly;
+		std::vector<int> m_clusterPortalOffsets;	// portals grouped by cluster
+		std::vector<int> m_clusterPortals;
+		// portal graph in CSR form, intra cluster and inter cluster edges
+		std::vector<int> m_edgeOffsets;
+		std::vector<int> m_edgeTo;
+		std::vector<float> m_edgeCost;
+	};
+}
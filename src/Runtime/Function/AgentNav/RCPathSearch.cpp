@@ -0,0 +1,94 @@
+#include "RCPathSearch.h"
+
+namespace GU
+{
+	RCPathSearch::~RCPathSearch()
+	{
+		delete m_nodePool;
+		delete m_openList;
+	}
+
+	bool RCPathSearch::init(const dtNavMesh* navMesh, int maxNodes)
+	{
+		m_navMesh = navMesh;
+		if (m_nodePool == nullptr || m_nodePool->getMaxNodes() < maxNodes)
+		{
+			delete m_nodePool;
+			delete m_openList;
+			m_nodePool = new dtNodePool(maxNodes, dtNextPow2(maxNodes / 4));
+			m_openList = new dtNodeQueue(maxNodes);
+		}
+		return m_navMesh != nullptr;
+	}
+
+	void RCPathSearch::getEdgeMidPoint(dtPolyRef fromRef, const dtPoly* fromPoly, const dtMeshTile* fromTile, const dtLink* link,
+		const dtPoly* toPoly, const dtMeshTile* toTile, float* mid)
+	{
+		// Off-mesh connections only touch the polygon at one vertex.
+		if (fromPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+		{
+			dtVcopy(mid, &fromTile->verts[fromPoly->verts[link->edge] * 3]);
+			return;
+		}
+		if (toPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+		{
+			// Pick the connection end point that links back to us.
+			for (unsigned int i = toPoly->firstLink; i != DT_NULL_LINK; i = toTile->links[i].next)
+			{
+				if (toTile->links[i].ref == fromRef)
+				{
+					dtVcopy(mid, &toTile->verts[toPoly->verts[toTile->links[i].edge] * 3]);
+					return;
+				}
+			}
+			dtVcopy(mid, &toTile->verts[toPoly->verts[0] * 3]);
+			return;
+		}
+
+		const float* v0 = &fromTile->verts[fromPoly->verts[link->edge] * 3];
+		const float* v1 = &fromTile->verts[fromPoly->verts[(link->edge + 1) % (int)fromPoly->vertCount] * 3];
+		float left[3], right[3];
+		dtVcopy(left, v0);
+		dtVcopy(right, v1);
+
+		// Links at tile borders only cover part of the edge.
+		if (link->side != 0xff && (link->bmin != 0 || link->bmax != 255))
+		{
+			const float s = 1.0f / 255.0f;
+			dtVlerp(left, v0, v1, link->bmin * s);
+			dtVlerp(right, v0, v1, link->bmax * s);
+		}
+
+		mid[0] = (left[0] + right[0]) * 0.5f;
+		mid[1] = (left[1] + right[1]) * 0.5f;
+		mid[2] = (left[2] + right[2]) * 0.5f;
+	}
+
+	dtStatus RCPathSearch::getPathToNode(const dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const
+	{
+		const dtNode* curNode = endNode;
+		int length = 0;
+		do
+		{
+			length++;
+			curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
+		} while (curNode);
+
+		// Keep the beginning of the corridor when it does not fit.
+		curNode = endNode;
+		int writeCount;
+		for (writeCount = length; writeCount > maxPath; writeCount--)
+			curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
+
+		for (int i = writeCount - 1; i >= 0; i--)
+		{
+			path[i] = curNode->id;
+			curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
+		}
+
+		*pathCount = dtMin(length, maxPath);
+		if (length > maxPath)
+			return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+		return DT_SUCCESS;
+	}
+}
@@ -0,0 +1,211 @@
+#pragma once
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <DetourNode.h>
+#include <DetourCommon.h>
+
+namespace GU
+{
+	// Same scale Detour applies to its euclidean heuristic.
+	static const float RC_H_SCALE = 0.999f;
+
+	struct RCEuclidHeuristic
+	{
+		const float* endPos;
+
+		float operator()(dtPolyRef, const float* pos) const
+		{
+			return dtVdist(pos, endPos) * RC_H_SCALE;
+		}
+	};
+
+	// A* over the Detour polygon graph. Mirrors dtNavMeshQuery::findPath, but the
+	// filter and heuristic are template parameters and the number of expanded nodes
+	// is reported. Passing a concrete filter type (see RCQueryFilters.h) lets
+	// passFilter/getCost inline; with dtQueryFilter they are only virtual calls when
+	// Detour is built with DT_VIRTUAL_QUERYFILTER (ENABLE_VIRTUAL_QUERYFILTER).
+	// One instance per thread, the node pool is not shared.
+	class RCPathSearch
+	{
+	public:
+		RCPathSearch() = default;
+		~RCPathSearch();
+		RCPathSearch(const RCPathSearch&) = delete;
+		RCPathSearch& operator=(const RCPathSearch&) = delete;
+
+		bool init(const dtNavMesh* navMesh, int maxNodes);
+
+		template<typename Filter, typename Heuristic>
+		dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef, const float* startPos, const float* endPos,
+			const Filter* filter, const Heuristic& heuristic, dtPolyRef* path, int* pathCount, const int maxPath);
+
+		template<typename Filter>
+		dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef, const float* startPos, const float* endPos,
+			const Filter* filter, dtPolyRef* path, int* pathCount, const int maxPath)
+		{
+			return findPath(startRef, endRef, startPos, endPos, filter, RCEuclidHeuristic{ endPos }, path, pathCount, maxPath);
+		}
+
+		int getLastExpandedNodes() const { return m_lastExpandedNodes; }
+		const dtNavMesh* getNavMesh() const { return m_navMesh; }
+
+		// Position the search gives the polygon entered through link, the costs are the
+		// distances between these points.
+		static void getEdgeMidPoint(dtPolyRef fromRef, const dtPoly* fromPoly, const dtMeshTile* fromTile, const dtLink* link,
+			const dtPoly* toPoly, const dtMeshTile* toTile, float* mid);
+	private:
+		dtStatus getPathToNode(const dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const;
+
+		const dtNavMesh* m_navMesh = nullptr;
+		dtNodePool* m_nodePool = nullptr;
+		dtNodeQueue* m_openList = nullptr;
+		int m_lastExpandedNodes = 0;
+	};
+
+	template<typename Filter, typename Heuristic>
+	dtStatus RCPathSearch::findPath(dtPolyRef startRef, dtPolyRef endRef, const float* startPos, const float* endPos,
+		const Filter* filter, const Heuristic& heuristic, dtPolyRef* path, int* pathCount, const int maxPath)
+	{
+		*pathCount = 0;
+		m_lastExpandedNodes = 0;
+		if (m_navMesh == nullptr || m_nodePool == nullptr || !path || maxPath <= 0)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		if (!m_navMesh->isValidPolyRef(startRef) || !m_navMesh->isValidPolyRef(endRef))
+			return DT_FAILURE | DT_INVALID_PARAM;
+
+		if (startRef == endRef)
+		{
+			path[0] = startRef;
+			*pathCount = 1;
+			return DT_SUCCESS;
+		}
+
+		m_nodePool->clear();
+		m_openList->clear();
+
+		dtNode* startNode = m_nodePool->getNode(startRef);
+		dtVcopy(startNode->pos, startPos);
+		startNode->pidx = 0;
+		startNode->cost = 0;
+		startNode->total = heuristic(startRef, startPos);
+		startNode->id = startRef;
+		startNode->flags = DT_NODE_OPEN;
+		m_openList->push(startNode);
+
+		dtNode* lastBestNode = startNode;
+		float lastBestNodeCost = startNode->total;
+		bool outOfNodes = false;
+
+		while (!m_openList->empty())
+		{
+			dtNode* bestNode = m_openList->pop();
+			bestNode->flags &= ~DT_NODE_OPEN;
+			bestNode->flags |= DT_NODE_CLOSED;
+			m_lastExpandedNodes++;
+
+			if (bestNode->id == endRef)
+			{
+				lastBestNode = bestNode;
+				break;
+			}
+
+			const dtPolyRef bestRef = bestNode->id;
+			const dtMeshTile* bestTile = 0;
+			const dtPoly* bestPoly = 0;
+			m_navMesh->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+
+			dtPolyRef parentRef = 0;
+			const dtMeshTile* parentTile = 0;
+			const dtPoly* parentPoly = 0;
+			if (bestNode->pidx)
+				parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+			if (parentRef)
+				m_navMesh->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+
+			for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+			{
+				const dtLink* link = &bestTile->links[i];
+				const dtPolyRef neighbourRef = link->ref;
+				if (!neighbourRef || neighbourRef == parentRef)
+					continue;
+
+				const dtMeshTile* neighbourTile = 0;
+				const dtPoly* neighbourPoly = 0;
+				m_navMesh->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+				if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+					continue;
+
+				// Tile border links may enter the same polygon from different sides.
+				unsigned char crossSide = 0;
+				if (link->side != 0xff)
+					crossSide = link->side >> 1;
+
+				dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
+				if (!neighbourNode)
+				{
+					outOfNodes = true;
+					continue;
+				}
+
+				if (neighbourNode->flags == 0)
+					getEdgeMidPoint(bestRef, bestPoly, bestTile, link, neighbourPoly, neighbourTile, neighbourNode->pos);
+
+				float cost = 0;
+				float h = 0;
+				if (neighbourRef == endRef)
+				{
+					const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+						parentRef, parentTile, parentPoly, bestRef, bestTile, bestPoly,
+						neighbourRef, neighbourTile, neighbourPoly);
+					const float endCost = filter->getCost(neighbourNode->pos, endPos,
+						bestRef, bestTile, bestPoly, neighbourRef, neighbourTile, neighbourPoly,
+						0, 0, 0);
+					cost = bestNode->cost + curCost + endCost;
+				}
+				else
+				{
+					const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+						parentRef, parentTile, parentPoly, bestRef, bestTile, bestPoly,
+						neighbourRef, neighbourTile, neighbourPoly);
+					cost = bestNode->cost + curCost;
+					h = heuristic(neighbourRef, neighbourNode->pos);
+				}
+
+				const float total = cost + h;
+				if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+					continue;
+				if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
+					continue;
+
+				neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+				neighbourNode->id = neighbourRef;
+				neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+				neighbourNode->cost = cost;
+				neighbourNode->total = total;
+
+				if (neighbourNode->flags & DT_NODE_OPEN)
+				{
+					m_openList->modify(neighbourNode);
+				}
+				else
+				{
+					neighbourNode->flags |= DT_NODE_OPEN;
+					m_openList->push(neighbourNode);
+				}
+
+				if (h < lastBestNodeCost)
+				{
+					lastBestNodeCost = h;
+					lastBestNode = neighbourNode;
+				}
+			}
+		}
+
+		dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
+		if (lastBestNode->id != endRef)
+			status |= DT_PARTIAL_RESULT;
+		if (outOfNodes)
+			status |= DT_OUT_OF_NODES;
+		return status;
+	}
+}
@@ -0,0 +1,357 @@
+#include "RCPathSmoother.h"
+#include <Core/ParallelFor.h>
+#include <DetourCommon.h>
+#include <Recast.h>
+#include <cstring>
+#include <cmath>
+
+namespace GU
+{
+	static bool inRange(const float* v1, const float* v2, const float r, const float h)
+	{
+		const float dx = v2[0] - v1[0];
+		const float dy = v2[1] - v1[1];
+		const float dz = v2[2] - v1[2];
+		return (dx * dx + dz * dz) < r * r && fabsf(dy) < h;
+	}
+
+	static bool getSteerTarget(dtNavMeshQuery* navQuery, const float* startPos, const float* endPos,
+		const float minTargetDist,
+		const dtPolyRef* path, const int pathSize,
+		float* steerPos, unsigned char& steerPosFlag, dtPolyRef& steerPosRef,
+		float* outPoints = 0, int* outPointCount = 0)
+	{
+		// Find steer target.
+		static const int MAX_STEER_POINTS = 3;
+		float steerPath[MAX_STEER_POINTS * 3];
+		unsigned char steerPathFlags[MAX_STEER_POINTS];
+		dtPolyRef steerPathPolys[MAX_STEER_POINTS];
+		int nsteerPath = 0;
+		navQuery->findStraightPath(startPos, endPos, path, pathSize,
+			steerPath, steerPathFlags, steerPathPolys, &nsteerPath, MAX_STEER_POINTS);
+		if (!nsteerPath)
+			return false;
+
+		if (outPoints && outPointCount)
+		{
+			*outPointCount = nsteerPath;
+			for (int i = 0; i < nsteerPath; ++i)
+				dtVcopy(&outPoints[i * 3], &steerPath[i * 3]);
+		}
+
+
+		// Find vertex far enough to steer to.
+		int ns = 0;
+		while (ns < nsteerPath)
+		{
+			// Stop at Off-Mesh link or when point is further than slop away.
+			if ((steerPathFlags[ns] & DT_STRAIGHTPATH_OFFMESH_CONNECTION) ||
+				!inRange(&steerPath[ns * 3], startPos, minTargetDist, 1000.0f))
+				break;
+			ns++;
+		}
+		// Failed to find good point to steer to.
+		if (ns >= nsteerPath)
+			return false;
+
+		dtVcopy(steerPos, &steerPath[ns * 3]);
+		steerPos[1] = startPos[1];
+		steerPosFlag = steerPathFlags[ns];
+		steerPosRef = steerPathPolys[ns];
+
+		return true;
+	}
+
+	static int fixupCorridor(dtPolyRef* path, const int npath, const int maxPath,
+		const dtPolyRef* visited, const int nvisited)
+	{
+		int furthestPath = -1;
+		int furthestVisited = -1;
+
+		// Find furthest common polygon.
+		for (int i = npath - 1; i >= 0; --i)
+		{
+			bool found = false;
+			for (int j = nvisited - 1; j >= 0; --j)
+			{
+				if (path[i] == visited[j])
+				{
+					furthestPath = i;
+					furthestVisited = j;
+					found = true;
+				}
+			}
+			if (found)
+				break;
+		}
+
+		// If no intersection found just return current path. 
+		if (furthestPath == -1 || furthestVisited == -1)
+			return npath;
+
+		// Concatenate paths.	
+
+		// Adjust beginning of the buffer to include the visited.
+		const int req = nvisited - furthestVisited;
+		const int orig = rcMin(furthestPath + 1, npath);
+		int size = rcMax(0, npath - orig);
+		if (req + size > maxPath)
+			size = maxPath - req;
+		if (size)
+			memmove(path + req, path + orig, size * sizeof(dtPolyRef));
+
+		// Store visited
+		for (int i = 0; i < req; ++i)
+			path[i] = visited[(nvisited - 1) - i];
+
+		return req + size;
+	}
+
+	// This function checks if the path has a small U-turn, that is,
+	// a polygon further in the path is adjacent to the first polygon
+	// in the path. If that happens, a shortcut is taken.
+	// This can happen if the target (T) location is at tile boundary,
+	// and we're (S) approaching it parallel to the tile edge.
+	// The choice at the vertex can be arbitrary, 
+	//  +---+---+
+	//  |:::|:::|
+	//  +-S-+-T-+
+	//  |:::|   | <-- the step can end up in here, resulting U-turn path.
+	//  +---+---+
+	static int fixupShortcuts(dtPolyRef* path, int npath, dtNavMeshQuery* navQuery)
+	{
+		if (npath < 3)
+			return npath;
+
+		// Get connected polygons
+		static const int maxNeis = 16;
+		dtPolyRef neis[maxNeis];
+		int nneis = 0;
+
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		if (dtStatusFailed(navQuery->getAttachedNavMesh()->getTileAndPolyByRef(path[0], &tile, &poly)))
+			return npath;
+
+		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			const dtLink* link = &tile->links[k];
+			if (link->ref != 0)
+			{
+				if (nneis < maxNeis)
+					neis[nneis++] = link->ref;
+			}
+		}
+
+		// If any of the neighbour polygons is within the next few polygons
+		// in the path, short cut to that polygon directly.
+		static const int maxLookAhead = 6;
+		int cut = 0;
+		for (int i = dtMin(maxLookAhead, npath) - 1; i > 1 && cut == 0; i--) {
+			for (int j = 0; j < nneis; j++)
+			{
+				if (path[i] == neis[j]) {
+					cut = i;
+					break;
+				}
+			}
+		}
+		if (cut > 1)
+		{
+			int offset = cut - 1;
+			npath -= offset;
+			for (int i = 1; i < npath; i++)
+				path[i] = path[i + offset];
+		}
+
+		return npath;
+	}
+
+	RCPathSmoother::~RCPathSmoother()
+	{
+		for (auto& worker : m_workers)
+			dtFreeNavMeshQuery(worker.navQuery);
+	}
+
+	bool RCPathSmoother::init(const dtNavMesh* navMesh, int maxNodes, int nworkers)
+	{
+		for (auto& worker : m_workers)
+			dtFreeNavMeshQuery(worker.navQuery);
+		m_workers.clear();
+		m_navMesh = navMesh;
+		if (navMesh == nullptr) return false;
+
+		m_workers.resize(dtMax(1, dtMin(nworkers, MAX_WORKERS)));
+		for (auto& worker : m_workers)
+		{
+			worker.navQuery = dtAllocNavMeshQuery();
+			if (worker.navQuery == nullptr || dtStatusFailed(worker.navQuery->init(navMesh, maxNodes)))
+				return false;
+		}
+		return true;
+	}
+
+	int RCPathSmoother::smoothPaths(const float* starts, const float* ends, int n, const float* halfExtents,
+		const dtQueryFilter* filter, int maxPoints, std::vector<float>& outPoints, std::vector<int>& outOffsets,
+		ThreadPool* pool)
+	{
+		outPoints.clear();
+		outOffsets.assign(dtMax(n, 0) + 1, 0);
+		if (m_workers.empty() || n <= 0) return 0;
+
+		// every chunk is a contiguous range of pairs, so the worker buffers in
+		// chunk order are the paths in pair order
+		int found[MAX_WORKERS] = {};
+		for (auto& worker : m_workers)
+		{
+			worker.points.clear();
+			worker.scratch.resize((size_t)maxPoints * 3);
+		}
+		parallelFor(pool, n, (int)m_workers.size(), [&](int chunk, int begin, int end)
+		{
+			Worker& worker = m_workers[chunk];
+			for (int i = begin; i < end; i++)
+			{
+				const int npoints = smoothPath(chunk, &starts[i * 3], &ends[i * 3], halfExtents, filter,
+					worker.scratch.data(), maxPoints);
+				worker.points.insert(worker.points.end(), worker.scratch.begin(), worker.scratch.begin() + npoints * 3);
+				outOffsets[i + 1] = npoints;
+				if (npoints) found[chunk]++;
+			}
+		});
+
+		for (int i = 0; i < n; i++)
+			outOffsets[i + 1] += outOffsets[i];
+		outPoints.reserve((size_t)outOffsets[n] * 3);
+		int total = 0;
+		for (int i = 0; i < (int)m_workers.size(); i++)
+		{
+			outPoints.insert(outPoints.end(), m_workers[i].points.begin(), m_workers[i].points.end());
+			total += found[i];
+		}
+		return total;
+	}
+
+	int RCPathSmoother::smoothPath(int worker, const float* start, const float* end, const float* halfExtents,
+		const dtQueryFilter* filter, float* outPoints, int maxPoints)
+	{
+		dtNavMeshQuery* navQuery = m_workers[worker].navQuery;
+		dtPolyRef* polys = m_workers[worker].polys;
+
+		dtPolyRef startRef = 0, endRef = 0;
+		navQuery->findNearestPoly(start, halfExtents, filter, &startRef, 0);
+		navQuery->findNearestPoly(end, halfExtents, filter, &endRef, 0);
+		if (!startRef || !endRef || maxPoints <= 0) return 0;
+
+		int npolys = 0;
+		navQuery->findPath(startRef, endRef, start, end, filter, polys, &npolys, MAX_POLYS);
+		if (!npolys) return 0;
+
+		// Iterate over the path to find smooth path on the detail mesh surface.
+		float iterPos[3], targetPos[3];
+		navQuery->closestPointOnPoly(startRef, start, iterPos, 0);
+		navQuery->closestPointOnPoly(polys[npolys - 1], end, targetPos, 0);
+
+		static const float STEP_SIZE = 0.5f;
+		static const float SLOP = 0.01f;
+
+		int npoints = 0;
+		dtVcopy(&outPoints[npoints * 3], iterPos);
+		npoints++;
+
+		// Move towards target a small advancement at a time until target reached or
+		// when ran out of memory to store the path.
+		while (npolys && npoints < maxPoints)
+		{
+			// Find location to steer towards.
+			float steerPos[3];
+			unsigned char steerPosFlag;
+			dtPolyRef steerPosRef;
+			if (!getSteerTarget(navQuery, iterPos, targetPos, SLOP, polys, npolys, steerPos, steerPosFlag, steerPosRef))
+				break;
+
+			const bool endOfPath = (steerPosFlag & DT_STRAIGHTPATH_END) ? true : false;
+			const bool offMeshConnection = (steerPosFlag & DT_STRAIGHTPATH_OFFMESH_CONNECTION) ? true : false;
+
+			// Find movement delta.
+			float delta[3], len;
+			dtVsub(delta, steerPos, iterPos);
+			len = sqrtf(dtVdot(delta, delta));
+			// If the steer target is end of path or off-mesh link, do not move past the location.
+			if ((endOfPath || offMeshConnection) && len < STEP_SIZE)
+				len = 1;
+			else
+				len = STEP_SIZE / len;
+			float moveTgt[3];
+			dtVmad(moveTgt, iterPos, delta, len);
+
+			// Move
+			float result[3];
+			dtPolyRef visited[16];
+			int nvisited = 0;
+			navQuery->moveAlongSurface(polys[0], iterPos, moveTgt, filter, result, visited, &nvisited, 16);
+
+			npolys = fixupCorridor(polys, npolys, MAX_POLYS, visited, nvisited);
+			npolys = fixupShortcuts(polys, npolys, navQuery);
+
+			float h = 0;
+			navQuery->getPolyHeight(polys[0], result, &h);
+			result[1] = h;
+			dtVcopy(iterPos, result);
+
+			// Handle end of path and off-mesh links when close enough.
+			if (endOfPath && inRange(iterPos, steerPos, SLOP, 1.0f))
+			{
+				// Reached end of path.
+				dtVcopy(iterPos, targetPos);
+				if (npoints < maxPoints)
+				{
+					dtVcopy(&outPoints[npoints * 3], iterPos);
+					npoints++;
+				}
+				break;
+			}
+			else if (offMeshConnection && inRange(iterPos, steerPos, SLOP, 1.0f))
+			{
+				// Reached off-mesh connection.
+				float startPos[3], endPos[3];
+
+				// Advance the path up to and over the off-mesh connection.
+				dtPolyRef prevRef = 0, polyRef = polys[0];
+				int npos = 0;
+				while (npos < npolys && polyRef != steerPosRef)
+				{
+					prevRef = polyRef;
+					polyRef = polys[npos];
+					npos++;
+				}
+				for (int i = npos; i < npolys; ++i)
+					polys[i - npos] = polys[i];
+				npolys -= npos;
+
+				// Handle the connection.
+				if (dtStatusSucceed(m_navMesh->getOffMeshConnectionPolyEndPoints(prevRef, polyRef, startPos, endPos)))
+				{
+					if (npoints < maxPoints)
+					{
+						dtVcopy(&outPoints[npoints * 3], startPos);
+						npoints++;
+					}
+					// Move position at the other side of the off-mesh link.
+					dtVcopy(iterPos, endPos);
+					float eh = 0.0f;
+					navQuery->getPolyHeight(polys[0], iterPos, &eh);
+					iterPos[1] = eh;
+				}
+			}
+
+			// Store results.
+			if (npoints < maxPoints)
+			{
+				dtVcopy(&outPoints[npoints * 3], iterPos);
+				npoints++;
+			}
+		}
+		return npoints;
+	}
+}
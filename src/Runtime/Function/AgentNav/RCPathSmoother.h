@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <Function/AgentNav/RCParams.h>
+class ThreadPool;
+
+namespace GU
+{
+	// Sampled walking paths for start/goal pairs, the "path follow" mode of the Recast
+	// demo: find the corridor, then step along it with moveAlongSurface. Every worker
+	// owns its dtNavMeshQuery and corridor buffers, so batches run in parallel.
+	class RCPathSmoother
+	{
+	public:
+		RCPathSmoother() = default;
+		~RCPathSmoother();
+		RCPathSmoother(const RCPathSmoother&) = delete;
+		RCPathSmoother& operator=(const RCPathSmoother&) = delete;
+
+		bool init(const dtNavMesh* navMesh, int maxNodes, int nworkers = MAX_WORKERS);
+		int getWorkerCount() const { return (int)m_workers.size(); }
+
+		// Paths of all pairs back to back in outPoints, pair i has the points
+		// [outOffsets[i], outOffsets[i + 1]), none when no path was found. At most
+		// maxPoints per pair. Returns the number of pairs with a path.
+		int smoothPaths(const float* starts, const float* ends, int n, const float* halfExtents,
+			const dtQueryFilter* filter, int maxPoints, std::vector<float>& outPoints, std::vector<int>& outOffsets,
+			ThreadPool* pool = nullptr);
+		// Single path with the scratch of one worker, returns the point count.
+		int smoothPath(int worker, const float* start, const float* end, const float* halfExtents,
+			const dtQueryFilter* filter, float* outPoints, int maxPoints);
+	private:
+		struct Worker
+		{
+			dtNavMeshQuery* navQuery = nullptr;
+			dtPolyRef polys[MAX_POLYS];
+			// points of the pairs of this worker's chunk, in pair order
+			std::vector<float> points;
+			std::vector<float> scratch;
+		};
+		const dtNavMesh* m_navMesh = nullptr;
+		std::vector<Worker> m_workers;
+	};
+}
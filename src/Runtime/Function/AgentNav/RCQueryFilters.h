@@ -0,0 +1,67 @@
+#pragma once
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <DetourCommon.h>
+#include <Function/AgentNav/RCNavGraph.h>
+
+namespace GU
+{
+	// Drop-in for dtQueryFilter in RCPathSearch. Same flag and area cost rules,
+	// but nothing is virtual so the calls inline into the A* loop.
+	struct RCAreaFilter
+	{
+		float areaCost[DT_MAX_AREAS];
+		unsigned short includeFlags = 0xffff;
+		unsigned short excludeFlags = 0;
+
+		RCAreaFilter()
+		{
+			for (int i = 0; i < DT_MAX_AREAS; i++)
+				areaCost[i] = 1.0f;
+		}
+
+		explicit RCAreaFilter(const dtQueryFilter& filter)
+		{
+			for (int i = 0; i < DT_MAX_AREAS; i++)
+				areaCost[i] = filter.getAreaCost(i);
+			includeFlags = filter.getIncludeFlags();
+			excludeFlags = filter.getExcludeFlags();
+		}
+
+		inline bool passFilter(const dtPolyRef, const dtMeshTile*, const dtPoly* poly) const
+		{
+			return (poly->flags & includeFlags) != 0 && (poly->flags & excludeFlags) == 0;
+		}
+
+		inline float getCost(const float* pa, const float* pb,
+			const dtPolyRef, const dtMeshTile*, const dtPoly*,
+			const dtPolyRef, const dtMeshTile*, const dtPoly* curPoly,
+			const dtPolyRef, const dtMeshTile*, const dtPoly*) const
+		{
+			return dtVdist(pa, pb) * areaCost[curPoly->getArea()];
+		}
+	};
+
+	// Area costs mark hazards, on top of that every polygon is penalised by the
+	// number of agents standing on it. density is indexed by RCNavGraph poly index.
+	struct RCCrowdCostFilter : public RCAreaFilter
+	{
+		const RCNavGraph* graph = nullptr;
+		const float* density = nullptr;
+		float densityWeight = 0.5f;
+
+		RCCrowdCostFilter() = default;
+		explicit RCCrowdCostFilter(const dtQueryFilter& filter) : RCAreaFilter(filter) {}
+
+		inline float getCost(const float* pa, const float* pb,
+			const dtPolyRef, const dtMeshTile*, const dtPoly*,
+			const dtPolyRef curRef, const dtMeshTile*, const dtPoly* curPoly,
+			const dtPolyRef, const dtMeshTile*, const dtPoly*) const
+		{
+			float cost = dtVdist(pa, pb) * areaCost[curPoly->getArea()];
+			if (density)
+				cost *= 1.0f + densityWeight * density[graph->indexOfUnsafe(curRef)];
+			return cost;
+		}
+	};
+}
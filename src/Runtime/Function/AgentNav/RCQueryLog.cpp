@@ -0,0 +1,161 @@
+#include "RCQueryLog.h"
+#include <DetourNavMeshQuery.h>
+#include <cstdint>
+#include <algorithm>
+
+namespace GU
+{
+	static const int QUERYLOG_MAGIC = 'R' << 24 | 'C' << 16 | 'Q' << 8 | 'L';
+	static const int QUERYLOG_VERSION = 1;
+
+	struct QueryLogHeader
+	{
+		int magic;
+		int version;
+		int polyRefSize;
+	};
+
+	// fixed part of every record, followed by pathSize poly refs
+	struct QueryLogEntry
+	{
+		uint8_t type;
+		uint8_t options;
+		uint16_t includeFlags;
+		uint16_t excludeFlags;
+		uint16_t pathSize;
+		dtPolyRef startRef;
+		dtPolyRef endRef;
+		float startPos[3];
+		float endPos[3];
+	};
+
+	static void setFilterFlags(RCQueryRecord& record, const dtQueryFilter* filter)
+	{
+		if (filter == nullptr) return;
+		record.includeFlags = filter->getIncludeFlags();
+		record.excludeFlags = filter->getExcludeFlags();
+	}
+
+	static void copyPos(float* dst, const float* src)
+	{
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+
+	RCQueryRecorder::~RCQueryRecorder()
+	{
+		close();
+	}
+
+	bool RCQueryRecorder::open(const std::filesystem::path& filepath)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_file.is_open()) m_file.close();
+		m_count = 0;
+		m_file.open(filepath, std::ios::binary | std::ios::trunc);
+		if (!m_file.is_open()) return false;
+		QueryLogHeader header{ QUERYLOG_MAGIC, QUERYLOG_VERSION, (int)sizeof(dtPolyRef) };
+		m_file.write((const char*)&header, sizeof(header));
+		return m_file.good();
+	}
+
+	void RCQueryRecorder::close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_file.is_open()) m_file.close();
+	}
+
+	void RCQueryRecorder::recordFindPath(dtPolyRef startRef, dtPolyRef endRef, const float* startPos, const float* endPos, const dtQueryFilter* filter)
+	{
+		RCQueryRecord record;
+		record.type = RC_QUERY_FIND_PATH;
+		record.startRef = startRef;
+		record.endRef = endRef;
+		copyPos(record.startPos, startPos);
+		copyPos(record.endPos, endPos);
+		setFilterFlags(record, filter);
+		write(record);
+	}
+
+	void RCQueryRecorder::recordNearestPoly(const float* center, const float* halfExtents, const dtQueryFilter* filter)
+	{
+		RCQueryRecord record;
+		record.type = RC_QUERY_NEAREST_POLY;
+		copyPos(record.startPos, center);
+		copyPos(record.endPos, halfExtents);
+		setFilterFlags(record, filter);
+		write(record);
+	}
+
+	void RCQueryRecorder::recordRaycast(dtPolyRef startRef, const float* startPos, const float* endPos, const dtQueryFilter* filter)
+	{
+		RCQueryRecord record;
+		record.type = RC_QUERY_RAYCAST;
+		record.startRef = startRef;
+		copyPos(record.startPos, startPos);
+		copyPos(record.endPos, endPos);
+		setFilterFlags(record, filter);
+		write(record);
+	}
+
+	void RCQueryRecorder::recordStraightPath(const float* startPos, const float* endPos, const dtPolyRef* path, int pathSize, int options)
+	{
+		RCQueryRecord record;
+		record.type = RC_QUERY_STRAIGHT_PATH;
+		record.options = options;
+		copyPos(record.startPos, startPos);
+		copyPos(record.endPos, endPos);
+		record.path.assign(path, path + pathSize);
+		write(record);
+	}
+
+	void RCQueryRecorder::write(const RCQueryRecord& record)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_file.is_open()) return;
+		QueryLogEntry entry;
+		entry.type = (uint8_t)record.type;
+		entry.options = (uint8_t)record.options;
+		entry.includeFlags = record.includeFlags;
+		entry.excludeFlags = record.excludeFlags;
+		entry.pathSize = (uint16_t)std::min<size_t>(record.path.size(), UINT16_MAX);
+		entry.startRef = record.startRef;
+		entry.endRef = record.endRef;
+		copyPos(entry.startPos, record.startPos);
+		copyPos(entry.endPos, record.endPos);
+		m_file.write((const char*)&entry, sizeof(entry));
+		if (entry.pathSize)
+			m_file.write((const char*)record.path.data(), entry.pathSize * sizeof(dtPolyRef));
+		m_count++;
+	}
+
+	bool RCQueryLogReader::open(const std::filesystem::path& filepath)
+	{
+		m_file.open(filepath, std::ios::binary);
+		if (!m_file.is_open()) return false;
+		QueryLogHeader header;
+		if (!m_file.read((char*)&header, sizeof(header))) return false;
+		// refs are only meaningful against a navmesh built with the same dtPolyRef size
+		return header.magic == QUERYLOG_MAGIC && header.version == QUERYLOG_VERSION &&
+			header.polyRefSize == (int)sizeof(dtPolyRef);
+	}
+
+	bool RCQueryLogReader::next(RCQueryRecord& record)
+	{
+		QueryLogEntry entry;
+		if (!m_file.read((char*)&entry, sizeof(entry))) return false;
+		record.type = entry.type;
+		record.options = entry.options;
+		record.includeFlags = entry.includeFlags;
+		record.excludeFlags = entry.excludeFlags;
+		record.startRef = entry.startRef;
+		record.endRef = entry.endRef;
+		copyPos(record.startPos, entry.startPos);
+		copyPos(record.endPos, entry.endPos);
+		record.path.resize(entry.pathSize);
+		if (entry.pathSize && !m_file.read((char*)record.path.data(), entry.pathSize * sizeof(dtPolyRef)))
+			return false;
+		return true;
+	}
+}
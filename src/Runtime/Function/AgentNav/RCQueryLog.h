@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
+#include <DetourNavMesh.h>
+class dtQueryFilter;
+
+namespace GU
+{
+	enum RCQueryType
+	{
+		RC_QUERY_FIND_PATH = 1,
+		RC_QUERY_NEAREST_POLY,
+		RC_QUERY_RAYCAST,
+		RC_QUERY_STRAIGHT_PATH,
+	};
+
+	// One captured navmesh query. Nearest poly queries store the search
+	// center in startPos and the half extents in endPos.
+	struct RCQueryRecord
+	{
+		int type = 0;
+		int options = 0;
+		unsigned short includeFlags = 0;
+		unsigned short excludeFlags = 0;
+		dtPolyRef startRef = 0;
+		dtPolyRef endRef = 0;
+		float startPos[3] = {};
+		float endPos[3] = {};
+		// corridor of a straight path query
+		std::vector<dtPolyRef> path;
+	};
+
+	// Appends queries to a binary log, safe to call from several threads.
+	class RCQueryRecorder
+	{
+	public:
+		RCQueryRecorder() = default;
+		~RCQueryRecorder();
+
+		bool open(const std::filesystem::path& filepath);
+		void close();
+		bool isOpen() const { return m_file.is_open(); }
+		int getRecordCount() const { return m_count; }
+
+		void recordFindPath(dtPolyRef startRef, dtPolyRef endRef, const float* startPos, const float* endPos, const dtQueryFilter* filter);
+		void recordNearestPoly(const float* center, const float* halfExtents, const dtQueryFilter* filter);
+		void recordRaycast(dtPolyRef startRef, const float* startPos, const float* endPos, const dtQueryFilter* filter);
+		void recordStraightPath(const float* startPos, const float* endPos, const dtPolyRef* path, int pathSize, int options);
+	private:
+		void write(const RCQueryRecord& record);
+
+		std::ofstream m_file;
+		std::mutex m_mutex;
+		int m_count = 0;
+	};
+
+	class RCQueryLogReader
+	{
+	public:
+		bool open(const std::filesystem::path& filepath);
+		// false at the end of the log or on a truncated record
+		bool next(RCQueryRecord& record);
+	private:
+		std::ifstream m_file;
+	};
+}
@@ -0,0 +1,271 @@
+#include "RCRaycast.h"
+#include <Function/AgentNav/ChunkyTriMesh.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Core/ParallelFor.h>
+#include <Recast.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace GU
+{
+	static bool isectSegAABB(const float* sp, const float* sq,
+		const float* amin, const float* amax,
+		float& tmin, float& tmax)
+	{
+		static const float EPS = 1e-6f;
+
+		float d[3];
+		d[0] = sq[0] - sp[0];
+		d[1] = sq[1] - sp[1];
+		d[2] = sq[2] - sp[2];
+		tmin = 0.0;
+		tmax = 1.0f;
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (fabsf(d[i]) < EPS)
+			{
+				if (sp[i] < amin[i] || sp[i] > amax[i])
+					return false;
+			}
+			else
+			{
+				const float ood = 1.0f / d[i];
+				float t1 = (amin[i] - sp[i]) * ood;
+				float t2 = (amax[i] - sp[i]) * ood;
+				if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
+				if (t1 > tmin) tmin = t1;
+				if (t2 < tmax) tmax = t2;
+				if (tmin > tmax) return false;
+			}
+		}
+
+		return true;
+	}
+
+	static bool intersectSegmentTriangle(const float* sp, const float* sq,
+		const float* a, const float* b, const float* c,
+		float& t)
+	{
+		float v, w;
+		float ab[3], ac[3], qp[3], ap[3], norm[3], e[3];
+		rcVsub(ab, b, a);
+		rcVsub(ac, c, a);
+		rcVsub(qp, sp, sq);
+
+		// Compute triangle normal. Can be precalculated or cached if
+		// intersecting multiple segments against the same triangle
+		rcVcross(norm, ab, ac);
+
+		// Compute denominator d. If d <= 0, segment is parallel to or points
+		// away from triangle, so exit early
+		float d = rcVdot(qp, norm);
+		if (d <= 0.0f) return false;
+
+		// Compute intersection t value of pq with plane of triangle. A ray
+		// intersects iff 0 <= t. Segment intersects iff 0 <= t <= 1. Delay
+		// dividing by d until intersection has been found to pierce triangle
+		rcVsub(ap, sp, a);
+		t = rcVdot(ap, norm);
+		if (t < 0.0f) return false;
+		if (t > d) return false; // For segment; exclude this code line for a ray test
+
+		// Compute barycentric coordinate components and test if within bounds
+		rcVcross(e, qp, ap);
+		v = rcVdot(ac, e);
+		if (v < 0.0f || v > d) return false;
+		w = -rcVdot(ab, e);
+		if (w < 0.0f || v + w > d) return false;
+
+		// Segment/ray intersects triangle. Perform delayed division
+		t /= d;
+
+		return true;
+	}
+
+	bool raycastTriMesh(const rcChunkyTriMesh* chunkyMesh, const float* verts, const float* bmin, const float* bmax,
+		const float* src, const float* dst, float& tmin, int* tri)
+	{
+		// Prune hit ray.
+		float btmin, btmax;
+		if (!isectSegAABB(src, dst, bmin, bmax, btmin, btmax))
+			return false;
+		float p[2], q[2];
+		p[0] = src[0] + (dst[0] - src[0]) * btmin;
+		p[1] = src[2] + (dst[2] - src[2]) * btmin;
+		q[0] = src[0] + (dst[0] - src[0]) * btmax;
+		q[1] = src[2] + (dst[2] - src[2]) * btmax;
+
+		int cid[512];
+		const int ncid = rcGetChunksOverlappingSegment(chunkyMesh, p, q, cid, 512);
+		if (!ncid)
+			return false;
+
+		tmin = 1.0f;
+		bool hit = false;
+
+		for (int i = 0; i < ncid; ++i)
+		{
+			const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+			const int* tris = &chunkyMesh->tris[node.i * 3];
+			const int ntris = node.n;
+
+			for (int j = 0; j < ntris; j++)
+			{
+				float t = 1;
+				if (intersectSegmentTriangle(src, dst,
+					&verts[tris[j * 3] * 3],
+					&verts[tris[j * 3 + 1] * 3],
+					&verts[tris[j * 3 + 2] * 3], t))
+				{
+					if (!hit || t < tmin)
+					{
+						tmin = t;
+						if (tri) *tri = chunkyMesh->triIds[node.i + j];
+					}
+					hit = true;
+				}
+			}
+		}
+
+		return hit;
+	}
+
+	static unsigned int spreadBits16(unsigned int x)
+	{
+		x &= 0xffff;
+		x = (x | (x << 8)) & 0x00ff00ff;
+		x = (x | (x << 4)) & 0x0f0f0f0f;
+		x = (x | (x << 2)) & 0x33333333;
+		x = (x | (x << 1)) & 0x55555555;
+		return x;
+	}
+
+	int raycastTriMeshBatch(const rcChunkyTriMesh* chunkyMesh, const float* verts, const float* bmin, const float* bmax,
+		const float* src, const float* dst, int nrays, float* outT, int* outTri, ThreadPool* pool)
+	{
+		for (int i = 0; i < nrays; i++)
+		{
+			outT[i] = 1.0f;
+			outTri[i] = -1;
+		}
+		if (nrays <= 0 || chunkyMesh == nullptr) return 0;
+
+		// Sort rays along a morton curve of their midpoints, so that the rays
+		// in one packet overlap mostly the same chunks.
+		const float ext[2] = { bmax[0] - bmin[0], bmax[2] - bmin[2] };
+		const float qs[2] = { ext[0] > 0.0f ? 65535.0f / ext[0] : 0.0f, ext[1] > 0.0f ? 65535.0f / ext[1] : 0.0f };
+		std::vector<std::pair<unsigned int, int> > order(nrays);
+		for (int i = 0; i < nrays; i++)
+		{
+			const float mx = (src[i * 3 + 0] + dst[i * 3 + 0]) * 0.5f;
+			const float mz = (src[i * 3 + 2] + dst[i * 3 + 2]) * 0.5f;
+			const unsigned int qx = (unsigned int)rcClamp((mx - bmin[0]) * qs[0], 0.0f, 65535.0f);
+			const unsigned int qz = (unsigned int)rcClamp((mz - bmin[2]) * qs[1], 0.0f, 65535.0f);
+			order[i] = { spreadBits16(qx) | (spreadBits16(qz) << 1), i };
+		}
+		std::sort(order.begin(), order.end());
+
+		const int npackets = (nrays + RAY_PACKET_SIZE - 1) / RAY_PACKET_SIZE;
+		std::atomic<int> nhits(0);
+
+		parallelFor(pool, npackets, MAX_WORKERS, [&](int, int begin, int end)
+		{
+			static const int MAX_CHUNKS = 512;
+			int cid[MAX_CHUNKS];
+			int rays[RAY_PACKET_SIZE];
+			float p[RAY_PACKET_SIZE][2], q[RAY_PACKET_SIZE][2];
+			int localHits = 0;
+
+			auto castAgainstChunk = [&](int a, const rcChunkyTriMeshNode& node)
+			{
+				const int r = rays[a];
+				const float* sp = &src[r * 3];
+				const float* sq = &dst[r * 3];
+				const int* tris = &chunkyMesh->tris[node.i * 3];
+				for (int j = 0; j < node.n; j++)
+				{
+					float t = 1;
+					if (intersectSegmentTriangle(sp, sq,
+						&verts[tris[j * 3] * 3],
+						&verts[tris[j * 3 + 1] * 3],
+						&verts[tris[j * 3 + 2] * 3], t))
+					{
+						if (outTri[r] == -1 || t < outT[r])
+						{
+							outT[r] = t;
+							outTri[r] = chunkyMesh->triIds[node.i + j];
+						}
+					}
+				}
+			};
+
+			for (int packet = begin; packet < end; packet++)
+			{
+				const int first = packet * RAY_PACKET_SIZE;
+				const int last = std::min(first + RAY_PACKET_SIZE, nrays);
+				float rmin[2] = { FLT_MAX, FLT_MAX };
+				float rmax[2] = { -FLT_MAX, -FLT_MAX };
+				int nactive = 0;
+				for (int k = first; k < last; k++)
+				{
+					const int r = order[k].second;
+					const float* sp = &src[r * 3];
+					const float* sq = &dst[r * 3];
+					float btmin, btmax;
+					if (!isectSegAABB(sp, sq, bmin, bmax, btmin, btmax))
+						continue;
+					p[nactive][0] = sp[0] + (sq[0] - sp[0]) * btmin;
+					p[nactive][1] = sp[2] + (sq[2] - sp[2]) * btmin;
+					q[nactive][0] = sp[0] + (sq[0] - sp[0]) * btmax;
+					q[nactive][1] = sp[2] + (sq[2] - sp[2]) * btmax;
+					for (int c = 0; c < 2; c++)
+					{
+						rmin[c] = rcMin(rmin[c], rcMin(p[nactive][c], q[nactive][c]));
+						rmax[c] = rcMax(rmax[c], rcMax(p[nactive][c], q[nactive][c]));
+					}
+					rays[nactive++] = r;
+				}
+				if (!nactive) continue;
+
+				// Fetch the chunks once for the whole packet, each chunk is then tested
+				// against all rays of the packet while its triangles are hot in cache.
+				const int ncid = rcGetChunksOverlappingRect(chunkyMesh, rmin, rmax, cid, MAX_CHUNKS);
+				if (ncid < MAX_CHUNKS)
+				{
+					for (int i = 0; i < ncid; i++)
+					{
+						const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+						for (int a = 0; a < nactive; a++)
+						{
+							if (rcCheckChunkOverlapSegment(node, p[a], q[a]))
+								castAgainstChunk(a, node);
+						}
+					}
+				}
+				else
+				{
+					// The packet is too spread out, fall back to per ray traversal.
+					for (int a = 0; a < nactive; a++)
+					{
+						const int nseg = rcGetChunksOverlappingSegment(chunkyMesh, p[a], q[a], cid, MAX_CHUNKS);
+						for (int i = 0; i < nseg; i++)
+							castAgainstChunk(a, chunkyMesh->nodes[cid[i]]);
+					}
+				}
+
+				for (int a = 0; a < nactive; a++)
+				{
+					if (outTri[rays[a]] != -1)
+						localHits++;
+				}
+			}
+			nhits += localHits;
+		});
+
+		return nhits;
+	}
+}
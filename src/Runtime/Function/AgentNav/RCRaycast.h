@@ -0,0 +1,18 @@
+#pragma once
+struct rcChunkyTriMesh;
+class ThreadPool;
+
+namespace GU
+{
+	// Segment casts against the input triangle mesh through its chunky tree, bmin and
+	// bmax are the mesh bounds. t is the nearest hit along src..dst, tri the index of
+	// the hit triangle in the source triangle array.
+	bool raycastTriMesh(const rcChunkyTriMesh* chunkyMesh, const float* verts, const float* bmin, const float* bmax,
+		const float* src, const float* dst, float& tmin, int* tri = nullptr);
+	// Casts nrays segments (src/dst are 3 floats per ray) in packets of RAY_PACKET_SIZE
+	// rays sorted along a morton curve, so a packet shares one chunk lookup. Writes the
+	// hit t (1 when missed) and triangle (-1 when missed) for every ray, returns the hit
+	// count. pool == nullptr casts every packet on the calling thread, same result.
+	int raycastTriMeshBatch(const rcChunkyTriMesh* chunkyMesh, const float* verts, const float* bmin, const float* bmax,
+		const float* src, const float* dst, int nrays, float* outT, int* outTri, ThreadPool* pool);
+}
@@ -0,0 +1,245 @@
+#include "RCScenarioBatch.h"
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCDensityGrid.h>
+#include <Core/ParallelFor.h>
+#include <DetourCommon.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+
+namespace GU
+{
+	// target stream of a seed, the spawn points use the seed itself
+	static const uint64_t TARGET_SEED_SALT = 0x6a09e667f3bcc909ull;
+
+	struct RCScenarioBatch::Worker
+	{
+		RCCrowd crowd;
+		RCDensityGrid grid;
+		std::vector<float> starts;
+		std::vector<dtPolyRef> startRefs;
+		std::vector<float> targets;
+		std::vector<dtPolyRef> targetRefs;
+		std::vector<int> idx;
+		std::vector<float> lastPos;
+		std::vector<float> walked;
+	};
+
+	static inline uint64_t splitMix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	static float percentile(std::vector<float>& values, float p)
+	{
+		if (values.empty()) return 0.0f;
+		const size_t idx = (size_t)(p * (values.size() - 1) + 0.5f);
+		std::nth_element(values.begin(), values.begin() + idx, values.end());
+		return values[idx];
+	}
+
+	static float mean(const std::vector<float>& values)
+	{
+		double sum = 0.0;
+		for (float v : values) sum += v;
+		return values.empty() ? 0.0f : (float)(sum / values.size());
+	}
+
+	RCScenarioBatch::RCScenarioBatch() = default;
+
+	RCScenarioBatch::~RCScenarioBatch()
+	{
+		dtFreeNavMeshQuery(m_navQuery);
+	}
+
+	bool RCScenarioBatch::init(dtNavMesh* navMesh, float maxAgentRadius, const dtQueryFilter& filter)
+	{
+		m_navMesh = navMesh;
+		m_maxAgentRadius = maxAgentRadius;
+		m_filter = filter;
+		m_workers.clear();
+		if (m_navQuery == nullptr) m_navQuery = dtAllocNavMeshQuery();
+		if (m_navQuery == nullptr || dtStatusFailed(m_navQuery->init(navMesh, 2048))) return false;
+		if (!m_graph.build(navMesh)) return false;
+		m_sampler.build(m_graph, m_navQuery, &m_filter);
+
+		// density grid bounds
+		const dtNavMesh* nav = navMesh;
+		dtVset(m_bmin, FLT_MAX, FLT_MAX, FLT_MAX);
+		dtVset(m_bmax, -FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (int i = 0; i < nav->getMaxTiles(); i++)
+		{
+			const dtMeshTile* tile = nav->getTile(i);
+			if (!tile || !tile->header) continue;
+			dtVmin(m_bmin, tile->header->bmin);
+			dtVmax(m_bmax, tile->header->bmax);
+		}
+		return m_sampler.getTotalArea() > 0.0f;
+	}
+
+	std::vector<RCScenarioResult> RCScenarioBatch::run(const RCScenarioSpec& spec, int runs, uint64_t baseSeed,
+		ThreadPool* pool, int maxWorkers)
+	{
+		std::vector<RCScenarioResult> results;
+		if (runs <= 0 || m_navMesh == nullptr) return results;
+
+		// exits are snapped once, same extents as the crowd
+		const float ext[3] = { m_maxAgentRadius * 2.0f, m_maxAgentRadius * 1.5f, m_maxAgentRadius * 2.0f };
+		m_exits.clear();
+		m_exitRefs.clear();
+		for (size_t i = 0; i + 2 < spec.exits.size(); i += 3)
+		{
+			dtPolyRef ref = 0;
+			float pos[3];
+			m_navQuery->findNearestPoly(&spec.exits[i], ext, &m_filter, &ref, pos);
+			if (!ref) continue;
+			m_exits.insert(m_exits.end(), pos, pos + 3);
+			m_exitRefs.push_back(ref);
+		}
+		if (!spec.exits.empty() && m_exitRefs.empty()) return results;
+
+		results.resize(runs);
+		const int nworkers = std::max(1, std::min(maxWorkers, runs));
+		while ((int)m_workers.size() < nworkers)
+			m_workers.push_back(std::make_unique<Worker>());
+
+		// runs take very different times, so workers pull the next seed instead of a fixed range
+		std::atomic<int> next{ 0 };
+		parallelFor(pool, nworkers, nworkers, [&](int, int begin, int end)
+		{
+			for (int w = begin; w < end; w++)
+			{
+				for (int i = next++; i < runs; i = next++)
+					runScenario(spec, baseSeed + i, *m_workers[w], results[i]);
+			}
+		});
+		return results;
+	}
+
+	void RCScenarioBatch::runScenario(const RCScenarioSpec& spec, uint64_t seed, Worker& worker, RCScenarioResult& result)
+	{
+		result = RCScenarioResult();
+		result.seed = seed;
+		const int n = spec.agentCount;
+		RCCrowd& crowd = worker.crowd;
+		if (n <= 0 || !crowd.init(n, m_maxAgentRadius, m_navMesh)) return;
+		*crowd.getEditableFilter(0) = m_filter;
+		crowd.initAvoidanceQualities();
+		crowd.replanBudgetMs = 0.0f;
+		worker.grid.init(m_bmin, m_bmax, spec.densityCellSize, n);
+
+		worker.starts.resize(n * 3);
+		worker.startRefs.resize(n);
+		worker.targets.resize(n * 3);
+		worker.targetRefs.resize(n);
+		int count = m_sampler.sample(spec.spawnQuery, n, seed, worker.starts.data(), worker.startRefs.data());
+		if (m_exitRefs.empty())
+		{
+			count = m_sampler.sample(RCNavSampleQuery(), count, seed ^ TARGET_SEED_SALT, worker.targets.data(), worker.targetRefs.data());
+		}
+		else
+		{
+			uint64_t state = seed ^ TARGET_SEED_SALT;
+			for (int i = 0; i < count; i++)
+			{
+				const int exit = (int)(splitMix64(state) % m_exitRefs.size());
+				dtVcopy(&worker.targets[i * 3], &m_exits[exit * 3]);
+				worker.targetRefs[i] = m_exitRefs[exit];
+			}
+		}
+
+		worker.idx.assign(count, -1);
+		worker.lastPos.assign(worker.starts.begin(), worker.starts.begin() + count * 3);
+		worker.walked.assign(count, 0.0f);
+		for (int i = 0; i < count; i++)
+		{
+			const int idx = crowd.addAgent(&worker.starts[i * 3], &spec.agentParams);
+			if (idx == -1) continue;
+			if (!crowd.requestMoveTarget(idx, worker.targetRefs[i], &worker.targets[i * 3]))
+			{
+				crowd.removeAgent(idx);
+				continue;
+			}
+			worker.idx[i] = idx;
+			dtVcopy(&worker.lastPos[i * 3], crowd.getAgent(idx)->npos);
+			result.agents++;
+		}
+
+		const float arriveSqr = spec.arriveRadius * spec.arriveRadius;
+		int active = result.agents;
+		float time = 0.0f;
+		float lastArrival = 0.0f;
+		while (result.ticks < spec.maxTicks && active > 0)
+		{
+			crowd.update(spec.dt, nullptr);
+			result.ticks++;
+			result.agentUpdates += active;
+			time += spec.dt;
+
+			for (int i = 0; i < count; i++)
+			{
+				const int idx = worker.idx[i];
+				if (idx == -1) continue;
+				const dtCrowdAgent* ag = crowd.getAgent(idx);
+				float* last = &worker.lastPos[i * 3];
+				worker.walked[i] += dtVdist2D(last, ag->npos);
+				dtVcopy(last, ag->npos);
+				if (dtVdistSqr(ag->npos, &worker.targets[i * 3]) < arriveSqr)
+				{
+					worker.grid.updateAgent(idx, ag->npos, false);
+					crowd.removeAgent(idx);
+					worker.idx[i] = -1;
+					result.arrivalTimes.push_back(time);
+					result.pathLengths.push_back(worker.walked[i]);
+					result.arrived++;
+					active--;
+					lastArrival = time;
+					continue;
+				}
+				worker.grid.updateAgent(idx, ag->npos, true);
+			}
+
+			// fullest cell of this tick, only cells holding an agent can be it
+			for (int i = 0; i < count; i++)
+			{
+				if (worker.idx[i] == -1) continue;
+				const int cell = worker.grid.getCellAt(&worker.lastPos[i * 3]);
+				if (cell != -1) result.peakDensity = std::max(result.peakDensity, worker.grid.getDensity(cell));
+			}
+		}
+		result.evacuationTime = active == 0 ? lastArrival : time;
+	}
+
+	RCScenarioSummary RCScenarioBatch::summarize(const std::vector<RCScenarioResult>& results)
+	{
+		RCScenarioSummary summary;
+		std::vector<float> evacuation;
+		std::vector<float> peaks;
+		std::vector<float> arrivals;
+		std::vector<float> lengths;
+		for (const RCScenarioResult& result : results)
+		{
+			summary.runs++;
+			summary.agents += result.agents;
+			summary.arrived += result.arrived;
+			summary.agentUpdates += result.agentUpdates;
+			evacuation.push_back(result.evacuationTime);
+			peaks.push_back(result.peakDensity);
+			arrivals.insert(arrivals.end(), result.arrivalTimes.begin(), result.arrivalTimes.end());
+			lengths.insert(lengths.end(), result.pathLengths.begin(), result.pathLengths.end());
+		}
+		summary.evacuationMean = mean(evacuation);
+		summary.evacuationP50 = percentile(evacuation, 0.5f);
+		summary.evacuationP90 = percentile(evacuation, 0.9f);
+		summary.evacuationMax = percentile(evacuation, 1.0f);
+		summary.peakDensityMean = mean(peaks);
+		summary.peakDensityMax = percentile(peaks, 1.0f);
+		summary.arrivalMean = mean(arrivals);
+		summary.pathLengthMean = mean(lengths);
+		summary.pathLengthP90 = percentile(lengths, 0.9f);
+		return summary;
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <DetourCrowd.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCNavSampler.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+class ThreadPool;
+
+namespace GU
+{
+	// one randomized crowd run: agents spawn at random navmesh points and walk to exits
+	struct RCScenarioSpec
+	{
+		int agentCount = 100;
+		RCNavSampleQuery spawnQuery;
+		// 3 floats per exit, every agent picks one at random. Random navmesh points when empty.
+		std::vector<float> exits;
+		dtCrowdAgentParams agentParams;
+		float dt = 1.0f / SIM_TICK_RATE;
+		int maxTicks = 36000;
+		float arriveRadius = AGENT_ARRIVE_RADIUS;
+		float densityCellSize = DENSITY_CELL_SIZE;
+	};
+
+	struct RCScenarioResult
+	{
+		uint64_t seed = 0;
+		int agents = 0;
+		int arrived = 0;
+		int ticks = 0;
+		uint64_t agentUpdates = 0;
+		float evacuationTime = 0.0f;	// last arrival, the whole run when agents are left
+		float peakDensity = 0.0f;		// agents per square meter in the fullest cell
+		std::vector<float> arrivalTimes;
+		std::vector<float> pathLengths;	// meters walked by the arrived agents
+	};
+
+	struct RCScenarioSummary
+	{
+		int runs = 0;
+		uint64_t agents = 0;
+		uint64_t arrived = 0;
+		uint64_t agentUpdates = 0;
+		// evacuation time over runs
+		float evacuationMean = 0.0f;
+		float evacuationP50 = 0.0f;
+		float evacuationP90 = 0.0f;
+		float evacuationMax = 0.0f;
+		// peak density over runs
+		float peakDensityMean = 0.0f;
+		float peakDensityMax = 0.0f;
+		// over every arrived agent of every run
+		float arrivalMean = 0.0f;
+		float pathLengthMean = 0.0f;
+		float pathLengthP90 = 0.0f;
+	};
+
+	// Monte Carlo runs of one scenario on a thread pool. The navmesh, its graph, the
+	// spawn sampler and the snapped exits are built once and only read by the runs.
+	// Every worker owns a crowd and a density grid that it reuses for the runs it
+	// takes, so memory grows with the worker count and not with the runs. Crowds
+	// update serially inside a run without the replanning time budget, the result of
+	// a seed does not depend on the thread count.
+	class RCScenarioBatch
+	{
+	public:
+		RCScenarioBatch();
+		~RCScenarioBatch();
+		RCScenarioBatch(const RCScenarioBatch&) = delete;
+		RCScenarioBatch& operator=(const RCScenarioBatch&) = delete;
+
+		// navMesh has to outlive the batch, filter is used for sampling and the crowds
+		bool init(dtNavMesh* navMesh, float maxAgentRadius, const dtQueryFilter& filter);
+		// runs with seeds baseSeed .. baseSeed + runs - 1, results are in seed order
+		std::vector<RCScenarioResult> run(const RCScenarioSpec& spec, int runs, uint64_t baseSeed,
+			ThreadPool* pool = nullptr, int maxWorkers = 1);
+
+		static RCScenarioSummary summarize(const std::vector<RCScenarioResult>& results);
+	private:
+		struct Worker;
+		void runScenario(const RCScenarioSpec& spec, uint64_t seed, Worker& worker, RCScenarioResult& result);
+
+		dtNavMesh* m_navMesh = nullptr;
+		dtNavMeshQuery* m_navQuery = nullptr;
+		float m_maxAgentRadius = 0.0f;
+		dtQueryFilter m_filter;
+		float m_bmin[3] = {};
+		float m_bmax[3] = {};
+		RCNavGraph m_graph;
+		RCNavSampler m_sampler;
+		std::vector<float> m_exits;	// snapped, 3 floats each
+		std::vector<dtPolyRef> m_exitRefs;
+		std::vector<std::unique_ptr<Worker> > m_workers;
+	};
+}
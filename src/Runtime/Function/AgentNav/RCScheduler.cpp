@@ -9,6 +9,26 @@
 #include <Function/AgentNav/RCData.h>
 #include <MainWindow.h>
 #include <Function/AgentNav/ChunkyTriMesh.h>
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCNavIslands.h>
+#include <Function/AgentNav/RCLandmarks.h>
+#include <Function/AgentNav/RCPathHierarchy.h>
+#include <Function/AgentNav/RCQueryLog.h>
+#include <Function/AgentNav/RCNavMeshIO.h>
+#include <Function/AgentNav/RCNavSampler.h>
+#include <Function/AgentNav/RCNavSnapGrid.h>
+#include <Function/AgentNav/RCPathSmoother.h>
+#include <Function/AgentNav/RCShardedCrowd.h>
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCSimLoop.h>
+#include <Function/AgentNav/RCTrajectory.h>
+#include <Function/AgentNav/RCDensityGrid.h>
+#include <Function/AgentNav/RCChecksum.h>
+#include <Function/AgentNav/RCSimLod.h>
+#include <Function/AgentNav/RCCheckpoint.h>
+#include <Function/AgentNav/RCAgentEvents.h>
+#include <Function/AgentNav/RCNavMeshBuild.h>
+#include <Function/AgentNav/RCRaycast.h>
 #define GLM_ENABLE_EXPERIMENTAL
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -24,83 +44,13 @@
 #include <yaml-cpp/yaml.h>
 #include <filesystem>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <Global/CoreContext.h>
+#include <Core/ParallelFor.h>
 namespace GU
 {
-	static bool isectSegAABB(const float* sp, const float* sq,
-		const float* amin, const float* amax,
-		float& tmin, float& tmax)
-	{
-		static const float EPS = 1e-6f;
-
-		float d[3];
-		d[0] = sq[0] - sp[0];
-		d[1] = sq[1] - sp[1];
-		d[2] = sq[2] - sp[2];
-		tmin = 0.0;
-		tmax = 1.0f;
-
-		for (int i = 0; i < 3; i++)
-		{
-			if (fabsf(d[i]) < EPS)
-			{
-				if (sp[i] < amin[i] || sp[i] > amax[i])
-					return false;
-			}
-			else
-			{
-				const float ood = 1.0f / d[i];
-				float t1 = (amin[i] - sp[i]) * ood;
-				float t2 = (amax[i] - sp[i]) * ood;
-				if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
-				if (t1 > tmin) tmin = t1;
-				if (t2 < tmax) tmax = t2;
-				if (tmin > tmax) return false;
-			}
-		}
-
-		return true;
-	}
-
-	static bool intersectSegmentTriangle(const float* sp, const float* sq,
-		const float* a, const float* b, const float* c,
-		float& t)
-	{
-		float v, w;
-		float ab[3], ac[3], qp[3], ap[3], norm[3], e[3];
-		rcVsub(ab, b, a);
-		rcVsub(ac, c, a);
-		rcVsub(qp, sp, sq);
-
-		// Compute triangle normal. Can be precalculated or cached if
-		// intersecting multiple segments against the same triangle
-		rcVcross(norm, ab, ac);
-
-		// Compute denominator d. If d <= 0, segment is parallel to or points
-		// away from triangle, so exit early
-		float d = rcVdot(qp, norm);
-		if (d <= 0.0f) return false;
-
-		// Compute intersection t value of pq with plane of triangle. A ray
-		// intersects iff 0 <= t. Segment intersects iff 0 <= t <= 1. Delay
-		// dividing by d until intersection has been found to pierce triangle
-		rcVsub(ap, sp, a);
-		t = rcVdot(ap, norm);
-		if (t < 0.0f) return false;
-		if (t > d) return false; // For segment; exclude this code line for a ray test
-
-		// Compute barycentric coordinate components and test if within bounds
-		rcVcross(e, qp, ap);
-		v = rcVdot(ac, e);
-		if (v < 0.0f || v > d) return false;
-		w = -rcVdot(ab, e);
-		if (w < 0.0f || v + w > d) return false;
-
-		// Segment/ray intersects triangle. Perform delayed division
-		t /= d;
-
-		return true;
-	}
-
 	static void calcVel(float* vel, const float* pos, const float* tgt, const float speed)
 	{
 		dtVsub(vel, tgt, pos);
@@ -109,166 +59,6 @@ namespace GU
 		dtVscale(vel, vel, speed);
 	}
 
-	static bool inRange(const float* v1, const float* v2, const float r, const float h)
-	{
-		const float dx = v2[0] - v1[0];
-		const float dy = v2[1] - v1[1];
-		const float dz = v2[2] - v1[2];
-		return (dx * dx + dz * dz) < r * r && fabsf(dy) < h;
-	}
-
-	static bool getSteerTarget(dtNavMeshQuery* navQuery, const float* startPos, const float* endPos,
-		const float minTargetDist,
-		const dtPolyRef* path, const int pathSize,
-		float* steerPos, unsigned char& steerPosFlag, dtPolyRef& steerPosRef,
-		float* outPoints = 0, int* outPointCount = 0)
-	{
-		// Find steer target.
-		static const int MAX_STEER_POINTS = 3;
-		float steerPath[MAX_STEER_POINTS * 3];
-		unsigned char steerPathFlags[MAX_STEER_POINTS];
-		dtPolyRef steerPathPolys[MAX_STEER_POINTS];
-		int nsteerPath = 0;
-		navQuery->findStraightPath(startPos, endPos, path, pathSize,
-			steerPath, steerPathFlags, steerPathPolys, &nsteerPath, MAX_STEER_POINTS);
-		if (!nsteerPath)
-			return false;
-
-		if (outPoints && outPointCount)
-		{
-			*outPointCount = nsteerPath;
-			for (int i = 0; i < nsteerPath; ++i)
-				dtVcopy(&outPoints[i * 3], &steerPath[i * 3]);
-		}
-
-
-		// Find vertex far enough to steer to.
-		int ns = 0;
-		while (ns < nsteerPath)
-		{
-			// Stop at Off-Mesh link or when point is further than slop away.
-			if ((steerPathFlags[ns] & DT_STRAIGHTPATH_OFFMESH_CONNECTION) ||
-				!inRange(&steerPath[ns * 3], startPos, minTargetDist, 1000.0f))
-				break;
-			ns++;
-		}
-		// Failed to find good point to steer to.
-		if (ns >= nsteerPath)
-			return false;
-
-		dtVcopy(steerPos, &steerPath[ns * 3]);
-		steerPos[1] = startPos[1];
-		steerPosFlag = steerPathFlags[ns];
-		steerPosRef = steerPathPolys[ns];
-
-		return true;
-	}
-
-	static int fixupCorridor(dtPolyRef* path, const int npath, const int maxPath,
-		const dtPolyRef* visited, const int nvisited)
-	{
-		int furthestPath = -1;
-		int furthestVisited = -1;
-
-		// Find furthest common polygon.
-		for (int i = npath - 1; i >= 0; --i)
-		{
-			bool found = false;
-			for (int j = nvisited - 1; j >= 0; --j)
-			{
-				if (path[i] == visited[j])
-				{
-					furthestPath = i;
-					furthestVisited = j;
-					found = true;
-				}
-			}
-			if (found)
-				break;
-		}
-
-		// If no intersection found just return current path. 
-		if (furthestPath == -1 || furthestVisited == -1)
-			return npath;
-
-		// Concatenate paths.	
-
-		// Adjust beginning of the buffer to include the visited.
-		const int req = nvisited - furthestVisited;
-		const int orig = rcMin(furthestPath + 1, npath);
-		int size = rcMax(0, npath - orig);
-		if (req + size > maxPath)
-			size = maxPath - req;
-		if (size)
-			memmove(path + req, path + orig, size * sizeof(dtPolyRef));
-
-		// Store visited
-		for (int i = 0; i < req; ++i)
-			path[i] = visited[(nvisited - 1) - i];
-
-		return req + size;
-	}
-
-	// This function checks if the path has a small U-turn, that is,
-	// a polygon further in the path is adjacent to the first polygon
-	// in the path. If that happens, a shortcut is taken.
-	// This can happen if the target (T) location is at tile boundary,
-	// and we're (S) approaching it parallel to the tile edge.
-	// The choice at the vertex can be arbitrary, 
-	//  +---+---+
-	//  |:::|:::|
-	//  +-S-+-T-+
-	//  |:::|   | <-- the step can end up in here, resulting U-turn path.
-	//  +---+---+
-	static int fixupShortcuts(dtPolyRef* path, int npath, dtNavMeshQuery* navQuery)
-	{
-		if (npath < 3)
-			return npath;
-
-		// Get connected polygons
-		static const int maxNeis = 16;
-		dtPolyRef neis[maxNeis];
-		int nneis = 0;
-
-		const dtMeshTile* tile = 0;
-		const dtPoly* poly = 0;
-		if (dtStatusFailed(navQuery->getAttachedNavMesh()->getTileAndPolyByRef(path[0], &tile, &poly)))
-			return npath;
-
-		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
-		{
-			const dtLink* link = &tile->links[k];
-			if (link->ref != 0)
-			{
-				if (nneis < maxNeis)
-					neis[nneis++] = link->ref;
-			}
-		}
-
-		// If any of the neighbour polygons is within the next few polygons
-		// in the path, short cut to that polygon directly.
-		static const int maxLookAhead = 6;
-		int cut = 0;
-		for (int i = dtMin(maxLookAhead, npath) - 1; i > 1 && cut == 0; i--) {
-			for (int j = 0; j < nneis; j++)
-			{
-				if (path[i] == neis[j]) {
-					cut = i;
-					break;
-				}
-			}
-		}
-		if (cut > 1)
-		{
-			int offset = cut - 1;
-			npath -= offset;
-			for (int i = 1; i < npath; i++)
-				path[i] = path[i + offset];
-		}
-
-		return npath;
-	}
-
 
 	RCScheduler::RCScheduler()
 	{
@@ -277,7 +67,7 @@ namespace GU
 		m_navQuery = dtAllocNavMeshQuery();
 
 		// crowd
-		m_crowd = dtAllocCrowd();
+		m_crowd = new RCCrowd();
 		m_targetRef = 0;
 		m_vod = dtAllocObstacleAvoidanceDebugData();
 		m_vod->init(2048);
@@ -285,10 +75,20 @@ namespace GU
 		m_agentDebug.idx = -1;
 		m_agentDebug.vod = m_vod;
 	}
+	RCScheduler::~RCScheduler()
+	{
+		// the simulation thread must not outlive the crowd
+		stopSimLoop();
+		// flushes the last trajectory chunk
+		stopTrajectoryRecord();
+		stopQueryLog();
+	}
+
 	bool RCScheduler::handelBuild(const RCParams& rcparams, Mesh* mesh)
 	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
 		m_rcparams = rcparams;
-		GLOBAL_MAINWINDOW->progressBegin(7);
+		GLOBAL_MAINWINDOW->progressBegin(NAVMESH_BUILD_STEPS);
 		GLOBAL_MAINWINDOW->setStatus(QString::fromLocal8Bit("ʼ"));
 		createRCMesh(mesh, m_mesh);
 
@@ -311,430 +111,142 @@ namespace GU
 		rcCalcBounds(m_mesh.getVerts(), m_mesh.getVertCount(), bmin, bmax);
 		rcVcopy(m_meshBMin, bmin);
 		rcVcopy(m_meshBMax, bmax);
-		//
-		// Step 1. Initialize build config.
-		//
-
-		// Init build configuration from GUI
-		auto timestart = clock();
-		memset(&m_cfg, 0, sizeof(m_cfg));
-		m_cfg.cs = rcparams.m_cellSize;
-		m_cfg.ch = rcparams.m_cellHeight;
-		m_cfg.walkableSlopeAngle = rcparams.m_agentMaxSlope;
-		m_cfg.walkableHeight = (int)ceilf(rcparams.m_agentHeight / m_cfg.ch);
-		m_cfg.walkableClimb = (int)floorf(rcparams.m_agentMaxClimb / m_cfg.ch);
-		m_cfg.walkableRadius = (int)ceilf(rcparams.m_agentRadius / m_cfg.cs);
-		m_cfg.maxEdgeLen = (int)(rcparams.m_edgeMaxLen / rcparams.m_cellSize);
-		m_cfg.maxSimplificationError = rcparams.m_edgeMaxError;
-		m_cfg.minRegionArea = (int)rcSqr(rcparams.m_regionMinSize);		// Note: area = size*size
-		m_cfg.mergeRegionArea = (int)rcSqr(rcparams.m_regionMergeSize);	// Note: area = size*size
-		m_cfg.maxVertsPerPoly = (int)rcparams.m_vertsPerPoly;
-		m_cfg.detailSampleDist = rcparams.m_detailSampleDist < 0.9f ? 0 : rcparams.m_cellSize * rcparams.m_detailSampleDist;
-		m_cfg.detailSampleMaxError = rcparams.m_cellHeight * rcparams.m_detailSampleMaxError;
-
-		// Set the area where the navigation will be build.
-		// Here the bounds of the input mesh are used, but the
-		// area could be specified by an user defined box, etc.
-		rcVcopy(m_cfg.bmin, bmin);
-		rcVcopy(m_cfg.bmax, bmax);
-		rcCalcGridSize(m_cfg.bmin, m_cfg.bmax, m_cfg.cs, &m_cfg.width, &m_cfg.height);
-
 		// Reset build times gathering.
 		m_ctx->resetTimers();
-
-		// Start the build process.	
 		m_ctx->startTimer(RC_TIMER_TOTAL);
-		m_ctx->log(RC_LOG_PROGRESS, "Building navigation:");
-		m_ctx->log(RC_LOG_PROGRESS, " - %d x %d cells", m_cfg.width, m_cfg.height);
-		m_ctx->log(RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts / 1000.0f, ntris / 1000.0f);
-
-		GLOBAL_MAINWINDOW->progressTick();
-
-		// Step 2. Rasterize input polygon soup.
-		//
-		// Allocate voxel heightfield where we rasterize our input data to.
-		timestart = clock();
-		m_solid = rcAllocHeightfield();
-		if (!m_solid)
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
-			return false;
-		}
-		if (!rcCreateHeightfield(m_ctx, *m_solid, m_cfg.width, m_cfg.height, m_cfg.bmin, m_cfg.bmax, m_cfg.cs, m_cfg.ch))
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
-			return false;
-		}
-
-		// Allocate array that can hold triangle area types.
-		// If you have multiple meshes you need to process, allocate
-		// and array which can hold the max number of triangles you need to process.
-		m_triareas = new unsigned char[ntris];
-		if (!m_triareas)
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", ntris);
-			return false;
-		}
-
-		// Find triangles which are walkable based on their slope and rasterize them.
-		// If your input data is multiple meshes, you can transform them here, calculate
-		// the are type for each of the meshes and rasterize them.
-		memset(m_triareas, 0, ntris * sizeof(unsigned char));
-		rcMarkWalkableTriangles(m_ctx, m_cfg.walkableSlopeAngle, verts, nverts, tris, ntris, m_triareas);
-		if (!rcRasterizeTriangles(m_ctx, verts, nverts, tris, m_triareas, ntris, *m_solid, m_cfg.walkableClimb))
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not rasterize triangles.");
-			return false;
-		}
-
-
-		if (!rcparams.m_keepInterResults)
-		{
-			delete[] m_triareas;
-			m_triareas = 0;
-		}
-
-		auto timeend = clock();
-		GLOBAL_MAINWINDOW->progressTick();
-
-		auto timedelta = (timeend - timestart);
-		qDebug() << "Build nav mesh step2: " << timedelta << "ms";
-		//
-		// Step 3. Filter walkables surfaces.
-		//
-
-		// Once all geoemtry is rasterized, we do initial pass of filtering to
-		// remove unwanted overhangs caused by the conservative rasterization
-		// as well as filter spans where the character cannot possibly stand.
-		timestart = clock();
-		if (rcparams.m_filterLowHangingObstacles)
-			rcFilterLowHangingWalkableObstacles(m_ctx, m_cfg.walkableClimb, *m_solid);
-		if (rcparams.m_filterLedgeSpans)
-			rcFilterLedgeSpans(m_ctx, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid);
-		if (rcparams.m_filterWalkableLowHeightSpans)
-			rcFilterWalkableLowHeightSpans(m_ctx, m_cfg.walkableHeight, *m_solid);
-
-		GLOBAL_MAINWINDOW->progressTick();
-		timeend = clock();
-		timedelta = (timeend - timestart);
-		qDebug() << "Build nav mesh step3: " << timedelta << "ms";
-		//
-		// Step 4. Partition walkable surface to simple regions.
-		//
-
-		// Compact the heightfield so that it is faster to handle from now on.
-		// This will result more cache coherent data as well as the neighbours
-		// between walkable cells will be calculated.
-		timestart = clock();
-		m_chf = rcAllocCompactHeightfield();
-		if (!m_chf)
+		RCBuildData data;
+		dtNavMesh* navMesh = buildNavMesh(m_ctx, rcparams, verts, nverts, tris, ntris, &data,
+			[]() { GLOBAL_MAINWINDOW->progressTick(); });
+		m_ctx->stopTimer(RC_TIMER_TOTAL);
+		GLOBAL_MAINWINDOW->progressEnd();
+		if (navMesh == nullptr) return false;
+		if (dtStatusFailed(m_navQuery->init(navMesh, 2048)))
 		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
+			m_ctx->log(RC_LOG_ERROR, "Could not init Detour navmesh query");
+			dtFreeNavMesh(navMesh);
 			return false;
 		}
-		if (!rcBuildCompactHeightfield(m_ctx, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid, *m_chf))
+		m_navMesh = navMesh;
+		m_cfg = data.cfg;
+
+		// intermediate results for rendering, the Recast data itself is only kept on request
+		m_heightFieldSolid = new RCHeightfieldSolid(*data.solid);
+		m_TCompatField = new RCTCompactField(*data.chf);
+		m_tContours = new RCTContours(*data.cset);
+		m_polymesh = new RCMesh(*data.dmesh);
+		m_polyContourMesh = new RCContour(*data.dmesh);
+
+		rcFreeHeightField(m_solid);
+		rcFreeCompactHeightfield(m_chf);
+		rcFreeContourSet(m_cset);
+		rcFreePolyMesh(m_pmesh);
+		rcFreePolyMeshDetail(m_dmesh);
+		m_solid = nullptr;
+		m_chf = nullptr;
+		m_cset = nullptr;
+		if (rcparams.m_keepInterResults)
 		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
-			return false;
+			std::swap(m_solid, data.solid);
+			std::swap(m_chf, data.chf);
+			std::swap(m_cset, data.cset);
 		}
+		m_pmesh = data.pmesh;
+		m_dmesh = data.dmesh;
+		data.pmesh = nullptr;
+		data.dmesh = nullptr;
 
-		m_heightFieldSolid = new RCHeightfieldSolid(*m_solid);
 
-		if (!rcparams.m_keepInterResults)
-		{
-			rcFreeHeightField(m_solid);
-			m_solid = 0;
-		}
-
-		// Erode the walkable area by agent radius.
-		if (!rcErodeWalkableArea(m_ctx, m_cfg.walkableRadius, *m_chf))
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not erode.");
-			return false;
-		}
-		
 
-		// Partition the heightfield so that we can use simple algorithm later to triangulate the walkable areas.
-		// There are 3 martitioning methods, each with some pros and cons:
-		// 1) Watershed partitioning
-		//   - the classic Recast partitioning
-		//   - creates the nicest tessellation
-		//   - usually slowest
-		//   - partitions the heightfield into nice regions without holes or overlaps
-		//   - the are some corner cases where this method creates produces holes and overlaps
-		//      - holes may appear when a small obstacles is close to large open area (triangulation can handle this)
-		//      - overlaps may occur if you have narrow spiral corridors (i.e stairs), this make triangulation to fail
-		//   * generally the best choice if you precompute the nacmesh, use this if you have large open areas
-		// 2) Monotone partioning
-		//   - fastest
-		//   - partitions the heightfield into regions without holes and overlaps (guaranteed)
-		//   - creates long thin polygons, which sometimes causes paths with detours
-		//   * use this if you want fast navmesh generation
-		// 3) Layer partitoining
-		//   - quite fast
-		//   - partitions the heighfield into non-overlapping regions
-		//   - relies on the triangulation code to cope with holes (thus slower than monotone partitioning)
-		//   - produces better triangles than monotone partitioning
-		//   - does not have the corner cases of watershed partitioning
-		//   - can be slow and create a bit ugly tessellation (still better than monotone)
-		//     if you have large open areas with small obstacles (not a problem if you use tiles)
-		//   * good choice to use for tiled navmesh with medium and small sized tiles
-
-		if (rcparams.m_partitionType == SAMPLE_PARTITION_WATERSHED)
-		{
-			// Prepare for region partitioning, by calculating distance field along the walkable surface.
-			if (!rcBuildDistanceField(m_ctx, *m_chf))
-			{
-				m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build distance field.");
-				return false;
-			}
+		// init crowd
+		m_crowd->init(MAX_AGENTS, rcparams.m_agentRadius, m_navMesh);
+		m_crowd->getEditableFilter(0)->setExcludeFlags(SAMPLE_POLYFLAGS_DISABLED);
+		// Setup local avoidance params to different qualities.
+		m_crowd->initAvoidanceQualities();
+		isAgentStateDirty = true;
 
-			// Partition the walkable surface into simple regions without holes.
-			if (!rcBuildRegions(m_ctx, *m_chf, 0, m_cfg.minRegionArea, m_cfg.mergeRegionArea))
-			{
-				m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build watershed regions.");
-				return false;
-			}
-		}
-		else if (rcparams.m_partitionType == SAMPLE_PARTITION_MONOTONE)
+		// sharded crowd, same filter and avoidance settings on every shard
+		if (isUseShardedCrowd)
 		{
-			// Partition the walkable surface into simple regions without holes.
-			// Monotone partitioning does not need distancefield.
-			if (!rcBuildRegionsMonotone(m_ctx, *m_chf, 0, m_cfg.minRegionArea, m_cfg.mergeRegionArea))
+			if (m_shardedCrowd == nullptr) m_shardedCrowd = new RCShardedCrowd();
+			m_shardedCrowd->init(MAX_CROWD_AGENTS, rcparams.m_agentRadius, m_navMesh, CROWD_SHARDS_X, CROWD_SHARDS_Z);
+			for (int i = 0; i < m_shardedCrowd->getShardCount(); i++)
 			{
-				m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build monotone regions.");
-				return false;
+				RCCrowd* shard = m_shardedCrowd->getShard(i);
+				*shard->getEditableFilter(0) = *m_crowd->getFilter(0);
+				for (int j = 0; j < 4; j++)
+					shard->setObstacleAvoidanceParams(j, m_crowd->getObstacleAvoidanceParams(j));
+				shard->replanBudgetMs = m_crowd->replanBudgetMs;
+				shard->replanBudgetNodes = m_crowd->replanBudgetNodes;
 			}
 		}
-		else // SAMPLE_PARTITION_LAYERS
+		else if (m_shardedCrowd)
 		{
-			// Partition the walkable surface into simple regions without holes.
-			if (!rcBuildLayerRegions(m_ctx, *m_chf, 0, m_cfg.minRegionArea))
-			{
-				m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build layer regions.");
-				return false;
-			}
+			delete m_shardedCrowd;
+			m_shardedCrowd = nullptr;
 		}
 
-		GLOBAL_MAINWINDOW->progressTick();
-		timeend = clock();
-		timedelta = (timeend - timestart);
-		qDebug() << "Build nav mesh step4: " << timedelta << "ms";
-		m_TCompatField = new RCTCompactField(*m_chf);
-		//
-		// Step 5. Trace and simplify region contours.
-		//
-
-		// Create contours.
+		// reachability islands
+		if (m_navGraph == nullptr) m_navGraph = new RCNavGraph();
+		if (m_navIslands == nullptr) m_navIslands = new RCNavIslands();
+		m_navGraph->build(m_navMesh);
+		const dtQueryFilter* islandFilters[ISLAND_FILTER_COUNT] = { m_crowd->getFilter(0), &m_defaultFilter };
+		m_navIslands->build(*m_navGraph, islandFilters, ISLAND_FILTER_COUNT);
+		qDebug() << "Navmesh islands: " << m_navIslands->getIslandCount(ISLAND_FILTER_CROWD);
+
+		// landmarks
+		if (m_landmarks == nullptr) m_landmarks = new RCLandmarks();
+		if (m_pathSearch == nullptr) m_pathSearch = new RCPathSearch();
+		clock_t timestart = clock();
+		clock_t timedelta;
+		m_landmarks->build(*m_navGraph, NUM_LANDMARKS);
+		m_pathSearch->init(m_navMesh, 2048);
+		timedelta = (clock() - timestart);
+		qDebug() << "Build landmarks: " << timedelta << "ms, " << m_landmarks->getMemorySize() << "bytes";
+
+		// path hierarchy
+		if (m_pathHierarchy == nullptr) m_pathHierarchy = new RCPathHierarchy();
 		timestart = clock();
-		m_cset = rcAllocContourSet();
-		if (!m_cset)
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'cset'.");
-			return false;
-		}
-		if (!rcBuildContours(m_ctx, *m_chf, m_cfg.maxSimplificationError, m_cfg.maxEdgeLen, *m_cset))
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not create contours.");
-			return false;
-		}
-		GLOBAL_MAINWINDOW->progressTick();
-		m_tContours = new RCTContours(*m_cset);
-		timeend = clock();
-		timedelta = (timeend - timestart);
-		qDebug() << "Build nav mesh step5: " << timedelta << "ms";
-		//
-		// Step 6. Build polygons mesh from contours.
-		//
-
-		// Build polygon navmesh from the contours.
-		m_pmesh = rcAllocPolyMesh();
-		if (!m_pmesh)
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'pmesh'.");
-			return false;
-		}
-		if (!rcBuildPolyMesh(m_ctx, *m_cset, m_cfg.maxVertsPerPoly, *m_pmesh))
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not triangulate contours.");
-			return false;
-		}
-
-		GLOBAL_MAINWINDOW->progressTick();
-		timeend = clock();
-		timedelta = (timeend - timestart);
-		qDebug() << "Build nav mesh step6: " << timedelta << "ms";
-		//
-		// Step 7. Create detail mesh which allows to access approximate height on each polygon.
-		//
+		m_pathHierarchy->build(*m_navGraph, &m_defaultFilter, HIERARCHY_CLUSTER_SIZE);
+		timedelta = (clock() - timestart);
+		qDebug() << "Build path hierarchy: " << timedelta << "ms, " << m_pathHierarchy->getClusterCount() << "clusters, " << m_pathHierarchy->getPortalCount() << "portals";
+
+		// crowd cost filter
+		m_crowdCostFilter = RCCrowdCostFilter(m_defaultFilter);
+		m_crowdCostFilter.areaCost[SAMPLE_POLYAREA_WATER] = 10.0f;
+		m_crowdCostFilter.graph = m_navGraph;
+		// the crowd tick rewrites m_polyDensity, searches point density at a copy
+		m_polyDensity.assign(m_navGraph->getPolyCount(), 0.0f);
+		m_crowdCostFilter.density = nullptr;
+
+		// random point sampler
+		if (m_navSampler == nullptr) m_navSampler = new RCNavSampler();
+		m_navSampler->build(*m_navGraph, m_navQuery, m_crowd->getFilter(0));
+
+		// nearest poly grid
+		if (m_snapGrid == nullptr) m_snapGrid = new RCNavSnapGrid();
 		timestart = clock();
-		m_dmesh = rcAllocPolyMeshDetail();
-		if (!m_dmesh)
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'pmdtl'.");
-			return false;
-		}
-
-		if (!rcBuildPolyMeshDetail(m_ctx, *m_pmesh, *m_chf, m_cfg.detailSampleDist, m_cfg.detailSampleMaxError, *m_dmesh))
-		{
-			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build detail mesh.");
-			return false;
-		}
-		m_polymesh = new RCMesh(*m_dmesh);
-		m_polyContourMesh = new RCContour(*m_dmesh);
-
-		if (!rcparams.m_keepInterResults)
-		{
-			rcFreeCompactHeightfield(m_chf);
-			m_chf = 0;
-			rcFreeContourSet(m_cset);
-			m_cset = 0;
-		}
-		timeend = clock();
-		timedelta = (timeend - timestart);
-		qDebug() << "Build nav mesh step7: " << timedelta << "ms";
-		// At this point the navigation mesh data is ready, you can access it from m_pmesh.
-		// See duDebugDrawPolyMesh or dtCreateNavMeshData as examples how to access the data.
-
-		//
-		// (Optional) Step 8. Create Detour data from Recast poly mesh.
-		//
-
-		// The GUI may allow more max points per polygon than Detour can handle.
-		// Only build the detour navmesh if we do not exceed the limit.
-		if (m_cfg.maxVertsPerPoly <= DT_VERTS_PER_POLYGON)
-		{
-			unsigned char* navData = 0;
-			int navDataSize = 0;
-
-			// Update poly flags from areas.
-			for (int i = 0; i < m_pmesh->npolys; ++i)
-			{
-				if (m_pmesh->areas[i] == RC_WALKABLE_AREA)
-					m_pmesh->areas[i] = SAMPLE_POLYAREA_GROUND;
-
-				if (m_pmesh->areas[i] == SAMPLE_POLYAREA_GROUND ||
-					m_pmesh->areas[i] == SAMPLE_POLYAREA_GRASS ||
-					m_pmesh->areas[i] == SAMPLE_POLYAREA_ROAD)
-				{
-					m_pmesh->flags[i] = SAMPLE_POLYFLAGS_WALK;
-				}
-				else if (m_pmesh->areas[i] == SAMPLE_POLYAREA_WATER)
-				{
-					m_pmesh->flags[i] = SAMPLE_POLYFLAGS_SWIM;
-				}
-				else if (m_pmesh->areas[i] == SAMPLE_POLYAREA_DOOR)
-				{
-					m_pmesh->flags[i] = SAMPLE_POLYFLAGS_WALK | SAMPLE_POLYFLAGS_DOOR;
-				}
-			}
+		m_snapGrid->build(*m_navGraph, m_navQuery);
+		timedelta = (clock() - timestart);
+		qDebug() << "Build snap grid: " << timedelta << "ms, " << m_snapGrid->getCellCount() << "cells";
 
+		// simulation lod, levels refer to the new crowd
+		if (m_simLod == nullptr) m_simLod = new RCSimLod();
+		m_simLod->init(getMaxAgents());
 
-			dtNavMeshCreateParams params;
-			memset(&params, 0, sizeof(params));
-			params.verts = m_pmesh->verts;
-			params.vertCount = m_pmesh->nverts;
-			params.polys = m_pmesh->polys;
-			params.polyAreas = m_pmesh->areas;
-			params.polyFlags = m_pmesh->flags;
-			params.polyCount = m_pmesh->npolys;
-			params.nvp = m_pmesh->nvp;
-			params.detailMeshes = m_dmesh->meshes;
-			params.detailVerts = m_dmesh->verts;
-			params.detailVertsCount = m_dmesh->nverts;
-			params.detailTris = m_dmesh->tris;
-			params.detailTriCount = m_dmesh->ntris;
-#if 0
-			params.offMeshConVerts = m_geom->getOffMeshConnectionVerts();
-			params.offMeshConRad = m_geom->getOffMeshConnectionRads();
-			params.offMeshConDir = m_geom->getOffMeshConnectionDirs();
-			params.offMeshConAreas = m_geom->getOffMeshConnectionAreas();
-			params.offMeshConFlags = m_geom->getOffMeshConnectionFlags();
-			params.offMeshConUserID = m_geom->getOffMeshConnectionId();
-			params.offMeshConCount = m_geom->getOffMeshConnectionCount();
-#endif
-			params.walkableHeight = rcparams.m_agentHeight;
-			params.walkableRadius = rcparams.m_agentRadius;
-			params.walkableClimb = rcparams.m_agentMaxClimb;
-			rcVcopy(params.bmin, m_pmesh->bmin);
-			rcVcopy(params.bmax, m_pmesh->bmax);
-			params.cs = m_cfg.cs;
-			params.ch = m_cfg.ch;
-			params.buildBvTree = true;
-
-			if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
-			{
-				m_ctx->log(RC_LOG_ERROR, "Could not build Detour navmesh.");
-				return false;
-			}
+		// agent events, pending ones refer to the old crowd
+		if (m_agentEvents == nullptr) m_agentEvents = new RCAgentEvents();
+		m_agentEvents->init(getMaxAgents());
 
-			m_navMesh = dtAllocNavMesh();
-			if (!m_navMesh)
-			{
-				dtFree(navData);
-				m_ctx->log(RC_LOG_ERROR, "Could not create Detour navmesh");
-				return false;
-			}
+		// density grid
+		if (m_densityGrid == nullptr) m_densityGrid = new RCDensityGrid();
+		m_densityGrid->init(m_cfg.bmin, m_cfg.bmax, DENSITY_CELL_SIZE, getMaxAgents());
+		m_densityGrid->setPeakDensity(DENSITY_PEAK);
+		qDebug() << "Density grid: " << m_densityGrid->getWidth() << "x" << m_densityGrid->getHeight() << "cells";
 
-			dtStatus status;
-
-			status = m_navMesh->init(navData, navDataSize, DT_TILE_FREE_DATA);
-			if (dtStatusFailed(status))
-			{
-				dtFree(navData);
-				m_ctx->log(RC_LOG_ERROR, "Could not init Detour navmesh");
-				return false;
-			}
-
-			status = m_navQuery->init(m_navMesh, 2048);
-			if (dtStatusFailed(status))
-			{
-				m_ctx->log(RC_LOG_ERROR, "Could not init Detour navmesh query");
-				return false;
-			}
-		}
-		GLOBAL_MAINWINDOW->progressTick();
-		GLOBAL_MAINWINDOW->progressEnd();
-		m_ctx->stopTimer(RC_TIMER_TOTAL);
-
-
-
-		// init crowd
-		m_crowd->init(MAX_AGENTS, rcparams.m_agentRadius, m_navMesh);
-		m_crowd->getEditableFilter(0)->setExcludeFlags(SAMPLE_POLYFLAGS_DISABLED);
-		// Setup local avoidance params to different qualities.
-		dtObstacleAvoidanceParams params;
-		// Use mostly default settings, copy from dtCrowd.
-		memcpy(&params, m_crowd->getObstacleAvoidanceParams(0), sizeof(dtObstacleAvoidanceParams));
-
-		// Low (11)
-		params.velBias = 0.5f;
-		params.adaptiveDivs = 5;
-		params.adaptiveRings = 2;
-		params.adaptiveDepth = 1;
-		m_crowd->setObstacleAvoidanceParams(0, &params);
-
-		// Medium (22)
-		params.velBias = 0.5f;
-		params.adaptiveDivs = 5;
-		params.adaptiveRings = 2;
-		params.adaptiveDepth = 2;
-		m_crowd->setObstacleAvoidanceParams(1, &params);
-
-		// Good (45)
-		params.velBias = 0.5f;
-		params.adaptiveDivs = 7;
-		params.adaptiveRings = 2;
-		params.adaptiveDepth = 3;
-		m_crowd->setObstacleAvoidanceParams(2, &params);
-
-		// High (66)
-		params.velBias = 0.5f;
-		params.adaptiveDivs = 7;
-		params.adaptiveRings = 3;
-		params.adaptiveDepth = 3;
-
-		m_crowd->setObstacleAvoidanceParams(3, &params);
+		// path smoother
+		if (m_pathSmoother == nullptr) m_pathSmoother = new RCPathSmoother();
+		m_pathSmoother->init(m_navMesh, 2048);
+		clearAgentSmoothPaths();
 
 
 		auto entity = GLOBAL_SCENE->createEntity("AgentTarget");
@@ -822,7 +334,21 @@ namespace GU
 			vkCmdDraw(cmdBuf, static_cast<uint32_t>(rcStraightPath[i]->m_verts.size()), 1, 0, 0);
 		}
 
-		for (size_t i = 0; i < rcAgentSamplePath.size(); i++)
+		if (isRenderAgentPath)
+		{
+			std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+			const int npaths = agentPathOffsets.empty() ? 0 : (int)agentPathOffsets.size() - 1;
+			if (isAgentPathCleared) rcAgentSamplePath.clear();
+			isAgentPathCleared = false;
+			for (int i = (int)rcAgentSamplePath.size(); i < npaths; i++)
+			{
+				std::vector<glm::vec3> points;
+				for (int j = agentPathOffsets[i]; j < agentPathOffsets[i + 1]; j++)
+					points.push_back(glm::make_vec3(&agentPaths[j * 3]));
+				rcAgentSamplePath.push_back(std::make_shared<RCAgentSamplePath>(points));
+			}
+		}
+		for (size_t i = 0; isRenderAgentPath && i < rcAgentSamplePath.size(); i++)
 		{
 			// draw contour
 			vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, GLOBAL_VULKAN_CONTEXT->rcContourPipeline);
@@ -836,52 +362,19 @@ namespace GU
 
 	bool RCScheduler::raycastMesh(float* src, float* dst, float& tmin)
 	{
-		// Prune hit ray.
-		float btmin, btmax;
-		if (!isectSegAABB(src, dst, m_meshBMin, m_meshBMax, btmin, btmax))
-			return false;
-		float p[2], q[2];
-		p[0] = src[0] + (dst[0] - src[0]) * btmin;
-		p[1] = src[2] + (dst[2] - src[2]) * btmin;
-		q[0] = src[0] + (dst[0] - src[0]) * btmax;
-		q[1] = src[2] + (dst[2] - src[2]) * btmax;
-
-		int cid[512];
-		const int ncid = rcGetChunksOverlappingSegment(m_chunkyMesh, p, q, cid, 512);
-		if (!ncid)
-			return false;
-
-		tmin = 1.0f;
-		bool hit = false;
-		const float* verts = m_mesh.getVerts();
-
-		for (int i = 0; i < ncid; ++i)
-		{
-			const rcChunkyTriMeshNode& node = m_chunkyMesh->nodes[cid[i]];
-			const int* tris = &m_chunkyMesh->tris[node.i * 3];
-			const int ntris = node.n;
-
-			for (int j = 0; j < ntris * 3; j += 3)
-			{
-				float t = 1;
-				if (intersectSegmentTriangle(src, dst,
-					&verts[tris[j] * 3],
-					&verts[tris[j + 1] * 3],
-					&verts[tris[j + 2] * 3], t))
-				{
-					if (t < tmin)
-						tmin = t;
-					hit = true;
-				}
-			}
-		}
+		if (m_chunkyMesh == nullptr) return false;
+		return raycastTriMesh(m_chunkyMesh, m_mesh.getVerts(), m_meshBMin, m_meshBMax, src, dst, tmin);
+	}
 
-		return hit;
+	int RCScheduler::raycastMeshBatch(const float* src, const float* dst, int nrays, float* outT, int* outTri)
+	{
+		return raycastTriMeshBatch(m_chunkyMesh, m_mesh.getVerts(), m_meshBMin, m_meshBMax,
+			src, dst, nrays, outT, outTri, GLOBAL_THREAD_POOL.get());
 	}
 
 	glm::vec3 RCScheduler::getAgentPosWithId(int idx)
 	{
-		auto agent = m_crowd->getAgent(idx);
+		auto agent = getCrowdAgent(idx);
 		float x = agent->npos[0];
 		float y = agent->npos[1];
 		float z = agent->npos[2];
@@ -890,9 +383,11 @@ namespace GU
 
 	void RCScheduler::getAgentRotationWithId(int idx, glm::vec3& rotation)
 	{
-		auto agent = m_crowd->getAgent(idx);
+		getRotationFromVelocity(getCrowdAgent(idx)->vel, rotation);
+	}
 
-		auto vel = agent->vel;
+	void RCScheduler::getRotationFromVelocity(const float* vel, glm::vec3& rotation)
+	{
 		auto glmvel = glm::vec3(vel[0], vel[1], vel[2]);
 		
 		if (glm::length(glmvel) == 0)
@@ -909,18 +404,43 @@ namespace GU
 
 	int RCScheduler::addAgent(const glm::vec3& pos, const dtCrowdAgentParams& ap)
 	{
-		int idx = m_crowd->addAgent(glm::value_ptr(pos), &ap);
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		int idx = m_shardedCrowd ? m_shardedCrowd->addAgent(glm::value_ptr(pos), &ap) : m_crowd->addAgent(glm::value_ptr(pos), &ap);
 		if (idx != -1)
 		{
+			isAgentStateDirty = true;
+			if (m_agentEvents) m_agentEvents->reset(idx);
 			if (m_targetRef)
-				m_crowd->requestMoveTarget(idx, m_targetRef, m_targetPos);
+			{
+				dtPolyRef targetRef = m_targetRef;
+				float targetPos[3];
+				dtVcopy(targetPos, m_targetPos);
+				if (resolveReachableTarget(getCrowdAgent(idx)->corridor.getFirstPoly(), ISLAND_FILTER_CROWD, m_crowd->getQueryExtents(), targetRef, targetPos))
+					requestCrowdMoveTarget(idx, targetRef, targetPos);
+			}
 		}
 		return idx;
 	}
 
+	int RCScheduler::addAgents(const float* starts, const float* targets, int n, int* outIdx)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		int nadded = 0;
+		for (int i = 0; i < n; i++)
+		{
+			outIdx[i] = m_shardedCrowd ? m_shardedCrowd->addAgent(&starts[i * 3], &agentParams) : m_crowd->addAgent(&starts[i * 3], &agentParams);
+			if (outIdx[i] == -1) continue;
+			if (m_agentEvents) m_agentEvents->reset(outIdx[i]);
+			nadded++;
+		}
+		if (nadded > 0) isAgentStateDirty = true;
+		setMoveTargets(outIdx, targets, n);
+		return nadded;
+	}
+
 	float RCScheduler::getVelLength(int idx)
 	{
-		auto agent = m_crowd->getAgent(idx);
+		auto agent = getCrowdAgent(idx);
 		auto vel = agent->vel;
 		glm::vec3 glmvel = { vel[0], vel[1] , vel[2] };
 		
@@ -962,7 +482,10 @@ namespace GU
 
 		GLOBAL_RCSCHEDULER->agentParams = agentParams;
 
+		// the entity must exist before the next event drain can see the slot
+		std::lock_guard<std::recursive_mutex> lock(GLOBAL_RCSCHEDULER->m_crowdMutex);
 		int idx = GLOBAL_RCSCHEDULER->addAgent(GLOBAL_RCSCHEDULER->hitPos, agentParams);
+		if (idx == -1) return;
 		GLOBAL_RCSCHEDULER->setMoveTarget(idx, agentTargetPos);
 		//GLOBAL_RCSCHEDULER->calAgentPath(GLOBAL_RCSCHEDULER->hitPos, agentTargetPos);
 
@@ -981,7 +504,9 @@ namespace GU
 
 		GLOBAL_RCSCHEDULER->agentParams = agentParams;
 
+		std::lock_guard<std::recursive_mutex> lock(GLOBAL_RCSCHEDULER->m_crowdMutex);
 		int idx = GLOBAL_RCSCHEDULER->addAgent(startpos, agentParams);
+		if (idx == -1) return;
 		GLOBAL_RCSCHEDULER->setMoveTarget(idx, endpos);
 		//GLOBAL_RCSCHEDULER->calAgentPath(GLOBAL_RCSCHEDULER->hitPos, agentTargetPos);
 
@@ -994,31 +519,480 @@ namespace GU
 		agentcomponent.startPos = startpos;
 		agentcomponent.targetPos = endpos;
 	}
+	int RCScheduler::spawnRandomAgents(int count, uint64_t seed, const RCNavSampleQuery& query)
+	{
+		if (m_navSampler == nullptr) return 0;
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		count = std::min(count, getMaxAgents() - getActiveAgentCount());
+		if (count <= 0) return 0;
+
+		std::vector<float> starts(count * 3);
+		std::vector<dtPolyRef> startRefs(count);
+		const int nstarts = m_navSampler->sample(query, count, seed, starts.data(), startRefs.data(), GLOBAL_THREAD_POOL.get());
+
+		const bool hasTarget = agentTargetPos != glm::vec3{ -9999.0, -9999.0, -9999.0 };
+		std::vector<float> targets;
+		std::vector<dtPolyRef> targetRefs;
+		int ntargets = 0;
+		if (!hasTarget)
+		{
+			targets.resize(nstarts * 3);
+			targetRefs.resize(nstarts);
+			ntargets = m_navSampler->sample(RCNavSampleQuery(), nstarts, seed ^ 0x5bd1e995u, targets.data(), targetRefs.data(), GLOBAL_THREAD_POOL.get());
+		}
+
+		std::vector<float> ends(nstarts * 3);
+		for (int i = 0; i < nstarts; i++)
+		{
+			glm::vec3 startPos = glm::make_vec3(&starts[i * 3]);
+			glm::vec3 endPos = hasTarget ? agentTargetPos : (ntargets ? glm::make_vec3(&targets[(i % ntargets) * 3]) : startPos);
+			memcpy(&ends[i * 3], glm::value_ptr(endPos), 3 * sizeof(float));
+		}
+		return GLOBAL_SCENE->spawnAgents(starts.data(), ends.data(), nstarts);
+	}
+
 	void RCScheduler::setMoveTarget(int idx, const glm::vec3& pos)
 	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
 		const dtQueryFilter* filter = m_crowd->getFilter(0);
 		const float* halfExtents = m_crowd->getQueryExtents();
-		m_navQuery->findNearestPoly(glm::value_ptr(pos), halfExtents, filter, &m_targetRef, m_targetPos);
+		if (m_queryRecorder) m_queryRecorder->recordNearestPoly(glm::value_ptr(pos), halfExtents, filter);
+		if (m_snapGrid)
+			m_snapGrid->findNearestPoly(glm::value_ptr(pos), halfExtents, filter, &m_targetRef, m_targetPos);
+		else
+			m_navQuery->findNearestPoly(glm::value_ptr(pos), halfExtents, filter, &m_targetRef, m_targetPos);
 		if (idx != -1)
 		{
-			dtCrowdAgent const * ag = m_crowd->getAgent(idx);
+			dtCrowdAgent const * ag = getCrowdAgent(idx);
 			if (ag && ag->active)
 			{
-				m_crowd->requestMoveTarget(idx, m_targetRef, m_targetPos);
+				dtPolyRef targetRef = m_targetRef;
+				float targetPos[3];
+				dtVcopy(targetPos, m_targetPos);
+				if (resolveReachableTarget(ag->corridor.getFirstPoly(), ISLAND_FILTER_CROWD, halfExtents, targetRef, targetPos))
+					requestCrowdMoveTarget(idx, targetRef, targetPos);
 			}
 		}
 	}
 
+	void RCScheduler::setMoveTargets(const int* idx, const glm::vec3* pos, int n)
+	{
+		if (n <= 0) return;
+		setMoveTargets(idx, glm::value_ptr(pos[0]), n);
+	}
+
+	void RCScheduler::setMoveTargets(const int* idx, const float* pos, int n)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (n <= 0) return;
+		std::vector<dtPolyRef> refs(n);
+		std::vector<float> pts(n * 3);
+		snapToNavMesh(pos, n, refs.data(), pts.data());
+		const float* halfExtents = m_crowd->getQueryExtents();
+		for (int i = 0; i < n; i++)
+		{
+			const dtCrowdAgent* ag = idx[i] != -1 ? getCrowdAgent(idx[i]) : nullptr;
+			if (!refs[i] || !ag || !ag->active) continue;
+			if (resolveReachableTarget(ag->corridor.getFirstPoly(), ISLAND_FILTER_CROWD, halfExtents, refs[i], &pts[i * 3]))
+				requestCrowdMoveTarget(idx[i], refs[i], &pts[i * 3]);
+		}
+	}
+
+	int RCScheduler::snapToNavMesh(const float* pos, int n, dtPolyRef* refs, float* pts)
+	{
+		const dtQueryFilter* filter = m_crowd->getFilter(0);
+		const float* halfExtents = m_crowd->getQueryExtents();
+		if (m_snapGrid)
+			return m_snapGrid->findNearestPolyBatch(pos, n, halfExtents, filter, refs, pts, GLOBAL_THREAD_POOL.get());
+		int hits = 0;
+		for (int i = 0; i < n; i++)
+		{
+			refs[i] = 0;
+			m_navQuery->findNearestPoly(&pos[i * 3], halfExtents, filter, &refs[i], pts ? &pts[i * 3] : 0);
+			if (refs[i]) hits++;
+		}
+		return hits;
+	}
+
+	bool RCScheduler::resolveReachableTarget(dtPolyRef startRef, int filterIdx, const float* halfExtents, dtPolyRef& targetRef, float* targetPos)
+	{
+		if (m_navIslands == nullptr || m_navIslands->isReachable(startRef, targetRef, filterIdx)) return true;
+		if (!isRedirectUnreachable) return false;
+
+		const int island = m_navIslands->getIsland(startRef, filterIdx);
+		float pos[3];
+		dtVcopy(pos, targetPos);
+		return m_navIslands->findNearestOnIsland(m_navQuery, pos, halfExtents, island, filterIdx, &targetRef, targetPos);
+	}
+
 	void RCScheduler::crowUpdatTick(float delatTime)
 	{	
 		if (m_crowd == nullptr) return;
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (isDeterministic) delatTime = m_lockstepDt;
+
+		if (m_shardedCrowd)
+		{
+			if (m_shardedCrowd->getActiveAgentCount() == 0) return;
+			for (int i = 0; i < m_shardedCrowd->getShardCount(); i++)
+			{
+				setCrowdSearch(m_shardedCrowd->getShard(i));
+				m_shardedCrowd->getShard(i)->cellGrid = m_densityGrid;
+			}
+			m_shardedCrowd->update(delatTime, GLOBAL_THREAD_POOL.get());
+			if (m_shardedCrowd->getDroppedProxyCount() > 0)
+				qDebug() << "Sharded crowd: " << m_shardedCrowd->getDroppedProxyCount() << "neighbour proxies dropped, shards grown";
+			m_crowdTick++;
+			m_crowdTime += delatTime;
+			if (isDeterministic) lockstepTick();
+			if (m_agentEvents) m_agentEvents->detect(this, m_crowdTick, delatTime);
+			if (isUseCrowdCost) updatePolyDensity();
+			if (m_densityGrid) updateDensityGrid();
+			if (isUseSimLod && !isDeterministic) m_simLod->update(this, m_crowdTick);
+			if (m_trajectoryRecorder) recordTrajectory(delatTime);
+			return;
+		}
 
 		int numActiveAgents = 0;
 		numActiveAgents = m_crowd->getActiveAgents(agents, MAX_AGENTS);
 		if (numActiveAgents == 0) return;
 
-		m_crowd->update(delatTime, &m_agentDebug);
+		setCrowdSearch(m_crowd);
+		m_crowd->cellGrid = m_densityGrid;
+		m_crowd->update(delatTime, &m_agentDebug, isUseParallelCrowd ? GLOBAL_THREAD_POOL.get() : nullptr);
+		m_crowdTick++;
+		m_crowdTime += delatTime;
+		if (isDeterministic) lockstepTick();
+		if (m_agentEvents) m_agentEvents->detect(this, m_crowdTick, delatTime);
+		if (isUseCrowdCost) updatePolyDensity();
+		if (m_densityGrid) updateDensityGrid();
+		if (isUseSimLod && !isDeterministic) m_simLod->update(this, m_crowdTick);
+		if (m_trajectoryRecorder) recordTrajectory(delatTime);
+	}
+
+	void RCScheduler::setCrowdSearch(RCCrowd* crowd)
+	{
+		// handelBuild rebuilds the tables together with the crowd
+		crowd->landmarks = isUseLandmarks ? m_landmarks : nullptr;
+		crowd->hierarchy = isUseHierarchy ? m_pathHierarchy : nullptr;
+		// the density of the last tick, updatePolyDensity rewrites it after the update
+		const bool crowdCost = isUseCrowdCost && !m_polyDensity.empty();
+		crowd->densityGraph = crowdCost ? m_navGraph : nullptr;
+		crowd->polyDensity = crowdCost ? m_polyDensity.data() : nullptr;
+		crowd->densityWeight = m_crowdCostFilter.densityWeight;
+		crowd->queryRecorder = m_queryRecorder;
+	}
+
+	void RCScheduler::setUseSimLod(bool enable)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_simLod == nullptr) m_simLod = new RCSimLod();
+		if (!enable && isUseSimLod) m_simLod->restore(this);
+		isUseSimLod = enable;
+	}
+
+	void RCScheduler::setLodCamera(const glm::vec3& pos, const glm::mat4& viewProj)
+	{
+		// the camera is only read by the lod update, no copy under its lock when it is off
+		if (isUseSimLod && m_simLod) m_simLod->setCamera(glm::value_ptr(pos), glm::value_ptr(viewProj));
+	}
+
+	void RCScheduler::setDeterministic(bool enable, uint64_t seed, float lockstepDt)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		isDeterministic = enable;
+		m_lockstepSeed = seed;
+		m_lockstepDt = lockstepDt;
+		// an opted-in replanning time budget depends on the machine
+		m_crowd->replanBudgetMs = enable ? 0.0f : REPLAN_BUDGET_MS;
+		for (int i = 0; m_shardedCrowd && i < m_shardedCrowd->getShardCount(); i++)
+			m_shardedCrowd->getShard(i)->replanBudgetMs = m_crowd->replanBudgetMs;
+		m_tickChecksums.clear();
+		UUID::setSeed(enable ? seed : 0);
+	}
+
+	void RCScheduler::lockstepTick()
+	{
+		// the checksum covers the state before arrivals leave
+		m_tickChecksums.push_back(computeCrowdChecksum());
+	}
+
+	uint64_t RCScheduler::computeCrowdChecksum()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		uint64_t hash = CROWD_CHECKSUM_SEED;
+		for (int i = 0; i < getMaxAgents(); i++)
+			hash = hashCrowdAgent(hash, i, getCrowdAgent(i));
+		return hash;
+	}
+
+	bool RCScheduler::saveChecksums(const std::filesystem::path& filepath)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		std::ofstream fout(filepath);
+		if (!fout.is_open()) return false;
+		for (size_t i = 0; i < m_tickChecksums.size(); i++)
+			fout << i + 1 << " " << std::hex << m_tickChecksums[i] << std::dec << "\n";
+		return fout.good();
+	}
+
+	bool RCScheduler::saveCheckpoint(RCCrowdCheckpoint& checkpoint)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_shardedCrowd)
+		{
+			qDebug() << "checkpoints need the single crowd";
+			return false;
+		}
+		// lod params are not saved, agents step down again after the next evaluations
+		if (isUseSimLod && m_simLod) m_simLod->restore(this);
+		checkpoint.clear();
+		checkpoint.tick = m_crowdTick;
+		checkpoint.time = m_crowdTime;
+		m_crowd->saveState(checkpoint.crowd);
+		if (GLOBAL_SCENE) GLOBAL_SCENE->saveAgentEntities(checkpoint.entities);
+		return true;
+	}
+
+	bool RCScheduler::restoreCheckpoint(const RCCrowdCheckpoint& checkpoint)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_shardedCrowd)
+		{
+			qDebug() << "checkpoints need the single crowd";
+			return false;
+		}
+		if (!m_crowd->loadState(checkpoint.crowd.data(), checkpoint.crowd.size()))
+		{
+			qDebug() << "checkpoint does not match the crowd";
+			return false;
+		}
+		m_crowdTick = checkpoint.tick;
+		m_crowdTime = checkpoint.time;
+		isAgentStateDirty = true;
+		// events of the replaced crowd, restore runs on the thread that drains them
+		if (m_agentEvents) m_agentEvents->clear();
+		if (m_tickChecksums.size() > checkpoint.tick) m_tickChecksums.resize(checkpoint.tick);
+		if (m_simLod) m_simLod->init(getMaxAgents());
+		if (m_densityGrid)
+		{
+			// the restored crowd lists every agent again on its next update
+			m_densityGrid->clear();
+			for (int i = 0; i < getMaxAgents(); i++)
+			{
+				const dtCrowdAgent* ag = getCrowdAgent(i);
+				if (ag->active) m_densityGrid->updateAgent(i, ag->npos);
+			}
+		}
+		if (GLOBAL_SCENE) GLOBAL_SCENE->restoreAgentEntities(checkpoint.entities);
+		return true;
+	}
+
+	const dtCrowdAgent* RCScheduler::getCrowdAgent(int idx)
+	{
+		return m_shardedCrowd ? m_shardedCrowd->getAgent(idx) : m_crowd->getAgent(idx);
+	}
+
+	bool RCScheduler::requestCrowdMoveTarget(int idx, dtPolyRef ref, const float* pos)
+	{
+		return m_shardedCrowd ? m_shardedCrowd->requestMoveTarget(idx, ref, pos) : m_crowd->requestMoveTarget(idx, ref, pos);
+	}
+
+	void RCScheduler::updateCrowdAgentParameters(int idx, const dtCrowdAgentParams* params)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_shardedCrowd) m_shardedCrowd->updateAgentParameters(idx, params);
+		else m_crowd->updateAgentParameters(idx, params);
+	}
+
+	void RCScheduler::removeCrowdAgent(int idx)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_shardedCrowd) m_shardedCrowd->removeAgent(idx);
+		else m_crowd->removeAgent(idx);
+		if (m_densityGrid) m_densityGrid->removeAgent(idx);
+		isAgentStateDirty = true;
+	}
+
+	void RCScheduler::startSimLoop(float tickRate, int maxCatchUpSteps)
+	{
+		if (m_simLoop == nullptr) m_simLoop = new RCSimLoop();
+		m_simLoop->setTickRate(tickRate);
+		m_simLoop->setMaxCatchUpSteps(maxCatchUpSteps);
+		m_simLoop->setTimeScale(m_timeScale);
+		m_simLoop->setCpuBudget(m_simCpuBudget);
+		m_simLoop->setPaused(!GLOBAL_PLAY);
+		m_simLoop->start(this);
+	}
+
+	void RCScheduler::stopSimLoop()
+	{
+		if (m_simLoop) m_simLoop->stop();
+		// the loop ticked without capturing m_agentState
+		isAgentStateDirty = true;
+	}
+
+	bool RCScheduler::isSimLoopRunning() const
+	{
+		return m_simLoop && m_simLoop->isRunning();
+	}
+
+	void RCScheduler::applySimLoopSettings()
+	{
+		if (!isSimLoopRunning()) return;
+		if (!isUseSimLoop)
+		{
+			stopSimLoop();
+			return;
+		}
+		m_simLoop->setTickRate(m_simTickRate);
+		m_simLoop->setMaxCatchUpSteps(m_simMaxCatchUpSteps);
+	}
+
+	void RCScheduler::advanceFrame(float frameTime)
+	{
+		if (m_frameClock == nullptr) m_frameClock = new RCSimClock();
+		m_frameClock->setTimeScale(m_timeScale);
+		m_frameClock->setCpuBudget(m_simCpuBudget);
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_timeScale == 1.0f)
+		{
+			crowUpdatTick(frameTime);
+			m_frameClock->addSample(frameTime, isDeterministic ? m_lockstepDt : frameTime);
+		}
+		else
+		{
+			const double step = isDeterministic ? m_lockstepDt : 1.0 / SIM_TICK_RATE;
+			m_frameClock->advance(frameTime, step, SIM_MAX_CATCHUP_STEPS, [this](double dt)
+			{
+				crowUpdatTick((float)dt);
+			});
+		}
+		// right after the ticks, so the renderer only reads the captured state
+		updateAgentState();
+	}
+
+	void RCScheduler::setTimeScale(float scale)
+	{
+		m_timeScale = std::min(std::max(scale, 0.0f), SIM_MAX_TIME_SCALE);
+		if (m_simLoop) m_simLoop->setTimeScale(m_timeScale);
+	}
+
+	void RCScheduler::setSimCpuBudget(float ms)
+	{
+		m_simCpuBudget = ms;
+		if (m_simLoop) m_simLoop->setCpuBudget(ms);
+	}
+
+	float RCScheduler::getSimSpeed() const
+	{
+		if (isSimLoopRunning()) return m_simLoop->getSimSpeed();
+		return m_frameClock ? m_frameClock->getSimSpeed() : 0.0f;
+	}
+
+	const RCCrowdSnapshot* RCScheduler::acquireAgentState(float& alpha)
+	{
+		alpha = 1.0f;
+		if (isSimLoopRunning()) return m_simLoop->acquireSnapshot(alpha);
+		// captured after the ticks, again here only for edits since then
+		updateAgentState();
+		return m_agentState;
+	}
+
+	void RCScheduler::updateAgentState()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_agentState == nullptr) m_agentState = new RCCrowdSnapshot();
+		else if (!isAgentStateDirty && m_agentState->tick == m_crowdTick) return;
+		m_agentState->capture(this, nullptr);
+		m_agentState->tick = m_crowdTick;
+		isAgentStateDirty = false;
+	}
+
+	int RCScheduler::setAgentGroup(int leader, const int* followers, int n)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_shardedCrowd) return 0;
+		int joined = 0;
+		for (int i = 0; i < n; i++)
+		{
+			// followers added later take the next free places of the wedge
+			float offset[3];
+			getGroupFormationOffset(m_crowd->getFollowerCount(leader), GROUP_SPACING, offset);
+			if (m_crowd->setAgentGroup(followers[i], leader, offset)) joined++;
+		}
+		return joined;
+	}
+
+	int RCScheduler::getAgentLeader(int idx)
+	{
+		return m_shardedCrowd ? -1 : m_crowd->getAgentLeader(idx);
+	}
+
+	int RCScheduler::getAgentFollowerCount(int idx)
+	{
+		return m_shardedCrowd ? 0 : m_crowd->getFollowerCount(idx);
+	}
+
+	int RCScheduler::getMaxAgents() const
+	{
+		return m_shardedCrowd ? m_shardedCrowd->getAgentCount() : m_crowd->getAgentCount();
 	}
+
+	int RCScheduler::getActiveAgentCount()
+	{
+		return m_shardedCrowd ? m_shardedCrowd->getActiveAgentCount() : m_crowd->getActiveAgents(agents, MAX_AGENTS);
+	}
+
+	void RCScheduler::updatePolyDensity()
+	{
+		if (m_navGraph == nullptr || m_polyDensity.empty()) return;
+		std::fill(m_polyDensity.begin(), m_polyDensity.end(), 0.0f);
+		for (int i = 0; i < getMaxAgents(); i++)
+		{
+			const dtCrowdAgent* ag = getCrowdAgent(i);
+			if (!ag->active) continue;
+			const int idx = m_navGraph->indexOf(ag->corridor.getFirstPoly());
+			if (idx >= 0) m_polyDensity[idx] += 1.0f;
+		}
+	}
+	void RCScheduler::updateDensityGrid()
+	{
+		m_densityGrid->setTime(m_crowdTime);
+		// removeCrowdAgent drops the removed agents itself
+		const std::vector<int>& moved = m_shardedCrowd ? m_shardedCrowd->getCellChanges() : m_crowd->getCellChanges();
+		for (int idx : moved)
+			m_densityGrid->updateAgent(idx, getCrowdAgent(idx)->npos);
+
+		std::vector<RCDensityAlert> alerts;
+		if (m_densityGrid->popAlerts(alerts) == 0 || m_agentEvents == nullptr) return;
+		for (const RCDensityAlert& alert : alerts)
+			m_agentEvents->post(m_crowdTick, alert.cell, RC_AGENT_EVENT_DENSITY_PEAK, alert.pos);
+	}
+
+	void RCScheduler::setGatePoint(const glm::vec3& pos)
+	{
+		if (!isSetGate || m_densityGrid == nullptr) return;
+		if (!m_hasGateStart)
+		{
+			m_gateStart = pos;
+			m_hasGateStart = true;
+			return;
+		}
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		m_densityGrid->addGate(glm::value_ptr(m_gateStart), glm::value_ptr(pos));
+		m_hasGateStart = false;
+	}
+
+	void RCScheduler::getGateFlowRates(std::vector<float>& rates)
+	{
+		rates.clear();
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_densityGrid == nullptr) return;
+		for (int i = 0; i < m_densityGrid->getGateCount(); i++)
+			rates.push_back(m_densityGrid->getGateFlowRate(i));
+	}
+
 	void RCScheduler::setCurrentTarget(const glm::vec3& pos)
 	{
 		if (!GLOBAL_RCSCHEDULER->isSetTarget || GLOBAL_RCSCHEDULER->isSetAgent) return;
@@ -1055,23 +1029,65 @@ namespace GU
 		if (!m_navMesh)
 			return;
 
-		m_navQuery->findNearestPoly(m_spos, m_polyPickExt, &m_filter, &m_startRef, 0);
-
-		m_navQuery->findNearestPoly(m_epos, m_polyPickExt, &m_filter, &m_endRef, 0);
+		if (m_queryRecorder)
+		{
+			m_queryRecorder->recordNearestPoly(m_spos, m_polyPickExt, &m_filter);
+			m_queryRecorder->recordNearestPoly(m_epos, m_polyPickExt, &m_filter);
+		}
+		if (m_snapGrid)
+		{
+			m_snapGrid->findNearestPoly(m_spos, m_polyPickExt, &m_filter, &m_startRef, 0);
+			m_snapGrid->findNearestPoly(m_epos, m_polyPickExt, &m_filter, &m_endRef, 0);
+		}
+		else
+		{
+			m_navQuery->findNearestPoly(m_spos, m_polyPickExt, &m_filter, &m_startRef, 0);
+			m_navQuery->findNearestPoly(m_epos, m_polyPickExt, &m_filter, &m_endRef, 0);
+		}
 
 		int m_straightPathOptions = DT_STRAIGHTPATH_ALL_CROSSINGS;
 		float m_straightPath[MAX_POLYS * 3];
 		unsigned char m_straightPathFlags[MAX_POLYS];
 		dtPolyRef m_straightPathPolys[MAX_POLYS];
 		int m_nstraightPath;
+		// Start and end on different islands would exhaust the node pool, reject or redirect up front.
+		if (m_startRef && !resolveReachableTarget(m_startRef, ISLAND_FILTER_DEFAULT, m_polyPickExt, m_endRef, m_epos))
+			return;
 		if (m_startRef && m_endRef)
 		{
-#ifdef DUMP_REQS
-			printf("ps  %f %f %f  %f %f %f  0x%x 0x%x\n",
-				m_spos[0], m_spos[1], m_spos[2], m_epos[0], m_epos[1], m_epos[2],
-				m_filter.getIncludeFlags(), m_filter.getExcludeFlags());
-#endif
-			m_navQuery->findPath(m_startRef, m_endRef, m_spos, m_epos, &m_filter, m_polys, &m_npolys, MAX_POLYS);
+			if (m_queryRecorder) m_queryRecorder->recordFindPath(m_startRef, m_endRef, m_spos, m_epos, &m_filter);
+			RCAbstractPath abstractPath;
+			const bool isHierarchical = isUseHierarchy && m_pathHierarchy && m_pathSearch &&
+				m_pathHierarchy->getCluster(m_startRef) != m_pathHierarchy->getCluster(m_endRef) &&
+				m_pathHierarchy->findAbstractPath(m_startRef, m_endRef, abstractPath);
+			if (isHierarchical)
+			{
+				// the segments near the start, as a crowd request refines them
+				m_pathHierarchy->refinePath(*m_pathSearch, &m_filter, abstractPath, 0, HIERARCHY_REFINE_SEGMENTS,
+					m_spos, m_epos, m_polys, &m_npolys, MAX_POLYS);
+			}
+			else if (isUseCrowdCost && m_pathSearch && m_crowdCostFilter.graph)
+			{
+				std::vector<float> density;
+				{
+					std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+					density = m_polyDensity;
+				}
+				RCCrowdCostFilter crowdCostFilter = m_crowdCostFilter;
+				crowdCostFilter.density = density.data();
+				crowdCostFilter.includeFlags = m_filter.getIncludeFlags();
+				crowdCostFilter.excludeFlags = m_filter.getExcludeFlags();
+				m_pathSearch->findPath(m_startRef, m_endRef, m_spos, m_epos, &crowdCostFilter, m_polys, &m_npolys, MAX_POLYS);
+			}
+			else if (isUseLandmarks && m_landmarks && m_landmarks->getLandmarkCount() > 0)
+			{
+				RCLandmarkHeuristic heuristic{ m_landmarks, m_navGraph->indexOf(m_endRef), m_epos };
+				m_pathSearch->findPath(m_startRef, m_endRef, m_spos, m_epos, &m_filter, heuristic, m_polys, &m_npolys, MAX_POLYS);
+			}
+			else
+			{
+				m_navQuery->findPath(m_startRef, m_endRef, m_spos, m_epos, &m_filter, m_polys, &m_npolys, MAX_POLYS);
+			}
 			m_nstraightPath = 0;
 			if (m_npolys)
 			{
@@ -1081,6 +1097,7 @@ namespace GU
 				if (m_polys[m_npolys - 1] != m_endRef)
 					m_navQuery->closestPointOnPoly(m_polys[m_npolys - 1], m_epos, epos, 0);
 				if (epos[1] < -900 || epos[1] > 900) return;
+				if (m_queryRecorder) m_queryRecorder->recordStraightPath(m_spos, epos, m_polys, m_npolys, m_straightPathOptions);
 				m_navQuery->findStraightPath(m_spos, epos, m_polys, m_npolys,
 					m_straightPath, m_straightPathFlags,
 					m_straightPathPolys, &m_nstraightPath, MAX_POLYS, m_straightPathOptions);
@@ -1099,6 +1116,34 @@ namespace GU
 		rcStraightPath.push_back(inputStraightPath);
 	}
 
+	int RCScheduler::calAgentSmoothPaths(const float* starts, const float* ends, int n)
+	{
+		if (m_pathSmoother == nullptr || n <= 0) return 0;
+		std::vector<float> points;
+		std::vector<int> offsets;
+		const int found = m_pathSmoother->smoothPaths(starts, ends, n, m_crowd->getQueryExtents(), m_crowd->getFilter(0),
+			MAX_SMOOTH, points, offsets, GLOBAL_THREAD_POOL.get());
+
+		// keep only the pairs with a path, every stored path is drawn
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (agentPathOffsets.empty()) agentPathOffsets.push_back(0);
+		for (int i = 0; i < n; i++)
+		{
+			if (offsets[i + 1] == offsets[i]) continue;
+			agentPaths.insert(agentPaths.end(), points.begin() + offsets[i] * 3, points.begin() + offsets[i + 1] * 3);
+			agentPathOffsets.push_back((int)agentPaths.size() / 3);
+		}
+		return found;
+	}
+
+	void RCScheduler::clearAgentSmoothPaths()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		agentPathOffsets.clear();
+		agentPaths.clear();
+		isAgentPathCleared = true;
+	}
+
 	void RCScheduler::saveAgent(const std::filesystem::path& filepath)
 	{
 		auto view = GLOBAL_SCENE->m_registry.view<AgentComponent, TagComponent>();
@@ -1141,12 +1186,92 @@ namespace GU
 	{
 		YAML::Node config = YAML::LoadFile(filepath.string());
 		auto agents = config["Agents"];
+		std::vector<float> starts;
+		std::vector<float> ends;
 		for (auto agent : agents)
 		{
-			glm::vec3 startPos = { agent.second[0].as<float>(), agent.second[1].as<float>(), agent.second[2].as<float>() };
-			glm::vec3 endPos = { agent.second[3].as<float>(), agent.second[4].as<float>(), agent.second[5].as<float>() };
-			GLOBAL_RCSCHEDULER->setAgent(startPos, endPos);
+			for (int i = 0; i < 3; i++)
+			{
+				starts.push_back(agent.second[i].as<float>());
+				ends.push_back(agent.second[3 + i].as<float>());
+			}
+		}
+		GLOBAL_SCENE->spawnAgents(starts.data(), ends.data(), (int)starts.size() / 3);
+	}
+
+	bool RCScheduler::saveNavMesh(const std::filesystem::path& filepath)
+	{
+		return GU::saveNavMesh(filepath, m_navMesh);
+	}
+
+	bool RCScheduler::startQueryLog(const std::filesystem::path& filepath)
+	{
+		// the crowd tick records through the same recorder
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_queryRecorder == nullptr) m_queryRecorder = new RCQueryRecorder();
+		if (!m_queryRecorder->open(filepath))
+		{
+			stopQueryLog();
+			return false;
+		}
+		// replay needs the navmesh the refs were captured against
+		std::filesystem::path meshpath = filepath;
+		meshpath.replace_extension(".navmesh");
+		saveNavMesh(meshpath);
+		return true;
+	}
+
+	bool RCScheduler::startTrajectoryRecord(const std::filesystem::path& filepath)
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_trajectoryRecorder == nullptr) m_trajectoryRecorder = new RCTrajectoryRecorder();
+		if (!m_trajectoryRecorder->open(filepath))
+		{
+			stopTrajectoryRecord();
+			return false;
 		}
+		return true;
+	}
+
+	bool RCScheduler::stopTrajectoryRecord()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_trajectoryRecorder == nullptr) return true;
+		const bool written = m_trajectoryRecorder->close();
+		if (!written) qDebug() << "Trajectory: write failed, the file is incomplete";
+		const uint64_t agentTicks = m_trajectoryRecorder->getAgentTickCount();
+		qDebug() << "Trajectory: " << m_trajectoryRecorder->getTickCount() << "ticks" << m_trajectoryRecorder->getBytesWritten() << "bytes"
+			<< (agentTicks ? (double)m_trajectoryRecorder->getBytesWritten() / agentTicks : 0.0) << "bytes per agent tick";
+		delete m_trajectoryRecorder;
+		m_trajectoryRecorder = nullptr;
+		return written;
+	}
+
+	void RCScheduler::recordTrajectory(float delatTime)
+	{
+		const int n = getMaxAgents();
+		RCTrajectoryFrame& frame = m_trajectoryRecorder->beginFrame(m_crowdTick, delatTime, n);
+		for (int i = 0; i < n; i++)
+		{
+			const dtCrowdAgent* ag = getCrowdAgent(i);
+			frame.state[i] = ag->active ? (unsigned char)(RC_AGENT_INVALID + ag->state) : (unsigned char)RC_AGENT_INACTIVE;
+			if (!ag->active) continue;
+			dtVcopy(&frame.pos[i * 3], ag->npos);
+			dtVcopy(&frame.vel[i * 3], ag->vel);
+		}
+		m_trajectoryRecorder->commitFrame();
+	}
+
+	void RCScheduler::stopQueryLog()
+	{
+		std::lock_guard<std::recursive_mutex> lock(m_crowdMutex);
+		if (m_queryRecorder == nullptr) return;
+		qDebug() << "Query log: " << m_queryRecorder->getRecordCount() << "queries";
+		delete m_queryRecorder;
+		m_queryRecorder = nullptr;
+		if (m_crowd) m_crowd->queryRecorder = nullptr;
+		for (int i = 0; m_shardedCrowd && i < m_shardedCrowd->getShardCount(); i++)
+			m_shardedCrowd->getShard(i)->queryRecorder = nullptr;
 	}
 
 	void RCScheduler::createRCMesh(Mesh* mesh, rcMeshLoaderObj& rcMesh)
@@ -2,12 +2,14 @@
 #include <memory>
 #include "rcMeshLoaderObj.h"
 #include <Function/AgentNav/RCParams.h>
+#include <Function/AgentNav/RCQueryFilters.h>
 #include <Recast.h>
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 #include <DetourCrowd.h>
 #include <vector>
 #include <filesystem>
+#include <mutex>
 class dtNavMesh;
 class dtNavMeshQuery;
 class dtCrowd;
@@ -25,16 +27,39 @@ namespace GU
 	class RCAgentSamplePath;
 	class RCTContours;
 	class RCTCompactField;
+	class RCNavGraph;
+	class RCNavIslands;
+	class RCLandmarks;
+	class RCPathSearch;
+	class RCPathHierarchy;
+	class RCQueryRecorder;
+	class RCTrajectoryRecorder;
+	class RCDensityGrid;
+	class RCSimLod;
+	class RCAgentEvents;
+	class RCNavSampler;
+	class RCNavSnapGrid;
+	class RCPathSmoother;
+	class RCShardedCrowd;
+	class RCCrowd;
+	class RCSimLoop;
+	class RCSimClock;
+	struct RCCrowdSnapshot;
+	struct RCCrowdCheckpoint;
+	struct RCNavSampleQuery;
 	class RCScheduler
 	{
 	public:
 		
 		RCScheduler();
-		~RCScheduler() = default;
+		~RCScheduler();
 
 		bool handelBuild(const RCParams& rcparams, Mesh* mesh);
 		void handelRender(VkCommandBuffer cmdBuf, int currentImage);
 		bool raycastMesh(float* src, float* dst, float& tmin);
+		// Cast nrays segments (src/dst are 3 floats per ray). Writes the hit t (1 when missed)
+		// and the source triangle index (-1 when missed) for every ray, returns the hit count.
+		int raycastMeshBatch(const float* src, const float* dst, int nrays, float* outT, int* outTri);
 
 		/* crowd */
 		// add agent by params
@@ -42,25 +67,103 @@ namespace GU
 		void getAgentRotationWithId(int idx, glm::vec3& rotation);
 		float getVelLength(int idx);
 		glm::vec3 getAgentColor(int idx);
+		// A slot freed on arrival may be reused, callers drain the scene's agent events
+		// first under m_crowdMutex so its old entity is gone.
 		int addAgent(const glm::vec3& pos, const dtCrowdAgentParams& ap);
+		// n agents with agentParams, targets are snapped in one batch. starts and targets are
+		// 3 floats per agent, outIdx gets the crowd index or -1. Returns the added count.
+		int addAgents(const float* starts, const float* targets, int n, int* outIdx);
 		void setAgent(const glm::vec3& pos);
 		void setAgent(const glm::vec3& startpos, const glm::vec3& endpos);
+		// Spawn up to count agents at random navmesh points matching query. They head for
+		// the current target when one is set, otherwise for random points. Returns the spawned count.
+		int spawnRandomAgents(int count, uint64_t seed, const RCNavSampleQuery& query);
 
 		void setMoveTarget(int idx, const glm::vec3& pos);
+		// batched setMoveTarget, all targets are snapped in one parallel pass
+		void setMoveTargets(const int* idx, const glm::vec3* pos, int n);
+		void setMoveTargets(const int* idx, const float* pos, int n);
+		// nearest polygons for n positions with the crowd filter and extents, returns the hit count
+		int snapToNavMesh(const float* pos, int n, dtPolyRef* refs, float* pts);
 		void setCurrentTarget(const glm::vec3& pos);
 		void crowUpdatTick(float delatTime);
+
+		// Crowd access for both the single dtCrowd and the sharded crowd.
+		const dtCrowdAgent* getCrowdAgent(int idx);
+		bool requestCrowdMoveTarget(int idx, dtPolyRef ref, const float* pos);
+		void updateCrowdAgentParameters(int idx, const dtCrowdAgentParams* params);
+		void removeCrowdAgent(int idx);
+		int getMaxAgents() const;
+		// Groups on the single crowd: only the leader plans a path, the followers walk in
+		// a wedge GROUP_SPACING apart and drop their own move targets. Returns how many
+		// followers joined, always 0 on the sharded crowd.
+		int setAgentGroup(int leader, const int* followers, int n);
+		// -1 when idx follows nobody
+		int getAgentLeader(int idx);
+		int getAgentFollowerCount(int idx);
+		int getActiveAgentCount();
+		// set before handelBuild, MAX_CROWD_AGENTS agents over CROWD_SHARDS_X * CROWD_SHARDS_Z crowds
+		bool isUseShardedCrowd = false;
+		RCShardedCrowd* m_shardedCrowd = nullptr;
+		// rotation facing along vel, unchanged for zero velocity
+		static void getRotationFromVelocity(const float* vel, glm::vec3& rotation);
+
+		// Fixed timestep simulation thread. While it runs the renderer must not call
+		// crowUpdatTick and reads agents through acquireAgentState.
+		void startSimLoop(float tickRate = SIM_TICK_RATE, int maxCatchUpSteps = SIM_MAX_CATCHUP_STEPS);
+		void stopSimLoop();
+		bool isSimLoopRunning() const;
+		RCSimLoop* m_simLoop = nullptr;
+		// editor settings, the editor runs the loop from play to stop
+		bool isUseSimLoop = true;
+		float m_simTickRate = SIM_TICK_RATE;
+		int m_simMaxCatchUpSteps = SIM_MAX_CATCHUP_STEPS;
+		// hands changed settings to a running loop, stops it when it was switched off
+		void applySimLoopSettings();
+		// Frame driven simulation when the simulation thread does not run. At time scale 1
+		// one tick of the frame time, above it fixed steps for the scaled frame time.
+		void advanceFrame(float frameTime);
+		RCSimClock* m_frameClock = nullptr;
+		// Time scale of the simulation thread and the frame driven simulation. Above real
+		// time each frame runs steps within the CPU budget (ms) and the renderer only sees the
+		// last one. getSimSpeed reports the simulated seconds per wall second reached.
+		void setTimeScale(float scale);
+		void setSimCpuBudget(float ms);
+		float getSimSpeed() const;
+		float m_timeScale = 1.0f;
+		float m_simCpuBudget = SIM_CPU_BUDGET_MS;
+		// Agent state of the last tick for the renderer: the simulation thread's latest
+		// snapshot when it runs, otherwise the one advanceFrame captured after its ticks.
+		const RCCrowdSnapshot* acquireAgentState(float& alpha);
+		// captures m_agentState in one pass over the crowd when it ticked or was edited since
+		void updateAgentState();
+		RCCrowdSnapshot* m_agentState = nullptr;
+		// set by crowd changes outside of a tick
+		bool isAgentStateDirty = true;
+		// held while the crowd ticks, crowd changes from other threads take it too
+		std::recursive_mutex m_crowdMutex;
 		dtPolyRef m_targetRef;
 		float m_targetPos[3];
 		dtCrowdAgent* agents[MAX_AGENTS];
 		dtCrowdAgentDebugInfo m_agentDebug;
 		dtObstacleAvoidanceDebugData* m_vod;
-		class dtCrowd* m_crowd;
+		RCCrowd* m_crowd;
+		// run the crowd update phases on GLOBAL_THREAD_POOL, same result as serial
+		bool isUseParallelCrowd = false;
 		dtCrowdAgentParams agentParams;
 		glm::vec3 agentTargetPos;
 		bool isConsiderDie = false;
-		// path
-		std::vector<int> numbAgentPaths;
-		std::vector<std::array<float, MAX_SMOOTH*3> > agentPaths;
+		// walking paths of spawned agents for display, path i has the points
+		// [agentPathOffsets[i], agentPathOffsets[i + 1]) of agentPaths. Guarded by
+		// m_crowdMutex, handelRender turns new paths into rcAgentSamplePath.
+		bool isRenderAgentPath = false;
+		std::vector<int> agentPathOffsets;
+		std::vector<float> agentPaths;
+		bool isAgentPathCleared = false;
+		RCPathSmoother* m_pathSmoother = nullptr;
+		// Sampled walking paths for n start/end pairs appended to agentPaths, returns how many were found.
+		int calAgentSmoothPaths(const float* starts, const float* ends, int n);
+		void clearAgentSmoothPaths();
 
 		std::vector<std::shared_ptr<RCAgentPath>> rcAgentPath;
 		std::vector<std::shared_ptr<RCStraightPath>> rcStraightPath;
@@ -71,6 +174,65 @@ namespace GU
 		void saveAgent(const std::filesystem::path& filepath);
 		void readAgent(const std::filesystem::path& filepath);
 
+		// query capture for the QueryReplay benchmark
+		bool saveNavMesh(const std::filesystem::path& filepath);
+		bool startQueryLog(const std::filesystem::path& filepath);
+		void stopQueryLog();
+		RCQueryRecorder* m_queryRecorder = nullptr;
+
+		// per tick agent state of every crowd tick into a compact trajectory file, see RCTrajectoryReader.
+		// stop returns false when the file could not be written completely.
+		bool startTrajectoryRecord(const std::filesystem::path& filepath);
+		bool stopTrajectoryRecord();
+		void recordTrajectory(float delatTime);
+		RCTrajectoryRecorder* m_trajectoryRecorder = nullptr;
+		uint64_t m_crowdTick = 0;
+		double m_crowdTime = 0.0;
+
+		// agent counts per DENSITY_CELL_SIZE cell, updated every crowd tick from the agents
+		// the crowd lists as moved to another cell. Peak density alerts go out as
+		// RC_AGENT_EVENT_DENSITY_PEAK events.
+		RCDensityGrid* m_densityGrid = nullptr;
+		void updateDensityGrid();
+		// counting gate between two double clicked points while isSetGate is on
+		void setGatePoint(const glm::vec3& pos);
+		bool isSetGate = false;
+		bool m_hasGateStart = false;
+		glm::vec3 m_gateStart;
+		// agents per second through every gate over the flow window
+		void getGateFlowRates(std::vector<float>& rates);
+
+		// Arrival, stuck, failed target and off-mesh transitions found at the end of every
+		// crowd tick. Arrivals leave the crowd inside the tick in slot order, the scene drains
+		// the events once per frame and despawns their entities.
+		RCAgentEvents* m_agentEvents = nullptr;
+
+		// Lockstep mode for reproducible runs. Every crowd tick advances lockstepDt whatever
+		// the frame time, UUIDs come from seed and the state checksum of every tick is kept.
+		void setDeterministic(bool enable, uint64_t seed = 1, float lockstepDt = 1.0f / SIM_TICK_RATE);
+		bool isDeterministic = false;
+		uint64_t m_lockstepSeed = 1;
+		float m_lockstepDt = 1.0f / SIM_TICK_RATE;
+		uint64_t computeCrowdChecksum();
+		// one "tick checksum" line per lockstep tick, diff two runs to find where they diverge
+		bool saveChecksums(const std::filesystem::path& filepath);
+		std::vector<uint64_t> m_tickChecksums;
+		void lockstepTick();
+
+		// Checkpoints of the crowd and its agent entities, to branch a scenario without
+		// simulating it again from the start. Restore also resets the tick counter, the
+		// density grid and the lockstep checksums to the saved tick. Not available for
+		// the sharded crowd. Callers of save drain the scene's agent events first under
+		// m_crowdMutex, agents removed on arrival must not be saved as entities.
+		bool saveCheckpoint(RCCrowdCheckpoint& checkpoint);
+		bool restoreCheckpoint(const RCCrowdCheckpoint& checkpoint);
+
+		// simulation level of detail by camera distance and density, off in lockstep mode
+		void setUseSimLod(bool enable);
+		void setLodCamera(const glm::vec3& pos, const glm::mat4& viewProj);
+		bool isUseSimLod = false;
+		RCSimLod* m_simLod = nullptr;
+
 		bool isSetTarget = false;
 		bool isSetAgent = false;
 		/* crowd */
@@ -85,30 +247,71 @@ namespace GU
 		RCTContours* m_tContours = nullptr;
 		RCTCompactField* m_TCompatField = nullptr;
 		RCHeightfieldSolid* m_heightFieldSolid = nullptr;
+
+		// reachability, labels are kept per filter
+		enum IslandFilter
+		{
+			ISLAND_FILTER_CROWD,	// m_crowd->getFilter(0)
+			ISLAND_FILTER_DEFAULT,	// m_defaultFilter
+			ISLAND_FILTER_COUNT
+		};
+		// default dtQueryFilter of calAgentPath and the hierarchy, the islands keep a pointer to it
+		dtQueryFilter m_defaultFilter;
+		// move targets on another island to the nearest reachable point instead of dropping them
+		bool isRedirectUnreachable = true;
+		RCNavGraph* m_navGraph = nullptr;
+		RCNavIslands* m_navIslands = nullptr;
+
+		// ALT landmark heuristic for calAgentPath and the crowd's full path requests
+		bool isUseLandmarks = false;
+		RCLandmarks* m_landmarks = nullptr;
+		RCPathSearch* m_pathSearch = nullptr;
+
+		// cluster level search for long paths, only the first HIERARCHY_REFINE_SEGMENTS
+		// segments are refined and the crowd extends an agent's corridor as it walks
+		bool isUseHierarchy = false;
+		RCPathHierarchy* m_pathHierarchy = nullptr;
+
+		// hazard area and crowd density costs for calAgentPath and the crowd's full path
+		// requests. The crowd tick refreshes the density under m_crowdMutex, readers outside
+		// the tick copy it under the same lock.
+		bool isUseCrowdCost = false;
+		RCCrowdCostFilter m_crowdCostFilter;
+		std::vector<float> m_polyDensity;
+		void updatePolyDensity();
+
+		// area weighted random points, used for mass spawning
+		RCNavSampler* m_navSampler = nullptr;
+		// grid accelerated findNearestPoly
+		RCNavSnapGrid* m_snapGrid = nullptr;
 		glm::vec3 hitPos;
 		RCParams m_rcparams;
 
 		uint64_t targetModelId;
 	private:
 		void createRCMesh(Mesh* mesh, rcMeshLoaderObj& rcMesh);
+		bool resolveReachableTarget(dtPolyRef startRef, int filterIdx, const float* halfExtents, dtPolyRef& targetRef, float* targetPos);
+		// path search options of the crowd from the isUse flags, set before every crowd tick
+		void setCrowdSearch(RCCrowd* crowd);
 	private:
-		unsigned char* m_triareas;
-		rcHeightfield* m_solid;
-		rcCompactHeightfield* m_chf;
-		rcContourSet* m_cset;
-		rcPolyMesh* m_pmesh;
+		// Recast results of the last build, solid, chf and cset only with m_keepInterResults
+		rcHeightfield* m_solid = nullptr;
+		rcCompactHeightfield* m_chf = nullptr;
+		rcContourSet* m_cset = nullptr;
+		rcPolyMesh* m_pmesh = nullptr;
 		rcConfig m_cfg;
-		rcPolyMeshDetail* m_dmesh;
+		rcPolyMeshDetail* m_dmesh = nullptr;
 		rcMeshLoaderObj m_mesh;
-		rcChunkyTriMesh* m_chunkyMesh;
+		rcChunkyTriMesh* m_chunkyMesh = nullptr;
 		BuildContext* m_ctx;
 		float m_meshBMin[3], m_meshBMax[3];
 
 
-		class dtNavMesh* m_navMesh;
+		class dtNavMesh* m_navMesh = nullptr;
 		class dtNavMeshQuery* m_navQuery;
 
-
+	public:
+		// shared with the headless navmesh build
 		enum PartitionType
 		{
 			SAMPLE_PARTITION_WATERSHED,
@@ -0,0 +1,373 @@
+#include "RCShardedCrowd.h"
+#include <Function/AgentNav/RCParams.h>
+#include <Core/ParallelFor.h>
+#include <DetourCommon.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace GU
+{
+	// dtProximityGrid stores 4 items per agent and proxy behind unsigned short links
+	static const int MAX_SHARD_CAPACITY = 16000;
+
+	RCShardedCrowd::~RCShardedCrowd()
+	{
+		clear();
+	}
+
+	bool RCShardedCrowd::init(int maxAgents, float maxAgentRadius, dtNavMesh* navMesh, int nshardsX, int nshardsZ)
+	{
+		clear();
+		if (navMesh == nullptr || maxAgents <= 0) return false;
+		m_navMesh = navMesh;
+		m_maxAgents = maxAgents;
+		m_nx = dtMax(1, nshardsX);
+		m_nz = dtMax(1, nshardsZ);
+		m_migrateSlack = maxAgentRadius;
+		m_inactiveAgent.active = false;
+
+		float bmin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float bmax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		const dtNavMesh* nav = navMesh;
+		for (int i = 0; i < nav->getMaxTiles(); i++)
+		{
+			const dtMeshTile* tile = nav->getTile(i);
+			if (!tile || !tile->header) continue;
+			dtVmin(bmin, tile->header->bmin);
+			dtVmax(bmax, tile->header->bmax);
+		}
+		if (bmin[0] > bmax[0]) return false;
+		m_origin[0] = bmin[0];
+		m_origin[1] = bmin[2];
+		m_cellSize[0] = dtMax((bmax[0] - bmin[0]) / m_nx, 0.01f);
+		m_cellSize[1] = dtMax((bmax[2] - bmin[2]) / m_nz, 0.01f);
+
+		// Shards rarely hold an even share, leave room for crowding. Proxies take a
+		// quarter of the room the grid ids leave. Full shards grow later.
+		const int nshards = m_nx * m_nz;
+		const int capacity = dtMin(dtMin(maxAgents, maxAgents * 4 / nshards + 256), MAX_SHARD_CAPACITY * 4 / 5);
+		const int maxProxies = capacity / 4;
+		m_shards.resize(nshards);
+		for (int z = 0; z < m_nz; z++)
+		{
+			for (int x = 0; x < m_nx; x++)
+			{
+				Shard& shard = m_shards[z * m_nx + x];
+				shard.bmin[0] = m_origin[0] + x * m_cellSize[0];
+				shard.bmin[1] = m_origin[1] + z * m_cellSize[1];
+				shard.bmax[0] = shard.bmin[0] + m_cellSize[0];
+				shard.bmax[1] = shard.bmin[1] + m_cellSize[1];
+				shard.crowd = new RCCrowd();
+				if (!shard.crowd->init(capacity, maxAgentRadius, navMesh, maxProxies))
+					return false;
+				shard.capacity = capacity;
+				shard.maxProxies = maxProxies;
+				shard.owner.assign(capacity, -1);
+				shard.active.resize(capacity);
+				shard.proxies.reserve(maxProxies);
+			}
+		}
+
+		m_slots.assign(maxAgents, Slot());
+		m_freeSlots.resize(maxAgents);
+		for (int i = 0; i < maxAgents; i++)
+			m_freeSlots[i] = maxAgents - 1 - i;
+		return true;
+	}
+
+	void RCShardedCrowd::clear()
+	{
+		for (auto& shard : m_shards)
+			delete shard.crowd;
+		m_shards.clear();
+		m_slots.clear();
+		m_freeSlots.clear();
+		m_droppedProxies = 0;
+		m_cellChanges.clear();
+		m_maxAgents = 0;
+		m_navMesh = nullptr;
+	}
+
+	int RCShardedCrowd::shardAt(const float* pos) const
+	{
+		const int x = dtClamp((int)floorf((pos[0] - m_origin[0]) / m_cellSize[0]), 0, m_nx - 1);
+		const int z = dtClamp((int)floorf((pos[2] - m_origin[1]) / m_cellSize[1]), 0, m_nz - 1);
+		return z * m_nx + x;
+	}
+
+	float RCShardedCrowd::distToShard(const Shard& shard, const float* pos) const
+	{
+		const float dx = dtMax(shard.bmin[0] - pos[0], dtMax(0.0f, pos[0] - shard.bmax[0]));
+		const float dz = dtMax(shard.bmin[1] - pos[2], dtMax(0.0f, pos[2] - shard.bmax[1]));
+		return sqrtf(dx * dx + dz * dz);
+	}
+
+	int RCShardedCrowd::addAgent(const float* pos, const dtCrowdAgentParams* params)
+	{
+		if (m_freeSlots.empty()) return -1;
+		const int s = shardAt(pos);
+		Shard& shard = m_shards[s];
+		int local = shard.crowd->addAgent(pos, params);
+		if (local == -1 && growShard(s, shard.capacity * 2, shard.maxProxies))
+			local = shard.crowd->addAgent(pos, params);
+		if (local == -1) return -1;
+
+		const int idx = m_freeSlots.back();
+		m_freeSlots.pop_back();
+		m_slots[idx].shard = s;
+		m_slots[idx].local = local;
+		shard.owner[local] = idx;
+		return idx;
+	}
+
+	void RCShardedCrowd::removeAgent(int idx)
+	{
+		if (idx < 0 || idx >= m_maxAgents || m_slots[idx].shard < 0) return;
+		Slot& slot = m_slots[idx];
+		Shard& shard = m_shards[slot.shard];
+		shard.crowd->removeAgent(slot.local);
+		shard.owner[slot.local] = -1;
+		slot = Slot();
+		m_freeSlots.push_back(idx);
+	}
+
+	bool RCShardedCrowd::requestMoveTarget(int idx, dtPolyRef ref, const float* pos)
+	{
+		if (idx < 0 || idx >= m_maxAgents || m_slots[idx].shard < 0) return false;
+		return m_shards[m_slots[idx].shard].crowd->requestMoveTarget(m_slots[idx].local, ref, pos);
+	}
+
+	bool RCShardedCrowd::requestMoveVelocity(int idx, const float* vel)
+	{
+		if (idx < 0 || idx >= m_maxAgents || m_slots[idx].shard < 0) return false;
+		return m_shards[m_slots[idx].shard].crowd->requestMoveVelocity(m_slots[idx].local, vel);
+	}
+
+	void RCShardedCrowd::updateAgentParameters(int idx, const dtCrowdAgentParams* params)
+	{
+		if (idx < 0 || idx >= m_maxAgents || m_slots[idx].shard < 0) return;
+		m_shards[m_slots[idx].shard].crowd->updateAgentParameters(m_slots[idx].local, params);
+	}
+
+	const dtCrowdAgent* RCShardedCrowd::getAgent(int idx) const
+	{
+		if (idx < 0 || idx >= m_maxAgents || m_slots[idx].shard < 0) return &m_inactiveAgent;
+		return m_shards[m_slots[idx].shard].crowd->getAgent(m_slots[idx].local);
+	}
+
+	int RCShardedCrowd::getActiveAgents(int* ids, int maxIds)
+	{
+		int n = 0;
+		for (Shard& shard : m_shards)
+		{
+			// the lists of the last update miss the agents added or moved since
+			shard.nactive = shard.crowd->getActiveAgents(shard.active.data(), (int)shard.active.size());
+			for (int i = 0; i < shard.nactive && n < maxIds; i++)
+				ids[n++] = shard.owner[shard.crowd->getAgentIndex(shard.active[i])];
+		}
+		return n;
+	}
+
+	int RCShardedCrowd::getProxyCount() const
+	{
+		int n = 0;
+		for (const auto& shard : m_shards)
+			n += shard.crowd->getNeighbourProxyCount();
+		return n;
+	}
+
+	void RCShardedCrowd::update(float dt, ThreadPool* pool)
+	{
+		if (m_shards.empty()) return;
+		const int nshards = (int)m_shards.size();
+
+		// Proxies are read from the border lists of the other shards, so every shard
+		// has its list before any of them gathers.
+		parallelFor(pool, nshards, MAX_WORKERS, [&](int, int begin, int end)
+		{
+			for (int s = begin; s < end; s++)
+				collectBorder(s);
+		});
+		float range = 0.0f;
+		for (const auto& shard : m_shards)
+			range = dtMax(range, shard.borderRange);
+		parallelFor(pool, nshards, MAX_WORKERS, [&](int, int begin, int end)
+		{
+			for (int s = begin; s < end; s++)
+				gatherProxies(s, range);
+		});
+
+		parallelFor(pool, nshards, MAX_WORKERS, [&](int, int begin, int end)
+		{
+			for (int s = begin; s < end; s++)
+			{
+				m_shards[s].crowd->update(dt, nullptr);
+				collectLeaving(s);
+			}
+		});
+
+		// global ids, before the migrations hand out new local ones
+		m_cellChanges.clear();
+		for (const auto& shard : m_shards)
+		{
+			for (int local : shard.crowd->getCellChanges())
+				m_cellChanges.push_back(shard.owner[local]);
+		}
+
+		// in shard order, the result does not depend on the pool
+		for (const auto& shard : m_shards)
+		{
+			for (int idx : shard.leaving)
+				moveAgent(idx, shardAt(getAgent(idx)->npos));
+		}
+
+		m_droppedProxies = 0;
+		for (int s = 0; s < nshards; s++)
+		{
+			Shard& shard = m_shards[s];
+			if (shard.droppedProxies == 0) continue;
+			m_droppedProxies += shard.droppedProxies;
+			growShard(s, shard.capacity, dtMax(shard.maxProxies * 2, (int)shard.proxies.size()));
+		}
+	}
+
+	void RCShardedCrowd::collectBorder(int s)
+	{
+		Shard& shard = m_shards[s];
+		shard.nactive = shard.crowd->getActiveAgents(shard.active.data(), (int)shard.active.size());
+		shard.border.clear();
+		shard.borderRange = 0.0f;
+		for (int i = 0; i < shard.nactive; i++)
+		{
+			const dtCrowdAgent* ag = shard.active[i];
+			const float range = ag->params.collisionQueryRange;
+			// negative for agents still outside after the migration slack
+			const float inside = dtMin(dtMin(ag->npos[0] - shard.bmin[0], shard.bmax[0] - ag->npos[0]),
+				dtMin(ag->npos[2] - shard.bmin[1], shard.bmax[1] - ag->npos[2]));
+			if (inside >= range) continue;
+			shard.border.push_back(shard.crowd->getAgentIndex(ag));
+			shard.borderRange = dtMax(shard.borderRange, range);
+		}
+	}
+
+	void RCShardedCrowd::gatherProxies(int s, float range)
+	{
+		// Every agent within its collision query range of another shard is visible there.
+		Shard& shard = m_shards[s];
+		shard.proxies.clear();
+		const int x = s % m_nx;
+		const int z = s / m_nx;
+		const int rx = (int)ceilf(range / m_cellSize[0]);
+		const int rz = (int)ceilf(range / m_cellSize[1]);
+		for (int tz = dtMax(0, z - rz); tz <= dtMin(m_nz - 1, z + rz); tz++)
+		{
+			for (int tx = dtMax(0, x - rx); tx <= dtMin(m_nx - 1, x + rx); tx++)
+			{
+				const int t = tz * m_nx + tx;
+				if (t == s) continue;
+				const Shard& other = m_shards[t];
+				for (int local : other.border)
+				{
+					const dtCrowdAgent* ag = other.crowd->getAgent(local);
+					if (distToShard(shard, ag->npos) >= ag->params.collisionQueryRange) continue;
+					RCCrowdProxy proxy;
+					dtVcopy(proxy.npos, ag->npos);
+					dtVcopy(proxy.vel, ag->vel);
+					dtVcopy(proxy.dvel, ag->dvel);
+					proxy.radius = ag->params.radius;
+					proxy.height = ag->params.height;
+					shard.proxies.push_back(proxy);
+				}
+			}
+		}
+		shard.droppedProxies = dtMax(0, (int)shard.proxies.size() - shard.maxProxies);
+		shard.crowd->setNeighbourProxies(shard.proxies.data(), (int)shard.proxies.size());
+	}
+
+	void RCShardedCrowd::collectLeaving(int s)
+	{
+		// the update does not add or remove agents, the list of collectBorder still holds
+		Shard& shard = m_shards[s];
+		shard.leaving.clear();
+		for (int i = 0; i < shard.nactive; i++)
+		{
+			const dtCrowdAgent* ag = shard.active[i];
+			// agents on an off-mesh link keep their animation state in the old shard
+			if (ag->state != DT_CROWDAGENT_STATE_WALKING) continue;
+			// small slack so agents walking along a border do not bounce between shards
+			if (distToShard(shard, ag->npos) <= m_migrateSlack || shardAt(ag->npos) == s) continue;
+			shard.leaving.push_back(shard.owner[shard.crowd->getAgentIndex(ag)]);
+		}
+	}
+
+	bool RCShardedCrowd::moveAgent(int idx, int to)
+	{
+		Slot& slot = m_slots[idx];
+		Shard& from = m_shards[slot.shard];
+		Shard& dest = m_shards[to];
+		const dtCrowdAgent* src = from.crowd->getAgent(slot.local);
+
+		int local = dest.crowd->addAgent(src->npos, &src->params);
+		if (local == -1 && growShard(to, dest.capacity * 2, dest.maxProxies))
+			local = dest.crowd->addAgent(src->npos, &src->params);
+		// destination at the grid limit, try again next tick
+		if (local == -1) return false;
+
+		dtCrowdAgent* ag = dest.crowd->getEditableAgent(local);
+		dtVcopy(ag->vel, src->vel);
+		dtVcopy(ag->dvel, src->dvel);
+		dtVcopy(ag->nvel, src->nvel);
+		ag->desiredSpeed = src->desiredSpeed;
+		ag->topologyOptTime = src->topologyOptTime;
+		ag->partial = src->partial;
+
+		switch (src->targetState)
+		{
+		case DT_CROWDAGENT_TARGET_VALID:
+			// the corridor starts at the current polygon, carry it over as is
+			ag->corridor.setCorridor(src->corridor.getTarget(), src->corridor.getPath(), src->corridor.getPathCount());
+			ag->targetState = src->targetState;
+			ag->targetRef = src->targetRef;
+			dtVcopy(ag->targetPos, src->targetPos);
+			ag->targetReplan = src->targetReplan;
+			ag->targetReplanTime = src->targetReplanTime;
+			break;
+		case DT_CROWDAGENT_TARGET_VELOCITY:
+			dest.crowd->requestMoveVelocity(local, src->targetPos);
+			break;
+		case DT_CROWDAGENT_TARGET_REQUESTING:
+		case DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE:
+		case DT_CROWDAGENT_TARGET_WAITING_FOR_PATH:
+			// path queue requests belong to the old shard, ask again
+			dest.crowd->requestMoveTarget(local, src->targetRef, src->targetPos);
+			break;
+		default:
+			ag->targetState = src->targetState;
+			break;
+		}
+
+		from.crowd->removeAgent(slot.local);
+		from.owner[slot.local] = -1;
+		dest.owner[local] = idx;
+		slot.shard = to;
+		slot.local = local;
+		return true;
+	}
+
+	bool RCShardedCrowd::growShard(int s, int capacity, int maxProxies)
+	{
+		// The agents and proxies of a shard share the grid ids, neither outgrows the
+		// global count. Local indices stay, so the owner lists only get longer.
+		Shard& shard = m_shards[s];
+		capacity = dtClamp(capacity, shard.capacity, dtMin(m_maxAgents, MAX_SHARD_CAPACITY - shard.maxProxies));
+		maxProxies = dtClamp(maxProxies, shard.maxProxies, dtMin(m_maxAgents, MAX_SHARD_CAPACITY - capacity));
+		if (capacity == shard.capacity && maxProxies == shard.maxProxies) return false;
+		if (!shard.crowd->resize(capacity, maxProxies)) return false;
+		shard.capacity = capacity;
+		shard.maxProxies = maxProxies;
+		shard.owner.resize(capacity, -1);
+		shard.active.resize(capacity);
+		return true;
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <Function/AgentNav/RCCrowd.h>
+class ThreadPool;
+
+namespace GU
+{
+	// Agents partitioned into a grid of RCCrowd shards over the navmesh bounds, so the
+	// crowd is no longer capped by one crowd and the shards update in parallel.
+	// Agents close to a border are handed to the neighbouring shards as read-only
+	// neighbour proxies, so avoidance, separation and collision see them with their
+	// state from the start of the tick. Agents leaving their shard migrate with their
+	// corridor and target. Agent ids are global and stay valid across migrations.
+	// Every pass runs per shard over its own agents, only the migrations are serial.
+	// A shard that runs out of agent or proxy slots grows, up to the proximity grid
+	// limit, so crowding into one shard is not capped while global ids are free.
+	class RCShardedCrowd
+	{
+	public:
+		RCShardedCrowd() = default;
+		~RCShardedCrowd();
+		RCShardedCrowd(const RCShardedCrowd&) = delete;
+		RCShardedCrowd& operator=(const RCShardedCrowd&) = delete;
+
+		bool init(int maxAgents, float maxAgentRadius, dtNavMesh* navMesh, int nshardsX, int nshardsZ);
+		void clear();
+
+		int getShardCount() const { return (int)m_shards.size(); }
+		// for filters, avoidance params and replan budgets, which have to be set on every shard
+		RCCrowd* getShard(int i) { return m_shards[i].crowd; }
+
+		int addAgent(const float* pos, const dtCrowdAgentParams* params);
+		void removeAgent(int idx);
+		bool requestMoveTarget(int idx, dtPolyRef ref, const float* pos);
+		bool requestMoveVelocity(int idx, const float* vel);
+		void updateAgentParameters(int idx, const dtCrowdAgentParams* params);
+		// never null, inactive ids return an agent with active == false
+		const dtCrowdAgent* getAgent(int idx) const;
+		int getAgentCount() const { return m_maxAgents; }
+		int getActiveAgentCount() const { return m_maxAgents - (int)m_freeSlots.size(); }
+		// global ids of the active agents shard by shard, returns the count
+		int getActiveAgents(int* ids, int maxIds);
+		// proxies used in the last update over all shards
+		int getProxyCount() const;
+		// proxies that did not fit their shard in the last update, the shards grow for the next
+		int getDroppedProxyCount() const { return m_droppedProxies; }
+		// global ids the shards listed in RCCrowd::getCellChanges in the last update
+		const std::vector<int>& getCellChanges() const { return m_cellChanges; }
+		int getShardOf(int idx) const { return m_slots[idx].shard; }
+		const float* getQueryExtents() const { return m_shards[0].crowd->getQueryExtents(); }
+		const dtQueryFilter* getFilter(int i) const { return m_shards[0].crowd->getFilter(i); }
+
+		// pool == nullptr runs the shards one after another, same result
+		void update(float dt, ThreadPool* pool);
+	private:
+		struct Slot
+		{
+			int shard = -1;
+			int local = -1;
+		};
+		struct Shard
+		{
+			RCCrowd* crowd = nullptr;
+			int capacity = 0;
+			int maxProxies = 0;
+			float bmin[2];
+			float bmax[2];
+			// local idx -> global id, -1 when free
+			std::vector<int> owner;
+			std::vector<dtCrowdAgent*> active;
+			int nactive = 0;
+			// own agents within their collision query range of the border
+			std::vector<int> border;
+			float borderRange = 0.0f;
+			std::vector<RCCrowdProxy> proxies;
+			int droppedProxies = 0;
+			// global ids of the agents that walked out
+			std::vector<int> leaving;
+		};
+
+		int shardAt(const float* pos) const;
+		float distToShard(const Shard& shard, const float* pos) const;
+		void collectBorder(int s);
+		void gatherProxies(int s, float range);
+		void collectLeaving(int s);
+		bool moveAgent(int idx, int to);
+		bool growShard(int s, int capacity, int maxProxies);
+
+		dtNavMesh* m_navMesh = nullptr;
+		int m_maxAgents = 0;
+		int m_nx = 0;
+		int m_nz = 0;
+		float m_origin[2] = {};
+		float m_cellSize[2] = {};
+		float m_migrateSlack = 0.0f;
+		std::vector<Shard> m_shards;
+		std::vector<Slot> m_slots;
+		std::vector<int> m_freeSlots;
+		int m_droppedProxies = 0;
+		std::vector<int> m_cellChanges;
+		dtCrowdAgent m_inactiveAgent;
+	};
+}
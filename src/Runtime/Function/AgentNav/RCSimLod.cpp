@@ -0,0 +1,132 @@
+#include "RCSimLod.h"
+#include <Function/AgentNav/RCScheduler.h>
+#include <Function/AgentNav/RCDensityGrid.h>
+#include <DetourCommon.h>
+#include <algorithm>
+#include <cstring>
+
+namespace GU
+{
+	void RCSimLod::init(int maxAgents)
+	{
+		m_levels.assign(maxAgents, RC_SIM_LOD_FULL);
+		m_fullParams.assign(maxAgents, dtCrowdAgentParams());
+		m_lodParams.assign(maxAgents, dtCrowdAgentParams());
+		memset(m_levelCounts, 0, sizeof(m_levelCounts));
+		m_levelCounts[RC_SIM_LOD_FULL] = maxAgents;
+	}
+
+	void RCSimLod::setCamera(const float* pos, const float* viewProj)
+	{
+		std::lock_guard<std::mutex> lock(m_cameraMutex);
+		dtVcopy(m_cameraPos, pos);
+		memcpy(m_viewProj, viewProj, sizeof(m_viewProj));
+		m_hasCamera = true;
+	}
+
+	int RCSimLod::pickLevel(int current, float dist, bool visible, bool dense) const
+	{
+		if (dense) return RC_SIM_LOD_FULL;
+		int level = current;
+		// step out only past the next distance + 10%, back in below the current one - 10%
+		while (level < RC_SIM_LOD_CORRIDOR && dist > m_distances[level] * 1.1f) level++;
+		while (level > RC_SIM_LOD_FULL && dist < m_distances[level - 1] * 0.9f) level--;
+		if (!visible) level = std::max(level, m_offscreenLevel);
+		return level;
+	}
+
+	void RCSimLod::applyLevel(RCScheduler* scheduler, int idx, const dtCrowdAgent* ag, int level)
+	{
+		const int current = m_levels[idx];
+		if (level == current) return;
+		if (current == RC_SIM_LOD_FULL) m_fullParams[idx] = ag->params;
+
+		dtCrowdAgentParams params = m_fullParams[idx];
+		if (level >= RC_SIM_LOD_MEDIUM)
+			params.obstacleAvoidanceType = std::min<unsigned char>(params.obstacleAvoidanceType, 1);
+		if (level >= RC_SIM_LOD_LOW)
+		{
+			params.obstacleAvoidanceType = 0;
+			params.updateFlags &= ~DT_CROWD_OPTIMIZE_TOPO;
+		}
+		if (level >= RC_SIM_LOD_CORRIDOR)
+		{
+			// collisions still need the close neighbours
+			params.updateFlags &= ~(DT_CROWD_OBSTACLE_AVOIDANCE | DT_CROWD_SEPARATION | DT_CROWD_OPTIMIZE_VIS);
+			params.collisionQueryRange = std::min(params.collisionQueryRange, params.radius * 4.0f);
+		}
+		scheduler->updateCrowdAgentParameters(idx, &params);
+		m_lodParams[idx] = params;
+		m_levelCounts[current]--;
+		m_levelCounts[level]++;
+		m_levels[idx] = (unsigned char)level;
+	}
+
+	void RCSimLod::update(RCScheduler* scheduler, uint64_t tick)
+	{
+		float cameraPos[3];
+		float viewProj[16];
+		{
+			std::lock_guard<std::mutex> lock(m_cameraMutex);
+			if (!m_hasCamera) return;
+			dtVcopy(cameraPos, m_cameraPos);
+			memcpy(viewProj, m_viewProj, sizeof(viewProj));
+		}
+
+		const RCDensityGrid* density = scheduler->m_densityGrid;
+		const int n = std::min(scheduler->getMaxAgents(), (int)m_levels.size());
+		const int interval = std::max(1, m_evalInterval);
+		for (int i = (int)(tick % interval); i < n; i += interval)
+		{
+			const dtCrowdAgent* ag = scheduler->getCrowdAgent(i);
+			if (!ag->active)
+			{
+				m_levelCounts[m_levels[i]]--;
+				m_levelCounts[RC_SIM_LOD_FULL]++;
+				m_levels[i] = RC_SIM_LOD_FULL;
+				continue;
+			}
+			// a slot reused or params changed by someone else since the last visit
+			const dtCrowdAgentParams& lodParams = m_lodParams[i];
+			if (m_levels[i] != RC_SIM_LOD_FULL &&
+				(ag->params.updateFlags != lodParams.updateFlags || ag->params.obstacleAvoidanceType != lodParams.obstacleAvoidanceType ||
+				 ag->params.collisionQueryRange != lodParams.collisionQueryRange))
+			{
+				m_levelCounts[m_levels[i]]--;
+				m_levelCounts[RC_SIM_LOD_FULL]++;
+				m_levels[i] = RC_SIM_LOD_FULL;
+			}
+
+			const float* p = ag->npos;
+			const float clip[4] = {
+				viewProj[0] * p[0] + viewProj[4] * p[1] + viewProj[8] * p[2] + viewProj[12],
+				viewProj[1] * p[0] + viewProj[5] * p[1] + viewProj[9] * p[2] + viewProj[13],
+				viewProj[2] * p[0] + viewProj[6] * p[1] + viewProj[10] * p[2] + viewProj[14],
+				viewProj[3] * p[0] + viewProj[7] * p[1] + viewProj[11] * p[2] + viewProj[15] };
+			const float w = clip[3] * 1.1f;
+			const bool visible = clip[3] > 0.0f && clip[0] >= -w && clip[0] <= w && clip[1] >= -w && clip[1] <= w && clip[2] <= w;
+
+			bool dense = false;
+			if (density)
+			{
+				const int cell = density->getCellAt(p);
+				dense = cell != -1 && density->getDensity(cell) >= m_denseDensity;
+			}
+			applyLevel(scheduler, i, ag, pickLevel(m_levels[i], dtVdist(p, cameraPos), visible, dense));
+		}
+	}
+
+	void RCSimLod::restore(RCScheduler* scheduler)
+	{
+		const int n = std::min(scheduler->getMaxAgents(), (int)m_levels.size());
+		for (int i = 0; i < n; i++)
+		{
+			if (m_levels[i] == RC_SIM_LOD_FULL) continue;
+			const dtCrowdAgent* ag = scheduler->getCrowdAgent(i);
+			if (ag->active) scheduler->updateCrowdAgentParameters(i, &m_fullParams[i]);
+			m_levelCounts[m_levels[i]]--;
+			m_levelCounts[RC_SIM_LOD_FULL]++;
+			m_levels[i] = RC_SIM_LOD_FULL;
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <DetourCrowd.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace GU
+{
+	class RCScheduler;
+
+	enum RCSimLodLevel
+	{
+		RC_SIM_LOD_FULL,		// the agent's own parameters
+		RC_SIM_LOD_MEDIUM,		// medium avoidance quality at most
+		RC_SIM_LOD_LOW,			// low avoidance quality, no topology optimization
+		RC_SIM_LOD_CORRIDOR,	// corridor following with collisions only
+		RC_SIM_LOD_LEVELS
+	};
+
+	// Per agent simulation level of detail. Agents close to the camera or in dense
+	// cells keep their parameters, farther and off-screen agents step down to cheaper
+	// avoidance and finally to plain corridor following. Levels only change params, the
+	// corridor and velocity carry over and the crowd's acceleration limit blends the
+	// steering, so switching is not visible. Distances have a 10% hysteresis band and
+	// each tick re-evaluates a slice of the agents.
+	class RCSimLod
+	{
+	public:
+		RCSimLod() = default;
+		~RCSimLod() = default;
+
+		void init(int maxAgents);
+		// called from the render thread, viewProj is column major with Vulkan clip depth
+		void setCamera(const float* pos, const float* viewProj);
+		void update(RCScheduler* scheduler, uint64_t tick);
+		// puts every degraded agent back to full detail
+		void restore(RCScheduler* scheduler);
+
+		int getLevel(int idx) const { return m_levels[idx]; }
+		int getLevelCount(int level) const { return m_levelCounts[level]; }
+
+		// camera distance where each level after full starts
+		float m_distances[RC_SIM_LOD_LEVELS - 1] = { 25.0f, 50.0f, 100.0f };
+		// cells with more agents per square meter stay at full detail
+		float m_denseDensity = 1.5f;
+		// off-screen agents use at least this level
+		int m_offscreenLevel = RC_SIM_LOD_LOW;
+		// ticks to visit every agent once
+		int m_evalInterval = 8;
+	private:
+		int pickLevel(int current, float dist, bool visible, bool dense) const;
+		void applyLevel(RCScheduler* scheduler, int idx, const dtCrowdAgent* ag, int level);
+
+		std::mutex m_cameraMutex;
+		float m_cameraPos[3] = {};
+		float m_viewProj[16] = {};
+		bool m_hasCamera = false;
+
+		std::vector<unsigned char> m_levels;
+		std::vector<dtCrowdAgentParams> m_fullParams;	// params before the agent was degraded
+		std::vector<dtCrowdAgentParams> m_lodParams;	// params set for the current level
+		int m_levelCounts[RC_SIM_LOD_LEVELS] = {};
+	};
+}
@@ -0,0 +1,225 @@
+#include "RCSimLoop.h"
+#include <Function/AgentNav/RCScheduler.h>
+#include <DetourCommon.h>
+#include <algorithm>
+#include <cmath>
+
+namespace GU
+{
+	void RCCrowdSnapshot::interpolate(int idx, float alpha, float* out) const
+	{
+		const float* a = &prevPos[idx * 3];
+		const float* b = &pos[idx * 3];
+		out[0] = a[0] + (b[0] - a[0]) * alpha;
+		out[1] = a[1] + (b[1] - a[1]) * alpha;
+		out[2] = a[2] + (b[2] - a[2]) * alpha;
+	}
+
+	void RCCrowdSnapshot::capture(RCScheduler* scheduler, const std::vector<float>* prev)
+	{
+		const int n = scheduler->getMaxAgents();
+		const size_t oldCount = color.size() / 3;
+		agentCount = n;
+		prevPos.resize((size_t)n * 3);
+		pos.resize((size_t)n * 3);
+		vel.resize((size_t)n * 3);
+		speed.resize(n);
+		rotation.resize((size_t)n * 3);
+		color.resize((size_t)n * 3);
+		state.resize(n);
+
+		// colors only depend on the slot
+		for (size_t i = oldCount; i < (size_t)n; i++)
+		{
+			const glm::vec3 c = scheduler->getAgentColor((int)i);
+			color[i * 3 + 0] = c.r;
+			color[i * 3 + 1] = c.g;
+			color[i * 3 + 2] = c.b;
+		}
+
+		const size_t nprev = prev ? prev->size() : 0;
+		for (int i = 0; i < n; i++)
+		{
+			const dtCrowdAgent* ag = scheduler->getCrowdAgent(i);
+			float* p = &pos[i * 3];
+			float* pp = &prevPos[i * 3];
+			float* v = &vel[i * 3];
+			if (!ag->active)
+			{
+				state[i] = RC_AGENT_INACTIVE;
+				continue;
+			}
+			state[i] = (unsigned char)(RC_AGENT_INVALID + ag->state);
+			dtVcopy(p, ag->npos);
+			dtVcopy(v, ag->vel);
+			// agents added after the capture have no previous state
+			if ((size_t)i * 3 + 2 < nprev) dtVcopy(pp, &(*prev)[i * 3]);
+			else dtVcopy(pp, p);
+
+			speed[i] = dtVlen(v);
+			glm::vec3 rot(0.0f);
+			RCScheduler::getRotationFromVelocity(v, rot);
+			rotation[i * 3 + 0] = rot.x;
+			rotation[i * 3 + 1] = rot.y;
+			rotation[i * 3 + 2] = rot.z;
+		}
+	}
+
+	void RCSimClock::reset()
+	{
+		m_accumulator = 0.0;
+		m_droppedTime = 0.0;
+		m_simSpeed = 0.0f;
+		m_windowWall = 0.0;
+		m_windowSim = 0.0;
+	}
+
+	void RCSimClock::idle(double frameTime)
+	{
+		m_accumulator = 0.0;
+		addSample(frameTime, 0.0);
+	}
+
+	void RCSimClock::addSample(double wallTime, double simTime)
+	{
+		m_windowWall += wallTime;
+		m_windowSim += simTime;
+		if (m_windowWall < 1.0) return;
+		m_simSpeed = (float)(m_windowSim / m_windowWall);
+		m_windowWall = 0.0;
+		m_windowSim = 0.0;
+	}
+
+	RCSimLoop::~RCSimLoop()
+	{
+		stop();
+	}
+
+	void RCSimLoop::start(RCScheduler* scheduler)
+	{
+		if (m_running || scheduler == nullptr) return;
+		m_scheduler = scheduler;
+		m_simTime = 0.0;
+		m_tickCount = 0;
+		m_clock.reset();
+		m_hasNew = false;
+		m_hasFront = false;
+		m_running = true;
+		m_thread = std::thread(&RCSimLoop::run, this);
+	}
+
+	void RCSimLoop::stop()
+	{
+		m_running = false;
+		if (m_thread.joinable()) m_thread.join();
+	}
+
+	void RCSimLoop::setTickRate(float ticksPerSecond)
+	{
+		m_tickRate = std::max(1.0f, ticksPerSecond);
+	}
+
+	void RCSimLoop::setMaxCatchUpSteps(int steps)
+	{
+		m_maxCatchUpSteps = std::max(1, steps);
+	}
+
+	void RCSimLoop::capturePositions(std::vector<float>& pos)
+	{
+		const int n = m_scheduler->getMaxAgents();
+		pos.resize((size_t)n * 3);
+		for (int i = 0; i < n; i++)
+		{
+			const dtCrowdAgent* ag = m_scheduler->getCrowdAgent(i);
+			pos[i * 3 + 0] = ag->npos[0];
+			pos[i * 3 + 1] = ag->npos[1];
+			pos[i * 3 + 2] = ag->npos[2];
+		}
+	}
+
+	void RCSimLoop::publish(double remainder, const std::vector<float>& prevPos)
+	{
+		RCCrowdSnapshot& snapshot = m_snapshots[m_back];
+		snapshot.tick = m_tickCount;
+		snapshot.simTime = m_simTime;
+		snapshot.remainder = remainder;
+		snapshot.publishTime = std::chrono::steady_clock::now();
+		snapshot.capture(m_scheduler, &prevPos);
+
+		std::lock_guard<std::mutex> lock(m_swapMutex);
+		std::swap(m_back, m_ready);
+		m_hasNew = true;
+	}
+
+	const RCCrowdSnapshot* RCSimLoop::acquireSnapshot(float& alpha)
+	{
+		std::lock_guard<std::mutex> lock(m_swapMutex);
+		if (m_hasNew)
+		{
+			std::swap(m_ready, m_front);
+			m_hasNew = false;
+			m_hasFront = true;
+		}
+		alpha = 1.0f;
+		if (!m_hasFront) return nullptr;
+
+		const RCCrowdSnapshot& snapshot = m_snapshots[m_front];
+		if (!m_paused)
+		{
+			const double step = 1.0 / m_tickRate;
+			const double since = std::chrono::duration<double>(std::chrono::steady_clock::now() - snapshot.publishTime).count();
+			alpha = (float)std::min(1.0, std::max(0.0, (snapshot.remainder + since * m_clock.getTimeScale()) / step));
+		}
+		return &snapshot;
+	}
+
+	void RCSimLoop::run()
+	{
+		using clock = std::chrono::steady_clock;
+		// a batch leaves the crowd to the render thread for at least this long
+		static const double MIN_BATCH_GAP = 0.001;
+
+		std::vector<float> prevPos;
+		auto last = clock::now();
+		while (m_running)
+		{
+			const double step = 1.0 / m_tickRate;
+			const auto now = clock::now();
+			const double frameTime = std::chrono::duration<double>(now - last).count();
+			last = now;
+
+			if (m_paused)
+			{
+				m_clock.idle(frameTime);
+				std::this_thread::sleep_until(now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(step)));
+				continue;
+			}
+
+			// above real time the renderer only sees the last step, there is nothing to blend
+			const float scale = m_clock.getTimeScale();
+			const bool blend = scale <= 1.0f;
+			std::unique_lock<std::recursive_mutex> lock(m_scheduler->m_crowdMutex, std::defer_lock);
+			const int steps = m_clock.advance(frameTime, step, m_maxCatchUpSteps, [&](double dt)
+			{
+				if (!lock.owns_lock()) lock.lock();
+				if (blend) capturePositions(prevPos);
+				m_scheduler->crowUpdatTick((float)dt);
+				m_simTime += dt;
+				m_tickCount++;
+			});
+			if (steps > 0)
+			{
+				if (!blend) prevPos.clear();
+				publish(m_clock.getAccumulator(), prevPos);
+				lock.unlock();
+			}
+
+			// wall time until the next step is due
+			const double wait = scale > 0.0f ? std::min(step, (step - m_clock.getAccumulator()) / scale) : step;
+			auto wake = now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(wait));
+			if (steps > 0)
+				wake = std::max(wake, clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(MIN_BATCH_GAP)));
+			std::this_thread::sleep_until(wake);
+		}
+	}
+}
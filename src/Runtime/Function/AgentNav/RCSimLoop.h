@@ -0,0 +1,185 @@
+#pragma once
+#include <Function/AgentNav/RCParams.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GU
+{
+	class RCScheduler;
+
+	enum RCAgentSnapshotState : unsigned char
+	{
+		RC_AGENT_INACTIVE,
+		RC_AGENT_INVALID,	// dtCrowdAgent states shifted by one
+		RC_AGENT_WALKING,
+		RC_AGENT_OFFMESH,
+	};
+
+	// Per agent slot state in structure of arrays layout, filled in one pass over the
+	// crowd so the renderer reads it linearly instead of going through dtCrowdAgent.
+	// Published by the simulation thread after a batch of ticks, or captured by
+	// RCScheduler::advanceFrame after the frame's ticks when no simulation thread runs.
+	// The renderer reads either through RCScheduler::acquireAgentState.
+	// prevPos is the state one tick before pos, the renderer blends them with alpha.
+	struct RCCrowdSnapshot
+	{
+		uint64_t tick = 0;
+		double simTime = 0.0;
+		// sim time left in the accumulator when published, and the wall clock of publishing
+		double remainder = 0.0;
+		std::chrono::steady_clock::time_point publishTime;
+		int agentCount = 0;
+		std::vector<float> prevPos;	// 3 per agent slot
+		std::vector<float> pos;
+		std::vector<float> vel;
+		std::vector<float> speed;		// 1 per agent slot
+		std::vector<float> rotation;	// euler angles facing along vel, zero when standing
+		std::vector<float> color;
+		std::vector<unsigned char> state;	// RCAgentSnapshotState
+
+		// prevPos == nullptr or shorter than the crowd uses the current position
+		void capture(RCScheduler* scheduler, const std::vector<float>* prevPos);
+		bool isActive(int idx) const { return idx >= 0 && idx < agentCount && state[idx] != RC_AGENT_INACTIVE; }
+		void interpolate(int idx, float alpha, float* out) const;
+	};
+
+	// Fixed steps for wall clock time at a time scale. Each advance adds frameTime times
+	// the time scale and runs the steps that are due, at most maxSteps per unit of time
+	// scale and only while the CPU budget of the call lasts. The backlog left after
+	// that is dropped, so a time scale the machine cannot keep up with runs as fast as
+	// the budget allows. Callers draw the state after the last step only.
+	class RCSimClock
+	{
+	public:
+		void reset();
+		// 0 stops the clock
+		void setTimeScale(float scale) { m_timeScale = std::min(std::max(scale, 0.0f), SIM_MAX_TIME_SCALE); }
+		float getTimeScale() const { return m_timeScale; }
+		// wall milliseconds per advance, <= 0 is unlimited. The first step always runs.
+		void setCpuBudget(float ms) { m_cpuBudgetMs = ms; }
+		float getCpuBudget() const { return m_cpuBudgetMs; }
+
+		// tick(step) runs once per step, returns the step count
+		template<typename F>
+		int advance(double frameTime, double step, int maxSteps, F&& tick);
+		// paused time, counts for the speed but adds nothing
+		void idle(double frameTime);
+
+		// sim time due but not run yet, less than a step after advance
+		double getAccumulator() const { return m_accumulator; }
+		// simulated seconds dropped because the step or CPU limit was hit
+		double getDroppedTime() const { return m_droppedTime; }
+		// simulated seconds per wall second over the last second
+		float getSimSpeed() const { return m_simSpeed; }
+		void addSample(double wallTime, double simTime);
+	private:
+		double m_accumulator = 0.0;
+		std::atomic<float> m_timeScale{ 1.0f };
+		std::atomic<float> m_cpuBudgetMs{ SIM_CPU_BUDGET_MS };
+		std::atomic<double> m_droppedTime{ 0.0 };
+		std::atomic<float> m_simSpeed{ 0.0f };
+		double m_windowWall = 0.0;
+		double m_windowSim = 0.0;
+	};
+
+	template<typename F>
+	int RCSimClock::advance(double frameTime, double step, int maxSteps, F&& tick)
+	{
+		using clock = std::chrono::steady_clock;
+		const auto start = clock::now();
+		const float scale = m_timeScale;
+		const double budget = m_cpuBudgetMs;
+		maxSteps *= std::max(1, (int)std::ceil(scale));
+		m_accumulator += frameTime * scale;
+
+		int steps = 0;
+		for (; m_accumulator >= step && steps < maxSteps; steps++)
+		{
+			if (steps > 0 && budget > 0.0 && std::chrono::duration<double, std::milli>(clock::now() - start).count() >= budget)
+				break;
+			tick(step);
+			m_accumulator -= step;
+		}
+		// still behind, drop whole steps
+		if (m_accumulator >= step)
+		{
+			const double dropped = m_accumulator - std::fmod(m_accumulator, step);
+			m_droppedTime = m_droppedTime + dropped;
+			m_accumulator -= dropped;
+		}
+		addSample(frameTime, steps * step);
+		return steps;
+	}
+
+	// Fixed timestep crowd simulation on its own thread. Wall time goes into an
+	// accumulator that is drained in steps of 1/tickRate, at most maxCatchUpSteps per
+	// wake up; backlog beyond that is dropped so a hitch slows the simulation down
+	// instead of producing one large step. Snapshots are triple buffered, the renderer
+	// takes the latest one without waiting for the simulation.
+	// Above real time a wake up runs the steps of the time scale within the CPU budget
+	// and publishes only the last one, without the state before it to blend from.
+	class RCSimLoop
+	{
+	public:
+		RCSimLoop() = default;
+		~RCSimLoop();
+		RCSimLoop(const RCSimLoop&) = delete;
+		RCSimLoop& operator=(const RCSimLoop&) = delete;
+
+		void start(RCScheduler* scheduler);
+		void stop();
+		bool isRunning() const { return m_running; }
+
+		// paused loops keep the thread alive but do not advance or accumulate time
+		void setPaused(bool paused) { m_paused = paused; }
+		bool isPaused() const { return m_paused; }
+
+		void setTickRate(float ticksPerSecond);
+		float getTickRate() const { return m_tickRate; }
+		void setMaxCatchUpSteps(int steps);
+		int getMaxCatchUpSteps() const { return m_maxCatchUpSteps; }
+
+		void setTimeScale(float scale) { m_clock.setTimeScale(scale); }
+		float getTimeScale() const { return m_clock.getTimeScale(); }
+		void setCpuBudget(float ms) { m_clock.setCpuBudget(ms); }
+		float getSimSpeed() const { return m_clock.getSimSpeed(); }
+
+		uint64_t getTickCount() const { return m_tickCount; }
+		// simulated seconds dropped because the catch-up limit or the CPU budget was hit
+		double getDroppedTime() const { return m_clock.getDroppedTime(); }
+
+		// Latest snapshot, nullptr before the first tick. Stays valid until the next
+		// acquireSnapshot call. alpha is the blend factor for the current wall time.
+		const RCCrowdSnapshot* acquireSnapshot(float& alpha);
+	private:
+		void run();
+		void capturePositions(std::vector<float>& pos);
+		void publish(double remainder, const std::vector<float>& prevPos);
+
+		RCScheduler* m_scheduler = nullptr;
+		std::thread m_thread;
+		std::atomic<bool> m_running{ false };
+		std::atomic<bool> m_paused{ false };
+		std::atomic<float> m_tickRate{ 60.0f };
+		std::atomic<int> m_maxCatchUpSteps{ 4 };
+		std::atomic<uint64_t> m_tickCount{ 0 };
+		RCSimClock m_clock;
+		double m_simTime = 0.0;
+
+		// triple buffer: sim writes m_snapshots[m_back], swaps it with m_ready,
+		// the reader swaps m_ready with m_front when m_hasNew is set
+		RCCrowdSnapshot m_snapshots[3];
+		int m_back = 0;
+		int m_ready = 1;
+		int m_front = 2;
+		bool m_hasNew = false;
+		bool m_hasFront = false;
+		std::mutex m_swapMutex;
+	};
+}
@@ -0,0 +1,446 @@
+#include "RCTrajectory.h"
+#include <Function/AgentNav/RCSimLoop.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace GU
+{
+	static const int TRAJECTORY_MAGIC = 'R' << 24 | 'C' << 16 | 'T' << 8 | 'J';
+	static const int TRAJECTORY_VERSION = 1;
+	// frames waiting for the writer before beginFrame blocks
+	static const size_t TRAJECTORY_MAX_PENDING = 256;
+
+	struct TrajectoryHeader
+	{
+		int magic;
+		int version;
+		float posQuant;
+		float velQuant;
+		int ticksPerChunk;
+	};
+
+	struct TrajectoryChunkHeader
+	{
+		uint32_t size;
+		uint32_t tickCount;
+		uint64_t firstTick;
+		uint64_t lastTick;
+	};
+
+	static inline void putVarint(std::vector<uint8_t>& out, uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			out.push_back((uint8_t)(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((uint8_t)v);
+	}
+
+	static inline bool getVarint(const uint8_t*& data, const uint8_t* end, uint64_t& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (data == end) return false;
+			const uint8_t b = *data++;
+			v |= (uint64_t)(b & 0x7f) << shift;
+			if (!(b & 0x80)) return true;
+		}
+		return false;
+	}
+
+	static inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+	static inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+	// 2 bit residual code: 0, +1, -1, or a zigzag varint after the code bytes
+	static inline int residualCode(int32_t r) { return r == 0 ? 0 : r == 1 ? 1 : r == -1 ? 2 : 3; }
+	static inline int32_t codeResidual(int code) { return code == 1 ? 1 : code == 2 ? -1 : 0; }
+
+	static inline int32_t quantize(float v, float quant) { return (int32_t)lrintf(v / quant); }
+
+	void RCTrajectoryFrame::resize(int n)
+	{
+		agentCount = n;
+		pos.resize((size_t)n * 3);
+		vel.resize((size_t)n * 3);
+		state.resize(n);
+	}
+
+	void RCTrajectoryCodec::reset()
+	{
+		lastTick = 0;
+		pos.clear();
+		prevPos.clear();
+		vel.clear();
+		state.clear();
+		history.clear();
+	}
+
+	void RCTrajectoryCodec::resize(int n)
+	{
+		if ((int)state.size() >= n) return;
+		pos.resize((size_t)n * 3, 0);
+		prevPos.resize((size_t)n * 3, 0);
+		vel.resize((size_t)n * 3, 0);
+		state.resize(n, RC_AGENT_INACTIVE);
+		history.resize(n, 0);
+	}
+
+	int RCTrajectoryCodec::encode(const RCTrajectoryFrame& frame, std::vector<uint8_t>& out)
+	{
+		const int n = frame.agentCount;
+		resize(n);
+		const int slots = (int)state.size();
+
+		putVarint(out, frame.tick - lastTick);
+		lastTick = frame.tick;
+		const size_t dtAt = out.size();
+		out.resize(dtAt + sizeof(float));
+		memcpy(&out[dtAt], &frame.dt, sizeof(float));
+		putVarint(out, n);
+
+		// state changes, slots past agentCount count as inactive
+		int nchanges = 0;
+		for (int i = 0; i < slots; i++)
+		{
+			const unsigned char s = i < n ? frame.state[i] : (unsigned char)RC_AGENT_INACTIVE;
+			if (s != state[i]) nchanges++;
+		}
+		putVarint(out, nchanges);
+		int lastId = 0;
+		for (int i = 0; i < slots; i++)
+		{
+			const unsigned char s = i < n ? frame.state[i] : (unsigned char)RC_AGENT_INACTIVE;
+			if (s == state[i]) continue;
+			putVarint(out, i - lastId);
+			out.push_back(s);
+			lastId = i;
+			if (state[i] == RC_AGENT_INACTIVE) history[i] = 0;
+			state[i] = s;
+		}
+
+		int nagents = 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (state[i] == RC_AGENT_INACTIVE) continue;
+			int32_t* p = &pos[i * 3];
+			int32_t* pp = &prevPos[i * 3];
+			int32_t* v = &vel[i * 3];
+			int32_t rp[3];
+			int32_t rv[3];
+			int32_t qp[3];
+			int32_t qv[3];
+			bool velChanged = false;
+			for (int j = 0; j < 3; j++)
+			{
+				qp[j] = quantize(frame.pos[i * 3 + j], posQuant);
+				qv[j] = quantize(frame.vel[i * 3 + j], velQuant);
+				// linear prediction once two samples are known
+				const int32_t pred = history[i] == 0 ? 0 : history[i] == 1 ? p[j] : 2 * p[j] - pp[j];
+				rp[j] = qp[j] - pred;
+				rv[j] = qv[j] - (history[i] ? v[j] : 0);
+				velChanged |= rv[j] != 0;
+			}
+			out.push_back((uint8_t)(residualCode(rp[0]) | residualCode(rp[1]) << 2 | residualCode(rp[2]) << 4 | (velChanged ? 1 << 6 : 0)));
+			if (velChanged)
+				out.push_back((uint8_t)(residualCode(rv[0]) | residualCode(rv[1]) << 2 | residualCode(rv[2]) << 4));
+			for (int j = 0; j < 3; j++)
+				if (residualCode(rp[j]) == 3) putVarint(out, zigzag(rp[j]));
+			if (velChanged)
+			{
+				for (int j = 0; j < 3; j++)
+					if (residualCode(rv[j]) == 3) putVarint(out, zigzag(rv[j]));
+			}
+			for (int j = 0; j < 3; j++)
+			{
+				pp[j] = p[j];
+				p[j] = qp[j];
+				v[j] = qv[j];
+			}
+			history[i] = (unsigned char)std::min(2, history[i] + 1);
+			nagents++;
+		}
+		return nagents;
+	}
+
+	bool RCTrajectoryCodec::decode(const uint8_t*& data, const uint8_t* end, RCTrajectoryFrame& frame)
+	{
+		uint64_t v = 0;
+		if (!getVarint(data, end, v)) return false;
+		frame.tick = lastTick + v;
+		lastTick = frame.tick;
+		if (end - data < (ptrdiff_t)sizeof(float)) return false;
+		memcpy(&frame.dt, data, sizeof(float));
+		data += sizeof(float);
+		if (!getVarint(data, end, v)) return false;
+		const int n = (int)v;
+		frame.resize(n);
+		resize(n);
+
+		uint64_t nchanges = 0;
+		if (!getVarint(data, end, nchanges)) return false;
+		uint64_t id = 0;
+		for (uint64_t c = 0; c < nchanges; c++)
+		{
+			if (!getVarint(data, end, v) || data == end) return false;
+			id += v;
+			if (id >= state.size()) return false;
+			const unsigned char s = *data++;
+			if (state[id] == RC_AGENT_INACTIVE) history[id] = 0;
+			state[id] = s;
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			frame.state[i] = state[i];
+			if (state[i] == RC_AGENT_INACTIVE) continue;
+			if (data == end) return false;
+			const uint8_t posCodes = *data++;
+			const bool velChanged = (posCodes & (1 << 6)) != 0;
+			uint8_t velCodes = 0;
+			if (velChanged)
+			{
+				if (data == end) return false;
+				velCodes = *data++;
+			}
+			int32_t rp[3];
+			int32_t rv[3];
+			for (int j = 0; j < 3; j++)
+			{
+				const int code = (posCodes >> (j * 2)) & 3;
+				rp[j] = codeResidual(code);
+				if (code == 3)
+				{
+					if (!getVarint(data, end, v)) return false;
+					rp[j] = (int32_t)unzigzag(v);
+				}
+			}
+			for (int j = 0; j < 3; j++)
+			{
+				const int code = (velCodes >> (j * 2)) & 3;
+				rv[j] = codeResidual(code);
+				if (code == 3)
+				{
+					if (!getVarint(data, end, v)) return false;
+					rv[j] = (int32_t)unzigzag(v);
+				}
+			}
+
+			int32_t* p = &pos[i * 3];
+			int32_t* pp = &prevPos[i * 3];
+			int32_t* qv = &vel[i * 3];
+			for (int j = 0; j < 3; j++)
+			{
+				const int32_t pred = history[i] == 0 ? 0 : history[i] == 1 ? p[j] : 2 * p[j] - pp[j];
+				const int32_t qp = pred + rp[j];
+				qv[j] = (history[i] ? qv[j] : 0) + rv[j];
+				pp[j] = p[j];
+				p[j] = qp;
+				frame.pos[i * 3 + j] = qp * posQuant;
+				frame.vel[i * 3 + j] = qv[j] * velQuant;
+			}
+			history[i] = (unsigned char)std::min(2, history[i] + 1);
+		}
+		return true;
+	}
+
+	RCTrajectoryRecorder::~RCTrajectoryRecorder()
+	{
+		close();
+	}
+
+	bool RCTrajectoryRecorder::open(const std::filesystem::path& filepath, float posQuant, float velQuant, int ticksPerChunk)
+	{
+		close();
+		m_file.open(filepath, std::ios::binary | std::ios::trunc);
+		if (!m_file.is_open()) return false;
+
+		m_codec.reset();
+		m_codec.posQuant = posQuant;
+		m_codec.velQuant = velQuant;
+		m_ticksPerChunk = std::max(1, ticksPerChunk);
+		m_chunk.clear();
+		m_chunkTicks = 0;
+		m_tickCount = 0;
+		m_agentTickCount = 0;
+		m_failed = false;
+
+		TrajectoryHeader header{ TRAJECTORY_MAGIC, TRAJECTORY_VERSION, posQuant, velQuant, m_ticksPerChunk };
+		m_file.write((const char*)&header, sizeof(header));
+		m_bytesWritten = sizeof(header);
+		if (!m_file.good())
+		{
+			m_file.close();
+			return false;
+		}
+		m_running = true;
+		m_thread = std::thread(&RCTrajectoryRecorder::run, this);
+		return true;
+	}
+
+	bool RCTrajectoryRecorder::close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_cond.notify_all();
+		if (m_thread.joinable()) m_thread.join();
+		if (m_file.is_open())
+		{
+			// the last buffered bytes are only written here
+			m_file.close();
+			if (m_file.fail()) m_failed = true;
+		}
+		return !m_failed;
+	}
+
+	RCTrajectoryFrame& RCTrajectoryRecorder::beginFrame(uint64_t tick, float dt, int agentCount)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [this] { return m_queue.size() < TRAJECTORY_MAX_PENDING || !m_running; });
+			if (m_pool.empty())
+			{
+				m_current = std::make_unique<RCTrajectoryFrame>();
+			}
+			else
+			{
+				m_current = std::move(m_pool.back());
+				m_pool.pop_back();
+			}
+		}
+		m_current->tick = tick;
+		m_current->dt = dt;
+		m_current->resize(agentCount);
+		return *m_current;
+	}
+
+	void RCTrajectoryRecorder::commitFrame()
+	{
+		if (!m_current) return;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_running) m_queue.push_back(std::move(m_current));
+			else m_current.reset();
+		}
+		m_cond.notify_all();
+	}
+
+	void RCTrajectoryRecorder::run()
+	{
+		while (true)
+		{
+			std::unique_ptr<RCTrajectoryFrame> frame;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cond.wait(lock, [this] { return !m_queue.empty() || !m_running; });
+				if (m_queue.empty()) break;
+				frame = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+			m_cond.notify_all();
+
+			if (m_failed)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pool.push_back(std::move(frame));
+				continue;
+			}
+			if (m_chunkTicks == 0)
+			{
+				// chunks decode on their own
+				m_codec.reset();
+				m_codec.lastTick = frame->tick;
+				m_chunkFirstTick = frame->tick;
+			}
+			m_agentTickCount += m_codec.encode(*frame, m_chunk);
+			m_chunkLastTick = frame->tick;
+			m_chunkTicks++;
+			m_tickCount++;
+			if (m_chunkTicks >= m_ticksPerChunk && !writeChunk()) m_failed = true;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pool.push_back(std::move(frame));
+		}
+		if (!m_failed && !writeChunk()) m_failed = true;
+	}
+
+	bool RCTrajectoryRecorder::writeChunk()
+	{
+		if (m_chunkTicks == 0) return true;
+		TrajectoryChunkHeader header{ (uint32_t)m_chunk.size(), (uint32_t)m_chunkTicks, m_chunkFirstTick, m_chunkLastTick };
+		m_file.write((const char*)&header, sizeof(header));
+		m_file.write((const char*)m_chunk.data(), m_chunk.size());
+		m_chunk.clear();
+		m_chunkTicks = 0;
+		if (!m_file.good()) return false;
+		m_bytesWritten += sizeof(header) + header.size;
+		return true;
+	}
+
+	bool RCTrajectoryReader::open(const std::filesystem::path& filepath)
+	{
+		m_file.close();
+		m_file.open(filepath, std::ios::binary);
+		if (!m_file.is_open()) return false;
+		TrajectoryHeader header;
+		m_file.read((char*)&header, sizeof(header));
+		if (!m_file || header.magic != TRAJECTORY_MAGIC || header.version != TRAJECTORY_VERSION)
+		{
+			m_file.close();
+			return false;
+		}
+		m_codec.reset();
+		m_codec.posQuant = header.posQuant;
+		m_codec.velQuant = header.velQuant;
+		m_dataStart = m_file.tellg();
+		m_chunkTicksLeft = 0;
+		return true;
+	}
+
+	bool RCTrajectoryReader::readChunk()
+	{
+		TrajectoryChunkHeader header;
+		m_file.read((char*)&header, sizeof(header));
+		if (!m_file) return false;
+		m_chunk.resize(header.size);
+		m_file.read((char*)m_chunk.data(), header.size);
+		if (!m_file) return false;
+		m_codec.reset();
+		m_codec.lastTick = header.firstTick;
+		m_cursor = m_chunk.data();
+		m_chunkTicksLeft = (int)header.tickCount;
+		return true;
+	}
+
+	bool RCTrajectoryReader::next(RCTrajectoryFrame& frame)
+	{
+		if (!m_file.is_open()) return false;
+		if (m_chunkTicksLeft == 0 && !readChunk()) return false;
+		m_chunkTicksLeft--;
+		return m_codec.decode(m_cursor, m_chunk.data() + m_chunk.size(), frame);
+	}
+
+	bool RCTrajectoryReader::seek(uint64_t tick)
+	{
+		if (!m_file.is_open()) return false;
+		m_file.clear();
+		m_file.seekg(m_dataStart);
+		m_chunkTicksLeft = 0;
+		TrajectoryChunkHeader header;
+		while (m_file.read((char*)&header, sizeof(header)))
+		{
+			if (header.lastTick >= tick)
+			{
+				m_file.seekg(-(std::streamoff)sizeof(header), std::ios::cur);
+				return true;
+			}
+			m_file.seekg(header.size, std::ios::cur);
+		}
+		m_file.clear();
+		return false;
+	}
+}
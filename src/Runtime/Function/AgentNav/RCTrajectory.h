@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GU
+{
+	// Agent state of one crowd tick, slots without an agent are RC_AGENT_INACTIVE.
+	struct RCTrajectoryFrame
+	{
+		uint64_t tick = 0;
+		float dt = 0.0f;
+		int agentCount = 0;
+		std::vector<float> pos;	// 3 per agent slot
+		std::vector<float> vel;
+		std::vector<unsigned char> state;	// RCAgentSnapshotState
+
+		void resize(int n);
+	};
+
+	// Decoder/encoder history shared by the recorder and the reader.
+	struct RCTrajectoryCodec
+	{
+		float posQuant = 0.01f;
+		float velQuant = 0.05f;
+		uint64_t lastTick = 0;
+		std::vector<int32_t> pos;	// quantized, 3 per slot
+		std::vector<int32_t> prevPos;
+		std::vector<int32_t> vel;
+		std::vector<unsigned char> state;
+		std::vector<unsigned char> history;	// samples in pos/prevPos, 0-2
+
+		void reset();
+		void resize(int n);
+		// appends one tick, returns the number of agents written
+		int encode(const RCTrajectoryFrame& frame, std::vector<uint8_t>& out);
+		// false on a truncated or corrupt tick
+		bool decode(const uint8_t*& data, const uint8_t* end, RCTrajectoryFrame& frame);
+	};
+
+	// Writes crowd trajectories to a chunked binary file. Positions and velocities are
+	// quantized and stored as residuals against a linear prediction, two bits per
+	// component for residuals in [-1, 1] and a varint escape otherwise. Agent slots are
+	// implicit, only state changes are listed per tick, so a steadily walking agent
+	// costs one or two bytes per tick. Every chunk starts from an empty history and can
+	// be decoded on its own.
+	// Frames are filled on the simulation thread, encoding and file writes happen on a
+	// background thread. beginFrame blocks when that thread falls far behind.
+	class RCTrajectoryRecorder
+	{
+	public:
+		RCTrajectoryRecorder() = default;
+		~RCTrajectoryRecorder();
+		RCTrajectoryRecorder(const RCTrajectoryRecorder&) = delete;
+		RCTrajectoryRecorder& operator=(const RCTrajectoryRecorder&) = delete;
+
+		// posQuant and velQuant in meters and meters per second
+		bool open(const std::filesystem::path& filepath, float posQuant = 0.01f, float velQuant = 0.05f, int ticksPerChunk = 600);
+		// writes the pending frames and the last chunk, false when a write failed
+		bool close();
+		bool isOpen() const { return m_running; }
+		// set by the writer thread when the file could not be written, later frames are
+		// dropped and readers stop at the chunk that failed
+		bool hasFailed() const { return m_failed; }
+
+		// Frame to fill for this tick, resized to agentCount slots. Hand it back with commitFrame.
+		RCTrajectoryFrame& beginFrame(uint64_t tick, float dt, int agentCount);
+		void commitFrame();
+
+		uint64_t getTickCount() const { return m_tickCount; }
+		uint64_t getAgentTickCount() const { return m_agentTickCount; }
+		uint64_t getBytesWritten() const { return m_bytesWritten; }
+	private:
+		void run();
+		bool writeChunk();
+
+		std::ofstream m_file;
+		std::thread m_thread;
+		std::atomic<bool> m_running{ false };
+		std::atomic<bool> m_failed{ false };
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::deque<std::unique_ptr<RCTrajectoryFrame> > m_queue;
+		std::vector<std::unique_ptr<RCTrajectoryFrame> > m_pool;
+		std::unique_ptr<RCTrajectoryFrame> m_current;
+
+		// owned by the writer thread
+		RCTrajectoryCodec m_codec;
+		std::vector<uint8_t> m_chunk;
+		int m_ticksPerChunk = 600;
+		int m_chunkTicks = 0;
+		uint64_t m_chunkFirstTick = 0;
+		uint64_t m_chunkLastTick = 0;
+
+		std::atomic<uint64_t> m_tickCount{ 0 };
+		std::atomic<uint64_t> m_agentTickCount{ 0 };
+		std::atomic<uint64_t> m_bytesWritten{ 0 };
+	};
+
+	class RCTrajectoryReader
+	{
+	public:
+		bool open(const std::filesystem::path& filepath);
+		// false at the end of the file or on a truncated chunk
+		bool next(RCTrajectoryFrame& frame);
+		// Moves to the chunk holding tick, next then returns the first tick of that chunk.
+		// False when the file ends before tick.
+		bool seek(uint64_t tick);
+
+		float getPosQuant() const { return m_codec.posQuant; }
+		float getVelQuant() const { return m_codec.velQuant; }
+	private:
+		bool readChunk();
+
+		std::ifstream m_file;
+		std::streampos m_dataStart;
+		RCTrajectoryCodec m_codec;
+		std::vector<uint8_t> m_chunk;
+		const uint8_t* m_cursor = nullptr;
+		int m_chunkTicksLeft = 0;
+	};
+}
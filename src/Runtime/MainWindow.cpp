@@ -24,16 +24,23 @@
 #include <QFileDialog>
 #include <Core/Project.h>
 #include <QProgressBar>
+#include <QComboBox>
+#include <QTimer>
 #include <Widgets/NavMeshParamsDlg.h>
 #include <Widgets/AddMeshToEntityDlg.h>
 #include <Core/ThreadPool.h>
 #include <Scene/Asset.h>
+#include <unordered_set>
 #include <Renderer/VulkanDescriptor.h>
 #include <Renderer/Texture.h>
 #include <Function/AgentNav/RCScheduler.h>
 #include <Function/Animation/Animation.h>
 #include <QMessageBox>
 #include <Widgets/AgentParam.h>
+#include <Widgets/SimParamDlg.h>
+#include <Function/AgentNav/RCCheckpoint.h>
+#include <Function/AgentNav/RCNavSampler.h>
+#include <QInputDialog>
 static QPointer<QPlainTextEdit> s_messageLogWidget;
 static QPointer<QFile> s_logFile;
 
@@ -149,9 +156,24 @@ MainWindow::MainWindow(QWidget *parent) :
 	ui->statusbar->addWidget(m_statusInfo);
 	ui->statusbar->addWidget(m_progressBar);
 	//m_progressBar->setValue(50);
+
+	// time scale, the status bar shows the simulation speed reached once a second
+	m_timeScaleBox = new QComboBox(this);
+	for (int scale : { 1, 2, 5, 10, 30, 60, 120 })
+		m_timeScaleBox->addItem(QString("x%1").arg(scale), scale);
+	m_timeScaleBox->setToolTip(QString::fromLocal8Bit("倍速"));
+	connect(m_timeScaleBox, SIGNAL(currentIndexChanged(int)), this, SLOT(slot_timeScaleChanged(int)));
+	ui->toolBar->addWidget(m_timeScaleBox);
+	m_simSpeedInfo = new QLabel(this);
+	ui->statusbar->addPermanentWidget(m_simSpeedInfo);
+	QTimer* simSpeedTimer = new QTimer(this);
+	connect(simSpeedTimer, SIGNAL(timeout()), this, SLOT(slot_updateSimSpeed()));
+	simSpeedTimer->start(1000);
 	agentParam = new AgentParam(this);
+	simParamDlg = new SimParamDlg(this);
 	ui->actAddAgent->setEnabled(false);
 	ui->actAgentTarget->setEnabled(false);
+	ui->actSpawnRandomAgents->setEnabled(false);
 }
 
 MainWindow::~MainWindow()
@@ -375,16 +397,28 @@ void MainWindow::progressEnd()
 
 void MainWindow::addEntity(uint64_t uuid)
 {
-	auto entity = GLOBAL_SCENE->getEntityByUUID(uuid);
-	auto name = entity.getComponent<GU::TagComponent>().Tag;
-	QStandardItem* item = new QStandardItem(name.c_str());
-	item->setData(uuid);
-	m_entityMap[uuid] = item;
+	addEntities({ uuid });
+}
+
+void MainWindow::addEntities(const std::vector<uint64_t>& uuids)
+{
+	if (uuids.empty()) return;
 	QIcon icon;
 	icon.addFile(":/images/entity.png");
-	item->setIcon(icon);
-	item->setEditable(false);
-	m_treeviewEntityRoot->appendRow(item);
+	QList<QStandardItem*> items;
+	items.reserve((int)uuids.size());
+	for (auto uuid : uuids)
+	{
+		auto entity = GLOBAL_SCENE->getEntityByUUID(uuid);
+		auto name = entity.getComponent<GU::TagComponent>().Tag;
+		QStandardItem* item = new QStandardItem(name.c_str());
+		item->setData(uuid);
+		m_entityMap[uuid] = item;
+		item->setIcon(icon);
+		item->setEditable(false);
+		items.append(item);
+	}
+	m_treeviewEntityRoot->appendRows(items);
 }
 
 void MainWindow::removeEntity(uint64_t uuid)
@@ -399,6 +433,19 @@ void MainWindow::removeEntity(uint64_t uuid)
 	}
 }
 
+void MainWindow::removeEntities(const std::vector<uint64_t>& uuids)
+{
+	if (uuids.empty()) return;
+	std::unordered_set<uint64_t> removed(uuids.begin(), uuids.end());
+	for (auto uuid : uuids) m_entityMap.erase(uuid);
+	// back to front so the rows in front keep their index
+	for (int i = m_treeviewEntityRoot->rowCount() - 1; i >= 0; i--)
+	{
+		if (removed.count(m_treeviewEntityRoot->child(i)->data().toULongLong()))
+			m_treeviewEntityRoot->removeRow(i);
+	}
+}
+
 
 void MainWindow::on_actShowViewDock_triggered()
 {
@@ -462,6 +509,8 @@ void MainWindow::on_actPlay_triggered()
 	ui->actShowViewDock->setChecked(false);*/
 	GU::g_CoreContext.g_isStop = false;
 	GU::g_CoreContext.g_isPlay = true;
+	if (GLOBAL_RCSCHEDULER->isUseSimLoop && !GLOBAL_RCSCHEDULER->isSimLoopRunning())
+		GLOBAL_RCSCHEDULER->startSimLoop(GLOBAL_RCSCHEDULER->m_simTickRate, GLOBAL_RCSCHEDULER->m_simMaxCatchUpSteps);
 }
 
 void MainWindow::on_actPause_triggered()
@@ -482,6 +531,7 @@ void MainWindow::on_actStop_triggered()
 	ui->actShowViewDock->setChecked(true);
 	GU::g_CoreContext.g_isPlay = false;
 	GU::g_CoreContext.g_isStop = true;
+	GLOBAL_RCSCHEDULER->stopSimLoop();
 }
 
 void MainWindow::on_actCreateEntity_triggered()
@@ -640,15 +690,23 @@ void MainWindow::on_actAgentParam_triggered()
 	{
 		ui->actAddAgent->setEnabled(true);
 		ui->actAgentTarget->setEnabled(true);
+		ui->actSpawnRandomAgents->setEnabled(true);
 	}
 }
 
+void MainWindow::on_actSimParam_triggered()
+{
+	simParamDlg->exec();
+}
+
 void MainWindow::on_actAgentTarget_triggered()
 {
 	bool isChecked = ui->actAgentTarget->isChecked();
 	GLOBAL_RCSCHEDULER->isSetTarget = isChecked;
 	GLOBAL_RCSCHEDULER->isSetAgent = false;
+	GLOBAL_RCSCHEDULER->isSetGate = false;
 	ui->actAddAgent->setChecked(false);
+	ui->actAddGate->setChecked(false);
 }
 
 void MainWindow::on_actAddAgent_triggered()
@@ -656,9 +714,33 @@ void MainWindow::on_actAddAgent_triggered()
 	bool isChecked = ui->actAddAgent->isChecked();
 	GLOBAL_RCSCHEDULER->isSetAgent = isChecked;
 	GLOBAL_RCSCHEDULER->isSetTarget = false;
+	GLOBAL_RCSCHEDULER->isSetGate = false;
+	ui->actAgentTarget->setChecked(false);
+	ui->actAddGate->setChecked(false);
+}
+
+void MainWindow::on_actAddGate_triggered()
+{
+	GLOBAL_RCSCHEDULER->isSetGate = ui->actAddGate->isChecked();
+	GLOBAL_RCSCHEDULER->m_hasGateStart = false;
+	GLOBAL_RCSCHEDULER->isSetAgent = false;
+	GLOBAL_RCSCHEDULER->isSetTarget = false;
+	ui->actAddAgent->setChecked(false);
 	ui->actAgentTarget->setChecked(false);
 }
 
+void MainWindow::on_actSpawnRandomAgents_triggered()
+{
+	const int freeSlots = GLOBAL_RCSCHEDULER->getMaxAgents() - GLOBAL_RCSCHEDULER->getActiveAgentCount();
+	if (freeSlots <= 0) return;
+	bool ok = false;
+	const int count = QInputDialog::getInt(this, QString::fromLocal8Bit("随机生成智能体"), QString::fromLocal8Bit("数量"),
+		std::min(100, freeSlots), 1, freeSlots, 10, &ok);
+	if (!ok) return;
+	// anywhere on the navmesh, heading for the target when one is set
+	GLOBAL_RCSCHEDULER->spawnRandomAgents(count, m_spawnSeed++, GU::RCNavSampleQuery());
+}
+
 void MainWindow::on_actSaveAgent_triggered()
 {
 	QFileDialog filedial;
@@ -681,6 +763,87 @@ void MainWindow::on_actReadAgent_triggered()
 	}
 }
 
+void MainWindow::on_actSaveCheckpoint_triggered()
+{
+	QString savepath = QFileDialog::getSaveFileName(this);
+	if (savepath.isEmpty()) return;
+	GU::RCCrowdCheckpoint checkpoint;
+	bool saved;
+	{
+		// agents removed on arrival must not be saved as entities
+		std::lock_guard<std::recursive_mutex> lock(GLOBAL_RCSCHEDULER->m_crowdMutex);
+		GLOBAL_SCENE->processAgentEvents();
+		saved = GLOBAL_RCSCHEDULER->saveCheckpoint(checkpoint);
+	}
+	if (!saved || !checkpoint.save(savepath.toStdString()))
+	{
+		QMessageBox msgBox;
+		msgBox.setIcon(QMessageBox::Icon::Critical);
+		msgBox.setText(QString::fromLocal8Bit("保存检查点失败"));
+		msgBox.exec();
+	}
+}
+
+void MainWindow::on_actReadCheckpoint_triggered()
+{
+	QString readPath = QFileDialog::getOpenFileName(this);
+	if (readPath.isEmpty()) return;
+	// the checkpoint has to come from the same navmesh and crowd size
+	GU::RCCrowdCheckpoint checkpoint;
+	if (!checkpoint.load(readPath.toStdString()) || !GLOBAL_RCSCHEDULER->restoreCheckpoint(checkpoint))
+	{
+		QMessageBox msgBox;
+		msgBox.setIcon(QMessageBox::Icon::Critical);
+		msgBox.setText(QString::fromLocal8Bit("恢复检查点失败"));
+		msgBox.exec();
+	}
+}
+
+void MainWindow::on_actRecordTrajectory_triggered()
+{
+	if (!ui->actRecordTrajectory->isChecked())
+	{
+		if (!GLOBAL_RCSCHEDULER->stopTrajectoryRecord())
+		{
+			QMessageBox msgBox;
+			msgBox.setIcon(QMessageBox::Icon::Critical);
+			msgBox.setText(QString::fromLocal8Bit("轨迹文件写入失败，文件不完整"));
+			msgBox.exec();
+		}
+		return;
+	}
+	QString savepath = QFileDialog::getSaveFileName(this);
+	if (savepath.isEmpty() || !GLOBAL_RCSCHEDULER->startTrajectoryRecord(savepath.toStdString()))
+	{
+		ui->actRecordTrajectory->setChecked(false);
+		if (savepath.isEmpty()) return;
+		QMessageBox msgBox;
+		msgBox.setIcon(QMessageBox::Icon::Critical);
+		msgBox.setText(QString::fromLocal8Bit("无法创建轨迹文件"));
+		msgBox.exec();
+	}
+}
+
+void MainWindow::on_actRecordQueries_triggered()
+{
+	if (!ui->actRecordQueries->isChecked())
+	{
+		GLOBAL_RCSCHEDULER->stopQueryLog();
+		return;
+	}
+	// the navmesh is saved next to the log for the replay
+	QString savepath = QFileDialog::getSaveFileName(this);
+	if (savepath.isEmpty() || !GLOBAL_RCSCHEDULER->startQueryLog(savepath.toStdString()))
+	{
+		ui->actRecordQueries->setChecked(false);
+		if (savepath.isEmpty()) return;
+		QMessageBox msgBox;
+		msgBox.setIcon(QMessageBox::Icon::Critical);
+		msgBox.setText(QString::fromLocal8Bit("无法创建查询日志文件"));
+		msgBox.exec();
+	}
+}
+
 void MainWindow::slot_treeviewEntity_customcontextmenu(const QPoint& point)
 {
 	QMenu* menu = new QMenu(this);
@@ -867,6 +1030,21 @@ void MainWindow::slot_importResource2Table(QString filename, uint64_t uuid, int
 		break;
 	}
 }
+void MainWindow::slot_timeScaleChanged(int index)
+{
+	GLOBAL_RCSCHEDULER->setTimeScale(m_timeScaleBox->itemData(index).toFloat());
+}
+
+void MainWindow::slot_updateSimSpeed()
+{
+	QString info = QString::fromLocal8Bit("仿真速度 x%1").arg(GLOBAL_RCSCHEDULER->getSimSpeed(), 0, 'f', 1);
+	std::vector<float> flowRates;
+	GLOBAL_RCSCHEDULER->getGateFlowRates(flowRates);
+	for (int i = 0; i < (int)flowRates.size(); i++)
+		info += QString::fromLocal8Bit("  门%1 %2人/秒").arg(i).arg(flowRates[i], 0, 'f', 1);
+	m_simSpeedInfo->setText(info);
+}
+
 void MainWindow::slot_progressTick(int max)
 {
 	if (max != 0 && max != -1)
@@ -5,6 +5,7 @@
 #include <Widgets/VulkanWindow.h>
 #include <QtOpenGL/QGLWidget>
 #include <Core/UUID.h>
+#include <vector>
 #include <QMetaType>
 namespace Ui {
 class MainWindow;
@@ -15,8 +16,10 @@ class QStandardItem;
 class QStandardItemModel;
 class QItemSelectionModel;
 class QProgressBar;
+class QComboBox;
 class NavMeshParamsDlg;
 class AgentParam;
+class SimParamDlg;
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -32,6 +35,9 @@ public:
     void progressEnd();
     void addEntity(uint64_t uuid);
     void removeEntity(uint64_t uuid);
+    // one model update for a batch of entities
+    void addEntities(const std::vector<uint64_t>& uuids);
+    void removeEntities(const std::vector<uint64_t>& uuids);
 private:
     void createPopMenu();
     void createEntityView();
@@ -62,6 +68,8 @@ private:
     QVulkanInstance* inst;
     QLabel* m_statusInfo;
     QProgressBar* m_progressBar;
+    QComboBox* m_timeScaleBox;
+    QLabel* m_simSpeedInfo;
     std::unordered_map<GU::UUID, QStandardItem*> m_entityMap;
 
    
@@ -69,9 +77,12 @@ private:
 
     int m_progressTaskNum = 0;
     int m_currentTaskNo = 0;
+    // every random spawn draws from the next seed, a session spawns the same agents again
+    uint64_t m_spawnSeed = 1;
 
     NavMeshParamsDlg* navmeshdlg;
     AgentParam* agentParam;
+    SimParamDlg* simParamDlg;
 
 Q_SIGNALS:
     void signal_importResource2Table(QString, uint64_t, int type);
@@ -97,10 +108,17 @@ private slots:
     void on_actImportTexture_triggered();
     void on_actImportSkeletalMesh_triggered();
     void on_actAgentParam_triggered();
+    void on_actSimParam_triggered();
     void on_actAgentTarget_triggered();
     void on_actAddAgent_triggered();
+    void on_actSpawnRandomAgents_triggered();
+    void on_actAddGate_triggered();
     void on_actSaveAgent_triggered();
     void on_actReadAgent_triggered();
+    void on_actSaveCheckpoint_triggered();
+    void on_actReadCheckpoint_triggered();
+    void on_actRecordTrajectory_triggered();
+    void on_actRecordQueries_triggered();
 
     void slot_tagPropertyChanged();
     void slot_treeviewEntity_customcontextmenu(const QPoint&);
@@ -110,6 +128,8 @@ private slots:
 
     void slot_importResource2Table(QString, uint64_t, int type);
     void slot_progressTick(int max);
+    void slot_timeScaleChanged(int index);
+    void slot_updateSimSpeed();
 };
 
 #endif // MAINWINDOW_H
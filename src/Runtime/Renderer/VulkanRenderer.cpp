@@ -15,6 +15,7 @@
 #include <MainWindow.h>
 #include <Function/AgentNav/RCVulkanGraphicsPipline.h>
 #include <Function/AgentNav/RCScheduler.h>
+#include <Function/AgentNav/RCSimLoop.h>
 #include <Renderer/Texture.h>
 #include <Function/Animation/Animation.h>
 namespace GU
@@ -101,6 +102,7 @@ namespace GU
 		CameraUBO cubo{};
 		cubo.view = m_Camera.getViewMatrix();
 		cubo.proj = m_Camera.getProjectionMatrix();
+		GLOBAL_RCSCHEDULER->setLodCamera(m_Camera.getPosition(), m_Camera.getProjectionViewMatrix());
 		cubo.proj[1][1] *= -1;
 		GLOBAL_VULKAN_CONTEXT->camearUBO->update(cubo, m_window->currentSwapChainImageIndex());
 		const QSize sz = m_window->swapChainImageSize();
@@ -153,7 +155,11 @@ namespace GU
 		GLOBAL_SCENE->renderTick(*GLOBAL_VULKAN_CONTEXT, cmdBuf, m_window->currentSwapChainImageIndex(), GLOBAL_DELTATIME);
 
 		// RCMesh
-		GLOBAL_RCSCHEDULER->crowUpdatTick(GLOBAL_DELTATIME);
+		// the simulation thread ticks on its own clock, it only follows play/pause here
+		if (GLOBAL_RCSCHEDULER->isSimLoopRunning())
+			GLOBAL_RCSCHEDULER->m_simLoop->setPaused(!GLOBAL_PLAY);
+		else
+			GLOBAL_RCSCHEDULER->advanceFrame(GLOBAL_DELTATIME);
 		GLOBAL_RCSCHEDULER->handelRender(cmdBuf, m_window->currentSwapChainImageIndex());
 
 		// submit queue
@@ -85,6 +85,13 @@ namespace GU
 		float speed = 24.0;
 	};
 
+	// UBO and descriptor sets of a despawned agent, reused by Scene::spawnAgents
+	struct AgentRenderResource
+	{
+		std::vector<VkDescriptorSet> descriptorSets;
+		std::shared_ptr<VulkanUniformBuffer<AgentModelUBO> > modelUBO;
+	};
+
 	struct AgentComponent
 	{
 		AgentComponent() = default;
@@ -101,6 +108,8 @@ namespace GU
 		std::string currentAnimation;
 		float timeintgal = 1.0;
 		float speed = 24.0;
+		// set by RC_AGENT_EVENT_STUCK until the agent moves again
+		bool isStuck = false;
 
 		std::vector<glm::vec3> samplePath;
 	};
@@ -6,8 +6,15 @@
 #include <Function/Animation/Animation.h>
 #include <Function/AgentNav/RCScheduler.h>
 #include <Function/AgentNav/RCData.h>
+#include <Function/AgentNav/RCSimLoop.h>
+#include <Function/AgentNav/RCCheckpoint.h>
+#include <Function/AgentNav/RCAgentEvents.h>
 #include <Global/CoreContext.h>
 #include <MainWindow.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <QDebug>
+#include <unordered_map>
+#include <cstring>
 namespace GU
 {
 	template<typename... Component>
@@ -89,29 +96,196 @@ namespace GU
 		GLOBAL_MAINWINDOW->removeEntity(uuid);
 	}
 
+	void Scene::processAgentEvents()
+	{
+		RCAgentEvents* events = GLOBAL_RCSCHEDULER->m_agentEvents;
+		m_agentEvents.clear();
+		if (events == nullptr || events->pop(m_agentEvents) == 0) return;
+
+		std::unordered_map<int, entt::entity> entities;
+		auto view = m_registry.view<AgentComponent>();
+		for (auto entity : view)
+			entities[view.get<AgentComponent>(entity).idx] = entity;
+
+		std::vector<entt::entity> arrived;
+		for (const RCAgentEvent& event : m_agentEvents)
+		{
+			// idx is a cell, not an agent
+			if (event.type == RC_AGENT_EVENT_DENSITY_PEAK)
+			{
+				GLOBAL_MAINWINDOW->setStatus(QString("Density peak in cell %1 at (%2, %3), tick %4")
+					.arg(event.idx).arg(event.pos[0], 0, 'f', 1).arg(event.pos[2], 0, 'f', 1).arg(event.tick));
+				continue;
+			}
+			auto it = entities.find(event.idx);
+			if (it == entities.end()) continue;
+			AgentComponent& agentComponent = view.get<AgentComponent>(it->second);
+			switch (event.type)
+			{
+			case RC_AGENT_EVENT_ARRIVED:
+				arrived.push_back(it->second);
+				entities.erase(it);
+				break;
+			case RC_AGENT_EVENT_STUCK:
+				agentComponent.isStuck = true;
+				break;
+			case RC_AGENT_EVENT_UNSTUCK:
+				agentComponent.isStuck = false;
+				break;
+			default:
+				break;
+			}
+		}
+		despawnAgents(arrived.data(), (int)arrived.size(), false);
+	}
+
+	int Scene::spawnAgents(const float* starts, const float* targets, int n)
+	{
+		if (n <= 0) return 0;
+		std::vector<uint64_t> uuids;
+		std::vector<float> pathStarts, pathTargets;
+		{
+			// free slots may be reused below, their old entities have to go first
+			std::lock_guard<std::recursive_mutex> lock(GLOBAL_RCSCHEDULER->m_crowdMutex);
+			processAgentEvents();
+			std::vector<int> idx(n);
+			GLOBAL_RCSCHEDULER->addAgents(starts, targets, n, idx.data());
+
+			uuids.reserve(n);
+			for (int i = 0; i < n; i++)
+			{
+				if (idx[i] == -1) continue;
+				if (GLOBAL_RCSCHEDULER->isRenderAgentPath)
+				{
+					pathStarts.insert(pathStarts.end(), &starts[i * 3], &starts[i * 3] + 3);
+					pathTargets.insert(pathTargets.end(), &targets[i * 3], &targets[i * 3] + 3);
+				}
+				UUID uuid;
+				Entity entity = createEntityWithUUID(uuid, "Agent" + std::to_string(idx[i]));
+				entity.getComponent<TransformComponent>().Translation = glm::make_vec3(&starts[i * 3]);
+
+				auto&& agentComponent = entity.addComponent<AgentComponent>();
+				agentComponent.idx = idx[i];
+				agentComponent.startPos = glm::make_vec3(&starts[i * 3]);
+				agentComponent.targetPos = glm::make_vec3(&targets[i * 3]);
+				if (m_agentResourcePool.empty())
+				{
+					agentComponent.createDescritorSets();
+				}
+				else
+				{
+					agentComponent.descriptorSets = std::move(m_agentResourcePool.back().descriptorSets);
+					agentComponent.modelUBO = std::move(m_agentResourcePool.back().modelUBO);
+					m_agentResourcePool.pop_back();
+				}
+				uuids.push_back(uuid);
+			}
+		}
+		// display paths of the spawned agents
+		if (!pathStarts.empty())
+			GLOBAL_RCSCHEDULER->calAgentSmoothPaths(pathStarts.data(), pathTargets.data(), (int)pathStarts.size() / 3);
+		GLOBAL_MAINWINDOW->addEntities(uuids);
+		return (int)uuids.size();
+	}
+
+	void Scene::despawnAgents(const entt::entity* entities, int n, bool removeCrowdAgents)
+	{
+		std::vector<uint64_t> uuids;
+		uuids.reserve(n);
+		for (int i = 0; i < n; i++)
+		{
+			if (!m_registry.valid(entities[i])) continue;
+			if (auto agentComponent = m_registry.try_get<AgentComponent>(entities[i]))
+			{
+				if (removeCrowdAgents) GLOBAL_RCSCHEDULER->removeCrowdAgent(agentComponent->idx);
+				AgentRenderResource resource;
+				resource.descriptorSets = std::move(agentComponent->descriptorSets);
+				resource.modelUBO = std::move(agentComponent->modelUBO);
+				m_agentResourcePool.push_back(std::move(resource));
+			}
+			auto uuid = m_registry.get<IDComponent>(entities[i]).ID;
+			m_registry.destroy(entities[i]);
+			m_entityMap.erase(uuid);
+			uuids.push_back(uuid);
+		}
+		GLOBAL_MAINWINDOW->removeEntities(uuids);
+	}
+
+	void Scene::saveAgentEntities(std::vector<RCCheckpointEntity>& entities)
+	{
+		auto view = m_registry.view<AgentComponent, TransformComponent, IDComponent>();
+		for (auto entity : view)
+		{
+			auto&& [agentComponent, transformComponent, idComponent] = view.get<AgentComponent, TransformComponent, IDComponent>(entity);
+			RCCheckpointEntity saved;
+			saved.uuid = idComponent.ID;
+			saved.idx = agentComponent.idx;
+			memcpy(saved.startPos, glm::value_ptr(agentComponent.startPos), sizeof(saved.startPos));
+			memcpy(saved.targetPos, glm::value_ptr(agentComponent.targetPos), sizeof(saved.targetPos));
+			memcpy(saved.translation, glm::value_ptr(transformComponent.Translation), sizeof(saved.translation));
+			memcpy(saved.rotation, glm::value_ptr(transformComponent.Rotation), sizeof(saved.rotation));
+			entities.push_back(saved);
+		}
+	}
+
+	void Scene::restoreAgentEntities(const std::vector<RCCheckpointEntity>& entities)
+	{
+		std::vector<entt::entity> current;
+		auto view = m_registry.view<AgentComponent>();
+		current.assign(view.begin(), view.end());
+		despawnAgents(current.data(), (int)current.size(), false);
+
+		std::vector<uint64_t> uuids;
+		uuids.reserve(entities.size());
+		for (const RCCheckpointEntity& saved : entities)
+		{
+			Entity entity = createEntityWithUUID(saved.uuid, "Agent" + std::to_string(saved.idx));
+			auto&& transformComponent = entity.getComponent<TransformComponent>();
+			transformComponent.Translation = glm::make_vec3(saved.translation);
+			transformComponent.Rotation = glm::make_vec3(saved.rotation);
+
+			auto&& agentComponent = entity.addComponent<AgentComponent>();
+			agentComponent.idx = saved.idx;
+			agentComponent.startPos = glm::make_vec3(saved.startPos);
+			agentComponent.targetPos = glm::make_vec3(saved.targetPos);
+			if (m_agentResourcePool.empty())
+			{
+				agentComponent.createDescritorSets();
+			}
+			else
+			{
+				agentComponent.descriptorSets = std::move(m_agentResourcePool.back().descriptorSets);
+				agentComponent.modelUBO = std::move(m_agentResourcePool.back().modelUBO);
+				m_agentResourcePool.pop_back();
+			}
+			uuids.push_back(saved.uuid);
+		}
+		GLOBAL_MAINWINDOW->addEntities(uuids);
+	}
+
 	void Scene::renderTick(VulkanContext& vulkanContext, VkCommandBuffer& cmdBuf, int currImageIndex, float deltaTime)
 	{
 
 		// agent
 		{
+			// agent state of the last tick in SoA layout, interpolated when the simulation thread runs
+			float alpha = 1.0f;
+			// arrivals and other transitions come from the crowd tick
+			processAgentEvents();
+			const RCCrowdSnapshot* snapshot = GLOBAL_RCSCHEDULER->acquireAgentState(alpha);
 			auto view = m_registry.view<AgentComponent, TransformComponent>();
 			for (auto entity : view)
 			{
 				auto&& [agentComponent, transformComponent] = view.get<AgentComponent, TransformComponent>(entity);
-				transformComponent.Translation = GLOBAL_RCSCHEDULER->getAgentPosWithId(agentComponent.idx);
-				//GLOBAL_RCSCHEDULER->getAgentRotationWithId(agentComponent.idx, transformComponent.Rotation);
-				
-				auto agent = GLOBAL_RCSCHEDULER->m_crowd->getAgent(agentComponent.idx);
-
-				if (!agent->active) continue;
-
-				float velLength = GLOBAL_RCSCHEDULER->getVelLength(agentComponent.idx);
+				const int idx = agentComponent.idx;
+				// nullptr until the simulation thread published its first tick
+				if (snapshot == nullptr || !snapshot->isActive(idx)) continue;
+				snapshot->interpolate(idx, alpha, &transformComponent.Translation.x);
+				const float velLength = snapshot->speed[idx];
+				if (velLength > 0.3)
+					transformComponent.Rotation = glm::make_vec3(&snapshot->rotation[idx * 3]);
 
 				std::string animationName = "Armature|Run";
-				if (velLength > 0.3)
-				{
-					GLOBAL_RCSCHEDULER->getAgentRotationWithId(agentComponent.idx, transformComponent.Rotation);
-				}
 
 				if (velLength < 1.5)
 				{
@@ -147,11 +321,11 @@ namespace GU
 				AgentModelUBO agentubo{};
 				memcpy(agentubo.bones, skeletalubo.bones, sizeof(skeletalubo.bones));
 				memcpy(&agentubo.model, &skeletalubo.model, sizeof(skeletalubo.model));
-				agentubo.clothcolor = GLOBAL_RCSCHEDULER->getAgentColor(agentComponent.idx);
+				agentubo.clothcolor = glm::make_vec3(&snapshot->color[idx * 3]);
 				agentComponent.modelUBO->update(agentubo, currImageIndex);
 
-				auto agentaaa = GLOBAL_RCSCHEDULER->m_crowd->getAgent(agentComponent.idx);
-				/*int nclosenes = 0;
+				/*auto agentaaa = GLOBAL_RCSCHEDULER->getCrowdAgent(agentComponent.idx);
+				int nclosenes = 0;
 				for (size_t i = 0; i < agentaaa->nneis; i++)
 				{
 					if (agentaaa->neis[i].dist < 5)
@@ -171,15 +345,6 @@ namespace GU
 				{
 					agentComponent.samplePath.push_back(transformComponent.Translation);
 				}
-				if (glm::length( agentComponent.targetPos - transformComponent.Translation ) < 1.5)
-				{
-					GLOBAL_RCSCHEDULER->m_crowd->removeAgent(agentComponent.idx);
-					//std::shared_ptr<RCAgentSamplePath> path = std::make_shared<RCAgentSamplePath>(agentComponent.samplePath);
-					//GLOBAL_RCSCHEDULER->rcAgentSamplePath.push_back(path);
-					auto uuid = m_registry.get<IDComponent>(entity).ID;
-					destroyEntity(getEntityByUUID(uuid));
-					continue;
-				}
 				for (auto mesh : testmeshnode->meshs)
 				{
 					VkBuffer vertexBuffers[] = { mesh.vertexBuffer };
@@ -8,6 +8,9 @@ namespace GU
 {
 
 	class Entity;
+	struct AgentRenderResource;
+	struct RCCheckpointEntity;
+	struct RCAgentEvent;
 	class Scene
 	{
 	public:
@@ -24,6 +27,21 @@ namespace GU
 
 		void destroyEntity(Entity entity);
 
+		// Spawn n agents in one batch: crowd agents are added and their targets snapped
+		// together, entities take UBOs and descriptor sets from the pool and the entity
+		// view is updated once. starts and targets are 3 floats per agent, returns the spawned count.
+		int spawnAgents(const float* starts, const float* targets, int n);
+		// Removes the crowd agents and entities, their render resources go back to the pool.
+		void despawnAgents(const entt::entity* entities, int n, bool removeCrowdAgents = true);
+		// Drains the crowd's agent events: arrived agents are despawned, stuck ones are
+		// flagged. Called once per frame, the crowd agents are already removed.
+		void processAgentEvents();
+		// agent entities of a crowd checkpoint
+		void saveAgentEntities(std::vector<RCCheckpointEntity>& entities);
+		// Replaces every agent entity with the saved ones, keeping their UUIDs. The crowd
+		// agents are not touched, RCScheduler::restoreCheckpoint restores them.
+		void restoreAgentEntities(const std::vector<RCCheckpointEntity>& entities);
+
 		void renderTick(VulkanContext& vulkanContext, VkCommandBuffer& cmdBuf, int currImageIndex, float deltaTime);
 
 		void initEntityResource();
@@ -34,6 +52,8 @@ namespace GU
 	public:
 		entt::registry m_registry;
 		std::unordered_map<UUID, entt::entity> m_entityMap;
+		std::vector<AgentRenderResource> m_agentResourcePool;
+		std::vector<RCAgentEvent> m_agentEvents;
 		
 		friend class Entity;
 	};
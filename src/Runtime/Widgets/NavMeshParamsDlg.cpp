@@ -20,6 +20,7 @@ NavMeshParamsDlg::NavMeshParamsDlg(QWidget *parent, QStandardItemModel* p_meshTa
 	connect(ui->isRenderDM, SIGNAL(stateChanged(int)), this, SLOT(on_IsRenderDMStateChanged(int)));
 	connect(ui->isRenderTContour, SIGNAL(stateChanged(int)), this, SLOT(on_IsRenderTContourChanged(int)));
 	connect(ui->isRenderTCompactField, SIGNAL(stateChanged(int)), this, SLOT(on_IsRenderTCompactFieldChanged(int)));
+	connect(ui->isRenderAgentPath, SIGNAL(stateChanged(int)), this, SLOT(on_IsRenderAgentPathChanged(int)));
 }
 
 void NavMeshParamsDlg::on_pushButtonOK_clicked()
@@ -141,3 +142,16 @@ void NavMeshParamsDlg::on_IsRenderTCompactFieldChanged(int state)
 		GLOBAL_RCSCHEDULER->isRenderTCompactField = false;
 	}
 }
+
+void NavMeshParamsDlg::on_IsRenderAgentPathChanged(int state)
+{
+	if (state == Qt::Checked)
+	{
+		GLOBAL_RCSCHEDULER->isRenderAgentPath = true;
+	}
+	else
+	{
+		GLOBAL_RCSCHEDULER->isRenderAgentPath = false;
+		GLOBAL_RCSCHEDULER->clearAgentSmoothPaths();
+	}
+}
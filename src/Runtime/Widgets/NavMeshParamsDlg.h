@@ -26,6 +26,7 @@ private slots:
     void on_IsRenderDMStateChanged(int state);
     void on_IsRenderTContourChanged(int state);
     void on_IsRenderTCompactFieldChanged(int state);
+    void on_IsRenderAgentPathChanged(int state);
 private:
     Ui::NavMeshParamsDlg *ui;
     QStandardItemModel* m_meshTableModel;
@@ -0,0 +1,60 @@
+#include "SimParamDlg.h"
+#include "ui_SimParamDlg.h"
+#include <Global/CoreContext.h>
+#include <Function/AgentNav/RCScheduler.h>
+#include <QFileDialog>
+#include <QMessageBox>
+SimParamDlg::SimParamDlg(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::SimParamDlg)
+{
+    ui->setupUi(this);
+	ui->isUseSimLoop->setChecked(GLOBAL_RCSCHEDULER->isUseSimLoop);
+	ui->tickRate->setValue(GLOBAL_RCSCHEDULER->m_simTickRate);
+	ui->maxCatchUpSteps->setValue(GLOBAL_RCSCHEDULER->m_simMaxCatchUpSteps);
+	ui->isUseShardedCrowd->setChecked(GLOBAL_RCSCHEDULER->isUseShardedCrowd);
+	ui->isUseParallelCrowd->setChecked(GLOBAL_RCSCHEDULER->isUseParallelCrowd);
+	ui->isUseSimLod->setChecked(GLOBAL_RCSCHEDULER->isUseSimLod);
+	ui->isUseLandmarks->setChecked(GLOBAL_RCSCHEDULER->isUseLandmarks);
+	ui->isUseHierarchy->setChecked(GLOBAL_RCSCHEDULER->isUseHierarchy);
+	ui->isUseCrowdCost->setChecked(GLOBAL_RCSCHEDULER->isUseCrowdCost);
+	ui->isDeterministic->setChecked(GLOBAL_RCSCHEDULER->isDeterministic);
+	ui->lockstepSeed->setValue((int)GLOBAL_RCSCHEDULER->m_lockstepSeed);
+}
+void SimParamDlg::on_pushButtonSet_clicked()
+{
+	GLOBAL_RCSCHEDULER->isUseSimLoop = ui->isUseSimLoop->isChecked();
+	GLOBAL_RCSCHEDULER->m_simTickRate = (float)ui->tickRate->value();
+	GLOBAL_RCSCHEDULER->m_simMaxCatchUpSteps = ui->maxCatchUpSteps->value();
+	GLOBAL_RCSCHEDULER->applySimLoopSettings();
+	// the crowd is created by handelBuild
+	GLOBAL_RCSCHEDULER->isUseShardedCrowd = ui->isUseShardedCrowd->isChecked();
+	GLOBAL_RCSCHEDULER->isUseParallelCrowd = ui->isUseParallelCrowd->isChecked();
+	GLOBAL_RCSCHEDULER->setUseSimLod(ui->isUseSimLod->isChecked());
+	// path search options are handed to the crowd on its next tick
+	GLOBAL_RCSCHEDULER->isUseLandmarks = ui->isUseLandmarks->isChecked();
+	GLOBAL_RCSCHEDULER->isUseHierarchy = ui->isUseHierarchy->isChecked();
+	GLOBAL_RCSCHEDULER->isUseCrowdCost = ui->isUseCrowdCost->isChecked();
+	// switching restarts the checksums, the lockstep dt follows the tick rate
+	const bool deterministic = ui->isDeterministic->isChecked();
+	const uint64_t seed = (uint64_t)ui->lockstepSeed->value();
+	if (deterministic != GLOBAL_RCSCHEDULER->isDeterministic || (deterministic && seed != GLOBAL_RCSCHEDULER->m_lockstepSeed))
+		GLOBAL_RCSCHEDULER->setDeterministic(deterministic, seed, 1.0f / GLOBAL_RCSCHEDULER->m_simTickRate);
+	accept();
+}
+void SimParamDlg::on_pushButtonSaveChecksums_clicked()
+{
+	QString savepath = QFileDialog::getSaveFileName(this);
+	if (savepath.isEmpty()) return;
+	if (!GLOBAL_RCSCHEDULER->saveChecksums(savepath.toStdString()))
+	{
+		QMessageBox msgBox;
+		msgBox.setIcon(QMessageBox::Icon::Critical);
+		msgBox.setText(QString::fromLocal8Bit("Уʧ"));
+		msgBox.exec();
+	}
+}
+SimParamDlg::~SimParamDlg()
+{
+    delete ui;
+}
@@ -0,0 +1,24 @@
+#ifndef SIMPARAMDLG_H
+#define SIMPARAMDLG_H
+
+#include <QDialog>
+
+namespace Ui {
+class SimParamDlg;
+}
+
+class SimParamDlg : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SimParamDlg(QWidget *parent = nullptr);
+    ~SimParamDlg();
+private slots:
+    void on_pushButtonSet_clicked();
+    void on_pushButtonSaveChecksums_clicked();
+private:
+    Ui::SimParamDlg *ui;
+};
+
+#endif // SIMPARAMDLG_H
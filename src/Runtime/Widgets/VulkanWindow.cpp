@@ -4,6 +4,7 @@
 #include <QWheelEvent>
 #include <Global/CoreContext.h>
 #include <Function/AgentNav/RCScheduler.h>
+#include <Scene/Scene.h>
 namespace GU
 {
 	QVulkanWindowRenderer* VulkanWindow::createRenderer()
@@ -74,7 +75,13 @@ namespace GU
     }
     void VulkanWindow::mouseDoubleClickEvent(QMouseEvent*)
     {
-        GLOBAL_RCSCHEDULER->setAgent(GLOBAL_RCSCHEDULER->hitPos);
+        {
+            // the new agent may take a slot freed on arrival, its old entity goes first
+            std::lock_guard<std::recursive_mutex> lock(GLOBAL_RCSCHEDULER->m_crowdMutex);
+            GLOBAL_SCENE->processAgentEvents();
+            GLOBAL_RCSCHEDULER->setAgent(GLOBAL_RCSCHEDULER->hitPos);
+        }
         GLOBAL_RCSCHEDULER->setCurrentTarget(GLOBAL_RCSCHEDULER->hitPos);
+        GLOBAL_RCSCHEDULER->setGatePoint(GLOBAL_RCSCHEDULER->hitPos);
     }
 }
\ No newline at end of file
@@ -0,0 +1,503 @@
+// Headless crowd runner. Loads a mesh (.obj, built with the editor's default
+// navmesh settings) or a saved navmesh, places the agents of a saveAgent YAML file
+// and steps RCCrowd as fast as possible, without Qt, Vulkan or vsync.
+//
+// usage: CrowdBench <mesh.obj|navmesh> <agents.yaml> [--ticks N] [--dt S] [--threads N]
+//                   [--radius R] [--arrive R] [--dump trajectories.csv] [--dump-every K]
+//                   [--save-navmesh path] [--checksums checksums.txt]
+//                   [--replan-ms M] [--replan-nodes N] [--checkpoint T]
+//                   [--batch RUNS] [--batch-agents N] [--seed S] [--group K]
+//                   [--time-scale S] [--cpu-budget MS]
+//
+// Runs until every agent arrived or N ticks passed. Reports agent-updates per second,
+// tick latency and the time spent in each crowd update phase. The run only depends on
+// the inputs unless --replan-ms adds a wall time limit to the replanning budget of
+// --replan-nodes search iterations per tick. --checksums writes the state hash of
+// every tick to compare two builds and ignores --replan-ms.
+// --checkpoint saves the crowd state after tick T and restores it, reporting both times.
+// --batch runs RUNS Monte Carlo crowds on --threads workers (all cores by default).
+// Agents spawn at random navmesh points and head for a random target of the file.
+// The tool then reports evacuation time, peak density and path length statistics,
+// and --dump writes one line per run.
+// --group K walks the agents in groups of K consecutive entries. The first one of a
+// group leads to its target, the others follow in formation and arrive with it.
+// --time-scale S paces the run at S times real time the way the editor does, running
+// the ticks of every 1/SIM_TICK_RATE frame within --cpu-budget milliseconds. The
+// achieved simulated seconds per wall second are reported either way.
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCNavMeshBuild.h>
+#include <Function/AgentNav/RCNavMeshIO.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Function/AgentNav/RCScheduler.h>
+#include <Function/AgentNav/RCChecksum.h>
+#include <Function/AgentNav/RCScenarioBatch.h>
+#include <Function/AgentNav/RCSimLoop.h>
+#include <Function/AgentNav/rcMeshLoaderObj.h>
+#include <Core/ThreadPool.h>
+#include <DetourCommon.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <Recast.h>
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GU;
+
+struct AgentSpec
+{
+	float start[3];
+	float target[3];
+};
+
+static bool loadAgents(const std::string& path, std::vector<AgentSpec>& agents)
+{
+	try
+	{
+		YAML::Node config = YAML::LoadFile(path);
+		for (auto agent : config["Agents"])
+		{
+			AgentSpec spec;
+			for (int i = 0; i < 3; i++)
+			{
+				spec.start[i] = agent.second[i].as<float>();
+				spec.target[i] = agent.second[3 + i].as<float>();
+			}
+			agents.push_back(spec);
+		}
+	}
+	catch (const YAML::Exception& e)
+	{
+		printf("Could not read agents '%s': %s\n", path.c_str(), e.what());
+		return false;
+	}
+	return true;
+}
+
+// defaults of the editor's navmesh dialog
+static RCParams defaultParams(float agentRadius)
+{
+	RCParams params;
+	params.m_cellSize = 0.3f;
+	params.m_cellHeight = 0.2f;
+	params.m_agentHeight = 2.0f;
+	params.m_agentRadius = agentRadius;
+	params.m_agentMaxClimb = 0.9f;
+	params.m_agentMaxSlope = 45.0f;
+	params.m_regionMinSize = 8.0f;
+	params.m_regionMergeSize = 20.0f;
+	params.m_edgeMaxLen = 12.0f;
+	params.m_edgeMaxError = 1.3f;
+	params.m_vertsPerPoly = 6.0f;
+	params.m_detailSampleDist = 6.0f;
+	params.m_detailSampleMaxError = 1.0f;
+	params.m_partitionType = 0;
+	params.m_filterLowHangingObstacles = true;
+	params.m_filterLedgeSpans = true;
+	params.m_filterWalkableLowHeightSpans = true;
+	params.m_keepInterResults = false;
+	return params;
+}
+
+static double percentile(std::vector<double>& values, double p)
+{
+	if (values.empty()) return 0.0;
+	size_t idx = (size_t)(p * (values.size() - 1) + 0.5);
+	std::nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+// Monte Carlo runs of the agent file on a shared navmesh, one crowd per worker
+static int runBatch(dtNavMesh* navMesh, const dtQueryFilter* filter, const dtCrowdAgentParams& ap,
+	const std::vector<AgentSpec>& specs, int runs, int agents, uint64_t seed, int threads, float dt,
+	int maxTicks, float agentRadius, float arriveRadius, const std::string& dumpPath)
+{
+	RCScenarioSpec scenario;
+	scenario.agentCount = agents > 0 ? agents : (int)specs.size();
+	// targets used by several agents of the file are picked more often
+	for (const AgentSpec& spec : specs)
+		scenario.exits.insert(scenario.exits.end(), spec.target, spec.target + 3);
+	scenario.agentParams = ap;
+	scenario.dt = dt;
+	scenario.maxTicks = maxTicks;
+	scenario.arriveRadius = arriveRadius;
+
+	RCScenarioBatch batch;
+	if (!batch.init(navMesh, agentRadius, *filter))
+	{
+		printf("Could not init the batch\n");
+		return 1;
+	}
+	const int workers = threads > 0 ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+	// parallelFor runs the first chunk on this thread
+	std::unique_ptr<ThreadPool> pool;
+	if (workers > 1) pool = std::make_unique<ThreadPool>(workers - 1);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<RCScenarioResult> results = batch.run(scenario, runs, seed, pool.get(), workers);
+	auto end = std::chrono::high_resolution_clock::now();
+	if (results.empty())
+	{
+		printf("No target of the agent file is on the navmesh\n");
+		return 1;
+	}
+	const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+	const RCScenarioSummary summary = RCScenarioBatch::summarize(results);
+
+	printf("Batch: %d runs of %d agents on %d workers, %.2f ms, %.2f runs/s, %.0f agent-updates/s\n",
+		summary.runs, scenario.agentCount, workers, ms, ms > 0.0 ? runs * 1000.0 / ms : 0.0,
+		ms > 0.0 ? summary.agentUpdates * 1000.0 / ms : 0.0);
+	printf("Arrived: %llu / %llu\n", (unsigned long long)summary.arrived, (unsigned long long)summary.agents);
+	printf("Evacuation s: mean %.2f  p50 %.2f  p90 %.2f  max %.2f\n",
+		summary.evacuationMean, summary.evacuationP50, summary.evacuationP90, summary.evacuationMax);
+	printf("Peak density /m2: mean %.2f  max %.2f\n", summary.peakDensityMean, summary.peakDensityMax);
+	printf("Arrival s: mean %.2f  Path m: mean %.2f  p90 %.2f\n",
+		summary.arrivalMean, summary.pathLengthMean, summary.pathLengthP90);
+
+	if (!dumpPath.empty())
+	{
+		FILE* dump = fopen(dumpPath.c_str(), "w");
+		if (dump == nullptr)
+		{
+			printf("Could not open '%s' for writing\n", dumpPath.c_str());
+			return 1;
+		}
+		fprintf(dump, "seed,agents,arrived,ticks,evacuation,peakDensity\n");
+		for (const RCScenarioResult& result : results)
+			fprintf(dump, "%llu,%d,%d,%d,%.3f,%.3f\n", (unsigned long long)result.seed, result.agents,
+				result.arrived, result.ticks, result.evacuationTime, result.peakDensity);
+		fclose(dump);
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		printf("usage: %s <mesh.obj|navmesh> <agents.yaml> [--ticks N] [--dt S] [--threads N] [--radius R] [--arrive R] [--dump trajectories.csv] [--dump-every K] [--save-navmesh path] [--checksums path] [--replan-ms M] [--replan-nodes N] [--checkpoint T] [--batch RUNS] [--batch-agents N] [--seed S] [--group K] [--time-scale S] [--cpu-budget MS]\n", argv[0]);
+		return 1;
+	}
+
+	std::string meshPath = argv[1];
+	std::string agentsPath = argv[2];
+	std::string dumpPath;
+	std::string saveMeshPath;
+	std::string checksumPath;
+	int maxTicks = 100000;
+	int threads = 0;
+	int dumpEvery = 1;
+	float dt = 1.0f / 60.0f;
+	float agentRadius = 0.6f;
+	float arriveRadius = 1.5f;
+	float replanMs = REPLAN_BUDGET_MS;
+	int replanNodes = REPLAN_BUDGET_NODES;
+	int checkpointTick = 0;
+	int batchRuns = 0;
+	int batchAgents = 0;
+	uint64_t seed = 1;
+	int groupSize = 1;
+	float timeScale = 0.0f;
+	float cpuBudget = SIM_CPU_BUDGET_MS;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+			maxTicks = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--dt") == 0 && i + 1 < argc)
+			dt = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threads = std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--radius") == 0 && i + 1 < argc)
+			agentRadius = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--arrive") == 0 && i + 1 < argc)
+			arriveRadius = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+			dumpPath = argv[++i];
+		else if (strcmp(argv[i], "--dump-every") == 0 && i + 1 < argc)
+			dumpEvery = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--save-navmesh") == 0 && i + 1 < argc)
+			saveMeshPath = argv[++i];
+		else if (strcmp(argv[i], "--checksums") == 0 && i + 1 < argc)
+			checksumPath = argv[++i];
+		else if (strcmp(argv[i], "--replan-ms") == 0 && i + 1 < argc)
+			replanMs = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--replan-nodes") == 0 && i + 1 < argc)
+			replanNodes = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+			checkpointTick = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+			batchRuns = std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--batch-agents") == 0 && i + 1 < argc)
+			batchAgents = std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--group") == 0 && i + 1 < argc)
+			groupSize = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--time-scale") == 0 && i + 1 < argc)
+			timeScale = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--cpu-budget") == 0 && i + 1 < argc)
+			cpuBudget = (float)atof(argv[++i]);
+	}
+	if (!checksumPath.empty()) replanMs = 0.0f;
+
+	// navmesh
+	dtNavMesh* navMesh = nullptr;
+	const RCParams params = defaultParams(agentRadius);
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	if (std::filesystem::path(meshPath).extension() == ".obj")
+	{
+		rcMeshLoaderObj mesh;
+		if (!mesh.load(meshPath))
+		{
+			printf("Could not load mesh '%s'\n", meshPath.c_str());
+			return 1;
+		}
+		rcContext ctx;
+		navMesh = buildNavMesh(&ctx, params, mesh.getVerts(), mesh.getVertCount(), mesh.getTris(), mesh.getTriCount());
+		if (navMesh && !saveMeshPath.empty())
+			saveNavMesh(saveMeshPath, navMesh);
+	}
+	else
+	{
+		navMesh = loadNavMesh(meshPath);
+	}
+	if (navMesh == nullptr)
+	{
+		printf("Could not build or load navmesh from '%s'\n", meshPath.c_str());
+		return 1;
+	}
+	auto buildEnd = std::chrono::high_resolution_clock::now();
+	printf("Navmesh: %.2f ms\n", std::chrono::duration<double, std::milli>(buildEnd - buildStart).count());
+
+	std::vector<AgentSpec> specs;
+	if (!loadAgents(agentsPath, specs))
+	{
+		dtFreeNavMesh(navMesh);
+		return 1;
+	}
+
+	// crowd, same setup as RCScheduler::handelBuild
+	RCCrowd crowd;
+	if (!crowd.init(std::max(1, (int)specs.size()), agentRadius, navMesh))
+	{
+		printf("Could not init crowd\n");
+		dtFreeNavMesh(navMesh);
+		return 1;
+	}
+	crowd.getEditableFilter(0)->setExcludeFlags(RCScheduler::SAMPLE_POLYFLAGS_DISABLED);
+	crowd.initAvoidanceQualities();
+	crowd.isTimingPhases = true;
+	crowd.replanBudgetMs = replanMs;
+	crowd.replanBudgetNodes = replanNodes;
+
+	dtNavMeshQuery* navQuery = dtAllocNavMeshQuery();
+	navQuery->init(navMesh, 2048);
+
+	dtCrowdAgentParams ap;
+	memset(&ap, 0, sizeof(ap));
+	ap.height = params.m_agentHeight;
+	ap.radius = agentRadius;
+	ap.maxAcceleration = 8.0f;
+	ap.maxSpeed = 3.5f;
+	ap.collisionQueryRange = ap.radius * 12.0f;
+	ap.pathOptimizationRange = ap.radius * 30.0f;
+	ap.updateFlags = DT_CROWD_ANTICIPATE_TURNS | DT_CROWD_OPTIMIZE_VIS | DT_CROWD_OPTIMIZE_TOPO |
+		DT_CROWD_OBSTACLE_AVOIDANCE | DT_CROWD_SEPARATION;
+	ap.obstacleAvoidanceType = 3;
+	ap.separationWeight = 2.0f;
+
+	if (batchRuns > 0)
+	{
+		int result = runBatch(navMesh, crowd.getFilter(0), ap, specs, batchRuns, batchAgents, seed,
+			threads, dt, maxTicks, agentRadius, arriveRadius, dumpPath);
+		dtFreeNavMeshQuery(navQuery);
+		dtFreeNavMesh(navMesh);
+		return result;
+	}
+
+	std::vector<int> agentIdx(specs.size(), -1);
+	std::vector<int> leaderOf(specs.size(), -1);	// spec index of the group leader
+	int placed = 0;
+	int groups = 0;
+	int groupLeader = -1;
+	int groupCount = 0;
+	for (size_t i = 0; i < specs.size(); i++)
+	{
+		const int idx = crowd.addAgent(specs[i].start, &ap);
+		if (idx == -1) continue;
+		if (groupCount > 0 && groupCount < groupSize)
+		{
+			float offset[3];
+			getGroupFormationOffset(groupCount - 1, GROUP_SPACING, offset);
+			if (crowd.setAgentGroup(idx, agentIdx[groupLeader], offset))
+			{
+				agentIdx[i] = idx;
+				leaderOf[i] = groupLeader;
+				groupCount++;
+				placed++;
+				continue;
+			}
+		}
+		dtPolyRef targetRef = 0;
+		float targetPos[3];
+		navQuery->findNearestPoly(specs[i].target, crowd.getQueryExtents(), crowd.getFilter(0), &targetRef, targetPos);
+		if (!targetRef || !crowd.requestMoveTarget(idx, targetRef, targetPos))
+		{
+			crowd.removeAgent(idx);
+			continue;
+		}
+		agentIdx[i] = idx;
+		placed++;
+		groupLeader = (int)i;
+		groupCount = 1;
+		groups++;
+	}
+	printf("Agents: %zu loaded, %d placed\n", specs.size(), placed);
+	if (groupSize > 1)
+		printf("Groups: %d, %d followers\n", groups, placed - groups);
+
+	FILE* dump = nullptr;
+	if (!dumpPath.empty())
+	{
+		dump = fopen(dumpPath.c_str(), "w");
+		if (dump) fprintf(dump, "tick,agent,x,y,z\n");
+		else printf("Could not open '%s' for writing\n", dumpPath.c_str());
+	}
+	FILE* checksums = nullptr;
+	if (!checksumPath.empty())
+	{
+		checksums = fopen(checksumPath.c_str(), "w");
+		if (!checksums) printf("Could not open '%s' for writing\n", checksumPath.c_str());
+	}
+
+	std::unique_ptr<ThreadPool> pool;
+	if (threads > 0) pool = std::make_unique<ThreadPool>(threads);
+
+	// run
+	std::vector<double> tickTimes;
+	tickTimes.reserve(maxTicks);
+	long long agentUpdates = 0;
+	int maxQueueDepth = 0;
+	int active = placed;
+	int arrived = 0;
+	int ticks = 0;
+	const float arriveSqr = arriveRadius * arriveRadius;
+	auto runStart = std::chrono::high_resolution_clock::now();
+	// one crowd tick with its checkpoint, checksum, dump and arrivals
+	auto runTick = [&]()
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		crowd.update(dt, nullptr, pool.get());
+		auto end = std::chrono::high_resolution_clock::now();
+		tickTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		agentUpdates += active;
+		maxQueueDepth = std::max(maxQueueDepth, crowd.getReplanStats().queueDepth);
+		ticks++;
+
+		if (ticks == checkpointTick)
+		{
+			std::vector<uint8_t> state;
+			auto saveStart = std::chrono::high_resolution_clock::now();
+			crowd.saveState(state);
+			auto saveEnd = std::chrono::high_resolution_clock::now();
+			const bool restored = crowd.loadState(state.data(), state.size());
+			auto loadEnd = std::chrono::high_resolution_clock::now();
+			printf("Checkpoint at tick %d: %zu bytes, save %.3f ms, restore %.3f ms%s\n", ticks, state.size(),
+				std::chrono::duration<double, std::milli>(saveEnd - saveStart).count(),
+				std::chrono::duration<double, std::milli>(loadEnd - saveEnd).count(), restored ? "" : " (failed)");
+		}
+
+		if (checksums)
+		{
+			uint64_t hash = CROWD_CHECKSUM_SEED;
+			for (int i = 0; i < crowd.getAgentCount(); i++)
+				hash = hashCrowdAgent(hash, i, crowd.getAgent(i));
+			fprintf(checksums, "%d %llx\n", ticks, (unsigned long long)hash);
+		}
+
+		for (size_t i = 0; i < specs.size(); i++)
+		{
+			if (agentIdx[i] == -1) continue;
+			const dtCrowdAgent* ag = crowd.getAgent(agentIdx[i]);
+			if (dump && ticks % dumpEvery == 0)
+				fprintf(dump, "%d,%zu,%.3f,%.3f,%.3f\n", ticks, i, ag->npos[0], ag->npos[1], ag->npos[2]);
+			// followers arrive with their leader
+			if (leaderOf[i] != -1) continue;
+			if (dtVdistSqr(ag->npos, specs[i].target) < arriveSqr)
+			{
+				for (size_t j = i + 1; j < specs.size(); j++)
+				{
+					if (leaderOf[j] != (int)i || agentIdx[j] == -1) continue;
+					crowd.removeAgent(agentIdx[j]);
+					agentIdx[j] = -1;
+					active--;
+					arrived++;
+				}
+				crowd.removeAgent(agentIdx[i]);
+				agentIdx[i] = -1;
+				active--;
+				arrived++;
+			}
+		}
+	};
+	RCSimClock simClock;
+	simClock.setTimeScale(timeScale);
+	simClock.setCpuBudget(cpuBudget);
+	auto lastFrame = std::chrono::steady_clock::now();
+	while (ticks < maxTicks && active > 0)
+	{
+		if (timeScale <= 0.0f)
+		{
+			runTick();
+			continue;
+		}
+		// paced run, every frame runs the ticks of its scaled wall time
+		const auto frameStart = std::chrono::steady_clock::now();
+		const double frameTime = std::chrono::duration<double>(frameStart - lastFrame).count();
+		lastFrame = frameStart;
+		simClock.advance(frameTime, dt, SIM_MAX_CATCHUP_STEPS, [&](double)
+		{
+			if (ticks < maxTicks && active > 0) runTick();
+		});
+		std::this_thread::sleep_until(frameStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / SIM_TICK_RATE)));
+	}
+	auto runEnd = std::chrono::high_resolution_clock::now();
+	const double runMs = std::chrono::duration<double, std::milli>(runEnd - runStart).count();
+	if (dump) fclose(dump);
+	if (checksums) fclose(checksums);
+
+	double updateMs = 0.0;
+	for (double t : tickTimes) updateMs += t;
+	printf("Ticks: %d (%.2f s simulated), wall %.2f ms, update %.2f ms\n", ticks, ticks * dt, runMs, updateMs);
+	printf("Arrived: %d / %d\n", arrived, placed);
+	printf("Sim speed: %.1f sim-s/s", runMs > 0.0 ? ticks * dt * 1000.0 / runMs : 0.0);
+	if (timeScale > 0.0f)
+		printf(" (time scale %.1f, %.2f s dropped)", simClock.getTimeScale(), simClock.getDroppedTime());
+	printf("\n");
+	printf("Agent-updates/s: %.0f\n", updateMs > 0.0 ? agentUpdates * 1000.0 / updateMs : 0.0);
+	printf("Tick ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+		percentile(tickTimes, 0.5), percentile(tickTimes, 0.9), percentile(tickTimes, 0.99), percentile(tickTimes, 1.0));
+	const RCReplanStats& replan = crowd.getReplanStats();
+	printf("Replans: %llu, queue depth max %d, latency avg %.3f s  max %.3f s\n",
+		(unsigned long long)replan.completed, maxQueueDepth, replan.getAvgLatency(), replan.maxLatency);
+
+	printf("%-14s %12s %10s %7s\n", "phase", "total(ms)", "ms/tick", "%");
+	for (int phase = 0; phase < RC_CROWD_PHASE_COUNT; phase++)
+	{
+		const double t = crowd.getPhaseTime(phase);
+		printf("%-14s %12.2f %10.4f %6.1f%%\n", getCrowdPhaseName(phase), t,
+			ticks ? t / ticks : 0.0, updateMs > 0.0 ? t * 100.0 / updateMs : 0.0);
+	}
+
+	dtFreeNavMeshQuery(navQuery);
+	dtFreeNavMesh(navMesh);
+	return 0;
+}
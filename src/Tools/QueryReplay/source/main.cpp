@@ -0,0 +1,251 @@
+// Replays a captured navmesh query log (RCScheduler::startQueryLog) against a
+// saved navmesh and reports throughput, latency percentiles and node expansions.
+//
+// usage: QueryReplay <queries.rql> [navmesh] [--search detour|rc|alt|hierarchy] [--filter default|inline] [--snap detour|grid] [--repeat N]
+//
+// --filter inline runs the rc and alt searches with RCAreaFilter instead of
+// dtQueryFilter. The difference is the cost of virtual filter dispatch when the
+// build has ENABLE_VIRTUAL_QUERYFILTER on, without it both filters inline. --snap grid
+// answers nearest poly queries from RCNavSnapGrid instead of the BV tree.
+// nodes/q is the number of polygons expanded (closed) per findPath in every mode,
+// summed over the segment searches of a hierarchical query. The portal graph
+// search of the hierarchy works on portals and is not counted.
+#include <Function/AgentNav/RCQueryLog.h>
+#include <Function/AgentNav/RCNavMeshIO.h>
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCLandmarks.h>
+#include <Function/AgentNav/RCPathSearch.h>
+#include <Function/AgentNav/RCPathHierarchy.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Function/AgentNav/RCQueryFilters.h>
+#include <Function/AgentNav/RCNavSnapGrid.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <DetourNode.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace GU;
+
+enum SearchMode
+{
+	SEARCH_DETOUR,
+	SEARCH_RC,
+	SEARCH_ALT,
+	SEARCH_HIERARCHY,
+};
+
+struct QueryStats
+{
+	const char* name = "";
+	std::vector<double> latencies;	// microseconds
+	long long nodes = 0;
+	int failed = 0;
+};
+
+static double percentile(std::vector<double>& values, double p)
+{
+	if (values.empty()) return 0.0;
+	size_t idx = (size_t)(p * (values.size() - 1) + 0.5);
+	std::nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+// nodes the last dtNavMeshQuery::findPath closed, RCPathSearch counts the same
+static int getExpandedNodes(const dtNavMeshQuery* navQuery)
+{
+	const dtNodePool* pool = navQuery->getNodePool();
+	int expanded = 0;
+	for (int i = 1; i <= pool->getNodeCount(); i++)
+	{
+		if (pool->getNodeAtIdx(i)->flags & DT_NODE_CLOSED) expanded++;
+	}
+	return expanded;
+}
+
+static void printStats(QueryStats& stats)
+{
+	if (stats.latencies.empty()) return;
+	double total = 0.0;
+	for (double t : stats.latencies) total += t;
+	const size_t count = stats.latencies.size();
+	printf("%-14s %8zu %12.0f %9.2f %9.2f %9.2f %9.2f %10.1f %7d\n", stats.name, count,
+		total > 0.0 ? count * 1e6 / total : 0.0,
+		percentile(stats.latencies, 0.5), percentile(stats.latencies, 0.9),
+		percentile(stats.latencies, 0.99), percentile(stats.latencies, 1.0),
+		(double)stats.nodes / count, stats.failed);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("usage: %s <queries.rql> [navmesh] [--search detour|rc|alt|hierarchy] [--filter default|inline] [--snap detour|grid] [--repeat N]\n", argv[0]);
+		return 1;
+	}
+
+	std::string logPath = argv[1];
+	std::string meshPath;
+	SearchMode mode = SEARCH_DETOUR;
+	bool isInlineFilter = false;
+	bool isSnapGrid = false;
+	int repeat = 1;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--search") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			if (strcmp(name, "rc") == 0) mode = SEARCH_RC;
+			else if (strcmp(name, "alt") == 0) mode = SEARCH_ALT;
+			else if (strcmp(name, "hierarchy") == 0) mode = SEARCH_HIERARCHY;
+			else mode = SEARCH_DETOUR;
+		}
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			isInlineFilter = strcmp(argv[++i], "inline") == 0;
+		else if (strcmp(argv[i], "--snap") == 0 && i + 1 < argc)
+			isSnapGrid = strcmp(argv[++i], "grid") == 0;
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+			repeat = std::max(1, atoi(argv[++i]));
+		else
+			meshPath = argv[i];
+	}
+	if (meshPath.empty())
+		meshPath = std::filesystem::path(logPath).replace_extension(".navmesh").string();
+
+	dtNavMesh* navMesh = loadNavMesh(meshPath);
+	if (navMesh == nullptr)
+	{
+		printf("Could not load navmesh '%s'\n", meshPath.c_str());
+		return 1;
+	}
+
+	std::vector<RCQueryRecord> records;
+	RCQueryLogReader reader;
+	if (!reader.open(logPath))
+	{
+		printf("Could not open query log '%s'\n", logPath.c_str());
+		dtFreeNavMesh(navMesh);
+		return 1;
+	}
+	RCQueryRecord record;
+	while (reader.next(record))
+		records.push_back(record);
+
+	dtNavMeshQuery* navQuery = dtAllocNavMeshQuery();
+	navQuery->init(navMesh, 2048);
+
+	RCNavGraph graph;
+	RCLandmarks landmarks;
+	RCPathSearch pathSearch;
+	RCPathHierarchy hierarchy;
+	RCNavSnapGrid snapGrid;
+	dtQueryFilter defaultFilter;
+	if (mode != SEARCH_DETOUR || isSnapGrid)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		graph.build(navMesh);
+		pathSearch.init(navMesh, 2048);
+		if (isSnapGrid) snapGrid.build(graph, navQuery);
+		if (mode == SEARCH_ALT) landmarks.build(graph, NUM_LANDMARKS);
+		else if (mode == SEARCH_HIERARCHY) hierarchy.build(graph, &defaultFilter, HIERARCHY_CLUSTER_SIZE);
+		auto end = std::chrono::high_resolution_clock::now();
+		printf("Preprocess: %.2f ms\n", std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	QueryStats stats[RC_QUERY_STRAIGHT_PATH + 1];
+	stats[RC_QUERY_FIND_PATH].name = "findPath";
+	stats[RC_QUERY_NEAREST_POLY].name = "findNearest";
+	stats[RC_QUERY_RAYCAST].name = "raycast";
+	stats[RC_QUERY_STRAIGHT_PATH].name = "straightPath";
+
+	dtPolyRef polys[MAX_POLYS];
+	float straightPath[MAX_POLYS * 3];
+	unsigned char straightPathFlags[MAX_POLYS];
+	dtPolyRef straightPathPolys[MAX_POLYS];
+	RCAbstractPath abstractPath;
+
+	for (int iter = 0; iter < repeat; iter++)
+	{
+		for (const RCQueryRecord& query : records)
+		{
+			if (query.type < RC_QUERY_FIND_PATH || query.type > RC_QUERY_STRAIGHT_PATH) continue;
+			dtQueryFilter filter;
+			filter.setIncludeFlags(query.includeFlags);
+			filter.setExcludeFlags(query.excludeFlags);
+			const RCAreaFilter inlineFilter(filter);
+
+			dtStatus status = DT_FAILURE;
+			int nodes = 0;
+			int count = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			switch (query.type)
+			{
+			case RC_QUERY_FIND_PATH:
+				if (mode == SEARCH_RC || mode == SEARCH_ALT)
+				{
+					RCLandmarkHeuristic heuristic{ &landmarks, graph.indexOf(query.endRef), query.endPos };
+					if (mode == SEARCH_RC && isInlineFilter)
+						status = pathSearch.findPath(query.startRef, query.endRef, query.startPos, query.endPos, &inlineFilter, polys, &count, MAX_POLYS);
+					else if (mode == SEARCH_RC)
+						status = pathSearch.findPath(query.startRef, query.endRef, query.startPos, query.endPos, &filter, polys, &count, MAX_POLYS);
+					else if (isInlineFilter)
+						status = pathSearch.findPath(query.startRef, query.endRef, query.startPos, query.endPos, &inlineFilter, heuristic, polys, &count, MAX_POLYS);
+					else
+						status = pathSearch.findPath(query.startRef, query.endRef, query.startPos, query.endPos, &filter, heuristic, polys, &count, MAX_POLYS);
+					nodes = pathSearch.getLastExpandedNodes();
+				}
+				else if (mode == SEARCH_HIERARCHY && hierarchy.findAbstractPath(query.startRef, query.endRef, abstractPath))
+				{
+					status = hierarchy.refinePath(pathSearch, &filter, abstractPath, 0, (int)abstractPath.waypoints.size() - 1,
+						query.startPos, query.endPos, polys, &count, MAX_POLYS, &nodes);
+				}
+				else
+				{
+					status = navQuery->findPath(query.startRef, query.endRef, query.startPos, query.endPos, &filter, polys, &count, MAX_POLYS);
+					nodes = getExpandedNodes(navQuery);
+				}
+				break;
+			case RC_QUERY_NEAREST_POLY:
+			{
+				float nearestPt[3];
+				if (isSnapGrid)
+					status = snapGrid.findNearestPoly(query.startPos, query.endPos, &filter, &polys[0], nearestPt) ? DT_SUCCESS : DT_FAILURE;
+				else
+					status = navQuery->findNearestPoly(query.startPos, query.endPos, &filter, &polys[0], nearestPt);
+				break;
+			}
+			case RC_QUERY_RAYCAST:
+			{
+				float t, hitNormal[3];
+				status = navQuery->raycast(query.startRef, query.startPos, query.endPos, &filter, &t, hitNormal, polys, &count, MAX_POLYS);
+				break;
+			}
+			case RC_QUERY_STRAIGHT_PATH:
+				status = navQuery->findStraightPath(query.startPos, query.endPos, query.path.data(), (int)query.path.size(),
+					straightPath, straightPathFlags, straightPathPolys, &count, MAX_POLYS, query.options);
+				break;
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+
+			QueryStats& s = stats[query.type];
+			s.latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+			s.nodes += nodes;
+			if (dtStatusFailed(status)) s.failed++;
+		}
+	}
+
+	printf("Replayed %zu queries x %d from '%s'\n", records.size(), repeat, logPath.c_str());
+	printf("%-14s %8s %12s %9s %9s %9s %9s %10s %7s\n", "query", "count", "queries/s", "p50(us)", "p90(us)", "p99(us)", "max(us)", "nodes/q", "failed");
+	for (int type = RC_QUERY_FIND_PATH; type <= RC_QUERY_STRAIGHT_PATH; type++)
+		printStats(stats[type]);
+
+	dtFreeNavMeshQuery(navQuery);
+	dtFreeNavMesh(navMesh);
+	return 0;
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <Function/AgentNav/RCAgentEvents.h>
+
+using namespace GU;
+
+namespace
+{
+	void postEvents(RCAgentEvents& events, int from, int to)
+	{
+		for (int i = from; i < to; i++)
+		{
+			const float pos[3] = { (float)i, 0.0f, 0.0f };
+			events.post(i, i, RC_AGENT_EVENT_STUCK, pos);
+		}
+	}
+
+	void expectInOrder(const std::vector<RCAgentEvent>& popped, int from)
+	{
+		for (int i = 0; i < (int)popped.size(); i++)
+		{
+			EXPECT_EQ(popped[i].tick, (uint64_t)(from + i));
+			EXPECT_EQ(popped[i].idx, from + i);
+			EXPECT_EQ(popped[i].pos[0], (float)(from + i));
+		}
+	}
+}
+
+// Events past the ring capacity wait in the overflow list and come out after the ring, in order
+TEST(AgentEventsTest, OverflowKeepsOrder)
+{
+	RCAgentEvents events;
+	// rings hold at least 64 events
+	events.init(8);
+	postEvents(events, 0, 100);
+
+	std::vector<RCAgentEvent> popped;
+	ASSERT_EQ(events.pop(popped), 64);
+	expectInOrder(popped, 0);
+
+	// the ring has room again, a new event still queues behind the waiting ones
+	postEvents(events, 100, 101);
+	popped.clear();
+	EXPECT_EQ(events.pop(popped), 0);
+
+	events.flushOverflow();
+	ASSERT_EQ(events.pop(popped), 37);
+	expectInOrder(popped, 64);
+}
+
+// Clearing drops the ring and the overflow list
+TEST(AgentEventsTest, ClearDropsOverflow)
+{
+	RCAgentEvents events;
+	events.init(8);
+	postEvents(events, 0, 100);
+	events.clear();
+	events.flushOverflow();
+
+	std::vector<RCAgentEvent> popped;
+	EXPECT_EQ(events.pop(popped), 0);
+	postEvents(events, 0, 1);
+	EXPECT_EQ(events.pop(popped), 1);
+}
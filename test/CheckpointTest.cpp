@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCCheckpoint.h>
+#include <filesystem>
+#include <fstream>
+
+using namespace GU;
+
+namespace
+{
+	const float DT = 1.0f / 30.0f;
+	const int TICKS = 300;
+
+	// agents meeting head-on in the open band between the first two walls, so the
+	// saved tick has walking agents with boundaries and neighbours
+	void addCrossingAgents(RCCrowd& crowd, const NavTest::Scene& scene)
+	{
+		const dtCrowdAgentParams ap = NavTest::agentParams();
+		for (int i = 0; i < 6; i++)
+		{
+			const float z = 17.0f + i * 2.0f;
+			const float starts[2][2] = { { 8.0f, z }, { 52.0f, z + 1.0f } };
+			const float ends[2][2] = { { 52.0f, z }, { 8.0f, z + 1.0f } };
+			for (int j = 0; j < 2; j++)
+			{
+				dtPolyRef ref;
+				float pos[3], target[3];
+				scene.findPoly(starts[j][0], starts[j][1], ref, pos);
+				const int idx = crowd.addAgent(pos, &ap);
+				scene.findPoly(ends[j][0], ends[j][1], ref, target);
+				crowd.requestMoveTarget(idx, ref, target);
+			}
+		}
+	}
+
+	// positions of every agent after every tick
+	std::vector<float> simulate(RCCrowd& crowd, int ticks)
+	{
+		std::vector<float> trace;
+		for (int tick = 0; tick < ticks; tick++)
+		{
+			crowd.update(DT, nullptr);
+			for (int i = 0; i < crowd.getAgentCount(); i++)
+			{
+				const dtCrowdAgent* ag = crowd.getAgent(i);
+				if (ag->active)
+					trace.insert(trace.end(), ag->npos, ag->npos + 3);
+			}
+		}
+		return trace;
+	}
+
+	int activeCount(RCCrowd& crowd)
+	{
+		std::vector<dtCrowdAgent*> agents(crowd.getAgentCount());
+		return crowd.getActiveAgents(agents.data(), (int)agents.size());
+	}
+}
+
+// A crowd restored from a saved tick runs on exactly as the crowd it was saved from
+TEST(CheckpointTest, RestoredCrowdMatchesOriginal)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCCrowd crowd;
+	ASSERT_TRUE(crowd.init(64, 0.6f, scene.navMesh));
+	crowd.initAvoidanceQualities();
+	addCrossingAgents(crowd, scene);
+	simulate(crowd, TICKS);
+
+	std::vector<uint8_t> state;
+	crowd.saveState(state);
+	const std::vector<float> original = simulate(crowd, TICKS);
+
+	// into the crowd it came from and into a new one
+	ASSERT_TRUE(crowd.loadState(state.data(), state.size()));
+	EXPECT_TRUE(simulate(crowd, TICKS) == original);
+
+	RCCrowd restored;
+	ASSERT_TRUE(restored.init(64, 0.6f, scene.navMesh));
+	restored.initAvoidanceQualities();
+	ASSERT_TRUE(restored.loadState(state.data(), state.size()));
+	EXPECT_EQ(activeCount(restored), 12);
+	EXPECT_TRUE(simulate(restored, TICKS) == original);
+}
+
+// States of a larger crowd or cut short are refused, a cut one leaves the crowd empty
+TEST(CheckpointTest, RejectsMismatchedState)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCCrowd crowd;
+	ASSERT_TRUE(crowd.init(64, 0.6f, scene.navMesh));
+	addCrossingAgents(crowd, scene);
+	simulate(crowd, 10);
+	std::vector<uint8_t> state;
+	crowd.saveState(state);
+
+	RCCrowd smaller;
+	ASSERT_TRUE(smaller.init(32, 0.6f, scene.navMesh));
+	EXPECT_FALSE(smaller.loadState(state.data(), state.size()));
+
+	EXPECT_FALSE(crowd.loadState(state.data(), state.size() - 1));
+	EXPECT_EQ(activeCount(crowd), 0);
+}
+
+// A checkpoint file whose header claims more data than the file holds is refused before allocating it
+TEST(CheckpointTest, RejectsOversizedFile)
+{
+	RCCrowdCheckpoint checkpoint;
+	checkpoint.tick = 7;
+	checkpoint.crowd.assign(64, 1);
+	checkpoint.entities.resize(2);
+	const std::filesystem::path filepath = std::filesystem::temp_directory_path() / "RCCheckpointTest.bin";
+	ASSERT_TRUE(checkpoint.save(filepath));
+	RCCrowdCheckpoint loaded;
+	ASSERT_TRUE(loaded.load(filepath));
+	EXPECT_EQ(loaded.crowd, checkpoint.crowd);
+
+	// crowdSize follows magic, version, tick and time
+	for (const uint64_t size : { (uint64_t)1 << 60, (uint64_t)65 })
+	{
+		std::fstream file(filepath, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(24);
+		file.write((const char*)&size, sizeof(size));
+		file.close();
+		EXPECT_FALSE(loaded.load(filepath)) << size;
+	}
+	std::filesystem::remove(filepath);
+}
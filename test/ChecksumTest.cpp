@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Core/ThreadPool.h>
+#include <Function/AgentNav/RCChecksum.h>
+#include <Function/AgentNav/RCCrowd.h>
+
+using namespace GU;
+
+namespace
+{
+	const float DT = 1.0f / 30.0f;
+	const int TICKS = 300;
+
+	// agents meeting head-on between the first two walls
+	void addCrossingAgents(RCCrowd& crowd, const NavTest::Scene& scene)
+	{
+		const dtCrowdAgentParams ap = NavTest::agentParams();
+		for (int i = 0; i < 6; i++)
+		{
+			const float z = 17.0f + i * 2.0f;
+			const float starts[2][2] = { { 8.0f, z }, { 52.0f, z + 1.0f } };
+			const float ends[2][2] = { { 52.0f, z }, { 8.0f, z + 1.0f } };
+			for (int j = 0; j < 2; j++)
+			{
+				dtPolyRef ref;
+				float pos[3], target[3];
+				scene.findPoly(starts[j][0], starts[j][1], ref, pos);
+				const int idx = crowd.addAgent(pos, &ap);
+				scene.findPoly(ends[j][0], ends[j][1], ref, target);
+				crowd.requestMoveTarget(idx, ref, target);
+			}
+		}
+	}
+
+	uint64_t checksum(RCCrowd& crowd)
+	{
+		uint64_t hash = CROWD_CHECKSUM_SEED;
+		for (int i = 0; i < crowd.getAgentCount(); i++)
+			hash = hashCrowdAgent(hash, i, crowd.getAgent(i));
+		return hash;
+	}
+
+	// checksum after every tick
+	std::vector<uint64_t> simulate(RCCrowd& crowd, int ticks, ThreadPool* pool)
+	{
+		std::vector<uint64_t> checksums;
+		for (int tick = 0; tick < ticks; tick++)
+		{
+			crowd.update(DT, nullptr, pool);
+			checksums.push_back(checksum(crowd));
+		}
+		return checksums;
+	}
+}
+
+// The same crowd gives the same checksum every tick, serial or on the pool
+TEST(ChecksumTest, ChecksumsAreDeterministic)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	ThreadPool pool(4);
+	RCCrowd serial, parallel;
+	ASSERT_TRUE(serial.init(64, 0.6f, scene.navMesh));
+	ASSERT_TRUE(parallel.init(64, 0.6f, scene.navMesh));
+	serial.initAvoidanceQualities();
+	parallel.initAvoidanceQualities();
+	addCrossingAgents(serial, scene);
+	addCrossingAgents(parallel, scene);
+	EXPECT_EQ(checksum(serial), checksum(parallel));
+
+	const std::vector<uint64_t> a = simulate(serial, TICKS, nullptr);
+	const std::vector<uint64_t> b = simulate(parallel, TICKS, &pool);
+	EXPECT_TRUE(a == b);
+}
+
+// One agent sent elsewhere changes the checksum from that tick on
+TEST(ChecksumTest, ChecksumsDiverge)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCCrowd a, b;
+	ASSERT_TRUE(a.init(64, 0.6f, scene.navMesh));
+	ASSERT_TRUE(b.init(64, 0.6f, scene.navMesh));
+	a.initAvoidanceQualities();
+	b.initAvoidanceQualities();
+	addCrossingAgents(a, scene);
+	addCrossingAgents(b, scene);
+	simulate(a, 10, nullptr);
+	simulate(b, 10, nullptr);
+	ASSERT_EQ(checksum(a), checksum(b));
+
+	dtPolyRef ref;
+	float target[3];
+	scene.findPoly(30.0f, 5.0f, ref, target);
+	b.requestMoveTarget(0, ref, target);
+	const std::vector<uint64_t> sa = simulate(a, 30, nullptr);
+	const std::vector<uint64_t> sb = simulate(b, 30, nullptr);
+	EXPECT_NE(sa.back(), sb.back());
+}
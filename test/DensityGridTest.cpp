@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCDensityGrid.h>
+
+using namespace GU;
+
+// Updating only the agents the crowd lists keeps the same counts and gate crossings as updating every agent
+TEST(DensityGridTest, CellChangesMatchFullUpdate)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	const dtCrowdAgentParams ap = NavTest::agentParams();
+	RCCrowd crowd;
+	ASSERT_TRUE(crowd.init(NavTest::NUM_QUERIES, ap.radius, scene.navMesh));
+	const float bmin[3] = { 0.0f, -1.0f, 0.0f };
+	const float bmax[3] = { 60.0f, 1.0f, 60.0f };
+	const float gateA[3] = { 30.0f, 0.0f, 0.0f };
+	const float gateB[3] = { 30.0f, 0.0f, 60.0f };
+	RCDensityGrid listed, full;
+	for (RCDensityGrid* grid : { &listed, &full })
+	{
+		grid->init(bmin, bmax, 2.0f, NavTest::NUM_QUERIES);
+		grid->addGate(gateA, gateB);
+	}
+	crowd.cellGrid = &listed;
+
+	for (int q = 0; q < NavTest::NUM_QUERIES; q++)
+	{
+		const float* query = NavTest::QUERIES[q];
+		dtPolyRef startRef, endRef;
+		float startPos[3], endPos[3];
+		ASSERT_TRUE(scene.findPoly(query[0], query[1], startRef, startPos));
+		ASSERT_TRUE(scene.findPoly(query[2], query[3], endRef, endPos));
+		const int idx = crowd.addAgent(startPos, &ap);
+		ASSERT_GE(idx, 0);
+		crowd.requestMoveTarget(idx, endRef, endPos);
+	}
+
+	int listedUpdates = 0;
+	for (int tick = 0; tick < 600; tick++)
+	{
+		crowd.update(1.0f / 30.0f, nullptr);
+		for (int idx : crowd.getCellChanges())
+			listed.updateAgent(idx, crowd.getAgent(idx)->npos);
+		listedUpdates += (int)crowd.getCellChanges().size();
+		for (int i = 0; i < crowd.getAgentCount(); i++)
+		{
+			const dtCrowdAgent* ag = crowd.getAgent(i);
+			if (ag->active) full.updateAgent(i, ag->npos);
+		}
+		if (tick == 300)
+		{
+			crowd.removeAgent(0);
+			listed.removeAgent(0);
+			full.removeAgent(0);
+		}
+		ASSERT_TRUE(listed.getCounts() == full.getCounts()) << tick;
+	}
+	EXPECT_EQ(listed.getGateCrossings(0, 0), full.getGateCrossings(0, 0));
+	EXPECT_EQ(listed.getGateCrossings(0, 1), full.getGateCrossings(0, 1));
+	// a walking agent changes its 2 m cell every dozen ticks or so
+	EXPECT_LT(listedUpdates, 600 * NavTest::NUM_QUERIES / 2);
+}
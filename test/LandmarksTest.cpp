@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCLandmarks.h>
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCPathSearch.h>
+
+using namespace GU;
+
+// The landmark bound must not cut off the optimal corridor plain A* finds
+TEST(LandmarksTest, PathCostMatchesPlainAStar)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	RCPathSearch search;
+	ASSERT_TRUE(search.init(scene.navMesh, 4096));
+	RCLandmarks landmarks;
+	landmarks.build(graph, NUM_LANDMARKS);
+	ASSERT_GT(landmarks.getLandmarkCount(), 0);
+
+	for (int q = 0; q < NavTest::NUM_QUERIES; q++)
+	{
+		const float* query = NavTest::QUERIES[q];
+		dtPolyRef startRef, endRef;
+		float startPos[3], endPos[3];
+		ASSERT_TRUE(scene.findPoly(query[0], query[1], startRef, startPos));
+		ASSERT_TRUE(scene.findPoly(query[2], query[3], endRef, endPos));
+
+		dtPolyRef flat[MAX_POLYS];
+		int nflat = 0;
+		ASSERT_TRUE(dtStatusSucceed(scene.navQuery->findPath(startRef, endRef, startPos, endPos, &scene.filter, flat, &nflat, MAX_POLYS)));
+		ASSERT_EQ(flat[nflat - 1], endRef);
+
+		RCLandmarkHeuristic heuristic{ &landmarks, graph.indexOf(endRef), endPos };
+		dtPolyRef alt[MAX_POLYS];
+		int nalt = 0;
+		ASSERT_TRUE(dtStatusSucceed(search.findPath(startRef, endRef, startPos, endPos, &scene.filter, heuristic, alt, &nalt, MAX_POLYS)));
+		ASSERT_GT(nalt, 0);
+		EXPECT_EQ(alt[nalt - 1], endRef) << "query " << q;
+
+		const float flatCost = scene.corridorCost(startPos, endPos, flat, nflat);
+		const float altCost = scene.corridorCost(startPos, endPos, alt, nalt);
+		ASSERT_GT(flatCost, 0.0f);
+		ASSERT_GT(altCost, 0.0f) << "query " << q;
+		EXPECT_LE(altCost, flatCost * 1.01f + 0.01f) << "query " << q;
+	}
+}
+
+// The bound is zero on the goal and never above the cost left along the optimal corridor
+TEST(LandmarksTest, BoundBelowCostToGo)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	RCLandmarks landmarks;
+	landmarks.build(graph, NUM_LANDMARKS);
+	ASSERT_GT(landmarks.getLandmarkCount(), 0);
+
+	for (int q = 0; q < NavTest::NUM_QUERIES; q++)
+	{
+		const float* query = NavTest::QUERIES[q];
+		dtPolyRef startRef, endRef;
+		float startPos[3], endPos[3];
+		ASSERT_TRUE(scene.findPoly(query[0], query[1], startRef, startPos));
+		ASSERT_TRUE(scene.findPoly(query[2], query[3], endRef, endPos));
+		const int endIdx = graph.indexOf(endRef);
+		EXPECT_EQ(landmarks.lowerBound(endIdx, endIdx), 0.0f);
+
+		dtPolyRef flat[MAX_POLYS];
+		int nflat = 0;
+		ASSERT_TRUE(dtStatusSucceed(scene.navQuery->findPath(startRef, endRef, startPos, endPos, &scene.filter, flat, &nflat, MAX_POLYS)));
+		for (int i = 1; i < nflat; i++)
+		{
+			// the node of flat[i] sits on the portal it was entered through
+			float pos[3];
+			ASSERT_TRUE(scene.portalMidPoint(flat[i - 1], flat[i], pos));
+			const float costToGo = scene.corridorCost(pos, endPos, &flat[i], nflat - i);
+			EXPECT_LE(landmarks.lowerBound(graph.indexOf(flat[i]), endIdx), costToGo + 0.01f) << "query " << q << " node " << i;
+		}
+	}
+}
+
+// Crowd path requests searched with the landmark bound find as short a corridor as the path queue
+TEST(LandmarksTest, CrowdRequestsMatchPathQueue)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	RCLandmarks landmarks;
+	landmarks.build(graph, NUM_LANDMARKS);
+	ASSERT_GT(landmarks.getLandmarkCount(), 0);
+
+	dtPolyRef startRef, endRef;
+	float startPos[3], endPos[3];
+	ASSERT_TRUE(scene.findPoly(2, 2, startRef, startPos));
+	ASSERT_TRUE(scene.findPoly(58, 58, endRef, endPos));
+	const dtCrowdAgentParams ap = NavTest::agentParams();
+
+	float length[2];
+	for (int useLandmarks = 0; useLandmarks < 2; useLandmarks++)
+	{
+		RCCrowd crowd;
+		ASSERT_TRUE(crowd.init(8, ap.radius, scene.navMesh));
+		crowd.landmarks = useLandmarks ? &landmarks : nullptr;
+		const int idx = crowd.addAgent(startPos, &ap);
+		ASSERT_GE(idx, 0);
+		ASSERT_TRUE(crowd.requestMoveTarget(idx, endRef, endPos));
+		const dtCrowdAgent* ag = crowd.getAgent(idx);
+		for (int tick = 0; tick < 10 && ag->targetState != DT_CROWDAGENT_TARGET_VALID; tick++)
+			crowd.update(1.0f / 30.0f, nullptr);
+		ASSERT_EQ(ag->targetState, DT_CROWDAGENT_TARGET_VALID) << "landmarks " << useLandmarks;
+		EXPECT_EQ(ag->corridor.getLastPoly(), endRef);
+		EXPECT_FALSE(ag->partial);
+		length[useLandmarks] = scene.straightPathLength(ag->corridor.getPos(), endPos, ag->corridor.getPath(), ag->corridor.getPathCount());
+		ASSERT_GT(length[useLandmarks], 0.0f) << "landmarks " << useLandmarks;
+	}
+	EXPECT_NEAR(length[1], length[0], length[0] * 0.01f);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCNavIslands.h>
+
+using namespace GU;
+
+namespace
+{
+	// only swimmable polygons, the scene has none
+	const unsigned short SWIM_FLAG = 0x02;
+
+#ifdef DT_VIRTUAL_QUERYFILTER
+	// rejects the island by position, so only a filter kept whole sees it
+	struct MainFloorFilter : public dtQueryFilter
+	{
+		bool passFilter(const dtPolyRef ref, const dtMeshTile* tile, const dtPoly* poly) const override
+		{
+			return tile->verts[poly->verts[0] * 3] < 65.0f && dtQueryFilter::passFilter(ref, tile, poly);
+		}
+	};
+#endif
+}
+
+// The floor and the island get labels of their own, paths between them are rejected
+TEST(NavIslandsTest, LabelsDisconnectedFloors)
+{
+	NavTest::Scene scene(true);
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	dtQueryFilter walk, swim;
+	swim.setIncludeFlags(SWIM_FLAG);
+	const dtQueryFilter* filters[2] = { &walk, &swim };
+	RCNavIslands islands;
+	islands.build(graph, filters, 2);
+	EXPECT_EQ(islands.getIslandCount(0), 2);
+	EXPECT_EQ(islands.getIslandCount(1), 0);
+
+	dtPolyRef a, b, island;
+	float pos[3];
+	ASSERT_TRUE(scene.findPoly(2, 2, a, pos));
+	ASSERT_TRUE(scene.findPoly(58, 58, b, pos));
+	ASSERT_TRUE(scene.findPoly(75, 5, island, pos));
+	EXPECT_NE(islands.getIsland(a, 0), -1);
+	EXPECT_NE(islands.getIsland(island, 0), islands.getIsland(a, 0));
+	EXPECT_TRUE(islands.isReachable(a, b, 0));
+	EXPECT_FALSE(islands.isReachable(a, island, 0));
+	EXPECT_EQ(islands.getIsland(a, 1), -1);
+	EXPECT_FALSE(islands.isReachable(a, b, 1));
+	EXPECT_EQ(islands.getIsland(0, 0), -1);
+}
+
+// A target on the island is moved to the nearest point of the floor the agent stands on
+TEST(NavIslandsTest, RedirectsToNearestOnIsland)
+{
+	NavTest::Scene scene(true);
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	dtQueryFilter walk;
+	const dtQueryFilter* filters[1] = { &walk };
+	RCNavIslands islands;
+	islands.build(graph, filters, 1);
+
+	dtPolyRef start, target;
+	float startPos[3], targetPos[3];
+	ASSERT_TRUE(scene.findPoly(30, 5, start, startPos));
+	ASSERT_TRUE(scene.findPoly(75, 5, target, targetPos));
+	const float halfExtents[3] = { 2.0f, 4.0f, 2.0f };
+	dtPolyRef ref;
+	float nearest[3];
+	ASSERT_TRUE(islands.findNearestOnIsland(scene.navQuery, targetPos, halfExtents, islands.getIsland(start, 0), 0, &ref, nearest));
+	EXPECT_TRUE(islands.isReachable(start, ref, 0));
+	// the floor edge facing the island
+	EXPECT_GT(nearest[0], 58.0f);
+	EXPECT_LT(nearest[0], 60.0f);
+	EXPECT_NEAR(nearest[2], 5.0f, 0.5f);
+
+	// an island without polygons has no nearest point
+	EXPECT_FALSE(islands.findNearestOnIsland(scene.navQuery, targetPos, halfExtents, 5, 0, &ref, nearest));
+	EXPECT_EQ(ref, (dtPolyRef)0);
+}
+
+#ifdef DT_VIRTUAL_QUERYFILTER
+// Subclassed filters keep their own passFilter for the labels and the redirect
+TEST(NavIslandsTest, KeepsVirtualFilters)
+{
+	NavTest::Scene scene(true);
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	MainFloorFilter mainFloor;
+	const dtQueryFilter* filters[1] = { &mainFloor };
+	RCNavIslands islands;
+	islands.build(graph, filters, 1);
+	EXPECT_EQ(islands.getIslandCount(0), 1);
+
+	dtPolyRef island;
+	float pos[3];
+	ASSERT_TRUE(scene.findPoly(75, 5, island, pos));
+	EXPECT_EQ(islands.getIsland(island, 0), -1);
+}
+#endif
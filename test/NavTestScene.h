@@ -0,0 +1,199 @@
+#pragma once
+#include <Function/AgentNav/RCNavMeshBuild.h>
+#include <Function/AgentNav/RCParams.h>
+#include <Function/AgentNav/RCPathSearch.h>
+#include <DetourCommon.h>
+#include <DetourCrowd.h>
+#include <DetourNavMesh.h>
+#include <DetourNavMeshQuery.h>
+#include <Recast.h>
+#include <cstring>
+#include <vector>
+
+// Shared navmesh for the AgentNav tests: a 60 x 60 m floor split by three walls with
+// alternating gaps, so a path from one side to the other winds through the whole mesh.
+namespace NavTest
+{
+	// defaults of the editor's navmesh dialog
+	inline GU::RCParams defaultParams()
+	{
+		GU::RCParams params;
+		params.m_cellSize = 0.3f;
+		params.m_cellHeight = 0.2f;
+		params.m_agentHeight = 2.0f;
+		params.m_agentRadius = 0.6f;
+		params.m_agentMaxClimb = 0.9f;
+		params.m_agentMaxSlope = 45.0f;
+		params.m_regionMinSize = 8.0f;
+		params.m_regionMergeSize = 20.0f;
+		params.m_edgeMaxLen = 12.0f;
+		params.m_edgeMaxError = 1.3f;
+		params.m_vertsPerPoly = 6.0f;
+		params.m_detailSampleDist = 6.0f;
+		params.m_detailSampleMaxError = 1.0f;
+		params.m_partitionType = 0;
+		params.m_filterLowHangingObstacles = true;
+		params.m_filterLedgeSpans = true;
+		params.m_filterWalkableLowHeightSpans = true;
+		params.m_keepInterResults = false;
+		return params;
+	}
+
+	// crowd agent as CrowdBench sets it up
+	inline dtCrowdAgentParams agentParams()
+	{
+		dtCrowdAgentParams ap;
+		memset(&ap, 0, sizeof(ap));
+		ap.height = 2.0f;
+		ap.radius = 0.6f;
+		ap.maxAcceleration = 8.0f;
+		ap.maxSpeed = 3.5f;
+		ap.collisionQueryRange = ap.radius * 12.0f;
+		ap.pathOptimizationRange = ap.radius * 30.0f;
+		ap.updateFlags = DT_CROWD_ANTICIPATE_TURNS | DT_CROWD_OPTIMIZE_VIS | DT_CROWD_OPTIMIZE_TOPO |
+			DT_CROWD_OBSTACLE_AVOIDANCE | DT_CROWD_SEPARATION;
+		ap.obstacleAvoidanceType = 3;
+		ap.separationWeight = 2.0f;
+		return ap;
+	}
+
+	inline void addQuad(std::vector<float>& verts, std::vector<int>& tris,
+		float x0, float y0, float z0, float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3)
+	{
+		const int base = (int)verts.size() / 3;
+		const float quad[] = { x0, y0, z0, x1, y1, z1, x2, y2, z2, x3, y3, z3 };
+		verts.insert(verts.end(), quad, quad + 12);
+		const int idx[] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+		tris.insert(tris.end(), idx, idx + 6);
+	}
+
+	inline void addWall(std::vector<float>& verts, std::vector<int>& tris, float x0, float z0, float x1, float z1, float h)
+	{
+		addQuad(verts, tris, x0, h, z0, x0, h, z1, x1, h, z1, x1, h, z0);
+		addQuad(verts, tris, x0, 0, z0, x0, h, z0, x1, h, z0, x1, 0, z0);
+		addQuad(verts, tris, x0, 0, z1, x0, h, z1, x1, h, z1, x1, 0, z1);
+		addQuad(verts, tris, x0, 0, z0, x0, h, z0, x0, h, z1, x0, 0, z1);
+		addQuad(verts, tris, x1, 0, z0, x1, h, z0, x1, h, z1, x1, 0, z1);
+	}
+
+	struct Scene
+	{
+		dtNavMesh* navMesh = nullptr;
+		dtNavMeshQuery* navQuery = nullptr;
+		dtQueryFilter filter;
+		// input triangles, 3 floats per vertex and 3 indices per triangle
+		std::vector<float> verts;
+		std::vector<int> tris;
+
+		// island adds a 10 x 10 m floor at x 70 .. 80 that no path reaches
+		explicit Scene(bool island = false)
+		{
+			addQuad(verts, tris, 0, 0, 0, 0, 0, 60, 60, 0, 60, 60, 0, 0);
+			addWall(verts, tris, 0, 14.5f, 50, 15.5f, 3);
+			addWall(verts, tris, 10, 29.5f, 60, 30.5f, 3);
+			addWall(verts, tris, 0, 44.5f, 50, 45.5f, 3);
+			if (island)
+				addQuad(verts, tris, 70, 0, 0, 70, 0, 10, 80, 0, 10, 80, 0, 0);
+			build();
+		}
+		// lanes lanes of laneLength m, 4 m apart and joined at alternating ends, the
+		// route from the first lane to the last walks all of them
+		Scene(int lanes, float laneLength)
+		{
+			const float width = lanes * 4.0f;
+			addQuad(verts, tris, 0, 0, 0, 0, 0, width, laneLength, 0, width, laneLength, 0, 0);
+			for (int i = 1; i < lanes; i++)
+			{
+				const float z = i * 4.0f;
+				if (i % 2)
+					addWall(verts, tris, 0, z - 0.5f, laneLength - 10.0f, z + 0.5f, 3);
+				else
+					addWall(verts, tris, 10.0f, z - 0.5f, laneLength, z + 0.5f, 3);
+			}
+			build();
+		}
+		~Scene()
+		{
+			dtFreeNavMeshQuery(navQuery);
+			dtFreeNavMesh(navMesh);
+		}
+		Scene(const Scene&) = delete;
+		Scene& operator=(const Scene&) = delete;
+
+		void build()
+		{
+			rcContext ctx(false);
+			navMesh = GU::buildNavMesh(&ctx, defaultParams(), verts.data(), (int)verts.size() / 3, tris.data(), (int)tris.size() / 3);
+			if (navMesh == nullptr) return;
+			navQuery = dtAllocNavMeshQuery();
+			navQuery->init(navMesh, 4096);
+		}
+
+		// nearest polygon to the floor point (x, z)
+		bool findPoly(float x, float z, dtPolyRef& ref, float* pos) const
+		{
+			const float center[3] = { x, 0.0f, z };
+			const float extents[3] = { 2.0f, 4.0f, 2.0f };
+			ref = 0;
+			return dtStatusSucceed(navQuery->findNearestPoly(center, extents, &filter, &ref, pos)) && ref != 0;
+		}
+
+		// position the A* search gives the node of to when entered from from
+		bool portalMidPoint(dtPolyRef from, dtPolyRef to, float* mid) const
+		{
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			const dtMeshTile* toTile = 0;
+			const dtPoly* toPoly = 0;
+			navMesh->getTileAndPolyByRefUnsafe(from, &tile, &poly);
+			navMesh->getTileAndPolyByRefUnsafe(to, &toTile, &toPoly);
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				if (tile->links[k].ref != to) continue;
+				GU::RCPathSearch::getEdgeMidPoint(from, poly, tile, &tile->links[k], toPoly, toTile, mid);
+				return true;
+			}
+			return false;
+		}
+
+		// cost the A* search assigns to a corridor, the distances between the portal midpoints,
+		// -1 when two polygons of it are not neighbours
+		float corridorCost(const float* startPos, const float* endPos, const dtPolyRef* path, int npath) const
+		{
+			float cost = 0.0f;
+			float pos[3];
+			dtVcopy(pos, startPos);
+			for (int i = 0; i + 1 < npath; i++)
+			{
+				float mid[3];
+				if (!portalMidPoint(path[i], path[i + 1], mid)) return -1.0f;
+				cost += dtVdist(pos, mid);
+				dtVcopy(pos, mid);
+			}
+			return cost + dtVdist(pos, endPos);
+		}
+
+		// length of the straight path along a corridor, -1 when it does not reach endPos
+		float straightPathLength(const float* startPos, const float* endPos, const dtPolyRef* path, int npath) const
+		{
+			float points[GU::MAX_POLYS * 3];
+			int npoints = 0;
+			const dtStatus status = navQuery->findStraightPath(startPos, endPos, path, npath, points, 0, 0, &npoints, GU::MAX_POLYS);
+			if (dtStatusFailed(status) || npoints == 0 || dtVdist(&points[(npoints - 1) * 3], endPos) > 0.01f) return -1.0f;
+			float length = 0.0f;
+			for (int i = 1; i < npoints; i++)
+				length += dtVdist(&points[(i - 1) * 3], &points[i * 3]);
+			return length;
+		}
+	};
+
+	// start and end floor points across the walls
+	const float QUERIES[][4] = {
+		{ 2, 2, 58, 58 },
+		{ 58, 2, 2, 58 },
+		{ 30, 5, 30, 55 },
+		{ 5, 58, 55, 20 },
+		{ 55, 35, 5, 10 },
+	};
+	const int NUM_QUERIES = sizeof(QUERIES) / sizeof(QUERIES[0]);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCNavGraph.h>
+#include <Function/AgentNav/RCPathHierarchy.h>
+#include <Function/AgentNav/RCPathSearch.h>
+#include <vector>
+
+using namespace GU;
+
+// The refined corridor covers the whole abstract path, it ends where the flat query ends
+TEST(PathHierarchyTest, RefinedPathMatchesFlatQuery)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	RCPathSearch search;
+	ASSERT_TRUE(search.init(scene.navMesh, 4096));
+	RCPathHierarchy hierarchy;
+	hierarchy.build(graph, &scene.filter, 8);
+	ASSERT_GT(hierarchy.getClusterCount(), 1);
+
+	for (int q = 0; q < NavTest::NUM_QUERIES; q++)
+	{
+		const float* query = NavTest::QUERIES[q];
+		dtPolyRef startRef, endRef;
+		float startPos[3], endPos[3];
+		ASSERT_TRUE(scene.findPoly(query[0], query[1], startRef, startPos));
+		ASSERT_TRUE(scene.findPoly(query[2], query[3], endRef, endPos));
+
+		dtPolyRef flat[MAX_POLYS];
+		int nflat = 0;
+		ASSERT_TRUE(dtStatusSucceed(scene.navQuery->findPath(startRef, endRef, startPos, endPos, &scene.filter, flat, &nflat, MAX_POLYS)));
+		ASSERT_GT(nflat, 0);
+		ASSERT_EQ(flat[nflat - 1], endRef);
+
+		RCAbstractPath abstractPath;
+		ASSERT_TRUE(hierarchy.findAbstractPath(startRef, endRef, abstractPath));
+		dtPolyRef refined[MAX_POLYS];
+		int nrefined = 0;
+		const dtStatus status = hierarchy.refinePath(search, &scene.filter, abstractPath, 0, (int)abstractPath.waypoints.size() - 1,
+			startPos, endPos, refined, &nrefined, MAX_POLYS);
+		ASSERT_TRUE(dtStatusSucceed(status));
+		EXPECT_FALSE(dtStatusDetail(status, DT_PARTIAL_RESULT)) << "query " << q;
+		ASSERT_GT(nrefined, 0);
+		EXPECT_EQ(refined[0], flat[0]) << "query " << q;
+		EXPECT_EQ(refined[nrefined - 1], flat[nflat - 1]) << "query " << q;
+
+		// the corridor is connected and not much longer than the optimal one
+		const float flatLength = scene.straightPathLength(startPos, endPos, flat, nflat);
+		const float refinedLength = scene.straightPathLength(startPos, endPos, refined, nrefined);
+		ASSERT_GT(flatLength, 0.0f);
+		ASSERT_GT(refinedLength, 0.0f) << "query " << q;
+		EXPECT_LE(refinedLength, flatLength * 1.5f) << "query " << q;
+	}
+}
+
+// A crowd request across more polygons than a corridor holds reaches the target, the
+// corridor is refined near the agent and extended while it walks
+TEST(PathHierarchyTest, CrowdWalksRouteLongerThanCorridor)
+{
+	const int LANES = 60;
+	NavTest::Scene scene(LANES, 200.0f);
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCNavGraph graph;
+	ASSERT_TRUE(graph.build(scene.navMesh));
+	RCPathHierarchy hierarchy;
+	hierarchy.build(graph, &scene.filter, HIERARCHY_CLUSTER_SIZE);
+	ASSERT_GT(hierarchy.getClusterCount(), 1);
+
+	dtPolyRef startRef, endRef;
+	float startPos[3], endPos[3];
+	ASSERT_TRUE(scene.findPoly(2, 2, startRef, startPos));
+	ASSERT_TRUE(scene.findPoly(2, LANES * 4.0f - 2.0f, endRef, endPos));
+
+	// the flat corridor does not fit in MAX_POLYS
+	std::vector<dtPolyRef> flat(4096);
+	int nflat = 0;
+	ASSERT_TRUE(dtStatusSucceed(scene.navQuery->findPath(startRef, endRef, startPos, endPos, &scene.filter, flat.data(), &nflat, (int)flat.size())));
+	ASSERT_EQ(flat[nflat - 1], endRef);
+	ASSERT_GT(nflat, MAX_POLYS);
+
+	const dtCrowdAgentParams ap = NavTest::agentParams();
+	RCCrowd crowd;
+	ASSERT_TRUE(crowd.init(4, ap.radius, scene.navMesh));
+	crowd.hierarchy = &hierarchy;
+	const int idx = crowd.addAgent(startPos, &ap);
+	ASSERT_GE(idx, 0);
+	ASSERT_TRUE(crowd.requestMoveTarget(idx, endRef, endPos));
+	const dtCrowdAgent* ag = crowd.getAgent(idx);
+
+	const float DT = 0.1f;
+	const int MAX_TICKS = 60000;
+	int maxCorridor = 0;
+	int tick = 0;
+	for (; tick < MAX_TICKS && dtVdist2D(ag->npos, endPos) > 1.0f; tick++)
+	{
+		crowd.update(DT, nullptr);
+		ASSERT_NE(ag->targetState, DT_CROWDAGENT_TARGET_FAILED) << "tick " << tick;
+		if (ag->targetState == DT_CROWDAGENT_TARGET_VALID)
+			maxCorridor = dtMax(maxCorridor, ag->corridor.getPathCount());
+	}
+	EXPECT_LT(tick, MAX_TICKS);
+	EXPECT_LE(dtVdist2D(ag->npos, endPos), 1.0f);
+	// a flat request would fill the corridor
+	EXPECT_LT(maxCorridor, MAX_POLYS);
+}
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Core/ThreadPool.h>
+#include <Function/AgentNav/RCPathSmoother.h>
+
+using namespace GU;
+
+// Batched paths are packed back to back in pair order, whatever worker computed them
+TEST(PathSmootherTest, PackedPathsMatchSinglePaths)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCPathSmoother smoother;
+	ASSERT_TRUE(smoother.init(scene.navMesh, 2048, 4));
+
+	// the queries plus one pair off the mesh, which has no path
+	std::vector<float> starts, ends;
+	for (int q = 0; q < NavTest::NUM_QUERIES; q++)
+	{
+		const float* query = NavTest::QUERIES[q];
+		starts.insert(starts.end(), { query[0], 0.0f, query[1] });
+		ends.insert(ends.end(), { query[2], 0.0f, query[3] });
+	}
+	starts.insert(starts.end(), { 500.0f, 0.0f, 500.0f });
+	ends.insert(ends.end(), { 10.0f, 0.0f, 10.0f });
+	const int n = (int)starts.size() / 3;
+	const float halfExtents[3] = { 2.0f, 4.0f, 2.0f };
+
+	ThreadPool pool(3);
+	std::vector<float> points;
+	std::vector<int> offsets;
+	EXPECT_EQ(smoother.smoothPaths(starts.data(), ends.data(), n, halfExtents, &scene.filter, MAX_SMOOTH, points, offsets, &pool), n - 1);
+	ASSERT_EQ((int)offsets.size(), n + 1);
+	EXPECT_EQ((int)points.size(), offsets[n] * 3);
+	EXPECT_EQ(offsets[n], offsets[n - 1]);
+
+	std::vector<float> single(MAX_SMOOTH * 3);
+	for (int i = 0; i < n; i++)
+	{
+		const int npoints = smoother.smoothPath(0, &starts[i * 3], &ends[i * 3], halfExtents, &scene.filter, single.data(), MAX_SMOOTH);
+		ASSERT_EQ(offsets[i + 1] - offsets[i], npoints);
+		for (int j = 0; j < npoints * 3; j++)
+			EXPECT_FLOAT_EQ(points[offsets[i] * 3 + j], single[j]);
+	}
+}
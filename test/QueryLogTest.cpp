@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCQueryLog.h>
+#include <filesystem>
+
+using namespace GU;
+
+// A crowd with a recorder logs its path searches and the visibility raycasts of its corridors
+TEST(QueryLogTest, RecordsCrowdQueries)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	const std::filesystem::path filepath = std::filesystem::temp_directory_path() / "RCQueryLogTest.bin";
+	{
+		RCQueryRecorder recorder;
+		ASSERT_TRUE(recorder.open(filepath));
+		const dtCrowdAgentParams ap = NavTest::agentParams();
+		RCCrowd crowd;
+		ASSERT_TRUE(crowd.init(8, ap.radius, scene.navMesh));
+		crowd.queryRecorder = &recorder;
+		for (int q = 0; q < NavTest::NUM_QUERIES; q++)
+		{
+			const float* query = NavTest::QUERIES[q];
+			dtPolyRef startRef, endRef;
+			float startPos[3], endPos[3];
+			ASSERT_TRUE(scene.findPoly(query[0], query[1], startRef, startPos));
+			ASSERT_TRUE(scene.findPoly(query[2], query[3], endRef, endPos));
+			const int idx = crowd.addAgent(startPos, &ap);
+			ASSERT_GE(idx, 0);
+			crowd.requestMoveTarget(idx, endRef, endPos);
+		}
+		for (int tick = 0; tick < 60; tick++)
+			crowd.update(1.0f / 30.0f, nullptr);
+		EXPECT_GT(recorder.getRecordCount(), 0);
+	}
+
+	RCQueryLogReader reader;
+	ASSERT_TRUE(reader.open(filepath));
+	RCQueryRecord record;
+	int counts[RC_QUERY_STRAIGHT_PATH + 1] = {};
+	while (reader.next(record))
+	{
+		ASSERT_GE(record.type, RC_QUERY_FIND_PATH);
+		ASSERT_LE(record.type, RC_QUERY_STRAIGHT_PATH);
+		counts[record.type]++;
+		if (record.type == RC_QUERY_FIND_PATH || record.type == RC_QUERY_RAYCAST)
+			EXPECT_TRUE(scene.navMesh->isValidPolyRef(record.startRef));
+	}
+	// a quick search per agent and full requests for the paths it does not finish
+	EXPECT_GT(counts[RC_QUERY_FIND_PATH], NavTest::NUM_QUERIES);
+	EXPECT_GT(counts[RC_QUERY_RAYCAST], 0);
+	std::filesystem::remove(filepath);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Core/ThreadPool.h>
+#include <Function/AgentNav/ChunkyTriMesh.h>
+#include <Function/AgentNav/RCRaycast.h>
+#include <random>
+
+using namespace GU;
+
+namespace
+{
+	const int NRAYS = 1000;
+
+	struct Rays
+	{
+		std::vector<float> src;
+		std::vector<float> dst;
+	};
+
+	// Drops onto the floor and the walls, flat casts through the walls, rays passing
+	// over the walls and rays outside the mesh bounds, shuffled so packets mix them.
+	Rays makeRays()
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> coord(-5.0f, 65.0f);
+		std::uniform_int_distribution<int> kind(0, 3);
+		Rays rays;
+		for (int i = 0; i < NRAYS; i++)
+		{
+			float sp[3], sq[3];
+			switch (kind(rng))
+			{
+			case 0:
+				sp[0] = coord(rng); sp[1] = 5.0f; sp[2] = coord(rng);
+				sq[0] = sp[0] + 2.0f; sq[1] = -1.0f; sq[2] = sp[2] - 1.0f;
+				break;
+			case 1:
+				sp[0] = coord(rng); sp[1] = 1.0f; sp[2] = coord(rng);
+				sq[0] = coord(rng); sq[1] = 1.0f; sq[2] = coord(rng);
+				break;
+			case 2:
+				sp[0] = coord(rng); sp[1] = 4.0f; sp[2] = coord(rng);
+				sq[0] = coord(rng); sq[1] = 4.0f; sq[2] = coord(rng);
+				break;
+			default:
+				sp[0] = 70.0f + coord(rng); sp[1] = 5.0f; sp[2] = coord(rng);
+				sq[0] = sp[0]; sq[1] = -1.0f; sq[2] = sp[2];
+				break;
+			}
+			rays.src.insert(rays.src.end(), sp, sp + 3);
+			rays.dst.insert(rays.dst.end(), sq, sq + 3);
+		}
+		return rays;
+	}
+}
+
+// Packets of rays find the same hits as casting every ray on its own, misses included
+TEST(RaycastTest, BatchMatchesSingleRays)
+{
+	NavTest::Scene scene;
+	const int nverts = (int)scene.verts.size() / 3;
+	const int ntris = (int)scene.tris.size() / 3;
+	// small chunks, so a packet overlaps several of them
+	rcChunkyTriMesh chunkyMesh;
+	ASSERT_TRUE(rcCreateChunkyTriMesh(scene.verts.data(), scene.tris.data(), ntris, 4, &chunkyMesh));
+	ASSERT_GT(chunkyMesh.nnodes, 1);
+	float bmin[3], bmax[3];
+	rcCalcBounds(scene.verts.data(), nverts, bmin, bmax);
+
+	const Rays rays = makeRays();
+	std::vector<float> expectedT(NRAYS, 1.0f);
+	std::vector<int> expectedTri(NRAYS, -1);
+	int expectedHits = 0;
+	for (int i = 0; i < NRAYS; i++)
+	{
+		if (raycastTriMesh(&chunkyMesh, scene.verts.data(), bmin, bmax, &rays.src[i * 3], &rays.dst[i * 3], expectedT[i], &expectedTri[i]))
+			expectedHits++;
+		else
+			expectedT[i] = 1.0f;
+	}
+	// every kind of ray is in the set
+	EXPECT_GT(expectedHits, NRAYS / 10);
+	EXPECT_LT(expectedHits, NRAYS);
+
+	ThreadPool pool(4);
+	ThreadPool* pools[2] = { nullptr, &pool };
+	for (ThreadPool* p : pools)
+	{
+		std::vector<float> t(NRAYS);
+		std::vector<int> tri(NRAYS);
+		const int hits = raycastTriMeshBatch(&chunkyMesh, scene.verts.data(), bmin, bmax,
+			rays.src.data(), rays.dst.data(), NRAYS, t.data(), tri.data(), p);
+		EXPECT_EQ(hits, expectedHits);
+		for (int i = 0; i < NRAYS; i++)
+		{
+			EXPECT_EQ(t[i], expectedT[i]) << "ray " << i;
+			EXPECT_EQ(tri[i], expectedTri[i]) << "ray " << i;
+		}
+	}
+}
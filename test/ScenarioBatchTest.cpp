@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Core/ThreadPool.h>
+#include <Function/AgentNav/RCScenarioBatch.h>
+
+using namespace GU;
+
+namespace
+{
+	const int RUNS = 4;
+	const uint64_t BASE_SEED = 7;
+
+	RCScenarioSpec smallSpec()
+	{
+		RCScenarioSpec spec;
+		spec.agentCount = 30;
+		spec.agentParams = NavTest::agentParams();
+		spec.dt = 1.0f / 30.0f;
+		spec.maxTicks = 1500;
+		// one exit in the band between the first two walls
+		spec.exits = { 30.0f, 0.0f, 22.0f };
+		return spec;
+	}
+
+	void expectSameResults(const std::vector<RCScenarioResult>& a, const std::vector<RCScenarioResult>& b)
+	{
+		ASSERT_EQ(a.size(), b.size());
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			EXPECT_EQ(a[i].seed, b[i].seed);
+			EXPECT_EQ(a[i].agents, b[i].agents);
+			EXPECT_EQ(a[i].arrived, b[i].arrived);
+			EXPECT_EQ(a[i].ticks, b[i].ticks);
+			EXPECT_EQ(a[i].agentUpdates, b[i].agentUpdates);
+			EXPECT_EQ(a[i].evacuationTime, b[i].evacuationTime);
+			EXPECT_EQ(a[i].peakDensity, b[i].peakDensity);
+			EXPECT_TRUE(a[i].arrivalTimes == b[i].arrivalTimes);
+			EXPECT_TRUE(a[i].pathLengths == b[i].pathLengths);
+		}
+	}
+}
+
+// A seed gives the same run again, whether the runs go one by one or on the pool
+TEST(ScenarioBatchTest, RunsAreReproducible)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCScenarioBatch batch;
+	ASSERT_TRUE(batch.init(scene.navMesh, 0.6f, scene.filter));
+	const RCScenarioSpec spec = smallSpec();
+
+	const std::vector<RCScenarioResult> serial = batch.run(spec, RUNS, BASE_SEED);
+	ASSERT_EQ((int)serial.size(), RUNS);
+	for (int i = 0; i < RUNS; i++)
+	{
+		EXPECT_EQ(serial[i].seed, BASE_SEED + i);
+		EXPECT_EQ(serial[i].agents, spec.agentCount);
+		EXPECT_GT(serial[i].arrived, 0);
+	}
+	// different seeds spawn different crowds
+	EXPECT_TRUE(serial[0].arrivalTimes != serial[1].arrivalTimes);
+
+	expectSameResults(serial, batch.run(spec, RUNS, BASE_SEED));
+	ThreadPool pool(4);
+	expectSameResults(serial, batch.run(spec, RUNS, BASE_SEED, &pool, 4));
+}
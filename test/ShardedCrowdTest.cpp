@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include "NavTestScene.h"
+#include <Core/ThreadPool.h>
+#include <Function/AgentNav/RCCrowd.h>
+#include <Function/AgentNav/RCShardedCrowd.h>
+#include <algorithm>
+
+using namespace GU;
+
+namespace
+{
+	const float DT = 1.0f / 30.0f;
+	const int TICKS = 1200;
+
+	// agents meeting head-on at x = 30, the border of a 2 x 2 sharding, in the open
+	// band between the first two walls
+	void crossingAgents(std::vector<float>& starts, std::vector<float>& ends)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			const float z = 17.0f + i * 2.0f;
+			starts.insert(starts.end(), { 8.0f, 0.0f, z, 52.0f, 0.0f, z + 1.0f });
+			ends.insert(ends.end(), { 52.0f, 0.0f, z, 8.0f, 0.0f, z + 1.0f });
+		}
+	}
+
+	struct Run
+	{
+		std::vector<float> trace;	// positions of every agent after every tick
+		std::vector<float> last;
+		float maxPenetration = 0.0f;
+	};
+
+	// same agents and targets on both crowd types, update(crowd) ticks it once
+	template<typename Crowd, typename Update>
+	Run simulate(Crowd& crowd, const NavTest::Scene& scene, Update update)
+	{
+		std::vector<float> starts, ends;
+		crossingAgents(starts, ends);
+		const int n = (int)starts.size() / 3;
+		const dtCrowdAgentParams ap = NavTest::agentParams();
+		std::vector<int> idx(n);
+		for (int i = 0; i < n; i++)
+		{
+			dtPolyRef ref;
+			float pos[3], target[3];
+			scene.findPoly(starts[i * 3], starts[i * 3 + 2], ref, pos);
+			idx[i] = crowd.addAgent(pos, &ap);
+			scene.findPoly(ends[i * 3], ends[i * 3 + 2], ref, target);
+			crowd.requestMoveTarget(idx[i], ref, target);
+		}
+
+		Run run;
+		run.last.resize(n * 3);
+		for (int tick = 0; tick < TICKS; tick++)
+		{
+			update(crowd);
+			for (int i = 0; i < n; i++)
+			{
+				const float* p = crowd.getAgent(idx[i])->npos;
+				run.trace.insert(run.trace.end(), p, p + 3);
+				for (int j = 0; j < i; j++)
+				{
+					const float* q = crowd.getAgent(idx[j])->npos;
+					const float dist = sqrtf(dtSqr(p[0] - q[0]) + dtSqr(p[2] - q[2]));
+					run.maxPenetration = std::max(run.maxPenetration, 2.0f * ap.radius - dist);
+				}
+			}
+		}
+		std::copy(run.trace.end() - n * 3, run.trace.end(), run.last.begin());
+		return run;
+	}
+
+	void initShards(RCShardedCrowd& crowd, dtNavMesh* navMesh, int nshards)
+	{
+		crowd.init(64, 0.6f, navMesh, nshards, nshards);
+		for (int i = 0; i < crowd.getShardCount(); i++)
+			crowd.getShard(i)->initAvoidanceQualities();
+	}
+}
+
+// One shard runs the same code as the single crowd, step for step
+TEST(ShardedCrowdTest, OneShardMatchesSingleCrowd)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCCrowd single;
+	ASSERT_TRUE(single.init(64, 0.6f, scene.navMesh));
+	single.initAvoidanceQualities();
+	RCShardedCrowd sharded;
+	initShards(sharded, scene.navMesh, 1);
+	ASSERT_EQ(sharded.getShardCount(), 1);
+
+	const Run a = simulate(single, scene, [](RCCrowd& crowd) { crowd.update(DT, nullptr); });
+	const Run b = simulate(sharded, scene, [](RCShardedCrowd& crowd) { crowd.update(DT, nullptr); });
+	EXPECT_TRUE(a.trace == b.trace);
+}
+
+// The shards update in parallel, the result does not depend on the pool
+TEST(ShardedCrowdTest, ShardsAreDeterministic)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	ThreadPool pool(4);
+	RCShardedCrowd serial, parallel;
+	initShards(serial, scene.navMesh, 2);
+	initShards(parallel, scene.navMesh, 2);
+
+	const Run a = simulate(serial, scene, [](RCShardedCrowd& crowd) { crowd.update(DT, nullptr); });
+	const Run b = simulate(parallel, scene, [&](RCShardedCrowd& crowd) { crowd.update(DT, &pool); });
+	EXPECT_TRUE(a.trace == b.trace);
+}
+
+// Agents across the border avoid and push each other through the proxies as in the single crowd
+TEST(ShardedCrowdTest, ShardsMatchSingleCrowd)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	RCCrowd single;
+	ASSERT_TRUE(single.init(64, 0.6f, scene.navMesh));
+	single.initAvoidanceQualities();
+	RCShardedCrowd sharded;
+	initShards(sharded, scene.navMesh, 2);
+
+	int maxProxies = 0;
+	const Run a = simulate(single, scene, [](RCCrowd& crowd) { crowd.update(DT, nullptr); });
+	const Run b = simulate(sharded, scene, [&](RCShardedCrowd& crowd)
+	{
+		crowd.update(DT, nullptr);
+		maxProxies = std::max(maxProxies, crowd.getProxyCount());
+	});
+	EXPECT_GT(maxProxies, 0);
+
+	std::vector<float> starts, ends;
+	crossingAgents(starts, ends);
+	for (int i = 0; i < (int)ends.size() / 3; i++)
+	{
+		// everyone crossed the border and arrived in both crowds
+		EXPECT_LT(dtVdist2D(&a.last[i * 3], &ends[i * 3]), 1.0f);
+		EXPECT_LT(dtVdist2D(&b.last[i * 3], &ends[i * 3]), 1.0f);
+		EXPECT_EQ(sharded.getShardOf(i), ends[i * 3] > 30.0f ? 1 : 0);
+	}
+	// without the proxies head-on agents walk through each other at the border
+	EXPECT_LT(b.maxPenetration, a.maxPenetration + 0.3f);
+}
+
+// A crowded shard grows past its share while global ids are free, its agents keep their state
+TEST(ShardedCrowdTest, FullShardGrows)
+{
+	NavTest::Scene scene;
+	ASSERT_NE(scene.navMesh, nullptr);
+	const int maxAgents = 1024;
+	RCShardedCrowd crowd;
+	ASSERT_TRUE(crowd.init(maxAgents, 0.6f, scene.navMesh, 4, 4));
+	const dtCrowdAgentParams ap = NavTest::agentParams();
+	dtPolyRef ref, targetRef;
+	float pos[3], target[3];
+	ASSERT_TRUE(scene.findPoly(8.0f, 17.0f, ref, pos));
+	ASSERT_TRUE(scene.findPoly(52.0f, 17.0f, targetRef, target));
+
+	const int first = crowd.addAgent(pos, &ap);
+	ASSERT_GE(first, 0);
+	ASSERT_TRUE(crowd.requestMoveTarget(first, targetRef, target));
+	for (int i = 1; i < maxAgents; i++)
+		ASSERT_GE(crowd.addAgent(pos, &ap), 0) << i;
+	EXPECT_EQ(crowd.getActiveAgentCount(), maxAgents);
+	EXPECT_EQ(crowd.addAgent(pos, &ap), -1);
+
+	EXPECT_EQ(crowd.getShardOf(maxAgents - 1), crowd.getShardOf(first));
+	EXPECT_TRUE(crowd.getAgent(first)->active);
+	EXPECT_NE(crowd.getAgent(first)->targetState, DT_CROWDAGENT_TARGET_NONE);
+	crowd.update(DT, nullptr);
+	EXPECT_EQ(crowd.getActiveAgentCount(), maxAgents);
+}
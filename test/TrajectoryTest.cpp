@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <Function/AgentNav/RCTrajectory.h>
+#include <Function/AgentNav/RCSimLoop.h>
+#include <cmath>
+#include <filesystem>
+
+using namespace GU;
+
+namespace
+{
+	const int AGENTS = 8;
+	const int TICKS = 60;
+	const float DT = 1.0f / 30.0f;
+
+	// agents on circles of different radius, slot 3 leaves at tick 20 and comes back
+	// at 40, slot 5 jumps 25 m at tick 30 so its residuals need the varint escape
+	void makeFrame(uint64_t tick, RCTrajectoryFrame& frame)
+	{
+		frame.tick = tick;
+		frame.dt = DT;
+		frame.resize(AGENTS);
+		for (int i = 0; i < AGENTS; i++)
+		{
+			const float r = 5.0f + i;
+			const float w = 0.05f / DT;
+			const float a = tick * 0.05f + i;
+			float* p = &frame.pos[i * 3];
+			float* v = &frame.vel[i * 3];
+			p[0] = 30.0f + r * cosf(a);
+			p[1] = 0.5f;
+			p[2] = 30.0f + r * sinf(a);
+			v[0] = -r * w * sinf(a);
+			v[1] = 0.0f;
+			v[2] = r * w * cosf(a);
+			if (i == 5 && tick >= 30) p[0] += 25.0f;
+			frame.state[i] = RC_AGENT_WALKING;
+			if (i == 3 && tick >= 20 && tick < 40) frame.state[i] = RC_AGENT_INACTIVE;
+		}
+	}
+
+	void expectFrame(const RCTrajectoryFrame& expected, const RCTrajectoryFrame& frame, float posQuant, float velQuant)
+	{
+		ASSERT_EQ(frame.tick, expected.tick);
+		EXPECT_EQ(frame.dt, expected.dt);
+		ASSERT_EQ(frame.agentCount, expected.agentCount);
+		for (int i = 0; i < expected.agentCount; i++)
+		{
+			ASSERT_EQ(frame.state[i], expected.state[i]);
+			if (expected.state[i] == RC_AGENT_INACTIVE) continue;
+			for (int j = 0; j < 3; j++)
+			{
+				EXPECT_NEAR(frame.pos[i * 3 + j], expected.pos[i * 3 + j], posQuant * 0.5f + 1e-4f);
+				EXPECT_NEAR(frame.vel[i * 3 + j], expected.vel[i * 3 + j], velQuant * 0.5f + 1e-4f);
+			}
+		}
+	}
+}
+
+// Every tick decodes to the recorded state within half a quantization step
+TEST(TrajectoryTest, CodecRoundTrip)
+{
+	RCTrajectoryCodec encoder;
+	std::vector<uint8_t> data;
+	RCTrajectoryFrame frame;
+	for (int tick = 1; tick <= TICKS; tick++)
+	{
+		makeFrame(tick, frame);
+		encoder.encode(frame, data);
+	}
+	// steadily walking agents cost a byte or two per tick
+	EXPECT_LT(data.size(), (size_t)(TICKS * AGENTS * 4));
+
+	RCTrajectoryCodec decoder;
+	const uint8_t* cursor = data.data();
+	const uint8_t* end = data.data() + data.size();
+	RCTrajectoryFrame expected, decoded;
+	for (int tick = 1; tick <= TICKS; tick++)
+	{
+		makeFrame(tick, expected);
+		ASSERT_TRUE(decoder.decode(cursor, end, decoded));
+		expectFrame(expected, decoded, decoder.posQuant, decoder.velQuant);
+	}
+	EXPECT_EQ(cursor, end);
+}
+
+// A tick cut short is reported instead of decoded from past the buffer
+TEST(TrajectoryTest, CodecRejectsTruncatedTick)
+{
+	RCTrajectoryCodec encoder;
+	std::vector<uint8_t> data;
+	RCTrajectoryFrame frame;
+	makeFrame(1, frame);
+	encoder.encode(frame, data);
+
+	RCTrajectoryCodec decoder;
+	const uint8_t* cursor = data.data();
+	EXPECT_FALSE(decoder.decode(cursor, data.data() + data.size() - 1, frame));
+}
+
+// Recorded chunks read back in order, seek starts at the chunk holding the tick
+TEST(TrajectoryTest, FileRoundTripAndSeek)
+{
+	const std::filesystem::path filepath = std::filesystem::temp_directory_path() / "RCTrajectoryTest.bin";
+	RCTrajectoryRecorder recorder;
+	ASSERT_TRUE(recorder.open(filepath, 0.01f, 0.05f, 16));
+	RCTrajectoryFrame expected;
+	for (int tick = 1; tick <= TICKS; tick++)
+	{
+		makeFrame(tick, expected);
+		RCTrajectoryFrame& frame = recorder.beginFrame(tick, DT, AGENTS);
+		frame.pos = expected.pos;
+		frame.vel = expected.vel;
+		frame.state = expected.state;
+		recorder.commitFrame();
+	}
+	EXPECT_TRUE(recorder.close());
+	EXPECT_FALSE(recorder.hasFailed());
+	EXPECT_EQ(recorder.getTickCount(), (uint64_t)TICKS);
+
+	{
+		RCTrajectoryReader reader;
+		ASSERT_TRUE(reader.open(filepath));
+		RCTrajectoryFrame frame;
+		for (int tick = 1; tick <= TICKS; tick++)
+		{
+			makeFrame(tick, expected);
+			ASSERT_TRUE(reader.next(frame));
+			expectFrame(expected, frame, reader.getPosQuant(), reader.getVelQuant());
+		}
+		EXPECT_FALSE(reader.next(frame));
+
+		// chunks of 16 ticks start at 1, 17, 33 and 49
+		ASSERT_TRUE(reader.seek(40));
+		ASSERT_TRUE(reader.next(frame));
+		makeFrame(33, expected);
+		expectFrame(expected, frame, reader.getPosQuant(), reader.getVelQuant());
+		EXPECT_FALSE(reader.seek(TICKS + 1));
+	}
+	std::filesystem::remove(filepath);
+}